@@ -0,0 +1,203 @@
+#include "Baseline.h"
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <cctype>
+
+namespace fs = std::filesystem;
+
+namespace Baseline
+{
+
+// Minimal parser that only supports what Save produces: objects, strings without escape
+// sequences and numbers
+class Parser
+{
+public:
+    Parser(const std::string &text)
+        : m_Text(text) {}
+
+    Entries Parse()
+    {
+        Entries entries;
+
+        Expect('{');
+        if (Peek() == '}')
+        {
+            Expect('}');
+            return entries;
+        }
+
+        for (;;)
+        {
+            std::string name = ParseString();
+            Expect(':');
+            entries[name] = ParseMetrics();
+
+            if (Peek() == ',')
+            {
+                Expect(',');
+                continue;
+            }
+
+            Expect('}');
+            return entries;
+        }
+    }
+
+private:
+    const std::string &m_Text;
+    size_t m_Pos = 0;
+
+    Metrics ParseMetrics()
+    {
+        Metrics metrics;
+
+        Expect('{');
+        if (Peek() == '}')
+        {
+            Expect('}');
+            return metrics;
+        }
+
+        for (;;)
+        {
+            std::string name = ParseString();
+            Expect(':');
+            metrics[name] = ParseNumber();
+
+            if (Peek() == ',')
+            {
+                Expect(',');
+                continue;
+            }
+
+            Expect('}');
+            return metrics;
+        }
+    }
+
+    std::string ParseString()
+    {
+        Expect('"');
+
+        size_t endPos = m_Text.find('"', m_Pos);
+        if (endPos == std::string::npos)
+            throw std::runtime_error("Unterminated string in baseline");
+
+        std::string result = m_Text.substr(m_Pos, endPos - m_Pos);
+        m_Pos = endPos + 1;
+
+        return result;
+    }
+
+    double ParseNumber()
+    {
+        SkipWhitespace();
+
+        size_t parsedCharacters = 0;
+        double result = std::stod(m_Text.substr(m_Pos), &parsedCharacters);
+        m_Pos += parsedCharacters;
+
+        return result;
+    }
+
+    char Peek()
+    {
+        SkipWhitespace();
+
+        if (m_Pos >= m_Text.size())
+            throw std::runtime_error("Unexpected end of baseline");
+
+        return m_Text[m_Pos];
+    }
+
+    void Expect(char character)
+    {
+        if (Peek() != character)
+            throw std::runtime_error(std::string("Expected '") + character + "' at offset " + std::to_string(m_Pos) + " in baseline");
+
+        m_Pos++;
+    }
+
+    void SkipWhitespace()
+    {
+        while (m_Pos < m_Text.size() && std::isspace(static_cast<unsigned char>(m_Text[m_Pos])))
+            m_Pos++;
+    }
+};
+
+Entries Load(const fs::path &path)
+{
+    std::ifstream file(path);
+    if (file.fail())
+        throw std::runtime_error("Couldn't open baseline: " + path.string());
+
+    std::stringstream content;
+    content << file.rdbuf();
+
+    std::string text = content.str();
+
+    return Parser(text).Parse();
+}
+
+void Save(const fs::path &path, const std::vector<BenchmarkRunner::Result> &results)
+{
+    std::ofstream file(path);
+    if (file.fail())
+        throw std::runtime_error("Couldn't create baseline: " + path.string());
+
+    file << std::fixed << std::setprecision(1);
+    file << "{\n";
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchmarkRunner::Result &result = results[i];
+
+        file << "  \"" << result.Name << "\": { ";
+        file << "\"p50\": " << result.Percentile(50.0) << ", ";
+        file << "\"p90\": " << result.Percentile(90.0) << ", ";
+        file << "\"p99\": " << result.Percentile(99.0) << ", ";
+        file << "\"mean\": " << result.Mean() << " }";
+        file << (i != results.size() - 1 ? ",\n" : "\n");
+    }
+
+    file << "}\n";
+}
+
+bool Compare(const Entries &baseline, const std::vector<BenchmarkRunner::Result> &results, double threshold)
+{
+    bool success = true;
+
+    std::cout << '\n';
+    std::cout << std::left << std::setw(32) << "Benchmark";
+    std::cout << std::right << std::setw(16) << "baseline p50" << std::setw(16) << "current p50" << std::setw(12) << "change" << '\n';
+
+    for (auto &result : results)
+    {
+        auto entry = baseline.find(result.Name);
+        if (entry == baseline.end() || entry->second.find("p50") == entry->second.end())
+            continue;
+
+        double baselineMedian = entry->second.at("p50");
+        double currentMedian = result.Percentile(50.0);
+        double change = baselineMedian > 0.0 ? (currentMedian - baselineMedian) / baselineMedian * 100.0 : 0.0;
+        bool regressed = change > threshold;
+
+        std::cout << std::left << std::setw(32) << result.Name;
+        std::cout << std::right << std::fixed << std::setprecision(0);
+        std::cout << std::setw(16) << baselineMedian << std::setw(16) << currentMedian;
+        std::cout << std::setprecision(1) << std::showpos << std::setw(11) << change << '%' << std::noshowpos;
+        std::cout << (regressed ? "  REGRESSION" : "") << '\n';
+
+        if (regressed)
+            success = false;
+    }
+
+    return success;
+}
+
+}
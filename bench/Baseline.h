@@ -0,0 +1,27 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "BenchmarkRunner.h"
+
+// A baseline is a JSON file that maps each benchmark name to its metrics, for example:
+// { "GetType": { "p50": 10234.5, "p90": 10456.1, "p99": 10987.2, "mean": 10301.7 } }
+// All the metrics are expressed in microseconds.
+namespace Baseline
+{
+
+using Metrics = std::map<std::string, double>;
+using Entries = std::map<std::string, Metrics>;
+
+Entries Load(const std::filesystem::path &path);
+
+void Save(const std::filesystem::path &path, const std::vector<BenchmarkRunner::Result> &results);
+
+// Compares the median of each result to the one stored in the baseline and returns false
+// if at least one of them is slower than the baseline by more than threshold percent.
+bool Compare(const Entries &baseline, const std::vector<BenchmarkRunner::Result> &results, double threshold);
+
+}
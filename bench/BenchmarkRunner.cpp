@@ -0,0 +1,116 @@
+#include "BenchmarkRunner.h"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <cmath>
+
+void BenchmarkRunner::AddBenchmark(
+    const std::string &name,
+    size_t iterations,
+    uint64_t bytesPerIteration,
+    BenchmarkFunction function,
+    BenchmarkFunction teardown
+)
+{
+    m_Benchmarks.push_back({ name, iterations, bytesPerIteration, function, teardown });
+}
+
+std::vector<BenchmarkRunner::Result> BenchmarkRunner::RunBenchmarks(const std::string &filter)
+{
+    std::vector<Result> results;
+
+    std::cout << std::left << std::setw(32) << "Benchmark";
+    std::cout << std::right << std::setw(8) << "Runs";
+    std::cout << std::setw(12) << "p50 (us)" << std::setw(12) << "p90 (us)" << std::setw(12) << "p99 (us)";
+    std::cout << std::setw(12) << "ops/s" << std::setw(12) << "MB/s" << '\n';
+
+    for (auto &benchmark : m_Benchmarks)
+    {
+        if (!filter.empty() && benchmark.Name.find(filter) == std::string::npos)
+            continue;
+
+        try
+        {
+            Result result = Run(benchmark);
+            DisplayResult(result);
+            results.push_back(result);
+        }
+        catch (const std::exception &exception)
+        {
+            std::cout << std::left << std::setw(32) << benchmark.Name << "FAILED. Error: " << exception.what() << '\n';
+            m_FailingBenchmarks++;
+        }
+    }
+
+    return results;
+}
+
+BenchmarkRunner::Result BenchmarkRunner::Run(const Benchmark &benchmark)
+{
+    Result result;
+    result.Name = benchmark.Name;
+    result.BytesPerIteration = benchmark.BytesPerIteration;
+    result.Samples.reserve(benchmark.Iterations);
+
+    for (size_t i = 0; i < benchmark.Iterations; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        benchmark.Function();
+        auto end = std::chrono::steady_clock::now();
+
+        result.Samples.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+
+        if (benchmark.Teardown)
+            benchmark.Teardown();
+    }
+
+    std::sort(result.Samples.begin(), result.Samples.end());
+
+    return result;
+}
+
+void BenchmarkRunner::DisplayResult(const Result &result)
+{
+    double mean = result.Mean();
+    double operationsPerSecond = mean > 0.0 ? 1000000.0 / mean : 0.0;
+    double megabytesPerSecond = static_cast<double>(result.BytesPerIteration) * operationsPerSecond / (1024.0 * 1024.0);
+
+    std::cout << std::left << std::setw(32) << result.Name;
+    std::cout << std::right << std::setw(8) << result.Samples.size();
+    std::cout << std::fixed << std::setprecision(0);
+    std::cout << std::setw(12) << result.Percentile(50.0);
+    std::cout << std::setw(12) << result.Percentile(90.0);
+    std::cout << std::setw(12) << result.Percentile(99.0);
+    std::cout << std::setprecision(1);
+    std::cout << std::setw(12) << operationsPerSecond;
+
+    if (result.BytesPerIteration > 0)
+        std::cout << std::setw(12) << megabytesPerSecond;
+    else
+        std::cout << std::setw(12) << '-';
+
+    std::cout << '\n';
+}
+
+double BenchmarkRunner::Result::Percentile(double percentile) const
+{
+    if (Samples.empty())
+        return 0.0;
+
+    // Nearest-rank method, the samples are already sorted
+    size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0 * static_cast<double>(Samples.size())));
+    size_t index = std::clamp<size_t>(rank, 1, Samples.size()) - 1;
+
+    return Samples[index];
+}
+
+double BenchmarkRunner::Result::Mean() const
+{
+    if (Samples.empty())
+        return 0.0;
+
+    return std::accumulate(Samples.begin(), Samples.end(), 0.0) / static_cast<double>(Samples.size());
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+
+class BenchmarkRunner
+{
+    using BenchmarkFunction = std::function<void()>;
+
+    struct Benchmark
+    {
+        std::string Name;
+        size_t Iterations = 0;
+        uint64_t BytesPerIteration = 0;
+        BenchmarkFunction Function = BenchmarkFunction();
+        BenchmarkFunction Teardown = BenchmarkFunction();
+    };
+
+public:
+    struct Result
+    {
+        std::string Name;
+        uint64_t BytesPerIteration = 0;
+
+        // Duration of each iteration in microseconds, sorted in ascending order
+        std::vector<double> Samples;
+
+        double Percentile(double percentile) const;
+        double Mean() const;
+    };
+
+    BenchmarkRunner() = default;
+
+    // The teardown function is called after each iteration and is not included in the measurements
+    void AddBenchmark(
+        const std::string &name,
+        size_t iterations,
+        uint64_t bytesPerIteration,
+        BenchmarkFunction function,
+        BenchmarkFunction teardown = BenchmarkFunction()
+    );
+
+    std::vector<Result> RunBenchmarks(const std::string &filter = "");
+
+    inline size_t GetFailureCount() const { return m_FailingBenchmarks; }
+
+private:
+    size_t m_FailingBenchmarks = 0;
+    std::vector<Benchmark> m_Benchmarks;
+
+    Result Run(const Benchmark &benchmark);
+    void DisplayResult(const Result &result);
+};
@@ -0,0 +1,499 @@
+#include "BenchmarkRunner.h"
+#include "Baseline.h"
+#include "XBDM.h"
+#include "TestServer.h"
+#include "DiskStorage.h"
+#include "MemoryStorage.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <cstdlib>
+
+namespace fs = std::filesystem;
+
+struct Options
+{
+    size_t CommandIterations = 100;
+    size_t TransferIterations = 3;
+    uint64_t MinFileSize = 1024;
+    uint64_t MaxFileSize = 256 * 1024;
+    size_t TreeWidth = 3;
+    size_t TreeDepth = 2;
+    uint64_t TreeFileSize = 1024;
+    std::string Filter;
+    fs::path BaselinePath;
+    fs::path SaveBaselinePath;
+    double Threshold = 10.0;
+    bool InMemoryStorage = false;
+    fs::path RecordPath;
+    fs::path TimelinePath;
+    TestServer::NetworkConditions NetworkConditions;
+};
+
+static void PrintUsage(const char *programName)
+{
+    std::cout << "Usage: " << programName << " [options]\n";
+    std::cout << "  --iterations <n>           Iterations of each command benchmark (default: 100)\n";
+    std::cout << "  --transfer-iterations <n>  Iterations of each transfer benchmark (default: 3)\n";
+    std::cout << "  --min-size <size>          Smallest file transferred, e.g. 1K (default: 1K)\n";
+    std::cout << "  --max-size <size>          Largest file transferred, e.g. 1G (default: 256K)\n";
+    std::cout << "  --tree-width <n>           Files and subdirectories per directory (default: 3)\n";
+    std::cout << "  --tree-depth <n>           Levels of subdirectories (default: 2)\n";
+    std::cout << "  --tree-file-size <size>    Size of the files in the generated trees (default: 1K)\n";
+    std::cout << "  --filter <text>            Only run the benchmarks whose name contains text\n";
+    std::cout << "  --baseline <path>          Compare the results with a baseline\n";
+    std::cout << "  --save-baseline <path>     Save the results as a new baseline\n";
+    std::cout << "  --threshold <percent>      Allowed median slowdown compared to the baseline (default: 10)\n";
+    std::cout << "  --storage <disk|memory>    Where the test server stores its files (default: disk)\n";
+    std::cout << "  --record <path>            Record the session of the benchmarked console to a trace\n";
+    std::cout << "  --timeline <path>          Save a timeline of the benchmarks in the Chrome trace event format\n";
+    std::cout << "  --latency <ms>             Simulated delay before each reply (default: 0)\n";
+    std::cout << "  --jitter <ms>              Upper bound of a random delay added to the latency (default: 0)\n";
+    std::cout << "  --seed <n>                 Seed of the jitter generator (default: 0)\n";
+    std::cout << "  --bandwidth <size>         Simulated bytes per second in each direction, e.g. 10M (default: unlimited)\n";
+    std::cout << "  --segment-size <size>      Size of the segments replies are split into (default: 1K)\n";
+    std::cout << "  --delayed-ack <ms>         Delay before the last small segment of a reply (default: 0)\n";
+}
+
+static uint64_t ParseSize(const std::string &size)
+{
+    size_t parsedCharacters = 0;
+    uint64_t value = std::stoull(size, &parsedCharacters);
+    std::string suffix = size.substr(parsedCharacters);
+
+    if (suffix.empty() || suffix == "B")
+        return value;
+    if (suffix == "K" || suffix == "KB")
+        return value * 1024;
+    if (suffix == "M" || suffix == "MB")
+        return value * 1024 * 1024;
+    if (suffix == "G" || suffix == "GB")
+        return value * 1024 * 1024 * 1024;
+
+    throw std::invalid_argument("Invalid size: " + size);
+}
+
+static std::string FormatSize(uint64_t size)
+{
+    if (size >= 1024 * 1024 * 1024 && size % (1024 * 1024 * 1024) == 0)
+        return std::to_string(size / (1024 * 1024 * 1024)) + "G";
+    if (size >= 1024 * 1024 && size % (1024 * 1024) == 0)
+        return std::to_string(size / (1024 * 1024)) + "M";
+    if (size >= 1024 && size % 1024 == 0)
+        return std::to_string(size / 1024) + "K";
+
+    return std::to_string(size) + "B";
+}
+
+static Options ParseOptions(int argc, char **argv)
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string option = argv[i];
+
+        if (option == "--help")
+        {
+            PrintUsage(argv[0]);
+            exit(0);
+        }
+
+        if (i + 1 >= argc)
+            throw std::invalid_argument("Missing value for " + option);
+
+        std::string value = argv[++i];
+
+        if (option == "--iterations")
+            options.CommandIterations = std::stoul(value);
+        else if (option == "--transfer-iterations")
+            options.TransferIterations = std::stoul(value);
+        else if (option == "--min-size")
+            options.MinFileSize = ParseSize(value);
+        else if (option == "--max-size")
+            options.MaxFileSize = ParseSize(value);
+        else if (option == "--tree-width")
+            options.TreeWidth = std::stoul(value);
+        else if (option == "--tree-depth")
+            options.TreeDepth = std::stoul(value);
+        else if (option == "--tree-file-size")
+            options.TreeFileSize = ParseSize(value);
+        else if (option == "--filter")
+            options.Filter = value;
+        else if (option == "--baseline")
+            options.BaselinePath = value;
+        else if (option == "--save-baseline")
+            options.SaveBaselinePath = value;
+        else if (option == "--threshold")
+            options.Threshold = std::stod(value);
+        else if (option == "--storage")
+        {
+            if (value != "disk" && value != "memory")
+                throw std::invalid_argument("Invalid storage: " + value);
+
+            options.InMemoryStorage = value == "memory";
+        }
+        else if (option == "--record")
+            options.RecordPath = value;
+        else if (option == "--timeline")
+            options.TimelinePath = value;
+        else if (option == "--latency")
+            options.NetworkConditions.Latency = std::chrono::milliseconds(std::stoul(value));
+        else if (option == "--jitter")
+            options.NetworkConditions.Jitter = std::chrono::milliseconds(std::stoul(value));
+        else if (option == "--seed")
+            options.NetworkConditions.Seed = static_cast<uint32_t>(std::stoul(value));
+        else if (option == "--bandwidth")
+            options.NetworkConditions.Bandwidth = ParseSize(value);
+        else if (option == "--segment-size")
+            options.NetworkConditions.SegmentSize = static_cast<size_t>(ParseSize(value));
+        else if (option == "--delayed-ack")
+            options.NetworkConditions.DelayedAck = std::chrono::milliseconds(std::stoul(value));
+        else
+            throw std::invalid_argument("Unknown option: " + option);
+    }
+
+    return options;
+}
+
+static void GenerateFile(const fs::path &path, uint64_t size)
+{
+    std::ofstream file(path, std::ofstream::binary);
+    if (file.fail())
+        throw std::runtime_error("Couldn't create file: " + path.string());
+
+    // Random content so that nothing along the way can take advantage of repeated patterns
+    std::mt19937 generator(static_cast<uint32_t>(size));
+    std::vector<uint32_t> buffer(64 * 1024);
+
+    for (uint64_t written = 0; written < size;)
+    {
+        for (auto &word : buffer)
+            word = generator();
+
+        uint64_t toWrite = std::min<uint64_t>(size - written, buffer.size() * sizeof(uint32_t));
+        file.write(reinterpret_cast<const char *>(buffer.data()), static_cast<std::streamsize>(toWrite));
+        written += toWrite;
+    }
+}
+
+// Creates width files and width subdirectories in path, and recursively does the same in
+// each subdirectory until depth reaches 0. Returns the total number of files created.
+static size_t GenerateTree(const fs::path &path, size_t width, size_t depth, uint64_t fileSize)
+{
+    size_t fileCount = 0;
+
+    fs::create_directories(path);
+
+    for (size_t i = 0; i < width; i++)
+    {
+        GenerateFile(path / ("file" + std::to_string(i) + ".bin"), fileSize);
+        fileCount++;
+
+        if (depth > 0)
+            fileCount += GenerateTree(path / ("directory" + std::to_string(i)), width, depth - 1, fileSize);
+    }
+
+    return fileCount;
+}
+
+// Returns the number of files GenerateTree would create
+static size_t CountTreeFiles(size_t width, size_t depth)
+{
+    return width * (1 + (depth > 0 ? CountTreeFiles(width, depth - 1) : 0));
+}
+
+// Creates the directories of the server that don't exist yet, one level at a time
+static void CreateServerDirectories(Storage &storage, const fs::path &path)
+{
+    fs::path currentPath;
+    for (const fs::path &component : path)
+    {
+        currentPath /= component;
+        if (!storage.Exists(currentPath.string()))
+            storage.CreateDirectory(currentPath.string());
+    }
+}
+
+// Shows where the time of the benchmarks went, command by command
+static void PrintCommandStats(const std::vector<XBDM::CommandStats> &stats)
+{
+    std::cout << '\n';
+    std::cout << std::left << std::setw(32) << "Command";
+    std::cout << std::right << std::setw(8) << "Calls" << std::setw(8) << "Errors";
+    std::cout << std::setw(12) << "mean (us)" << std::setw(12) << "p99 (us)" << std::setw(12) << "in recv";
+    std::cout << std::setw(12) << "sent (KB)" << std::setw(12) << "recv (KB)" << '\n';
+
+    for (const auto &commandStats : stats)
+    {
+        double receiveRatio = commandStats.TotalLatency.count() > 0 ? 100.0 * commandStats.ReceiveTime.count() / commandStats.TotalLatency.count() : 0.0;
+
+        std::cout << std::left << std::setw(32) << commandStats.Name;
+        std::cout << std::right << std::setw(8) << commandStats.Calls << std::setw(8) << commandStats.Errors;
+        std::cout << std::fixed << std::setprecision(0);
+        std::cout << std::setw(12) << std::chrono::duration_cast<std::chrono::microseconds>(commandStats.MeanLatency()).count();
+        std::cout << std::setw(12) << commandStats.LatencyPercentile(99.0).count();
+        std::cout << std::setw(11) << receiveRatio << '%';
+        std::cout << std::setw(12) << commandStats.BytesSent / 1024 << std::setw(12) << commandStats.BytesReceived / 1024 << '\n';
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+
+    try
+    {
+        options = ParseOptions(argc, argv);
+    }
+    catch (const std::exception &exception)
+    {
+        std::cerr << exception.what() << '\n';
+        PrintUsage(argv[0]);
+        return 2;
+    }
+
+    // Both sides of the transfers live in a temporary directory, the server side is only
+    // used when the test server serves files straight from the local file system
+    fs::path workingDirectory = fs::temp_directory_path() / "XBDMBenchmarks";
+    fs::path serverDirectory = workingDirectory / "server";
+    fs::path clientDirectory = workingDirectory / "client";
+    fs::remove_all(workingDirectory);
+    fs::create_directories(serverDirectory);
+    fs::create_directories(clientDirectory);
+
+    // Set the benchmarking environment up
+    TestServer server;
+    BenchmarkRunner runner;
+
+    server.SetNetworkConditions(options.NetworkConditions);
+
+    // With the in-memory storage, the files on the server side are generated on the fly which
+    // takes the disk out of the measurements and makes huge files and trees free to create
+    std::shared_ptr<MemoryStorage> memoryStorage;
+    std::shared_ptr<Storage> storage = std::make_shared<DiskStorage>();
+    if (options.InMemoryStorage)
+    {
+        memoryStorage = std::make_shared<MemoryStorage>();
+        storage = memoryStorage;
+        CreateServerDirectories(*storage, serverDirectory);
+    }
+
+    server.SetStorage(storage);
+
+    auto generateServerFile = [&](const fs::path &path, uint64_t size) {
+        if (memoryStorage != nullptr)
+            memoryStorage->AddGeneratedFile(path.string(), size);
+        else
+            GenerateFile(path, size);
+    };
+
+    std::thread thread(std::bind(&TestServer::Start, &server));
+    server.WaitForServerToListen();
+
+    XBDM::Console console("127.0.0.1");
+    if (!options.RecordPath.empty())
+        console.StartRecording(options.RecordPath);
+
+    auto timeline = std::make_shared<XBDM::Timeline>();
+    if (!options.TimelinePath.empty())
+        console.SetTimeline(timeline);
+
+    if (!console.OpenConnection())
+    {
+        std::cerr << "Couldn't connect to the test server\n";
+        server.RequestShutdown();
+        thread.join();
+        return 1;
+    }
+
+    // Console::GetName caches the name after the first call so Console::GetType is used to
+    // measure the cost of a single-line command instead
+    runner.AddBenchmark("GetType", options.CommandIterations, 0, [&]() {
+        console.GetType();
+    });
+
+    fs::path attributesFile = serverDirectory / "attributes.bin";
+    generateServerFile(attributesFile, 1024);
+    runner.AddBenchmark("GetFileAttributes", options.CommandIterations, 0, [&]() {
+        console.GetFileAttributes(attributesFile.string());
+    });
+
+    // Memory reads, a large contiguous one and a batch of small scattered ones
+    const uint32_t memoryBase = 0x82000000;
+    const uint32_t memorySize = 16 * 1024 * 1024;
+    server.GetMemory(730)->AddRegion(memoryBase, memorySize);
+
+    std::vector<char> memoryBuffer(memorySize);
+    runner.AddBenchmark("ReadMemory/" + FormatSize(memorySize), options.TransferIterations, memorySize, [&]() {
+        console.ReadMemory(memoryBase, memorySize, memoryBuffer.data());
+    });
+
+    std::vector<XBDM::MemoryRead> scatteredReads(256);
+    for (size_t i = 0; i < scatteredReads.size(); i++)
+    {
+        scatteredReads[i].Address = memoryBase + static_cast<uint32_t>(i * 64 * 1024);
+        scatteredReads[i].Length = 16;
+        scatteredReads[i].Buffer = memoryBuffer.data() + i * 16;
+    }
+
+    // The same region as ReadMemory so the two can be compared, the difference being the cost
+    // of the scan that isn't hidden behind the network
+    XBDM::Pattern scanPattern = XBDM::Pattern::FromSignature("7c 08 02 a6 ?? ?? ?? ?? 94 21");
+    runner.AddBenchmark("ScanMemory/" + FormatSize(memorySize), options.TransferIterations, memorySize, [&]() {
+        console.ScanMemory(memoryBase, memorySize, scanPattern);
+    });
+
+    // Also compared to ReadMemory, the difference being the cost of writing the dump
+    fs::path dumpPath = clientDirectory / "memory.dump";
+    runner.AddBenchmark("DumpMemory/" + FormatSize(memorySize), options.TransferIterations, memorySize, [&]() {
+        console.DumpMemory({ { memoryBase, memorySize } }, dumpPath);
+    });
+
+    runner.AddBenchmark("ReadMemoryBatch/256x16", options.CommandIterations, scatteredReads.size() * 16, [&]() {
+        console.ReadMemory(scatteredReads);
+    });
+
+    // The conversion alone, then a whole screenshot where it adds to the transfer of the framebuffer
+    XBDM::FramebufferInfo framebufferInfo;
+    framebufferInfo.Width = TestServer::s_ScreenWidth;
+    framebufferInfo.Height = TestServer::s_ScreenHeight;
+    framebufferInfo.Format = 0x18280186;
+    framebufferInfo.Size = TestServer::s_ScreenWidth * ((TestServer::s_ScreenHeight + 31) & ~31u) * 4;
+    std::vector<uint8_t> framebuffer(framebufferInfo.Size, 0x5a);
+    XBDM::Image screenshot;
+    std::string screenLabel = std::to_string(TestServer::s_ScreenWidth) + "x" + std::to_string(TestServer::s_ScreenHeight);
+
+    runner.AddBenchmark("ConvertFramebuffer/" + screenLabel, options.CommandIterations, framebufferInfo.Size, [&]() {
+        XBDM::ConvertFramebuffer(framebuffer.data(), framebufferInfo, screenshot);
+    });
+
+    runner.AddBenchmark("Screenshot/" + screenLabel, options.TransferIterations, framebufferInfo.Size, [&]() {
+        console.Screenshot(screenshot);
+    });
+
+    // Comparing identical framebuffers is the worst case of a delta-encoded capture, every block
+    // being compared to its end
+    std::vector<uint8_t> previousFramebuffer = framebuffer;
+    runner.AddBenchmark("CompareFramebuffers/" + screenLabel, options.CommandIterations, framebufferInfo.Size, [&]() {
+        size_t changedBlocks = 0;
+        for (size_t offset = 0; offset < framebuffer.size(); offset += 4096)
+            changedBlocks += XBDM::AreBlocksEqual(framebuffer.data() + offset, previousFramebuffer.data() + offset, std::min<size_t>(4096, framebuffer.size() - offset)) ? 0 : 1;
+
+        if (changedBlocks != 0)
+            throw std::runtime_error("Identical framebuffers compared as different");
+    });
+
+    for (uint64_t size = options.MinFileSize; size <= options.MaxFileSize; size *= 16)
+    {
+        std::string sizeLabel = FormatSize(size);
+
+        fs::path pathOnServer = serverDirectory / ("file" + sizeLabel + ".bin");
+        fs::path receivedPathOnClient = clientDirectory / ("received" + sizeLabel + ".bin");
+        generateServerFile(pathOnServer, size);
+        runner.AddBenchmark(
+            "ReceiveFile/" + sizeLabel,
+            options.TransferIterations,
+            size,
+            [&, pathOnServer, receivedPathOnClient]() { console.ReceiveFile(pathOnServer.string(), receivedPathOnClient); },
+            [receivedPathOnClient]() { fs::remove(receivedPathOnClient); }
+        );
+
+        fs::path pathOnClient = clientDirectory / ("file" + sizeLabel + ".bin");
+        fs::path sentPathOnServer = serverDirectory / ("sent" + sizeLabel + ".bin");
+        GenerateFile(pathOnClient, size);
+        runner.AddBenchmark(
+            "SendFile/" + sizeLabel,
+            options.TransferIterations,
+            size,
+            [&, pathOnClient, sentPathOnServer]() { console.SendFile(sentPathOnServer.string(), pathOnClient); },
+            [&, sentPathOnServer]() { storage->Remove(sentPathOnServer.string()); }
+        );
+
+        // Avoid overflowing when the maximum size is close to the limit of uint64_t
+        if (size > options.MaxFileSize / 16)
+            break;
+    }
+
+    std::string treeLabel = std::to_string(options.TreeWidth) + "x" + std::to_string(options.TreeDepth);
+
+    fs::path treeOnServer = serverDirectory / "tree";
+    fs::path receivedTreeOnClient = clientDirectory / "receivedTree";
+    size_t treeFileCount = CountTreeFiles(options.TreeWidth, options.TreeDepth);
+    if (memoryStorage != nullptr)
+        memoryStorage->AddGeneratedTree(treeOnServer.string(), options.TreeWidth, options.TreeDepth, options.TreeFileSize);
+    else
+        GenerateTree(treeOnServer, options.TreeWidth, options.TreeDepth, options.TreeFileSize);
+
+    // Listing a single directory, which is what dominates the cost of walking wide trees
+    runner.AddBenchmark("GetDirectoryContents/" + std::to_string(options.TreeWidth), options.CommandIterations, 0, [&]() {
+        console.GetDirectoryContents(treeOnServer.string());
+    });
+
+    runner.AddBenchmark(
+        "ReceiveDirectory/" + treeLabel,
+        options.TransferIterations,
+        treeFileCount * options.TreeFileSize,
+        [&]() { console.ReceiveDirectory(treeOnServer.string(), receivedTreeOnClient); },
+        [&]() { fs::remove_all(receivedTreeOnClient); }
+    );
+
+    fs::path archiveOnClient = clientDirectory / "receivedTree.tar";
+    runner.AddBenchmark(
+        "ReceiveDirectoryToArchive/" + treeLabel,
+        options.TransferIterations,
+        treeFileCount * options.TreeFileSize,
+        [&]() {
+            XBDM::FileArchiveSink sink(archiveOnClient);
+            console.ReceiveDirectoryToArchive(treeOnServer.string(), sink);
+        },
+        [&]() { fs::remove(archiveOnClient); }
+    );
+
+    fs::path treeOnClient = clientDirectory / "tree";
+    fs::path sentTreeOnServer = serverDirectory / "sentTree";
+    GenerateTree(treeOnClient, options.TreeWidth, options.TreeDepth, options.TreeFileSize);
+    runner.AddBenchmark(
+        "SendDirectory/" + treeLabel,
+        options.TransferIterations,
+        treeFileCount * options.TreeFileSize,
+        [&]() { console.SendDirectory(sentTreeOnServer.string(), treeOnClient); },
+        [&]() { storage->Remove(sentTreeOnServer.string()); }
+    );
+
+    // Running the benchmarks and shuting down the server
+    std::vector<BenchmarkRunner::Result> results = runner.RunBenchmarks(options.Filter);
+    PrintCommandStats(console.GetStats());
+
+    console.CloseConnection();
+    console.StopRecording();
+    server.RequestShutdown();
+    thread.join();
+
+    fs::remove_all(workingDirectory);
+
+    // A benchmark that fails is at least as bad as a regression
+    bool success = runner.GetFailureCount() == 0;
+
+    try
+    {
+        if (!options.SaveBaselinePath.empty())
+            Baseline::Save(options.SaveBaselinePath, results);
+
+        if (!options.TimelinePath.empty())
+            timeline->SaveChromeTrace(options.TimelinePath);
+
+        if (!options.BaselinePath.empty())
+            success = Baseline::Compare(Baseline::Load(options.BaselinePath), results, options.Threshold) && success;
+    }
+    catch (const std::exception &exception)
+    {
+        std::cerr << exception.what() << '\n';
+        return 1;
+    }
+
+    return static_cast<int>(!success);
+}
@@ -3,3 +3,10 @@
 // To be included by the client
 
 #include "../src/Console.h"
+#include "../src/Snapshot.h"
+#include "../src/Watcher.h"
+#include "../src/Notification.h"
+#include "../src/DebugLog.h"
+#include "../src/FrameCapture.h"
+#include "../src/Fleet.h"
+#include "../src/Discovery.h"
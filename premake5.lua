@@ -3,6 +3,16 @@ newoption {
   description = "Compile tests.",
 }
 
+newoption {
+  trigger = "benchmark",
+  description = "Compile benchmarks.",
+}
+
+newoption {
+  trigger = "no-stats",
+  description = "Compile the per-command stats out of the library.",
+}
+
 workspace "XBDM"
   local startprojectname = _OPTIONS["test"] and "Tests" or "XBDM"
 
@@ -21,6 +31,10 @@ workspace "XBDM"
     "release",
   }
 
+  if _OPTIONS["no-stats"] then
+    defines "XBDM_DISABLE_STATS"
+  end
+
   filter "system:not macosx"
     systemversion "latest"
 
@@ -83,3 +97,44 @@ if _OPTIONS["test"] then
     filter "system:linux"
       links { "pthread" }
 end
+
+if _OPTIONS["benchmark"] then
+  project "Benchmarks"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++17"
+
+    local xbdmincludedir = path.join(".", "include")
+    local testdir = path.join(".", "test")
+    local benchdir = path.join(".", "bench")
+
+    -- The benchmarks run against the same server as the tests
+    files {
+      path.join(testdir, "TestServer.h"),
+      path.join(testdir, "TestServer.cpp"),
+      path.join(testdir, "Poller.h"),
+      path.join(testdir, "Poller.cpp"),
+      path.join(testdir, "Storage.h"),
+      path.join(testdir, "DiskStorage.h"),
+      path.join(testdir, "DiskStorage.cpp"),
+      path.join(testdir, "MemoryStorage.h"),
+      path.join(testdir, "MemoryStorage.cpp"),
+      path.join(testdir, "MemorySpace.h"),
+      path.join(testdir, "MemorySpace.cpp"),
+      path.join(testdir, "Utils.h"),
+      path.join(testdir, "Utils.cpp"),
+      path.join(benchdir, "**.h"),
+      path.join(benchdir, "**.cpp"),
+    }
+
+    includedirs {
+      benchdir,
+      testdir,
+      xbdmincludedir,
+    }
+
+    links { "XBDM" }
+
+    filter "system:linux"
+      links { "pthread" }
+end
@@ -9,8 +9,5 @@ if [[ ! -f "$PREMAKE_EXECUTABLE_PATH" ]]; then
     "$SCRIPT_DIR/download-premake-posix.sh"
 fi
 
-if [[ $1 == "--test" ]]; then
-    "$PREMAKE_EXECUTABLE_PATH" --file="$ROOT_DIR/premake5.lua" gmake2 --test
-else
-    "$PREMAKE_EXECUTABLE_PATH" --file="$ROOT_DIR/premake5.lua" gmake2
-fi
+# Forward the options (--test, --benchmark) to premake
+"$PREMAKE_EXECUTABLE_PATH" --file="$ROOT_DIR/premake5.lua" gmake2 "$@"
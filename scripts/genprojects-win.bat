@@ -8,9 +8,5 @@ IF NOT EXIST "%PremakeExecutablePath%" (
     CALL "%~dp0download-premake-win.bat"
 )
 
-IF "%1" == "--test" (
-    CALL "%PremakeExecutablePath%" --file="%RootDir%\premake5.lua" gmake2 --test
-) ELSE (
-    CALL "%PremakeExecutablePath%" --file="%RootDir%\premake5.lua" gmake2
-)
-
+REM Forward the options (--test, --benchmark) to premake
+CALL "%PremakeExecutablePath%" --file="%RootDir%\premake5.lua" gmake2 %*
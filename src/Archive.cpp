@@ -0,0 +1,209 @@
+#include "pch.h"
+#include "Archive.h"
+
+namespace XBDM
+{
+
+FileArchiveSink::FileArchiveSink(const std::filesystem::path &path)
+    : m_Path(path), m_File(path, std::ofstream::binary)
+{
+    if (m_File.fail())
+        throw std::runtime_error("Couldn't create archive file: " + path.string());
+}
+
+void FileArchiveSink::Write(const char *data, size_t length)
+{
+    m_File.write(data, static_cast<std::streamsize>(length));
+
+    if (m_File.fail())
+        throw std::runtime_error("Couldn't write archive file: " + m_Path.string());
+}
+
+StreamArchiveSink::StreamArchiveSink(std::ostream &stream)
+    : m_Stream(stream)
+{
+}
+
+void StreamArchiveSink::Write(const char *data, size_t length)
+{
+    m_Stream.write(data, static_cast<std::streamsize>(length));
+
+    if (m_Stream.fail())
+        throw std::runtime_error("Couldn't write archive to the stream");
+}
+
+CallbackArchiveSink::CallbackArchiveSink(std::function<void(const char *, size_t)> callback)
+    : m_Callback(std::move(callback))
+{
+}
+
+void CallbackArchiveSink::Write(const char *data, size_t length)
+{
+    m_Callback(data, length);
+}
+
+// Largest value of the 12 bytes octal fields of the ustar header
+static const uint64_t s_MaxOctalValue = 077777777777;
+
+// Octal numbers are padded with zeros and terminated by a NUL character
+static void WriteOctal(char *field, size_t fieldSize, uint64_t value)
+{
+    field[fieldSize - 1] = '\0';
+
+    for (size_t i = fieldSize - 1; i > 0; i--)
+    {
+        field[i - 1] = static_cast<char>('0' + (value & 7));
+        value >>= 3;
+    }
+}
+
+// Each record is "<length> <key>=<value>\n", the length counting its own digits
+static std::string MakePaxRecord(const std::string &key, const std::string &value)
+{
+    size_t baseLength = 1 + key.size() + 1 + value.size() + 1;
+    size_t length = baseLength + 1;
+
+    while (std::to_string(length).size() + baseLength != length)
+        length = std::to_string(length).size() + baseLength;
+
+    return std::to_string(length) + ' ' + key + '=' + value + '\n';
+}
+
+// Splits path between the prefix and name fields of the ustar header, which is only possible
+// on a separator leaving at most 155 characters before it and 100 after it
+static bool SplitUstarPath(const std::string &path, std::string &prefix, std::string &name)
+{
+    if (path.size() <= 100)
+    {
+        prefix.clear();
+        name = path;
+        return true;
+    }
+
+    // The rightmost separator that fits leaves the shortest name, a trailing separator can't be used
+    // since the name would be empty
+    size_t separator = path.rfind('/', 155);
+    if (separator != std::string::npos && separator == path.size() - 1 && separator > 0)
+        separator = path.rfind('/', separator - 1);
+
+    if (separator == std::string::npos || separator == 0 || path.size() - separator - 1 > 100)
+        return false;
+
+    prefix = path.substr(0, separator);
+    name = path.substr(separator + 1);
+
+    return true;
+}
+
+TarWriter::TarWriter(ArchiveSink &sink)
+    : m_Sink(sink)
+{
+}
+
+void TarWriter::AddDirectory(const std::string &path, time_t modificationDate)
+{
+    if (m_InFile)
+        throw std::logic_error("The content of the previous file isn't complete");
+
+    WriteHeader(path.empty() || path.back() == '/' ? path : path + '/', '5', 0, modificationDate);
+}
+
+void TarWriter::BeginFile(const std::string &path, uint64_t size, time_t modificationDate)
+{
+    if (m_InFile)
+        throw std::logic_error("The content of the previous file isn't complete");
+
+    WriteHeader(path, '0', size, modificationDate);
+
+    m_FileSize = size;
+    m_FileWritten = 0;
+    m_InFile = true;
+}
+
+void TarWriter::WriteFileContent(const char *data, size_t length)
+{
+    if (!m_InFile || m_FileWritten + length > m_FileSize)
+        throw std::logic_error("More content than the size given to BeginFile");
+
+    m_Sink.Write(data, length);
+    m_FileWritten += length;
+}
+
+void TarWriter::EndFile()
+{
+    if (!m_InFile || m_FileWritten != m_FileSize)
+        throw std::logic_error("Less content than the size given to BeginFile");
+
+    WritePadding(m_FileSize);
+    m_InFile = false;
+}
+
+void TarWriter::Finish()
+{
+    if (m_InFile)
+        throw std::logic_error("The content of the last file isn't complete");
+
+    std::array<char, s_BlockSize * 2> endOfArchive = {};
+    m_Sink.Write(endOfArchive.data(), endOfArchive.size());
+}
+
+void TarWriter::WriteHeader(const std::string &path, char type, uint64_t size, time_t modificationDate)
+{
+    std::string prefix;
+    std::string name;
+    std::string paxRecords;
+
+    if (!SplitUstarPath(path, prefix, name))
+    {
+        paxRecords += MakePaxRecord("path", path);
+        prefix.clear();
+        name = path.substr(0, 100);
+    }
+
+    if (size > s_MaxOctalValue)
+    {
+        paxRecords += MakePaxRecord("size", std::to_string(size));
+        size = 0;
+    }
+
+    // The extended header applies to the entry right after it
+    if (!paxRecords.empty())
+    {
+        WriteHeader("PaxHeaders/" + name.substr(0, 89), 'x', paxRecords.size(), modificationDate);
+        m_Sink.Write(paxRecords.data(), paxRecords.size());
+        WritePadding(paxRecords.size());
+    }
+
+    std::array<char, s_BlockSize> header = {};
+    memcpy(header.data(), name.data(), name.size());
+    WriteOctal(header.data() + 100, 8, type == '5' ? 0755 : 0644);
+    WriteOctal(header.data() + 108, 8, 0);
+    WriteOctal(header.data() + 116, 8, 0);
+    WriteOctal(header.data() + 124, 12, size);
+    WriteOctal(header.data() + 136, 12, static_cast<uint64_t>(std::max<time_t>(modificationDate, 0)));
+    header[156] = type;
+    memcpy(header.data() + 257, "ustar", 6);
+    memcpy(header.data() + 263, "00", 2);
+    memcpy(header.data() + 345, prefix.data(), prefix.size());
+
+    // The checksum is computed with its own field filled with spaces
+    memset(header.data() + 148, ' ', 8);
+    uint32_t checksum = 0;
+    for (char byte : header)
+        checksum += static_cast<uint8_t>(byte);
+
+    WriteOctal(header.data() + 148, 7, checksum);
+
+    m_Sink.Write(header.data(), header.size());
+}
+
+void TarWriter::WritePadding(uint64_t size)
+{
+    static const std::array<char, s_BlockSize> zeros = {};
+
+    size_t remainder = static_cast<size_t>(size % s_BlockSize);
+    if (remainder != 0)
+        m_Sink.Write(zeros.data(), s_BlockSize - remainder);
+}
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+namespace XBDM
+{
+
+// Destination of an archive, Write is called with consecutive parts of the archive and
+// throws when they can't be written
+class ArchiveSink
+{
+public:
+    virtual ~ArchiveSink() = default;
+
+    virtual void Write(const char *data, size_t length) = 0;
+};
+
+class FileArchiveSink : public ArchiveSink
+{
+public:
+    FileArchiveSink(const std::filesystem::path &path);
+
+    void Write(const char *data, size_t length) override;
+
+private:
+    std::filesystem::path m_Path;
+    std::ofstream m_File;
+};
+
+// Writes to a stream owned by the caller, e.g. std::cout to pipe the archive to another program
+class StreamArchiveSink : public ArchiveSink
+{
+public:
+    StreamArchiveSink(std::ostream &stream);
+
+    void Write(const char *data, size_t length) override;
+
+private:
+    std::ostream &m_Stream;
+};
+
+class CallbackArchiveSink : public ArchiveSink
+{
+public:
+    CallbackArchiveSink(std::function<void(const char *, size_t)> callback);
+
+    void Write(const char *data, size_t length) override;
+
+private:
+    std::function<void(const char *, size_t)> m_Callback;
+};
+
+// Writes a POSIX (pax) tar archive one entry at a time, so that the content of the files
+// can be streamed into it without knowing the whole archive in advance. Paths too long for
+// the ustar header are stored in pax extended headers.
+class TarWriter
+{
+public:
+    TarWriter(ArchiveSink &sink);
+
+    void AddDirectory(const std::string &path, time_t modificationDate);
+
+    // The content of the file is then given through WriteFileContent, exactly size bytes of it
+    void BeginFile(const std::string &path, uint64_t size, time_t modificationDate);
+    void WriteFileContent(const char *data, size_t length);
+    void EndFile();
+
+    // Writes the end of archive marker
+    void Finish();
+
+private:
+    static constexpr size_t s_BlockSize = 512;
+
+    ArchiveSink &m_Sink;
+    uint64_t m_FileSize = 0;
+    uint64_t m_FileWritten = 0;
+    bool m_InFile = false;
+
+    void WriteHeader(const std::string &path, char type, uint64_t size, time_t modificationDate);
+    void WritePadding(uint64_t size);
+};
+
+}
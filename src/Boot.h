@@ -0,0 +1,44 @@
+#pragma once
+
+#include "XboxPath.h"
+
+namespace XBDM
+{
+
+// How Console::RebootAndWait and Console::LaunchXexAndWait find out that the console is ready.
+// The console is polled, waiting InitialPollInterval after the first poll and doubling the
+// interval up to MaxPollInterval, and the "execution started" notification ends the wait as
+// soon as the console sends it.
+struct BootOptions
+{
+    std::chrono::milliseconds Timeout = std::chrono::milliseconds(120000);
+    std::chrono::milliseconds InitialPollInterval = std::chrono::milliseconds(20);
+    std::chrono::milliseconds MaxPollInterval = std::chrono::milliseconds(500);
+
+    // Opens a notification channel for the duration of the wait, the console is only polled
+    // when this is false or when the channel can't be opened
+    bool UseNotifications = true;
+};
+
+// Durations measured from when the boot command started being sent
+struct BootResult
+{
+    XboxPath ActiveTitle;
+
+    // Until the console acknowledged the command
+    std::chrono::microseconds CommandDuration = std::chrono::microseconds(0);
+
+    // Until the console was seen going down, by a notification or by the connection being
+    // closed, 0 if it wasn't seen
+    std::chrono::microseconds ShutdownDuration = std::chrono::microseconds(0);
+
+    // Until the title was running
+    std::chrono::microseconds ReadyDuration = std::chrono::microseconds(0);
+
+    uint32_t Polls = 0;
+
+    // Whether the wait ended with the console notifying that the title started, rather than with a poll
+    bool Notified = false;
+};
+
+}
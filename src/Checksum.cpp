@@ -0,0 +1,411 @@
+#include "pch.h"
+#include "Checksum.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define XBDM_CRC32C_X86
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #else
+        #include <nmmintrin.h>
+    #endif
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define XBDM_CRC32C_X86_64
+#endif
+
+namespace XBDM
+{
+
+// Slicing-by-8 tables, table[0] being the classic byte-at-a-time table and table[k] giving the
+// contribution of a byte followed by k zero bytes, so that 8 bytes can be processed at once
+static const std::array<std::array<uint32_t, 256>, 8> &GetCrc32cTables()
+{
+    static const std::array<std::array<uint32_t, 256>, 8> tables = []() {
+        std::array<std::array<uint32_t, 256>, 8> tables = {};
+
+        // Reversed Castagnoli polynomial
+        const uint32_t polynomial = 0x82f63b78;
+
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
+
+            tables[0][i] = crc;
+        }
+
+        for (size_t k = 1; k < tables.size(); k++)
+        {
+            for (size_t i = 0; i < 256; i++)
+                tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xff];
+        }
+
+        return tables;
+    }();
+
+    return tables;
+}
+
+static uint32_t UpdateCrc32cSoftware(uint32_t crc, const uint8_t *data, size_t length)
+{
+    const auto &tables = GetCrc32cTables();
+
+    while (length >= 8)
+    {
+        uint32_t low = 0;
+        uint32_t high = 0;
+        memcpy(&low, data, sizeof(low));
+        memcpy(&high, data + 4, sizeof(high));
+        low ^= crc;
+
+        crc = tables[7][low & 0xff] ^ tables[6][(low >> 8) & 0xff] ^ tables[5][(low >> 16) & 0xff] ^ tables[4][low >> 24] ^
+              tables[3][high & 0xff] ^ tables[2][(high >> 8) & 0xff] ^ tables[1][(high >> 16) & 0xff] ^ tables[0][high >> 24];
+
+        data += 8;
+        length -= 8;
+    }
+
+    while (length > 0)
+    {
+        crc = (crc >> 8) ^ tables[0][(crc ^ *data) & 0xff];
+        data++;
+        length--;
+    }
+
+    return crc;
+}
+
+#ifdef XBDM_CRC32C_X86
+    #ifndef _MSC_VER
+__attribute__((target("sse4.2")))
+    #endif
+static uint32_t UpdateCrc32cHardware(uint32_t crc, const uint8_t *data, size_t length)
+{
+    #ifdef XBDM_CRC32C_X86_64
+    uint64_t crc64 = crc;
+    while (length >= 8)
+    {
+        uint64_t word = 0;
+        memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+
+        data += 8;
+        length -= 8;
+    }
+    crc = static_cast<uint32_t>(crc64);
+    #endif
+
+    while (length > 0)
+    {
+        crc = _mm_crc32_u8(crc, *data);
+        data++;
+        length--;
+    }
+
+    return crc;
+}
+#endif
+
+bool Crc32c::IsHardwareAccelerated()
+{
+#ifdef XBDM_CRC32C_X86
+    static const bool supported = []() {
+    #ifdef _MSC_VER
+        int info[4] = { 0 };
+        __cpuid(info, 1);
+
+        return (info[2] & (1 << 20)) != 0;
+    #else
+        return __builtin_cpu_supports("sse4.2") != 0;
+    #endif
+    }();
+
+    return supported;
+#else
+    return false;
+#endif
+}
+
+void Crc32c::Update(const void *data, size_t length)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+
+#ifdef XBDM_CRC32C_X86
+    if (IsHardwareAccelerated())
+    {
+        m_State = UpdateCrc32cHardware(m_State, bytes, length);
+        return;
+    }
+#endif
+
+    m_State = UpdateCrc32cSoftware(m_State, bytes, length);
+}
+
+uint32_t Crc32c::Finish() const
+{
+    return m_State ^ 0xffffffff;
+}
+
+static const uint64_t s_XxPrime1 = 11400714785074694791ULL;
+static const uint64_t s_XxPrime2 = 14029467366897019727ULL;
+static const uint64_t s_XxPrime3 = 1609587929392839161ULL;
+static const uint64_t s_XxPrime4 = 9650029242287828579ULL;
+static const uint64_t s_XxPrime5 = 2870177450012600261ULL;
+
+static inline uint64_t RotateLeft(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t ReadLittleEndian64(const uint8_t *data)
+{
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--)
+        value = (value << 8) | data[i];
+
+    return value;
+}
+
+static inline uint32_t ReadLittleEndian32(const uint8_t *data)
+{
+    return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 | static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24;
+}
+
+static inline uint64_t XxRound(uint64_t accumulator, uint64_t input)
+{
+    accumulator += input * s_XxPrime2;
+    accumulator = RotateLeft(accumulator, 31);
+
+    return accumulator * s_XxPrime1;
+}
+
+static inline uint64_t XxMergeRound(uint64_t hash, uint64_t accumulator)
+{
+    hash ^= XxRound(0, accumulator);
+
+    return hash * s_XxPrime1 + s_XxPrime4;
+}
+
+XxHash64::XxHash64(uint64_t seed)
+    : m_Seed(seed)
+{
+    m_Accumulators = { seed + s_XxPrime1 + s_XxPrime2, seed + s_XxPrime2, seed, seed - s_XxPrime1 };
+}
+
+void XxHash64::Update(const void *data, size_t length)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    m_TotalLength += length;
+
+    // Complete the stripe started by the previous update
+    if (m_BufferSize > 0)
+    {
+        size_t toCopy = std::min(length, m_Buffer.size() - m_BufferSize);
+        memcpy(m_Buffer.data() + m_BufferSize, bytes, toCopy);
+        m_BufferSize += toCopy;
+        bytes += toCopy;
+        length -= toCopy;
+
+        if (m_BufferSize < m_Buffer.size())
+            return;
+
+        for (size_t i = 0; i < m_Accumulators.size(); i++)
+            m_Accumulators[i] = XxRound(m_Accumulators[i], ReadLittleEndian64(m_Buffer.data() + i * 8));
+
+        m_BufferSize = 0;
+    }
+
+    // Stripes of 32 bytes, one 8-byte lane per accumulator
+    while (length >= m_Buffer.size())
+    {
+        for (size_t i = 0; i < m_Accumulators.size(); i++)
+            m_Accumulators[i] = XxRound(m_Accumulators[i], ReadLittleEndian64(bytes + i * 8));
+
+        bytes += m_Buffer.size();
+        length -= m_Buffer.size();
+    }
+
+    memcpy(m_Buffer.data(), bytes, length);
+    m_BufferSize = length;
+}
+
+uint64_t XxHash64::Finish() const
+{
+    uint64_t hash = 0;
+
+    if (m_TotalLength >= m_Buffer.size())
+    {
+        hash = RotateLeft(m_Accumulators[0], 1) + RotateLeft(m_Accumulators[1], 7) + RotateLeft(m_Accumulators[2], 12) + RotateLeft(m_Accumulators[3], 18);
+
+        for (uint64_t accumulator : m_Accumulators)
+            hash = XxMergeRound(hash, accumulator);
+    }
+    else
+        hash = m_Seed + s_XxPrime5;
+
+    hash += m_TotalLength;
+
+    // Mix in what didn't fill a whole stripe
+    const uint8_t *bytes = m_Buffer.data();
+    size_t length = m_BufferSize;
+
+    for (; length >= 8; bytes += 8, length -= 8)
+    {
+        hash ^= XxRound(0, ReadLittleEndian64(bytes));
+        hash = RotateLeft(hash, 27) * s_XxPrime1 + s_XxPrime4;
+    }
+
+    if (length >= 4)
+    {
+        hash ^= static_cast<uint64_t>(ReadLittleEndian32(bytes)) * s_XxPrime1;
+        hash = RotateLeft(hash, 23) * s_XxPrime2 + s_XxPrime3;
+        bytes += 4;
+        length -= 4;
+    }
+
+    for (; length > 0; bytes++, length--)
+    {
+        hash ^= *bytes * s_XxPrime5;
+        hash = RotateLeft(hash, 11) * s_XxPrime1;
+    }
+
+    // Final avalanche
+    hash ^= hash >> 33;
+    hash *= s_XxPrime2;
+    hash ^= hash >> 29;
+    hash *= s_XxPrime3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+static const std::array<uint32_t, 64> s_Sha256RoundConstants = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t RotateRight(uint32_t value, int bits)
+{
+    return (value >> bits) | (value << (32 - bits));
+}
+
+Sha256::Sha256()
+    : m_State({ 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 })
+{
+}
+
+void Sha256::ProcessBlock(std::array<uint32_t, 8> &state, const uint8_t *block)
+{
+    std::array<uint32_t, 64> schedule;
+
+    for (size_t i = 0; i < 16; i++)
+        schedule[i] = static_cast<uint32_t>(block[i * 4]) << 24 | static_cast<uint32_t>(block[i * 4 + 1]) << 16 | static_cast<uint32_t>(block[i * 4 + 2]) << 8 | block[i * 4 + 3];
+
+    for (size_t i = 16; i < 64; i++)
+    {
+        uint32_t s0 = RotateRight(schedule[i - 15], 7) ^ RotateRight(schedule[i - 15], 18) ^ (schedule[i - 15] >> 3);
+        uint32_t s1 = RotateRight(schedule[i - 2], 17) ^ RotateRight(schedule[i - 2], 19) ^ (schedule[i - 2] >> 10);
+        schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (size_t i = 0; i < 64; i++)
+    {
+        uint32_t s1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25);
+        uint32_t choice = (e & f) ^ (~e & g);
+        uint32_t temp1 = h + s1 + choice + s_Sha256RoundConstants[i] + schedule[i];
+        uint32_t s0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22);
+        uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t temp2 = s0 + majority;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+void Sha256::Update(const void *data, size_t length)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    m_TotalLength += length;
+
+    if (m_BufferSize > 0)
+    {
+        size_t toCopy = std::min(length, m_Buffer.size() - m_BufferSize);
+        memcpy(m_Buffer.data() + m_BufferSize, bytes, toCopy);
+        m_BufferSize += toCopy;
+        bytes += toCopy;
+        length -= toCopy;
+
+        if (m_BufferSize < m_Buffer.size())
+            return;
+
+        ProcessBlock(m_State, m_Buffer.data());
+        m_BufferSize = 0;
+    }
+
+    while (length >= m_Buffer.size())
+    {
+        ProcessBlock(m_State, bytes);
+        bytes += m_Buffer.size();
+        length -= m_Buffer.size();
+    }
+
+    memcpy(m_Buffer.data(), bytes, length);
+    m_BufferSize = length;
+}
+
+Sha256::Digest Sha256::Finish() const
+{
+    // Padding is applied to copies so that more data can still be added afterwards
+    std::array<uint32_t, 8> state = m_State;
+    std::array<uint8_t, 128> padding = {};
+    memcpy(padding.data(), m_Buffer.data(), m_BufferSize);
+    padding[m_BufferSize] = 0x80;
+
+    // The length in bits takes the last 8 bytes of the last block
+    size_t paddedSize = m_BufferSize + 1 + 8 <= 64 ? 64 : 128;
+    uint64_t bitLength = m_TotalLength * 8;
+    for (size_t i = 0; i < 8; i++)
+        padding[paddedSize - 1 - i] = static_cast<uint8_t>(bitLength >> (i * 8));
+
+    for (size_t offset = 0; offset < paddedSize; offset += 64)
+        ProcessBlock(state, padding.data() + offset);
+
+    Digest digest;
+    for (size_t i = 0; i < state.size(); i++)
+    {
+        digest[i * 4] = static_cast<uint8_t>(state[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+    }
+
+    return digest;
+}
+
+}
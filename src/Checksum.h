@@ -0,0 +1,57 @@
+#pragma once
+
+namespace XBDM
+{
+
+// The checksums are computed incrementally: Update can be called any number of times with
+// consecutive parts of the data, Finish returns the checksum of everything given so far.
+
+// CRC-32C (Castagnoli), using the SSE 4.2 crc32 instruction when the CPU supports it
+class Crc32c
+{
+public:
+    void Update(const void *data, size_t length);
+    uint32_t Finish() const;
+
+    static bool IsHardwareAccelerated();
+
+private:
+    uint32_t m_State = 0xffffffff;
+};
+
+class XxHash64
+{
+public:
+    XxHash64(uint64_t seed = 0);
+
+    void Update(const void *data, size_t length);
+    uint64_t Finish() const;
+
+private:
+    uint64_t m_Seed;
+    std::array<uint64_t, 4> m_Accumulators;
+    std::array<uint8_t, 32> m_Buffer = {};
+    size_t m_BufferSize = 0;
+    uint64_t m_TotalLength = 0;
+};
+
+class Sha256
+{
+public:
+    using Digest = std::array<uint8_t, 32>;
+
+    Sha256();
+
+    void Update(const void *data, size_t length);
+    Digest Finish() const;
+
+private:
+    std::array<uint32_t, 8> m_State;
+    std::array<uint8_t, 64> m_Buffer = {};
+    size_t m_BufferSize = 0;
+    uint64_t m_TotalLength = 0;
+
+    static void ProcessBlock(std::array<uint32_t, 8> &state, const uint8_t *block);
+};
+
+}
@@ -1,23 +1,28 @@
 #include "pch.h"
 #include "Console.h"
 
+#include "Notification.h"
 #include "Utils.h"
 
+#ifndef _WIN32
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <netinet/tcp.h>
+#endif
+
 #define FILETIME_TO_TIMET(time) ((time) / 10000000LL - 11644473600LL)
 #define TIMET_TO_FILETIME(time) ((time) * 10000000LL + 116444736000000000LL)
 
 namespace XBDM
 {
 
-using namespace std::chrono_literals;
-
 Console::Console()
     : m_Socket(INVALID_SOCKET)
 {
 }
 
-Console::Console(const std::string &ipAddress)
-    : m_IpAddress(ipAddress), m_Socket(INVALID_SOCKET)
+Console::Console(const std::string &ipAddress, uint16_t port)
+    : m_IpAddress(ipAddress), m_Port(port), m_Socket(INVALID_SOCKET)
 {
 }
 
@@ -28,10 +33,9 @@ Console::~Console()
 
 bool Console::OpenConnection()
 {
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "OpenConnection");
+
     m_Connected = false;
-    addrinfo hints;
-    addrinfo *addrInfo;
-    memset(&hints, 0, sizeof(hints));
 
 #ifdef _WIN32
     WSADATA wsaData;
@@ -39,46 +43,67 @@ bool Console::OpenConnection()
         return false;
 #endif
 
-    if (getaddrinfo(m_IpAddress.c_str(), "730", &hints, &addrInfo) != 0)
+    if (!m_AddressResolved)
     {
-        CloseConnection();
-        return false;
+        addrinfo hints;
+        addrinfo *addrInfo;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_protocol = IPPROTO_TCP;
+
+        if (getaddrinfo(m_IpAddress.c_str(), std::to_string(m_Port).c_str(), &hints, &addrInfo) != 0)
+        {
+            Disconnect();
+            return false;
+        }
+
+        memcpy(&m_Address, addrInfo->ai_addr, addrInfo->ai_addrlen);
+        m_AddressLength = static_cast<int>(addrInfo->ai_addrlen);
+        m_AddressResolved = true;
+        freeaddrinfo(addrInfo);
     }
 
-    m_Socket = socket(addrInfo->ai_family, addrInfo->ai_socktype, addrInfo->ai_protocol);
-    if (m_Socket < 0)
+    m_Socket = socket(m_Address.ss_family, SOCK_STREAM, IPPROTO_TCP);
+    if (m_Socket == INVALID_SOCKET)
     {
-        CloseConnection();
+        Disconnect();
         return false;
     }
 
-    // The only way I found to reduce the response time on Linux is to set the timeout
-    // to 10 000 microseconds but it makes the response time extremely long on Windows.
-    // It's far from being an optimal solution but it works.
-#ifdef _WIN32
-    timeval tv = { 5, 0 };
-#else
-    timeval tv = { 0, 10000 };
+    ApplyTimeout();
+
+    // Commands are sent with a single send so there is nothing for Nagle's algorithm to coalesce,
+    // it would only hold the end of file contents back. Keepalive probes notice a console that
+    // was turned off while the connection was idle.
+    int yes = 1;
+    setsockopt(m_Socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&yes), sizeof(yes));
+    setsockopt(m_Socket, SOL_SOCKET, SO_KEEPALIVE, reinterpret_cast<const char *>(&yes), sizeof(yes));
+#ifdef TCP_KEEPIDLE
+    int idle = s_KeepAliveIdleSeconds;
+    int interval = s_KeepAliveIntervalSeconds;
+    int probes = s_KeepAliveProbes;
+    setsockopt(m_Socket, IPPROTO_TCP, TCP_KEEPIDLE, reinterpret_cast<const char *>(&idle), sizeof(idle));
+    setsockopt(m_Socket, IPPROTO_TCP, TCP_KEEPINTVL, reinterpret_cast<const char *>(&interval), sizeof(interval));
+    setsockopt(m_Socket, IPPROTO_TCP, TCP_KEEPCNT, reinterpret_cast<const char *>(&probes), sizeof(probes));
 #endif
-    setsockopt(m_Socket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char *>(&tv), sizeof(timeval));
 
-    if (connect(m_Socket, addrInfo->ai_addr, static_cast<int>(addrInfo->ai_addrlen)) == SOCKET_ERROR)
+    if (!Connect(reinterpret_cast<const sockaddr *>(&m_Address), m_AddressLength))
     {
-        CloseConnection();
+        // The address might have changed, e.g. a new DHCP lease behind a host name
+        m_AddressResolved = false;
+        Disconnect();
         return false;
     }
 
-    if (m_Socket == INVALID_SOCKET)
-    {
-        CloseConnection();
-        return false;
-    }
+    m_TraceWriter.Write(TraceEvent::Type::Connected, nullptr, 0);
+    m_ConnectionLost = false;
 
     std::string response = Receive();
     if (response != "201- connected\r\n")
         return false;
 
     m_Connected = true;
+    m_AutoReconnect = true;
 
     return true;
 }
@@ -91,12 +116,24 @@ bool Console::OpenConnection()
 
 void Console::CloseConnection()
 {
+    m_AutoReconnect = false;
+
+    Disconnect();
+}
+
+void Console::Disconnect()
+{
+    // A command interrupted by the connection being closed failed
+    FinishCommand(false);
+
     if (m_Socket != INVALID_SOCKET)
     {
         CloseSocket(m_Socket);
         m_Socket = INVALID_SOCKET;
     }
 
+    m_ReceiveBuffer.clear();
+
 #ifdef _WIN32
     WSACleanup();
 #endif
@@ -104,14 +141,206 @@ void Console::CloseConnection()
     m_Connected = false;
 }
 
+void Console::SetReconnectPolicy(const ReconnectPolicy &policy)
+{
+    if (policy.InitialDelay.count() < 0 || policy.MaxDelay < policy.InitialDelay)
+        throw std::invalid_argument("The reconnection delays must be positive and increasing");
+
+    m_ReconnectPolicy = policy;
+}
+
+bool Console::IsConnectionAlive()
+{
+    if (m_Socket == INVALID_SOCKET || m_ConnectionLost)
+        return false;
+
+    // A socket closed by the other end is readable, and reading from it returns 0
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(m_Socket, &readSet);
+    timeval tv = { 0, 0 };
+
+    if (select(static_cast<int>(m_Socket) + 1, &readSet, nullptr, nullptr, &tv) <= 0)
+        return true;
+
+    char byte = 0;
+
+    return recv(m_Socket, &byte, sizeof(byte), MSG_PEEK) > 0;
+}
+
+bool Console::ReconnectWithBackoff()
+{
+    std::chrono::milliseconds delay = m_ReconnectPolicy.InitialDelay;
+
+    for (uint32_t attempt = 0; attempt < m_ReconnectPolicy.MaxAttempts; attempt++)
+    {
+        if (attempt > 0)
+        {
+            std::this_thread::sleep_for(delay);
+            delay = std::min(delay * 2, m_ReconnectPolicy.MaxDelay);
+        }
+
+        Disconnect();
+
+        if (OpenConnection())
+        {
+            m_ReconnectionCount++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::string Console::SendQuery(const std::string &command)
+{
+    bool canRetry = m_AutoReconnect && m_ReconnectPolicy.MaxAttempts > 0;
+
+    // The command is only sent again when the connection was lost after sending it, SendCommand
+    // failing means that the connection couldn't be opened again or that the command couldn't be sent
+    bool commandSent = false;
+
+    try
+    {
+        SendCommand(command);
+        commandSent = true;
+        std::string response = Receive();
+
+        if (!m_ConnectionLost || !canRetry)
+            return response;
+    }
+    catch (const std::exception &)
+    {
+        if (!commandSent || !m_ConnectionLost || !canRetry)
+            throw;
+    }
+
+    // SendCommand opens the connection again before sending the command a second time
+    SendCommand(command);
+
+    return Receive();
+}
+
+void Console::SetTimeout(std::chrono::milliseconds timeout)
+{
+    if (timeout.count() <= 0)
+        throw std::invalid_argument("The timeout must be positive");
+
+    m_Timeout = timeout;
+
+    if (m_Socket != INVALID_SOCKET)
+        ApplyTimeout();
+}
+
+void Console::ApplyTimeout()
+{
+    // Responses are read until they are complete (see Console::Receive) so the timeout
+    // is only reached when the console stops responding
+#ifdef _WIN32
+    DWORD timeout = static_cast<DWORD>(m_Timeout.count());
+    setsockopt(m_Socket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char *>(&timeout), sizeof(DWORD));
+#else
+    timeval tv = { static_cast<time_t>(m_Timeout.count() / 1000), static_cast<suseconds_t>((m_Timeout.count() % 1000) * 1000) };
+    setsockopt(m_Socket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char *>(&tv), sizeof(timeval));
+#endif
+}
+
+bool Console::Connect(const sockaddr *address, int addressLength)
+{
+    // A console that is off doesn't refuse the connection, the operating system would keep
+    // trying for minutes so the connection is made non-blocking to wait for it at most m_Timeout
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(m_Socket, FIONBIO, &nonBlocking);
+#else
+    int flags = fcntl(m_Socket, F_GETFL, 0);
+    fcntl(m_Socket, F_SETFL, flags | O_NONBLOCK);
+#endif
+
+    bool connected = connect(m_Socket, address, addressLength) != SOCKET_ERROR;
+
+#ifdef _WIN32
+    bool inProgress = !connected && WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    bool inProgress = !connected && errno == EINPROGRESS;
+#endif
+
+    if (inProgress)
+    {
+        fd_set writeSet;
+        FD_ZERO(&writeSet);
+        FD_SET(m_Socket, &writeSet);
+        fd_set errorSet = writeSet;
+        timeval tv = { static_cast<long>(m_Timeout.count() / 1000), static_cast<long>((m_Timeout.count() % 1000) * 1000) };
+
+        // Windows reports failed connections in the error set, other systems in the write set
+        if (select(static_cast<int>(m_Socket) + 1, nullptr, &writeSet, &errorSet, &tv) > 0)
+        {
+            int error = 0;
+            socklen_t errorLength = sizeof(error);
+            connected = getsockopt(m_Socket, SOL_SOCKET, SO_ERROR, reinterpret_cast<char *>(&error), &errorLength) == 0 && error == 0;
+        }
+    }
+
+#ifdef _WIN32
+    u_long blocking = 0;
+    ioctlsocket(m_Socket, FIONBIO, &blocking);
+#else
+    fcntl(m_Socket, F_SETFL, flags);
+#endif
+
+    return connected;
+}
+
+std::vector<CommandStats> Console::GetStats() const
+{
+#ifndef XBDM_DISABLE_STATS
+    return m_Stats.GetSnapshot();
+#else
+    return std::vector<CommandStats>();
+#endif
+}
+
+void Console::ResetStats()
+{
+#ifndef XBDM_DISABLE_STATS
+    m_Stats.Reset();
+#endif
+}
+
+void Console::SetStatsEnabled(bool enabled)
+{
+    m_StatsEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Console::StartRecording(const std::filesystem::path &tracePath)
+{
+    m_TraceWriter.Open(tracePath);
+}
+
+void Console::StopRecording()
+{
+    m_TraceWriter.Close();
+}
+
+void Console::SetTimeline(std::shared_ptr<Timeline> timeline)
+{
+    m_Timeline = std::move(timeline);
+    m_TimelineCommand.InFlight = false;
+
+    if (m_Timeline != nullptr)
+        m_TimelineTrack = m_Timeline->AddTrack(m_IpAddress + ':' + std::to_string(m_Port));
+}
+
 const std::string &Console::GetName()
 {
     // If the console name has already been requested, just sent what was cached last time
     if (!m_Name.empty())
         return m_Name;
 
-    SendCommand("dbgname");
-    std::string response = Receive();
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "GetName");
+
+    std::string response = SendQuery("dbgname");
 
     if (response.size() <= 5)
         throw std::runtime_error("Response length too short");
@@ -129,10 +358,11 @@ const std::string &Console::GetName()
 
 std::vector<Drive> Console::GetDrives()
 {
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "GetDrives");
+
     std::vector<Drive> drives;
 
-    SendCommand("drivelist");
-    std::string listResponse = Receive();
+    std::string listResponse = SendQuery("drivelist");
 
     if (listResponse.size() <= 4)
         throw std::runtime_error("Response length too short");
@@ -179,8 +409,7 @@ std::vector<Drive> Console::GetDrives()
             drive.FriendlyName = "Volume";
 
         // Get the free space for each drive
-        SendCommand("drivefreespace name=\"" + drive.Name + "\\\"");
-        std::string spaceResponse = Receive();
+        std::string spaceResponse = SendQuery("drivefreespace name=\"" + drive.Name + "\\\"");
 
         // Create 64-bit unsigned integers and making the value of 'XXXhi' properties
         // their upper 32 bits and the value of 'XXXlo' properties their lower 32 bits.
@@ -204,10 +433,11 @@ std::vector<Drive> Console::GetDrives()
 
 std::set<File> Console::GetDirectoryContents(const XboxPath &directoryPath)
 {
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "GetDirectoryContents", directoryPath.String());
+
     std::set<File> files;
 
-    SendCommand("dirlist name=\"" + (directoryPath.String().back() != '\\' ? directoryPath + '\\' : directoryPath) + "\"");
-    std::string contentResponse = Receive();
+    std::string contentResponse = SendQuery("dirlist name=\"" + (directoryPath.String().back() != '\\' ? directoryPath + '\\' : directoryPath) + "\"");
 
     if (contentResponse.size() <= 4)
         throw std::runtime_error("Response length too short");
@@ -265,10 +495,11 @@ std::set<File> Console::GetDirectoryContents(const XboxPath &directoryPath)
 
 File Console::GetFileAttributes(const XboxPath &path)
 {
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "GetFileAttributes", path.String());
+
     File file;
 
-    SendCommand("getfileattributes name=\"" + path + "\"");
-    std::string attributesResponse = Receive();
+    std::string attributesResponse = SendQuery("getfileattributes name=\"" + path + "\"");
 
     if (attributesResponse.size() <= 4)
         throw std::runtime_error("Response length too short");
@@ -289,20 +520,31 @@ File Console::GetFileAttributes(const XboxPath &path)
     return file;
 }
 
-void Console::LaunchXex(const XboxPath &xexPath)
+// The directory the title runs from is given with its trailing separator
+static std::string GetLaunchCommand(const XboxPath &xexPath)
 {
     XboxPath directory = xexPath.Parent();
+    std::string directoryString = directory.IsEmpty() ? std::string() : directory + "\\";
+
+    return "magicboot title=\"" + xexPath + "\" directory=\"" + directoryString + "\"";
+}
+
+void Console::LaunchXex(const XboxPath &xexPath)
+{
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "LaunchXex", xexPath.String());
 
-    SendCommand("magicboot title=\"" + xexPath + "\" directory=\"" + directory + "\"");
+    SendCommand(GetLaunchCommand(xexPath));
 
-    // Nothing should be received but just in case
-    ClearSocket();
+    // The response is not checked but it still needs to be read so that it doesn't get
+    // mistaken for the response of the next command
+    Receive();
 }
 
 XboxPath Console::GetActiveTitle()
 {
-    SendCommand("xbeinfo running");
-    std::string activeTitleResponse = Receive();
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "GetActiveTitle");
+
+    std::string activeTitleResponse = SendQuery("xbeinfo running");
 
     if (activeTitleResponse.size() <= 4)
         throw std::runtime_error("Response length too short");
@@ -315,8 +557,9 @@ XboxPath Console::GetActiveTitle()
 
 std::string Console::GetType()
 {
-    SendCommand("consoletype");
-    std::string consoleTypeResponse = Receive();
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "GetType");
+
+    std::string consoleTypeResponse = SendQuery("consoletype");
 
     if (consoleTypeResponse.size() <= 4)
         throw std::runtime_error("Response length too short");
@@ -339,6 +582,8 @@ void Console::SynchronizeTime()
 
 void Console::SetTime(time_t time)
 {
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "SetTime");
+
     uint64_t filetime = TIMET_TO_FILETIME(time);
     uint32_t clockHigh = filetime >> 32;
     uint32_t clockLow = filetime & 0xFFFFFFFF;
@@ -363,6 +608,8 @@ void Console::SetTime(time_t time)
 
 void Console::Reboot()
 {
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "Reboot");
+
     SendCommand("magicboot COLD");
 
     std::string rebootResponse = Receive();
@@ -376,11 +623,9 @@ void Console::Reboot()
 
 void Console::GoToDashboard()
 {
-    SendCommand("magicboot");
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "GoToDashboard");
 
-    // I don't know why but going to the dashboard seems to take longer than other operations
-    // and the console takes longer to respond
-    std::this_thread::sleep_for(20ms);
+    SendCommand("magicboot");
 
     std::string goToDashboardResponse = Receive();
 
@@ -398,287 +643,1690 @@ void Console::RestartActiveTitle()
     LaunchXex(activeTitlePath);
 }
 
-void Console::ReceiveFile(const XboxPath &remotePath, const std::filesystem::path &localPath)
+BootResult Console::LaunchXexAndWait(const XboxPath &xexPath, const BootOptions &options)
 {
-    char headerBuffer[40] = { 0 };
-    std::string header = "203- binary response follows\r\n";
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "LaunchXexAndWait", xexPath.String());
 
-    SendCommand("getfile name=\"" + remotePath + "\"");
+    return BootAndWait(GetLaunchCommand(xexPath), xexPath, options);
+}
 
-    // Receive the header
-    if (recv(m_Socket, headerBuffer, static_cast<int>(header.size()), 0) == SOCKET_ERROR)
-        throw std::runtime_error("Couldn't receive the response header");
+BootResult Console::RebootAndWait(const BootOptions &options)
+{
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "RebootAndWait");
 
-    if (strlen(headerBuffer) <= 4)
-    {
-        ClearSocket();
-        throw std::runtime_error("Response length too short");
-    }
+    return BootAndWait("magicboot COLD", XboxPath(), options);
+}
 
-    if (headerBuffer[0] != '2')
-    {
-        ClearSocket();
-        throw std::invalid_argument("Invalid remote path: " + remotePath);
-    }
+BootResult Console::BootAndWait(const std::string &command, const XboxPath &expectedTitle, const BootOptions &options)
+{
+    using Clock = std::chrono::steady_clock;
 
-    if (header != headerBuffer)
+    if (options.InitialPollInterval.count() <= 0 || options.MaxPollInterval < options.InitialPollInterval)
+        throw std::invalid_argument("The poll intervals must be positive and increasing");
+
+    bool launchingTitle = !expectedTitle.IsEmpty();
+
+    // Until the console went down, the title it runs is the one from before the command. That
+    // only matters when it's the title being launched, or when rebooting.
+    bool mustGoDown = !launchingTitle;
+    if (launchingTitle)
     {
-        ClearSocket();
-        throw std::runtime_error("Couldn't receive the file");
+        try
+        {
+            mustGoDown = GetActiveTitle() == expectedTitle;
+        }
+        catch (const std::exception &)
+        {
+        }
     }
 
-    // Receive the file size (4-byte integer sent right after the header)
-    int fileSize = 0;
-    if (recv(m_Socket, reinterpret_cast<char *>(&fileSize), sizeof(int), 0) == SOCKET_ERROR)
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + options.Timeout;
+
+    // Updated by the notification listener
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool wentDown = false;
+    Clock::time_point downTime;
+    uint32_t startedCount = 0;
+
+    auto goDown = [&](Clock::time_point time) {
+        if (!wentDown)
+        {
+            wentDown = true;
+            downTime = time;
+        }
+    };
+
+    // Started before sending the command so that none of the notifications of this boot are missed
+    std::unique_ptr<NotificationListener> listener;
+    if (options.UseNotifications)
     {
-        ClearSocket();
-        throw std::runtime_error("Couldn't receive the file size");
+        listener = std::make_unique<NotificationListener>(*this);
+        listener->Subscribe([&](const Notification &notification) {
+            bool isExecution = notification.Type == NotificationType::ExecutionState;
+            bool down = notification.Type == NotificationType::ConnectionLost || (isExecution && notification.Arguments == "rebooting");
+            bool started = isExecution && notification.Arguments == "started";
+
+            if (!down && !started)
+                return;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (down)
+                    goDown(Clock::now());
+                if (started)
+                    startedCount++;
+            }
+            changed.notify_all();
+        });
+
+        try
+        {
+            listener->Start();
+        }
+        catch (const std::exception &)
+        {
+            listener.reset();
+        }
     }
 
-    int bytes = 0;
-    size_t totalBytes = 0;
-    char contentBuffer[s_PacketSize] = { 0 };
+    bool commandSent = false;
 
-    std::ofstream outFile;
-    outFile.open(localPath, std::ofstream::binary);
+    try
+    {
+        SendCommand(command);
+        commandSent = true;
 
-    if (outFile.fail())
+        std::string response = Receive();
+
+        if (!m_ConnectionLost && (response.size() <= 4 || response[0] != '2'))
+            throw std::runtime_error(launchingTitle ? "Couldn't launch " + expectedTitle : "Couldn't cold reboot the console");
+    }
+    catch (const std::exception &)
     {
-        ClearSocket();
-        throw std::runtime_error("Invalid local path: " + localPath.string());
+        // A console rebooting right away can close the connection before responding, once
+        // the command was sent
+        if (!commandSent || !m_ConnectionLost)
+            throw;
     }
 
-    // Receive the content of the file from the server and write it to the file on the client
-    while (totalBytes < static_cast<size_t>(fileSize))
+    BootResult result;
+    result.CommandDuration = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+
+    std::chrono::milliseconds interval = options.InitialPollInterval;
+    bool notified = false;
+    for (;;)
     {
-        if ((bytes = recv(m_Socket, contentBuffer, sizeof(contentBuffer), 0)) == SOCKET_ERROR)
+        result.Polls++;
+
+        // The console closing the connection means it went down, it is then polled by
+        // trying to connect again
+        bool alive = m_Connected && IsConnectionAlive();
+        if (m_Connected && !alive)
         {
-            outFile.close();
-            throw std::runtime_error("Couldn't receive the file");
+            std::lock_guard<std::mutex> lock(mutex);
+            goDown(Clock::now());
         }
 
-        totalBytes += static_cast<size_t>(bytes);
+        // Neither connecting nor polling can wait past the deadline
+        std::chrono::milliseconds timeout = m_Timeout;
+        std::chrono::milliseconds timeLeft = std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now());
+        SetTimeout(std::clamp(timeLeft, std::chrono::milliseconds(1), timeout));
 
-        outFile.write(contentBuffer, bytes);
+        if (!alive)
+        {
+            Disconnect();
+            OpenConnection();
+        }
 
-        // Reset contentBuffer
-        memset(contentBuffer, 0, sizeof(contentBuffer));
-    }
+        XboxPath activeTitle;
+        bool titleRunning = false;
+        if (m_Connected)
+        {
+            // Reconnecting here would hide that the console went down
+            bool autoReconnect = m_AutoReconnect;
+            m_AutoReconnect = false;
+
+            try
+            {
+                activeTitle = GetActiveTitle();
+                titleRunning = !launchingTitle || activeTitle == expectedTitle;
+            }
+            catch (const std::exception &)
+            {
+            }
+
+            m_AutoReconnect = autoReconnect;
+        }
 
-    // Give write permission to the group (only effective on POSIX systems)
-    std::filesystem::permissions(localPath, std::filesystem::perms::group_write, std::filesystem::perm_options::add);
+        SetTimeout(timeout);
 
-    outFile.close();
+        std::unique_lock<std::mutex> lock(mutex);
+        Clock::time_point now = Clock::now();
 
-    // Clean the socket just in case there is more to receive
-    ClearSocket();
-}
+        // A title starting after the command was sent also means the console went down before
+        if (titleRunning && (wentDown || startedCount > 0 || !mustGoDown))
+        {
+            result.ActiveTitle = activeTitle;
+            result.ReadyDuration = std::chrono::duration_cast<std::chrono::microseconds>(now - start);
+            result.Notified = notified;
+            if (wentDown)
+                result.ShutdownDuration = std::chrono::duration_cast<std::chrono::microseconds>(downTime - start);
 
-void Console::ReceiveDirectory(const XboxPath &remotePath, const std::filesystem::path &localPath)
-{
-    std::set<File> files = GetDirectoryContents(remotePath);
+            return result;
+        }
 
-    bool directoryCreated = std::filesystem::create_directory(localPath);
-    if (!directoryCreated)
-        throw std::runtime_error("Could not create directory at location " + localPath.string());
+        if (now >= deadline)
+        {
+            std::string timeout = std::to_string(options.Timeout.count()) + " ms";
 
-    for (auto &file : files)
-    {
-        std::filesystem::path nextDirectory = localPath / file.Name;
+            throw std::runtime_error(launchingTitle ? expectedTitle + " wasn't running after " + timeout : "The console didn't come back from the reboot after " + timeout);
+        }
 
-        if (file.IsDirectory)
-            ReceiveDirectory(remotePath + '\\' + file.Name, nextDirectory.string());
-        else
-            ReceiveFile(remotePath + '\\' + file.Name, nextDirectory.string());
+        // A title starting ends the wait early, checking that it's the right one
+        uint32_t previousStartedCount = startedCount;
+        notified = changed.wait_until(lock, std::min(now + interval, deadline), [&]() { return startedCount != previousStartedCount; });
+        interval = std::min(interval * 2, options.MaxPollInterval);
     }
 }
 
-void Console::SendFile(const XboxPath &remotePath, const std::filesystem::path &localPath)
+TransferResult Console::ReceiveFile(const XboxPath &remotePath, const std::filesystem::path &localPath, const TransferOptions &options)
 {
-    std::ifstream file;
-    file.open(localPath, std::ifstream::binary);
+    TransferTracker tracker(options);
 
-    if (file.fail())
-        throw std::runtime_error("Invalid local path: " + localPath.string());
+    ReceiveFile(remotePath, localPath, tracker);
 
-    // Get the file size
-    file.seekg(0, file.end);
-    size_t fileSize = file.tellg();
-    file.seekg(0, file.beg);
+    return tracker.Finish();
+}
 
-    // Create the command
-    std::stringstream command;
-    command << "sendfile name=\"" << remotePath << "\" ";
-    command << "length=0x" << std::hex << fileSize << "\r\n";
+void Console::ReceiveFile(const XboxPath &remotePath, const std::filesystem::path &localPath, TransferTracker &tracker)
+{
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "ReceiveFile", remotePath.String());
 
-    SendCommand(command.str());
+    std::ofstream outFile;
 
-    char headerBuffer[40] = { 0 };
-    std::string header = "204- send binary data\r\n";
+    auto open = [&](uint32_t) {
+        outFile.open(localPath, std::ofstream::binary);
+        return !outFile.fail();
+    };
 
-    // Receive the header
-    if (recv(m_Socket, headerBuffer, static_cast<int>(header.size()), 0) == SOCKET_ERROR)
-        throw std::runtime_error("Couldn't receive the response header");
+    // Stops writing on the first failure, e.g. a full disk, so that a truncated file isn't
+    // reported as transferred
+    auto write = [&](const char *data, size_t length) {
+        outFile.write(data, static_cast<std::streamsize>(length));
+        return outFile.good();
+    };
 
-    if (strlen(headerBuffer) <= 4)
+    bool written = false;
+    try
     {
-        ClearSocket();
-        file.close();
-        throw std::runtime_error("Response length too short");
+        written = ReceiveFileContent(remotePath, localPath, tracker, open, write);
     }
-
-    if (headerBuffer[0] != '2')
+    catch (const OperationCancelled &)
     {
-        ClearSocket();
-        file.close();
-        throw std::invalid_argument("Invalid remote path: " + remotePath);
-    }
+        if (outFile.is_open())
+        {
+            outFile.close();
+            std::filesystem::remove(localPath);
+        }
 
-    if (header != headerBuffer)
-    {
-        ClearSocket();
-        file.close();
-        throw std::runtime_error("Couldn't send the file");
+        throw;
     }
 
-    char contentBuffer[s_PacketSize] = { 0 };
-
-    while (!file.eof())
-    {
-        file.read(contentBuffer, sizeof(contentBuffer));
+    if (!outFile.is_open())
+        throw std::runtime_error("Invalid local path: " + localPath.string());
 
-        if (send(m_Socket, contentBuffer, static_cast<int>(file.gcount()), 0) == SOCKET_ERROR)
-        {
-            CloseConnection();
-            file.close();
-            throw std::runtime_error("Couldn't send the file");
-        }
+    // Closing flushes what is left of the content, which can fail too
+    outFile.close();
 
-        // Reset contentBuffer
-        memset(contentBuffer, 0, sizeof(contentBuffer));
+    if (!written || outFile.fail())
+    {
+        if (std::filesystem::is_regular_file(localPath))
+            std::filesystem::remove(localPath);
 
-        // Give the Xbox 360 some time to process what was sent...
-        std::this_thread::sleep_for(20ms);
+        throw std::runtime_error("Couldn't write " + localPath.string());
     }
 
-    file.close();
-
-    // Receive the "200- OK\r\n" message the Xbox sends when the entire file is received
-    ClearSocket();
+    // Give write permission to the group (only effective on POSIX systems)
+    std::filesystem::permissions(localPath, std::filesystem::perms::group_write, std::filesystem::perm_options::add);
 }
 
-void Console::SendDirectory(const XboxPath &remotePath, const std::filesystem::path &localPath)
+bool Console::ReceiveFileContent(const XboxPath &remotePath, const std::filesystem::path &localPath, TransferTracker &tracker, const std::function<bool(uint32_t)> &open, const std::function<bool(const char *, size_t)> &write)
 {
-    bool remotePathAlreadyExists = false;
+    if (tracker.IsCancelled())
+        throw OperationCancelled("Transfer cancelled before receiving " + remotePath);
 
-    // We expect GetFileAttributes to throw here because we need remotePath not to exist
+    tracker.BeginFile(remotePath.String(), localPath);
+
+    // The command is only over once the whole file is received, or when something goes wrong
     try
     {
-        GetFileAttributes(remotePath);
-        remotePathAlreadyExists = true;
-    }
-    catch (const std::exception &)
-    {
-    }
+        std::string header = "203- binary response follows\r\n";
 
-    if (remotePathAlreadyExists)
-        throw std::invalid_argument("A file or directory with the name \"" + remotePath + "\" already exists");
+        SendCommand("getfile name=\"" + remotePath + "\"");
 
-    CreateDirectory(remotePath);
+        // Receive the header
+        std::string headerResponse = ReceiveLine();
 
-    for (const auto &entry : std::filesystem::directory_iterator(localPath))
-    {
-        std::filesystem::path entryFileName = entry.path().filename();
-        XboxPath nextRemotePath = remotePath / entryFileName.string();
-        std::filesystem::path nextLocalPath = localPath / entryFileName;
+        if (headerResponse.size() <= 4)
+            throw std::runtime_error("Response length too short");
 
-        entry.is_directory() ? SendDirectory(nextRemotePath, nextLocalPath) : SendFile(nextRemotePath, nextLocalPath);
-    }
+        if (headerResponse[0] != '2')
+            throw std::invalid_argument("Invalid remote path: " + remotePath);
+
+        if (headerResponse != header)
+        {
+            ClearSocket();
+            throw std::runtime_error("Couldn't receive the file");
+        }
+
+        // Receive the file size (4-byte integer sent right after the header)
+        uint32_t fileSize = 0;
+        if (!ReceiveBytes(reinterpret_cast<char *>(&fileSize), sizeof(fileSize)))
+        {
+            ClearSocket();
+            throw std::runtime_error("Couldn't receive the file size");
+        }
+
+        if (!tracker.IsTotalKnown())
+            tracker.SetTotalBytes(fileSize);
+
+        size_t totalBytes = 0;
+        char contentBuffer[s_PacketSize] = { 0 };
+
+        // The console sends the file content no matter what so, even if the destination can't
+        // take it, the content still needs to be received for the connection to stay usable
+        bool writable = open(fileSize);
+
+        // Receive the content of the file from the server and give it to the destination
+        while (totalBytes < static_cast<size_t>(fileSize))
+        {
+            // The console can't be told to stop sending the file so the only way to stop
+            // receiving it is to start over with a new connection
+            if (tracker.IsCancelled())
+            {
+                Reconnect();
+                throw OperationCancelled("Transfer cancelled while receiving " + remotePath);
+            }
+
+            // Never receive more than what is left of the file, anything after that is part of the next response
+            size_t toReceive = std::min<size_t>(sizeof(contentBuffer), fileSize - totalBytes);
+
+            if (!ReceiveBytes(contentBuffer, toReceive))
+                throw std::runtime_error("Couldn't receive the file");
+
+            totalBytes += toReceive;
+            tracker.Add(contentBuffer, toReceive);
+
+            if (writable)
+                writable = write(contentBuffer, toReceive);
+        }
+
+        FinishCommand(writable);
+
+        if (writable)
+            tracker.EndFile();
+
+        return writable;
+    }
+    catch (const std::exception &)
+    {
+        FinishCommand(false);
+        throw;
+    }
+}
+
+TransferResult Console::ReceiveDirectory(const XboxPath &remotePath, const std::filesystem::path &localPath, const TransferOptions &options)
+{
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "ReceiveDirectory", remotePath.String());
+
+    // The whole tree is listed before receiving anything so that the total size is known
+    // from the start
+    std::vector<TreeEntry> entries;
+    ListDirectoryTree(remotePath, localPath, entries);
+
+    TransferTracker tracker(options);
+    uint64_t totalBytes = 0;
+    for (auto &entry : entries)
+        totalBytes += entry.Attributes.Size;
+
+    tracker.SetTotalBytes(totalBytes);
+
+    bool directoryCreated = std::filesystem::create_directory(localPath);
+    if (!directoryCreated)
+        throw std::runtime_error("Could not create directory at location " + localPath.string());
+
+    // Parent directories are always listed before their content
+    for (auto &entry : entries)
+    {
+        if (entry.Attributes.IsDirectory)
+        {
+            directoryCreated = std::filesystem::create_directory(entry.LocalPath);
+            if (!directoryCreated)
+                throw std::runtime_error("Could not create directory at location " + entry.LocalPath.string());
+        }
+        else
+            ReceiveFile(entry.RemotePath, entry.LocalPath, tracker);
+    }
+
+    return tracker.Finish();
+}
+
+TransferResult Console::ReceiveDirectoryToArchive(const XboxPath &remotePath, ArchiveSink &sink, const TransferOptions &options)
+{
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "ReceiveDirectoryToArchive", remotePath.String());
+
+    // The entries of the archive are all under a directory named after the remote directory,
+    // like when archiving a local directory
+    File root = GetFileAttributes(remotePath);
+    std::filesystem::path rootPath = remotePath.FileName().String();
+
+    std::vector<TreeEntry> entries;
+    ListDirectoryTree(remotePath, rootPath, entries);
+
+    TransferTracker tracker(options);
+    uint64_t totalBytes = 0;
+    for (auto &entry : entries)
+        totalBytes += entry.Attributes.Size;
+
+    tracker.SetTotalBytes(totalBytes);
+
+    TarWriter archive(sink);
+    if (!rootPath.empty())
+        archive.AddDirectory(rootPath.generic_string(), root.ModificationDate);
+
+    for (auto &entry : entries)
+    {
+        std::string entryPath = entry.LocalPath.generic_string();
+
+        if (entry.Attributes.IsDirectory)
+        {
+            archive.AddDirectory(entryPath, entry.Attributes.ModificationDate);
+            continue;
+        }
+
+        Timeline::ScopedSpan fileSpan(m_Timeline.get(), m_TimelineTrack, "ReceiveFile", entry.RemotePath.String());
+
+        // Errors of the sink are kept until the whole file is received, so that the connection
+        // stays usable
+        std::exception_ptr sinkError;
+
+        auto open = [&](uint32_t fileSize) {
+            try
+            {
+                archive.BeginFile(entryPath, fileSize, entry.Attributes.ModificationDate);
+                return true;
+            }
+            catch (const std::exception &)
+            {
+                sinkError = std::current_exception();
+                return false;
+            }
+        };
+
+        auto write = [&](const char *data, size_t length) {
+            try
+            {
+                archive.WriteFileContent(data, length);
+                return true;
+            }
+            catch (const std::exception &)
+            {
+                sinkError = std::current_exception();
+                return false;
+            }
+        };
+
+        ReceiveFileContent(entry.RemotePath, entry.LocalPath, tracker, open, write);
+
+        if (sinkError)
+            std::rethrow_exception(sinkError);
+
+        archive.EndFile();
+    }
+
+    archive.Finish();
+
+    return tracker.Finish();
+}
+
+void Console::ListDirectoryTree(const XboxPath &remotePath, const std::filesystem::path &localPath, std::vector<TreeEntry> &entries)
+{
+    std::set<File> files = GetDirectoryContents(remotePath);
+
+    for (auto &file : files)
+    {
+        XboxPath nextRemotePath = remotePath + '\\' + file.Name;
+        std::filesystem::path nextLocalPath = localPath / file.Name;
+
+        entries.push_back({ nextRemotePath, nextLocalPath, file });
+
+        if (file.IsDirectory)
+            ListDirectoryTree(nextRemotePath, nextLocalPath, entries);
+    }
+}
+
+static std::string GetSendFileCommand(const XboxPath &remotePath, uint64_t size)
+{
+    std::stringstream command;
+    command << "sendfile name=\"" << remotePath << "\" ";
+    command << "length=0x" << std::hex << size;
+
+    return command.str();
+}
+
+TransferResult Console::SendFile(const XboxPath &remotePath, const std::filesystem::path &localPath, const TransferOptions &options)
+{
+    TransferTracker tracker(options);
+
+    SendFile(remotePath, localPath, tracker);
+
+    return tracker.Finish();
+}
+
+void Console::SendFile(const XboxPath &remotePath, const std::filesystem::path &localPath, TransferTracker &tracker)
+{
+    std::ifstream file;
+    file.open(localPath, std::ifstream::binary);
+
+    if (file.fail())
+        throw std::runtime_error("Invalid local path: " + localPath.string());
+
+    // Get the file size
+    file.seekg(0, file.end);
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    file.seekg(0, file.beg);
+
+    char contentBuffer[s_PacketSize] = { 0 };
+
+    SendFileContent(remotePath, localPath, fileSize, tracker, [&](const char *&data) {
+        file.read(contentBuffer, sizeof(contentBuffer));
+        data = contentBuffer;
+
+        return static_cast<size_t>(file.gcount());
+    });
+}
+
+bool Console::SendFileContent(const XboxPath &remotePath, const std::filesystem::path &localPath, uint64_t size, TransferTracker &tracker, const std::function<size_t(const char *&)> &read, bool commandSent, const std::string &nextCommand)
+{
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "SendFile", remotePath.String());
+
+    std::string command = GetSendFileCommand(remotePath, size);
+
+    // A command already sent is still received by the console, a cancellation is handled
+    // once its header arrives
+    if (commandSent)
+        BeginCommand(command);
+    else if (tracker.IsCancelled())
+        throw OperationCancelled("Transfer cancelled before sending " + remotePath);
+
+    tracker.BeginFile(remotePath.String(), localPath);
+
+    // Set while the next command is sent but the response to this one isn't received yet
+    bool nextCommandSent = false;
+
+    // The command is only over once the console acknowledges the whole file, or when something goes wrong
+    try
+    {
+        if (!tracker.IsTotalKnown())
+            tracker.SetTotalBytes(size);
+
+        if (!commandSent)
+            SendCommand(command);
+
+        std::string header = "204- send binary data\r\n";
+
+        // Receive the header
+        std::string headerResponse = ReceiveLine();
+
+        if (headerResponse.size() <= 4)
+            throw std::runtime_error("Response length too short");
+
+        if (headerResponse[0] != '2')
+            throw std::invalid_argument("Invalid remote path: " + remotePath);
+
+        if (headerResponse != header)
+        {
+            ClearSocket();
+            throw std::runtime_error("Couldn't send the file");
+        }
+
+        // There is no need to wait between packets, TCP flow control already prevents
+        // us from sending faster than the console can receive
+        uint64_t sent = 0;
+        while (sent < size)
+        {
+            // The console waits for the number of bytes announced in the command so the only way
+            // to stop sending is to start over with a new connection, and then remove what the
+            // console already received
+            if (tracker.IsCancelled())
+            {
+                Reconnect();
+
+                try
+                {
+                    DeleteFile(remotePath, false);
+                }
+                catch (const std::exception &)
+                {
+                }
+
+                throw OperationCancelled("Transfer cancelled while sending " + remotePath);
+            }
+
+            const char *data = nullptr;
+            size_t length = read(data);
+
+            // The content changed since its size was announced
+            if (length == 0 || length > size - sent)
+            {
+                Disconnect();
+                throw std::runtime_error("The size of " + localPath.string() + " changed while sending it");
+            }
+
+            if (!SendBytes(data, length))
+            {
+                Disconnect();
+                throw std::runtime_error("Couldn't send the file");
+            }
+
+            tracker.Add(data, length);
+            sent += length;
+        }
+
+        if (!nextCommand.empty() && !tracker.IsCancelled())
+        {
+            std::string fullNextCommand = nextCommand + "\r\n";
+            if (!SendBytes(fullNextCommand.c_str(), fullNextCommand.size()))
+            {
+                Disconnect();
+                throw std::runtime_error("Couldn't send the file");
+            }
+
+            nextCommandSent = true;
+        }
+
+        // Receive the "200- OK\r\n" message the Xbox sends when the entire file is received
+        std::string response = ReceiveLine();
+        FinishCommand(response.size() > 4 && response[0] == '2');
+
+        if (response.size() <= 4 || response[0] != '2')
+            throw std::runtime_error("Couldn't send the file");
+
+        tracker.EndFile();
+
+        return nextCommandSent;
+    }
+    catch (const std::exception &)
+    {
+        FinishCommand(false);
+
+        // The response to the next command would be taken for the response to the one after
+        if (nextCommandSent)
+            Disconnect();
+
+        throw;
+    }
+}
+
+TransferResult Console::SendDirectory(const XboxPath &remotePath, const std::filesystem::path &localPath, const TransferOptions &options)
+{
+    TransferTracker tracker(options);
+
+    // The local tree is walked first so that the total size is known from the start
+    uint64_t totalBytes = 0;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(localPath))
+    {
+        if (entry.is_regular_file())
+            totalBytes += entry.file_size();
+    }
+
+    tracker.SetTotalBytes(totalBytes);
+
+    SendDirectory(remotePath, localPath, tracker);
+
+    return tracker.Finish();
+}
+
+void Console::SendDirectory(const XboxPath &remotePath, const std::filesystem::path &localPath, TransferTracker &tracker)
+{
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "SendDirectory", remotePath.String());
+
+    bool remotePathAlreadyExists = false;
+
+    // We expect GetFileAttributes to throw here because we need remotePath not to exist
+    try
+    {
+        GetFileAttributes(remotePath);
+        remotePathAlreadyExists = true;
+    }
+    catch (const std::exception &)
+    {
+    }
+
+    if (remotePathAlreadyExists)
+        throw std::invalid_argument("A file or directory with the name \"" + remotePath + "\" already exists");
+
+    CreateDirectory(remotePath);
+
+    for (const auto &entry : std::filesystem::directory_iterator(localPath))
+    {
+        std::filesystem::path entryFileName = entry.path().filename();
+        XboxPath nextRemotePath = remotePath / entryFileName.string();
+        std::filesystem::path nextLocalPath = localPath / entryFileName;
+
+        entry.is_directory() ? SendDirectory(nextRemotePath, nextLocalPath, tracker) : SendFile(nextRemotePath, nextLocalPath, tracker);
+    }
+}
+
+// File names are case-insensitive on the console
+static std::string GetPathKey(const std::string &path)
+{
+    std::string key = path;
+    std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    return key;
+}
+
+// std::filesystem::file_time_type can't be converted to time_t before C++20, its offset to the
+// system clock is measured instead
+static time_t GetModificationDate(const std::filesystem::path &path)
+{
+    auto fileTime = std::filesystem::last_write_time(path);
+    auto systemTime = std::chrono::system_clock::now() + std::chrono::duration_cast<std::chrono::system_clock::duration>(fileTime - std::filesystem::file_time_type::clock::now());
+
+    return std::chrono::system_clock::to_time_t(systemTime);
+}
+
+DeployResult Console::DeployAndLaunch(const DeployManifest &manifest, const XboxPath &xexPath, const DeployOptions &options)
+{
+    using Clock = std::chrono::steady_clock;
+
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "DeployAndLaunch", xexPath.String());
+
+    Clock::time_point start = Clock::now();
+    DeployResult result;
+
+    // Each remote directory is listed once, with its files indexed by name
+    std::unordered_map<std::string, std::unordered_map<std::string, File>> listings;
+    std::set<std::string> existingDirectories;
+    std::vector<DeployEntry> changedFiles;
+    uint64_t totalBytes = 0;
+
+    for (const DeployEntry &entry : manifest.GetFiles())
+    {
+        XboxPath directory = entry.RemotePath.Parent();
+        std::string directoryKey = GetPathKey(directory.String());
+
+        auto listing = listings.find(directoryKey);
+        if (listing == listings.end())
+        {
+            std::unordered_map<std::string, File> files;
+
+            try
+            {
+                for (const File &file : GetDirectoryContents(directory))
+                    files[GetPathKey(file.Name)] = file;
+
+                existingDirectories.insert(directoryKey);
+            }
+            catch (const std::invalid_argument &)
+            {
+                CreateDirectories(directory, existingDirectories);
+            }
+
+            listing = listings.emplace(directoryKey, std::move(files)).first;
+        }
+
+        const std::string &remotePath = entry.RemotePath.String();
+        auto remoteFile = listing->second.find(GetPathKey(remotePath.substr(remotePath.find_last_of('\\') + 1)));
+        uint64_t size = std::filesystem::file_size(entry.LocalPath);
+
+        // The remote file is dated from when it was sent, to the second, so a file modified
+        // locally during that second is sent again
+        bool upToDate = !options.Force &&
+            remoteFile != listing->second.end() &&
+            !remoteFile->second.IsDirectory &&
+            remoteFile->second.Size == size &&
+            GetModificationDate(entry.LocalPath) < remoteFile->second.ModificationDate;
+
+        if (upToDate)
+        {
+            result.Skipped.push_back(entry.RemotePath);
+            continue;
+        }
+
+        changedFiles.push_back(entry);
+        totalBytes += size;
+    }
+
+    Clock::time_point uploadStart = Clock::now();
+    result.CompareDuration = std::chrono::duration_cast<std::chrono::microseconds>(uploadStart - start);
+
+    TransferTracker tracker(options.Transfer);
+    tracker.SetTotalBytes(totalBytes);
+    SendFiles(changedFiles, tracker);
+    result.Transfer = tracker.Finish();
+
+    Clock::time_point launchStart = Clock::now();
+    result.UploadDuration = std::chrono::duration_cast<std::chrono::microseconds>(launchStart - uploadStart);
+
+    result.Boot = LaunchXexAndWait(xexPath, options.Boot);
+
+    Clock::time_point end = Clock::now();
+    result.LaunchDuration = std::chrono::duration_cast<std::chrono::microseconds>(end - launchStart);
+    result.TotalDuration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+
+    return result;
+}
+
+void Console::SendFiles(const std::vector<DeployEntry> &files, TransferTracker &tracker)
+{
+    // The next file is opened before the current one is sent, so that its size is known for its
+    // command and a file that can't be opened doesn't leave a command waiting for its content
+    std::array<std::ifstream, 2> streams;
+    std::array<uint64_t, 2> sizes = { 0, 0 };
+    std::vector<char> buffer(s_UploadBufferSize);
+
+    auto open = [&](size_t index) {
+        std::ifstream &file = streams[index % 2];
+
+        file.close();
+        file.clear();
+        file.open(files[index].LocalPath, std::ifstream::binary);
+
+        if (file.fail())
+            throw std::runtime_error("Invalid local path: " + files[index].LocalPath.string());
+
+        file.seekg(0, file.end);
+        sizes[index % 2] = static_cast<uint64_t>(file.tellg());
+        file.seekg(0, file.beg);
+    };
+
+    if (!files.empty())
+        open(0);
+
+    bool commandSent = false;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        std::string nextCommand;
+        if (i + 1 < files.size())
+        {
+            try
+            {
+                open(i + 1);
+            }
+            catch (const std::exception &)
+            {
+                // The console is waiting for the content of the current file
+                if (commandSent)
+                    Disconnect();
+
+                throw;
+            }
+
+            nextCommand = GetSendFileCommand(files[i + 1].RemotePath, sizes[(i + 1) % 2]);
+        }
+
+        std::ifstream &file = streams[i % 2];
+
+        commandSent = SendFileContent(files[i].RemotePath, files[i].LocalPath, sizes[i % 2], tracker, [&](const char *&data) {
+            file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            data = buffer.data();
+
+            return static_cast<size_t>(file.gcount());
+        }, commandSent, nextCommand);
+    }
+}
+
+void Console::CreateDirectories(const XboxPath &directoryPath, std::set<std::string> &existing)
+{
+    std::string key = GetPathKey(directoryPath.String());
+    if (directoryPath.IsRoot() || existing.count(key) != 0)
+        return;
+
+    CreateDirectories(directoryPath.Parent(), existing);
+
+    try
+    {
+        CreateDirectory(directoryPath);
+    }
+    catch (const std::invalid_argument &)
+    {
+        // It already exists
+    }
+
+    existing.insert(key);
+}
+
+void Console::DeleteFile(const XboxPath &path, bool isDirectory)
+{
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "DeleteFile", path.String());
+
+    if (isDirectory)
+    {
+        std::set<File> files = GetDirectoryContents(path);
+
+        for (auto &file : files)
+            DeleteFile(path + '\\' + file.Name, file.IsDirectory);
+    }
+
+    SendCommand("delete name=\"" + path + '\"' + (isDirectory ? " dir" : ""));
+    std::string response = Receive();
+
+    if (response.size() <= 4)
+        throw std::runtime_error("Response length too short");
+
+    if (response[0] != '2')
+        throw std::runtime_error("Couldn't delete " + path);
+}
+
+void Console::CreateDirectory(const XboxPath &path)
+{
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "CreateDirectory", path.String());
+
+    SendCommand("mkdir name=\"" + path + "\"");
+    std::string response = Receive();
+
+    if (response.size() <= 4)
+        throw std::runtime_error("Response length too short");
+
+    if (response.substr(0, 3) == "410")
+        throw std::invalid_argument("A file or directory with the name \"" + path + "\" already exists");
+
+    if (response[0] != '2')
+        throw std::runtime_error("Couldn't create directory " + path);
+}
+
+void Console::RenameFile(const XboxPath &oldName, const XboxPath &newName)
+{
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "RenameFile", oldName.String());
+
+    SendCommand("rename name=\"" + oldName + "\" newname=\"" + newName + "\"");
+    std::string response = Receive();
+
+    if (response.size() <= 4)
+        throw std::runtime_error("Response length too short");
+
+    if (response[0] != '2')
+        throw std::runtime_error("Couldn't rename " + oldName);
+}
+
+void Console::ReadMemory(uint32_t address, uint32_t length, void *buffer)
+{
+    std::vector<MemoryRead> reads(1);
+    reads[0].Address = address;
+    reads[0].Length = length;
+    reads[0].Buffer = buffer;
+
+    ReadMemory(reads);
+
+    if (!reads[0].Succeeded)
+        throw std::invalid_argument("Memory isn't readable: " + Utils::ToHexAddress(address) + " (" + std::to_string(length) + " bytes)");
+}
+
+void Console::ReadMemory(std::vector<MemoryRead> &reads)
+{
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "ReadMemory", std::to_string(reads.size()) + " reads");
+
+    // Each chunk is read with a single getmemex command and covers all the reads it contains
+    struct Chunk
+    {
+        uint64_t Address = 0;
+        uint64_t End = 0;
+        std::vector<size_t> Reads;
+    };
+
+    std::vector<size_t> order;
+    for (size_t i = 0; i < reads.size(); i++)
+    {
+        if (static_cast<uint64_t>(reads[i].Address) + reads[i].Length > static_cast<uint64_t>(UINT32_MAX) + 1)
+            throw std::invalid_argument("Memory range past the end of the address space: " + Utils::ToHexAddress(reads[i].Address));
+
+        order.push_back(i);
+    }
+
+    std::sort(order.begin(), order.end(), [&](size_t left, size_t right) { return reads[left].Address < reads[right].Address; });
+
+    // Reads separated by less than s_MemoryMergeGap bytes are cheaper to read together than with
+    // separate commands, the bytes in between are received and dropped
+    std::vector<Chunk> chunks;
+    for (size_t index : order)
+    {
+        MemoryRead &read = reads[index];
+        read.Succeeded = true;
+
+        uint64_t start = read.Address;
+        uint64_t end = start + read.Length;
+        if (start == end)
+            continue;
+
+        if (!chunks.empty())
+        {
+            Chunk &last = chunks.back();
+            if (start >= last.Address && start <= last.End + s_MemoryMergeGap && end - last.Address <= s_MaxMemoryChunkSize)
+            {
+                last.End = std::max(last.End, end);
+                last.Reads.push_back(index);
+                continue;
+            }
+        }
+
+        for (uint64_t chunkStart = start; chunkStart < end; chunkStart += s_MaxMemoryChunkSize)
+            chunks.push_back({ chunkStart, std::min<uint64_t>(end, chunkStart + s_MaxMemoryChunkSize), { index } });
+    }
+
+    std::vector<std::string> commands;
+    for (const Chunk &chunk : chunks)
+        commands.push_back("getmemex addr=" + Utils::ToHexAddress(chunk.Address) + " length=" + Utils::ToHexAddress(chunk.End - chunk.Address));
+
+    std::vector<char> content;
+    std::vector<std::pair<uint32_t, uint32_t>> unreadable;
+
+    SendPipelined(commands, [&](size_t chunkIndex) {
+        const Chunk &chunk = chunks[chunkIndex];
+        uint32_t length = static_cast<uint32_t>(chunk.End - chunk.Address);
+
+        std::string header = ReceiveLine();
+
+        if (header.size() <= 4)
+            throw std::runtime_error("Response length too short");
+
+        if (header != "203- binary response follows\r\n")
+            throw std::runtime_error("Couldn't read memory at " + Utils::ToHexAddress(chunk.Address));
+
+        // A chunk covering a single read is a part of it and is received in place
+        const MemoryRead &firstRead = reads[chunk.Reads[0]];
+        bool inPlace = chunk.Reads.size() == 1;
+        char *destination = static_cast<char *>(firstRead.Buffer) + (chunk.Address - firstRead.Address);
+
+        if (!inPlace)
+        {
+            content.resize(length);
+            destination = content.data();
+        }
+
+        unreadable.clear();
+        ReceiveMemoryBlocks(destination, length, unreadable);
+        FinishCommand(true);
+
+        for (size_t readIndex : chunk.Reads)
+        {
+            MemoryRead &read = reads[readIndex];
+            uint64_t start = std::max<uint64_t>(read.Address, chunk.Address);
+            uint64_t end = std::min<uint64_t>(static_cast<uint64_t>(read.Address) + read.Length, chunk.End);
+
+            if (!inPlace)
+                memcpy(static_cast<char *>(read.Buffer) + (start - read.Address), content.data() + (start - chunk.Address), static_cast<size_t>(end - start));
+
+            for (const auto &[offset, size] : unreadable)
+            {
+                if (chunk.Address + offset < end && start < chunk.Address + offset + size)
+                    read.Succeeded = false;
+            }
+        }
+
+        return true;
+    });
 }
 
-void Console::DeleteFile(const XboxPath &path, bool isDirectory)
+std::vector<uint32_t> Console::ScanMemory(uint32_t address, uint32_t length, const Pattern &pattern, const ScanOptions &options)
 {
-    if (isDirectory)
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "ScanMemory", Utils::ToHexAddress(address));
+
+    uint64_t end = static_cast<uint64_t>(address) + length;
+    if (end > static_cast<uint64_t>(UINT32_MAX) + 1)
+        throw std::invalid_argument("Memory range past the end of the address space: " + Utils::ToHexAddress(address));
+
+    if (options.BlockSize == 0 || options.BlockSize > s_MaxMemoryChunkSize)
+        throw std::invalid_argument("The block size must be between 1 and " + std::to_string(s_MaxMemoryChunkSize) + " bytes");
+
+    // Each block is read with the first bytes of the next one so that matches overlapping two blocks
+    // are found, they are reported by the block they start in
+    struct Block
     {
-        std::set<File> files = GetDirectoryContents(path);
+        uint64_t Address = 0;
+        uint64_t OwnedEnd = 0;
+        uint32_t Length = 0;
+    };
+
+    std::vector<Block> blocks;
+    std::vector<std::string> commands;
+    for (uint64_t blockStart = address; blockStart < end; blockStart += options.BlockSize)
+    {
+        uint64_t ownedEnd = std::min<uint64_t>(end, blockStart + options.BlockSize);
+        uint64_t readEnd = std::min<uint64_t>(end, ownedEnd + pattern.Size() - 1);
 
-        for (auto &file : files)
-            DeleteFile(path + '\\' + file.Name, file.IsDirectory);
+        blocks.push_back({ blockStart, ownedEnd, static_cast<uint32_t>(readEnd - blockStart) });
+        commands.push_back("getmemex addr=" + Utils::ToHexAddress(blockStart) + " length=" + Utils::ToHexAddress(readEnd - blockStart));
     }
 
-    SendCommand("delete name=\"" + path + '\"' + (isDirectory ? " dir" : ""));
-    std::string response = Receive();
+    // While a block is scanned, the next one is received in the other buffer
+    std::array<std::vector<char>, 2> buffers;
+    std::array<std::vector<std::pair<uint32_t, uint32_t>>, 2> unreadable;
+    std::vector<uint32_t> results;
+    std::future<void> scan;
+
+    auto isFull = [&]() {
+        return options.MaxResults != 0 && results.size() >= options.MaxResults;
+    };
+
+    auto scanBlock = [&](size_t blockIndex) {
+        const Block &block = blocks[blockIndex];
+        const std::vector<char> &buffer = buffers[blockIndex % 2];
+        const uint8_t *data = reinterpret_cast<const uint8_t *>(buffer.data());
+
+        // Only the readable runs between the unreadable ranges are scanned
+        uint32_t runStart = 0;
+        auto scanRun = [&](uint32_t runEnd) {
+            pattern.Find(data + runStart, runEnd - runStart, [&](size_t offset) {
+                uint64_t matchAddress = block.Address + runStart + offset;
+                if (matchAddress >= block.OwnedEnd)
+                    return false;
+
+                if (matchAddress % std::max<uint32_t>(options.Alignment, 1) == 0)
+                    results.push_back(static_cast<uint32_t>(matchAddress));
+
+                return !isFull();
+            });
+        };
+
+        for (const auto &[offset, size] : unreadable[blockIndex % 2])
+        {
+            if (offset > runStart)
+                scanRun(offset);
 
-    if (response.size() <= 4)
-        throw std::runtime_error("Response length too short");
+            runStart = offset + size;
+        }
 
-    if (response[0] != '2')
-        throw std::runtime_error("Couldn't delete " + path);
+        if (runStart < block.Length)
+            scanRun(block.Length);
+    };
+
+    SendPipelined(commands, [&](size_t blockIndex) {
+        const Block &block = blocks[blockIndex];
+
+        std::string header = ReceiveLine();
+
+        if (header.size() <= 4)
+            throw std::runtime_error("Response length too short");
+
+        if (header != "203- binary response follows\r\n")
+            throw std::runtime_error("Couldn't read memory at " + Utils::ToHexAddress(block.Address));
+
+        buffers[blockIndex % 2].resize(block.Length);
+        unreadable[blockIndex % 2].clear();
+        ReceiveMemoryBlocks(buffers[blockIndex % 2].data(), block.Length, unreadable[blockIndex % 2]);
+        FinishCommand(true);
+
+        // The previous block has to be scanned before its buffer is reused for the next one
+        if (scan.valid())
+            scan.get();
+
+        if (isFull())
+            return false;
+
+        scan = std::async(std::launch::async, scanBlock, blockIndex);
+
+        return true;
+    });
+
+    if (scan.valid())
+        scan.get();
+
+    if (isFull())
+        results.resize(options.MaxResults);
+
+    return results;
 }
 
-void Console::CreateDirectory(const XboxPath &path)
+void Console::DumpMemory(const std::vector<MemoryRange> &regions, const std::filesystem::path &path, uint32_t pageSize)
 {
-    SendCommand("mkdir name=\"" + path + "\"");
-    std::string response = Receive();
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "DumpMemory", path.string());
 
-    if (response.size() <= 4)
-        throw std::runtime_error("Response length too short");
+    if (pageSize > s_MaxMemoryChunkSize)
+        throw std::invalid_argument("The page size can't be more than " + std::to_string(s_MaxMemoryChunkSize) + " bytes");
 
-    if (response.substr(0, 3) == "410")
-        throw std::invalid_argument("A file or directory with the name \"" + path + "\" already exists");
+    DumpWriter writer(path, pageSize);
 
-    if (response[0] != '2')
-        throw std::runtime_error("Couldn't create directory " + path);
+    // Regions are extended to whole pages and merged so that each page is read once
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    for (const MemoryRange &region : regions)
+    {
+        writer.AddRegion(region.Address, region.Length);
+
+        if (region.Length == 0)
+            continue;
+
+        uint64_t start = region.Address & ~static_cast<uint64_t>(pageSize - 1);
+        uint64_t end = (static_cast<uint64_t>(region.Address) + region.Length + pageSize - 1) & ~static_cast<uint64_t>(pageSize - 1);
+        ranges.emplace_back(start, end);
+    }
+
+    std::sort(ranges.begin(), ranges.end());
+
+    std::vector<MemoryRange> chunks;
+    std::vector<std::string> commands;
+    uint64_t covered = 0;
+    for (const auto &[start, end] : ranges)
+    {
+        for (uint64_t chunkStart = std::max(start, covered); chunkStart < end; chunkStart += s_MaxMemoryChunkSize)
+        {
+            uint32_t chunkLength = static_cast<uint32_t>(std::min<uint64_t>(end - chunkStart, s_MaxMemoryChunkSize));
+            chunks.push_back({ static_cast<uint32_t>(chunkStart), chunkLength });
+            commands.push_back("getmemex addr=" + Utils::ToHexAddress(chunkStart) + " length=" + Utils::ToHexAddress(chunkLength));
+        }
+
+        covered = std::max(covered, end);
+    }
+
+    std::vector<char> buffer;
+    std::vector<std::pair<uint32_t, uint32_t>> unreadable;
+
+    SendPipelined(commands, [&](size_t chunkIndex) {
+        const MemoryRange &chunk = chunks[chunkIndex];
+
+        std::string header = ReceiveLine();
+
+        if (header.size() <= 4)
+            throw std::runtime_error("Response length too short");
+
+        if (header != "203- binary response follows\r\n")
+            throw std::runtime_error("Couldn't read memory at " + Utils::ToHexAddress(chunk.Address));
+
+        buffer.resize(chunk.Length);
+        unreadable.clear();
+        ReceiveMemoryBlocks(buffer.data(), chunk.Length, unreadable);
+        FinishCommand(true);
+
+        // The runs of pages without unreadable bytes are written while the next chunks are
+        // still being received
+        uint32_t runStart = 0;
+        auto writeRun = [&](uint32_t runEnd) {
+            if (runEnd > runStart)
+                writer.WritePages(chunk.Address + runStart, buffer.data() + runStart, runEnd - runStart);
+        };
+
+        for (const auto &[offset, size] : unreadable)
+        {
+            writeRun(offset & ~(pageSize - 1));
+            runStart = (offset + size + pageSize - 1) & ~(pageSize - 1);
+        }
+
+        writeRun(chunk.Length);
+
+        return true;
+    });
+
+    writer.Finish();
 }
 
-void Console::RenameFile(const XboxPath &oldName, const XboxPath &newName)
+void Console::WriteMemory(uint32_t address, const void *data, size_t length)
 {
-    SendCommand("rename name=\"" + oldName + "\" newname=\"" + newName + "\"");
-    std::string response = Receive();
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "WriteMemory", Utils::ToHexAddress(address));
 
-    if (response.size() <= 4)
+    if (static_cast<uint64_t>(address) + length > static_cast<uint64_t>(UINT32_MAX) + 1)
+        throw std::invalid_argument("Memory range past the end of the address space: " + Utils::ToHexAddress(address));
+
+    // The console doesn't accept commands longer than 512 bytes so the data, sent in hexadecimal,
+    // is split in chunks
+    static const char hexDigits[] = "0123456789abcdef";
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    std::vector<std::string> commands;
+
+    for (size_t offset = 0; offset < length; offset += s_SetMemoryChunkSize)
+    {
+        size_t chunkLength = std::min(s_SetMemoryChunkSize, length - offset);
+        std::string command = "setmem addr=" + Utils::ToHexAddress(address + offset) + " data=";
+
+        for (size_t i = 0; i < chunkLength; i++)
+        {
+            command += hexDigits[bytes[offset + i] >> 4];
+            command += hexDigits[bytes[offset + i] & 0xf];
+        }
+
+        commands.push_back(std::move(command));
+    }
+
+    bool writable = true;
+    uint64_t firstUnwritable = 0;
+
+    SendPipelined(commands, [&](size_t chunkIndex) {
+        std::string response = ReceiveLine();
+
+        if (response.size() <= 4)
+            throw std::runtime_error("Response length too short");
+
+        // The response tells how many bytes were set, which stops at the first byte that isn't writable
+        size_t offset = chunkIndex * s_SetMemoryChunkSize;
+        size_t expected = std::min(s_SetMemoryChunkSize, length - offset);
+        size_t written = 0;
+        size_t setIndex = response.find("set ");
+
+        if (response[0] == '2' && setIndex != std::string::npos)
+            written = std::stoul(response.substr(setIndex + 4), nullptr, 0);
+
+        FinishCommand(response[0] == '2');
+
+        if (written < expected && writable)
+        {
+            writable = false;
+            firstUnwritable = address + offset + written;
+        }
+
+        return true;
+    });
+
+    if (!writable)
+        throw std::invalid_argument("Memory isn't writable: " + Utils::ToHexAddress(firstUnwritable));
+}
+
+Image Console::Screenshot()
+{
+    Image image;
+    Screenshot(image);
+
+    return image;
+}
+
+void Console::Screenshot(Image &image)
+{
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "Screenshot");
+
+    std::vector<uint8_t> framebuffer;
+    FramebufferInfo info = CaptureFramebuffer(framebuffer);
+
+    ConvertFramebuffer(framebuffer.data(), info, image);
+}
+
+void Console::Screenshot(const std::filesystem::path &path)
+{
+    Image image;
+    Screenshot(image);
+
+    image.Save(path);
+}
+
+FramebufferInfo Console::CaptureFramebuffer(std::vector<uint8_t> &framebuffer)
+{
+    Timeline::ScopedSpan span(m_Timeline.get(), m_TimelineTrack, "CaptureFramebuffer");
+
+    SendCommand("screenshot");
+
+    std::string header = ReceiveLine();
+
+    if (header.size() <= 4)
+    {
+        FinishCommand(false);
         throw std::runtime_error("Response length too short");
+    }
 
-    if (response[0] != '2')
-        throw std::runtime_error("Couldn't rename " + oldName);
+    if (header != "203- binary response follows\r\n")
+    {
+        FinishCommand(false);
+        throw std::runtime_error("Couldn't take a screenshot");
+    }
+
+    // The framebuffer follows a line describing it, anything going wrong from now on leaves
+    // the rest of the framebuffer in the socket so the connection has to be started over
+    try
+    {
+        std::string description = ReceiveLine();
+
+        FramebufferInfo info;
+        info.Width = GetIntegerProperty(description, "width", true);
+        info.Height = GetIntegerProperty(description, "height", true);
+        info.Pitch = GetIntegerProperty(description, "pitch", true);
+        info.Format = GetIntegerProperty(description, "format", true);
+        info.Size = GetIntegerProperty(description, "framebuffersize", true);
+
+        framebuffer.resize(info.Size);
+        if (!ReceiveBytes(reinterpret_cast<char *>(framebuffer.data()), framebuffer.size()))
+            throw std::runtime_error("Couldn't receive the framebuffer");
+
+        FinishCommand(true);
+
+        return info;
+    }
+    catch (const std::exception &)
+    {
+        FinishCommand(false);
+        Reconnect();
+        throw;
+    }
+}
+
+void Console::Reconnect()
+{
+    Disconnect();
+    OpenConnection();
+}
+
+void Console::SendPipelined(const std::vector<std::string> &commands, const std::function<bool(size_t)> &receive)
+{
+    size_t sent = 0;
+    size_t received = 0;
+    bool stopped = false;
+
+    try
+    {
+        while (received < sent || (!stopped && received < commands.size()))
+        {
+            // Commands are sent in batches, once half of the previous batch has been answered
+            if (!stopped && sent - received <= s_MaxPipelinedCommands / 2)
+            {
+                std::string batch;
+                while (sent < commands.size() && sent - received < s_MaxPipelinedCommands)
+                    batch += commands[sent++] + "\r\n";
+
+                if (!batch.empty() && !SendBytes(batch.data(), batch.size()))
+                    throw std::runtime_error("Couldn't send the commands");
+            }
+
+            // The command being answered is measured from when its response starts being read
+            BeginCommand(commands[received]);
+#ifndef XBDM_DISABLE_STATS
+            if (m_PendingCommand.InFlight)
+                m_PendingCommand.Sample.BytesSent += commands[received].size() + 2;
+#endif
+
+            stopped = !receive(received) || stopped;
+            received++;
+        }
+    }
+    catch (const std::exception &)
+    {
+        FinishCommand(false);
+
+        // The responses still on their way would be taken for the responses of the next commands
+        Reconnect();
+        throw;
+    }
+}
+
+void Console::ReceiveMemoryBlocks(char *buffer, uint32_t length, std::vector<std::pair<uint32_t, uint32_t>> &unreadable)
+{
+    // Blocks are at most 1KB so, instead of receiving each block and its header separately, they
+    // are parsed from a staging buffer filled with large receives. What is received past the
+    // end of the response goes back to m_ReceiveBuffer.
+    std::vector<char> staging(std::max<size_t>(64 * 1024, m_ReceiveBuffer.size()));
+    size_t begin = 0;
+    size_t end = m_ReceiveBuffer.size();
+    memcpy(staging.data(), m_ReceiveBuffer.data(), end);
+    m_ReceiveBuffer.clear();
+
+    auto fill = [&](size_t needed) {
+        if (end - begin >= needed)
+            return true;
+
+        memmove(staging.data(), staging.data() + begin, end - begin);
+        end -= begin;
+        begin = 0;
+
+        while (end < needed)
+        {
+            int bytes = ReceiveSome(staging.data() + end, staging.size() - end);
+            if (bytes <= 0)
+                return false;
+
+            end += static_cast<size_t>(bytes);
+        }
+
+        return true;
+    };
+
+    uint32_t received = 0;
+    while (received < length)
+    {
+        if (!fill(sizeof(uint16_t)))
+            throw std::runtime_error("Couldn't receive the memory");
+
+        // The high bit of the block size is set when the block isn't readable, no content follows
+        uint16_t blockHeader = 0;
+        memcpy(&blockHeader, staging.data() + begin, sizeof(blockHeader));
+        begin += sizeof(blockHeader);
+
+        uint32_t blockSize = blockHeader & 0x7fff;
+        if (blockSize == 0 || blockSize > length - received)
+            throw std::runtime_error("Invalid memory block size");
+
+        if ((blockHeader & 0x8000) != 0)
+        {
+            memset(buffer + received, 0, blockSize);
+
+            if (!unreadable.empty() && unreadable.back().first + unreadable.back().second == received)
+                unreadable.back().second += blockSize;
+            else
+                unreadable.emplace_back(received, blockSize);
+        }
+        else
+        {
+            if (!fill(blockSize))
+                throw std::runtime_error("Couldn't receive the memory");
+
+            memcpy(buffer + received, staging.data() + begin, blockSize);
+            begin += blockSize;
+        }
+
+        received += blockSize;
+    }
+
+    m_ReceiveBuffer.assign(staging.data() + begin, end - begin);
 }
 
 std::string Console::Receive()
 {
-    // We allocate s_PacketSize + 1 but will only receive s_PacketSize at a time to guarantee
-    // that the last byte is always 0 so that strings stay null terminated
-    char buffer[s_PacketSize + 1] = { 0 };
-    std::stringstream stream;
+    // Every response starts with a status line
+    std::string response = ReceiveLine();
 
-    while (recv(m_Socket, buffer, s_PacketSize, 0) > 0)
+    // Multiline responses (status code 202) are made of lines following the status line
+    // and end with a line only containing a dot
+    if (response.compare(0, 3, "202") == 0)
     {
-        // Give the Xbox 360 some time to notice we received something...
-        std::this_thread::sleep_for(10ms);
-        stream << buffer;
+        for (;;)
+        {
+            std::string line = ReceiveLine();
+            response += line;
 
-        // Reset buffer
-        memset(buffer, 0, s_PacketSize);
+            // An incomplete line means the connection was closed or timed out
+            if (line == ".\r\n" || !Utils::String::EndsWith(line, "\r\n"))
+                break;
+        }
     }
 
-    std::string result = stream.str();
+    FinishCommand(response.size() > 4 && response[0] == '2');
 
-    // Sometimes the response ends but we still receive some stuff.
-    // If that's the case, we want to remove everything after ".\r\n".
-    size_t endPos = result.find(".\r\n");
-    if (endPos != std::string::npos && result.substr(result.size() - 3, 3) != ".\r\n")
-        result = result.substr(0, endPos);
+    return response;
+}
 
-    return result;
+std::string Console::ReceiveLine()
+{
+    char buffer[s_PacketSize] = { 0 };
+    size_t endPos = 0;
+
+    while ((endPos = m_ReceiveBuffer.find("\r\n")) == std::string::npos)
+    {
+        int bytes = ReceiveSome(buffer, s_PacketSize);
+
+        // If the connection was closed or timed out, return whatever was received so far
+        if (bytes <= 0)
+        {
+            std::string partialLine = m_ReceiveBuffer;
+            m_ReceiveBuffer.clear();
+
+            return partialLine;
+        }
+
+        m_ReceiveBuffer.append(buffer, static_cast<size_t>(bytes));
+    }
+
+    std::string line = m_ReceiveBuffer.substr(0, endPos + 2);
+    m_ReceiveBuffer.erase(0, endPos + 2);
+
+    return line;
+}
+
+bool Console::ReceiveBytes(char *buffer, size_t length)
+{
+    // Start with what was already received while looking for the end of a line
+    size_t fromReceiveBuffer = std::min<size_t>(length, m_ReceiveBuffer.size());
+    memcpy(buffer, m_ReceiveBuffer.data(), fromReceiveBuffer);
+    m_ReceiveBuffer.erase(0, fromReceiveBuffer);
+
+    size_t totalBytes = fromReceiveBuffer;
+
+    while (totalBytes < length)
+    {
+        int bytes = ReceiveSome(buffer + totalBytes, length - totalBytes);
+        if (bytes <= 0)
+            return false;
+
+        totalBytes += static_cast<size_t>(bytes);
+    }
+
+    return true;
+}
+
+#ifdef MSG_NOSIGNAL
+    #define SEND_FLAGS MSG_NOSIGNAL
+#else
+    #define SEND_FLAGS 0
+#endif
+
+bool Console::SendBytes(const char *buffer, size_t length)
+{
+    size_t totalBytes = 0;
+
+    // send can return before everything is sent so keep sending until everything is
+    while (totalBytes < length)
+    {
+        int bytes = send(m_Socket, buffer + totalBytes, static_cast<int>(length - totalBytes), SEND_FLAGS);
+        if (bytes == SOCKET_ERROR)
+            return false;
+
+        m_TraceWriter.Write(TraceEvent::Type::Sent, buffer + totalBytes, static_cast<size_t>(bytes));
+
+        totalBytes += static_cast<size_t>(bytes);
+    }
+
+#ifndef XBDM_DISABLE_STATS
+    if (m_PendingCommand.InFlight)
+        m_PendingCommand.Sample.BytesSent += length;
+#endif
+
+    return true;
+}
+
+int Console::ReceiveSome(char *buffer, size_t length)
+{
+    int bytes = 0;
+
+#ifndef XBDM_DISABLE_STATS
+    if (m_PendingCommand.InFlight)
+    {
+        auto start = std::chrono::steady_clock::now();
+        bytes = recv(m_Socket, buffer, static_cast<int>(length), 0);
+        m_PendingCommand.Sample.ReceiveTime += std::chrono::steady_clock::now() - start;
+
+        if (bytes > 0)
+            m_PendingCommand.Sample.BytesReceived += static_cast<uint64_t>(bytes);
+    }
+    else
+        bytes = recv(m_Socket, buffer, static_cast<int>(length), 0);
+#else
+    bytes = recv(m_Socket, buffer, static_cast<int>(length), 0);
+#endif
+
+    if (bytes > 0)
+        m_TraceWriter.Write(TraceEvent::Type::Received, buffer, static_cast<size_t>(bytes));
+
+    // Anything but a timeout means the connection is gone
+#ifdef _WIN32
+    if (bytes == 0 || (bytes < 0 && WSAGetLastError() != WSAETIMEDOUT))
+#else
+    if (bytes == 0 || (bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+#endif
+        m_ConnectionLost = true;
+
+    if (bytes > 0 && m_TimelineCommand.InFlight && m_TimelineCommand.FirstByte == Timeline::Clock::time_point())
+        m_TimelineCommand.FirstByte = Timeline::Clock::now();
+
+    return bytes;
 }
 
 void Console::SendCommand(const std::string &command)
 {
+    // A connection closed by the console is only noticed once it's used again
+    if (m_AutoReconnect && !IsConnectionAlive() && !ReconnectWithBackoff())
+        throw std::runtime_error("Lost the connection to " + m_IpAddress + " and couldn't open it again");
+
+    BeginCommand(command);
+
     std::string fullCommand = command + "\r\n";
-    if (send(m_Socket, fullCommand.c_str(), static_cast<int>(fullCommand.size()), 0) == SOCKET_ERROR)
-        CloseConnection();
+    if (!SendBytes(fullCommand.c_str(), fullCommand.size()))
+    {
+        m_ConnectionLost = true;
+        Disconnect();
+        throw std::runtime_error("Lost the connection to " + m_IpAddress);
+    }
+
+    if (m_TimelineCommand.InFlight)
+        m_TimelineCommand.SendEnd = Timeline::Clock::now();
+}
+
+void Console::BeginCommand(const std::string &command)
+{
+    if (m_Timeline != nullptr)
+    {
+        m_TimelineCommand.InFlight = true;
+        m_TimelineCommand.Command = command;
+        m_TimelineCommand.Start = Timeline::Clock::now();
+        m_TimelineCommand.SendEnd = m_TimelineCommand.Start;
+        m_TimelineCommand.FirstByte = Timeline::Clock::time_point();
+    }
 
-    // Give the Xbox 360 some time to process the command and create a response...
-    std::this_thread::sleep_for(10ms);
+#ifndef XBDM_DISABLE_STATS
+    if (!m_StatsEnabled.load(std::memory_order_relaxed))
+        return;
+
+    m_PendingCommand.InFlight = true;
+    m_PendingCommand.VerbIndex = StatsRecorder::GetVerbIndex(command);
+    m_PendingCommand.Sample = StatsRecorder::Sample();
+    m_PendingCommand.Start = std::chrono::steady_clock::now();
+#else
+    (void)command;
+#endif
+}
+
+void Console::FinishCommand(bool success)
+{
+    if (m_TimelineCommand.InFlight && m_Timeline != nullptr)
+    {
+        auto end = Timeline::Clock::now();
+        auto firstByte = m_TimelineCommand.FirstByte != Timeline::Clock::time_point() ? m_TimelineCommand.FirstByte : end;
+        std::string verb = m_TimelineCommand.Command.substr(0, m_TimelineCommand.Command.find(' '));
+        std::string detail = success ? m_TimelineCommand.Command : m_TimelineCommand.Command + " (failed)";
+
+        m_Timeline->AddSpan({ verb, "command", detail, m_TimelineTrack, m_TimelineCommand.Start, end });
+        m_Timeline->AddSpan({ "send", "phase", std::string(), m_TimelineTrack, m_TimelineCommand.Start, m_TimelineCommand.SendEnd });
+        m_Timeline->AddSpan({ "wait", "phase", std::string(), m_TimelineTrack, m_TimelineCommand.SendEnd, firstByte });
+        m_Timeline->AddSpan({ "transfer", "phase", std::string(), m_TimelineTrack, firstByte, end });
+    }
+
+    m_TimelineCommand.InFlight = false;
+
+#ifndef XBDM_DISABLE_STATS
+    if (!m_PendingCommand.InFlight)
+        return;
+
+    m_PendingCommand.InFlight = false;
+    m_PendingCommand.Sample.Latency = std::chrono::steady_clock::now() - m_PendingCommand.Start;
+    m_PendingCommand.Sample.Success = success;
+    m_Stats.Record(m_PendingCommand.VerbIndex, m_PendingCommand.Sample);
+#else
+    (void)success;
+#endif
 }
 
 uint32_t Console::GetIntegerProperty(const std::string &line, const std::string &propertyName, bool hex)
@@ -717,9 +2365,23 @@ std::string Console::GetStringProperty(const std::string &line, const std::strin
 
 void Console::ClearSocket()
 {
+    m_ReceiveBuffer.clear();
+
+    // Only discard what was already received, waiting for more would mean always waiting
+    // for the timeout to be reached
     char buffer[s_PacketSize] = { 0 };
-    while (recv(m_Socket, buffer, s_PacketSize, 0) > 0)
+    for (;;)
     {
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(m_Socket, &readSet);
+        timeval tv = { 0, 0 };
+
+        if (select(static_cast<int>(m_Socket) + 1, &readSet, nullptr, nullptr, &tv) <= 0)
+            break;
+
+        if (ReceiveSome(buffer, s_PacketSize) <= 0)
+            break;
     }
 }
 
@@ -2,6 +2,16 @@
 
 #include "Definitions.h"
 #include "XboxPath.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "Timeline.h"
+#include "Transfer.h"
+#include "Archive.h"
+#include "Scanner.h"
+#include "Dump.h"
+#include "Image.h"
+#include "Boot.h"
+#include "Deploy.h"
 
 namespace XBDM
 {
@@ -10,7 +20,7 @@ class Console
 {
 public:
     Console();
-    Console(const std::string &ipAddress);
+    Console(const std::string &ipAddress, uint16_t port = s_DefaultPort);
     ~Console();
 
     bool OpenConnection();
@@ -33,32 +43,242 @@ public:
     void GoToDashboard();
     void RestartActiveTitle();
 
-    void ReceiveFile(const XboxPath &remotePath, const std::filesystem::path &localPath);
-    void ReceiveDirectory(const XboxPath &remotePath, const std::filesystem::path &localPath);
-    void SendFile(const XboxPath &remotePath, const std::filesystem::path &localPath);
-    void SendDirectory(const XboxPath &remotePath, const std::filesystem::path &localPath);
+    // Send the same commands as LaunchXex and Reboot but return once the console runs the title
+    // (any title after a reboot), which is noticed through notifications and polling. Throw
+    // std::runtime_error if the console refuses the command or isn't ready within options.Timeout.
+    BootResult LaunchXexAndWait(const XboxPath &xexPath, const BootOptions &options = BootOptions());
+    BootResult RebootAndWait(const BootOptions &options = BootOptions());
+
+    // Transfers can report their progress and be cancelled through options, cancelling
+    // throws OperationCancelled. The result holds the checksums of every file transferred.
+    TransferResult ReceiveFile(const XboxPath &remotePath, const std::filesystem::path &localPath, const TransferOptions &options = TransferOptions());
+    TransferResult ReceiveDirectory(const XboxPath &remotePath, const std::filesystem::path &localPath, const TransferOptions &options = TransferOptions());
+    // Streams the remote tree into a tar archive instead of creating the files locally, the
+    // entries keep the modification dates of the remote files. The result refers to the
+    // files by their path in the archive. A cancelled transfer leaves an incomplete archive.
+    TransferResult ReceiveDirectoryToArchive(const XboxPath &remotePath, ArchiveSink &sink, const TransferOptions &options = TransferOptions());
+    TransferResult SendFile(const XboxPath &remotePath, const std::filesystem::path &localPath, const TransferOptions &options = TransferOptions());
+    TransferResult SendDirectory(const XboxPath &remotePath, const std::filesystem::path &localPath, const TransferOptions &options = TransferOptions());
+
+    // Sends the files of the manifest the console doesn't have yet, the ones with another size or
+    // modified locally since they were sent, then launches xexPath and waits until it runs (see
+    // LaunchXexAndWait). Missing remote directories are created. Local and remote dates are
+    // compared, so the clock of the console should be synchronized (see SynchronizeTime).
+    DeployResult DeployAndLaunch(const DeployManifest &manifest, const XboxPath &xexPath, const DeployOptions &options = DeployOptions());
+
     void DeleteFile(const XboxPath &path, bool isDirectory);
     void CreateDirectory(const XboxPath &path);
     void RenameFile(const XboxPath &oldName, const XboxPath &newName);
 
+    // Memory is read with the binary getmemex command, in chunks of up to s_MaxMemoryChunkSize
+    // bytes whose commands are sent without waiting for the previous responses. Reading or
+    // writing memory that isn't mapped throws std::invalid_argument.
+    void ReadMemory(uint32_t address, uint32_t length, void *buffer);
+    void WriteMemory(uint32_t address, const void *data, size_t length);
+    inline void WriteMemory(uint32_t address, const std::vector<uint8_t> &data) { WriteMemory(address, data.data(), data.size()); }
+
+    // Batched form for many small reads: reads close to each other are merged into a single
+    // command and all the commands are pipelined, so the batch costs about one round trip.
+    // Unreadable ranges don't throw, their Succeeded flag is left to false instead.
+    void ReadMemory(std::vector<MemoryRead> &reads);
+
+    // Searches length bytes of memory starting at address for pattern and returns the addresses
+    // of the matches in increasing order. Blocks are scanned on another thread while the next
+    // ones are received, unreadable memory is skipped.
+    std::vector<uint32_t> ScanMemory(uint32_t address, uint32_t length, const Pattern &pattern, const ScanOptions &options = ScanOptions());
+
+    // Writes the regions, extended to whole pages, to a dump that DumpReader can open. Pages are
+    // written as they are received and unreadable pages are left out of the dump.
+    void DumpMemory(const std::vector<MemoryRange> &regions, const std::filesystem::path &path, uint32_t pageSize = 4096);
+
+    // Captures the framebuffer and converts it to RGBA. The overload taking an image reuses its
+    // pixel buffer, the one taking a path saves to PNG or PPM depending on the extension.
+    Image Screenshot();
+    void Screenshot(Image &image);
+    void Screenshot(const std::filesystem::path &path);
+
+    // Receives the framebuffer as the console stores it, to be given to ConvertFramebuffer
+    FramebufferInfo CaptureFramebuffer(std::vector<uint8_t> &framebuffer);
+
     inline bool IsConnected() { return m_Connected; }
 
     inline const std::string &GetIpAddress() const { return m_IpAddress; }
 
+    inline uint16_t GetPort() const { return m_Port; }
+
+    // Longest wait for the console to accept the connection and for each part of a response,
+    // 5 seconds by default. Applies to the current connection and the next ones.
+    void SetTimeout(std::chrono::milliseconds timeout);
+
+    inline std::chrono::milliseconds GetTimeout() const { return m_Timeout; }
+
+    // A command finding the connection closed, e.g. because the console rebooted, opens it again
+    // first. Commands only reading the state of the console are also sent again when the
+    // connection is lost before their response arrives. Connections closed with CloseConnection
+    // aren't opened again.
+    void SetReconnectPolicy(const ReconnectPolicy &policy);
+
+    inline const ReconnectPolicy &GetReconnectPolicy() const { return m_ReconnectPolicy; }
+
+    // Times the connection was opened again by a command
+    inline uint64_t GetReconnectionCount() const { return m_ReconnectionCount; }
+
+    // Metrics of the commands sent since the console object was created or since the
+    // last call to ResetStats. Can be called from any thread. Always empty when the
+    // library is compiled with XBDM_DISABLE_STATS.
+    std::vector<CommandStats> GetStats() const;
+    void ResetStats();
+
+    // Stats are enabled by default, disabling them skips all the measurements
+    void SetStatsEnabled(bool enabled);
+
+    // Writes every byte sent and received to a trace file (see TraceWriter) until StopRecording
+    // is called, so that the session can be replayed later without the console
+    void StartRecording(const std::filesystem::path &tracePath);
+    void StopRecording();
+
+    // Adds spans for each operation, each command they send and the phases of the commands
+    // to timeline, on a track named after the address of the console. nullptr stops adding spans.
+    void SetTimeline(std::shared_ptr<Timeline> timeline);
+
 private:
+    // Turns its own console connection into a notification channel
+    friend class NotificationListener;
+
+    // Sends the same file content to many consoles
+    friend class ConsoleFleet;
+
     bool m_Connected = false;
     std::string m_IpAddress;
+    uint16_t m_Port = s_DefaultPort;
     std::string m_Name;
     SOCKET m_Socket;
+    std::chrono::milliseconds m_Timeout = std::chrono::milliseconds(s_TimeoutMilliseconds);
+
+    // The address is only resolved again when connecting to it fails
+    bool m_AddressResolved = false;
+    sockaddr_storage m_Address = {};
+    int m_AddressLength = 0;
+
+    ReconnectPolicy m_ReconnectPolicy;
+    bool m_AutoReconnect = false;
+    bool m_ConnectionLost = false;
+    uint64_t m_ReconnectionCount = 0;
+    std::string m_ReceiveBuffer;
+    TraceWriter m_TraceWriter;
+
+    // The command being sent is split in 3 phases on the timeline: sending the command, waiting
+    // for the first byte of the response and receiving the rest of the response
+    struct TimelineCommand
+    {
+        bool InFlight = false;
+        std::string Command;
+        Timeline::Clock::time_point Start;
+        Timeline::Clock::time_point SendEnd;
+        Timeline::Clock::time_point FirstByte;
+    };
+
+    std::shared_ptr<Timeline> m_Timeline;
+    uint32_t m_TimelineTrack = 0;
+    TimelineCommand m_TimelineCommand;
     static const int s_PacketSize = 1024;
+    static const uint16_t s_DefaultPort = 730;
+    static constexpr int s_TimeoutMilliseconds = 5000;
+    static constexpr int s_KeepAliveIdleSeconds = 10;
+    static constexpr int s_KeepAliveIntervalSeconds = 2;
+    static constexpr int s_KeepAliveProbes = 3;
+    static constexpr uint32_t s_MaxMemoryChunkSize = 1024 * 1024;
+    static constexpr uint32_t s_MemoryMergeGap = 256;
+    static constexpr size_t s_SetMemoryChunkSize = 224;
+    static constexpr size_t s_MaxPipelinedCommands = 32;
+    static constexpr size_t s_UploadBufferSize = 64 * 1024;
+
+    // The command waiting for its response to be complete. Declared even when the library is
+    // compiled with XBDM_DISABLE_STATS, so that the layout of Console doesn't depend on it.
+    struct PendingCommand
+    {
+        bool InFlight = false;
+        size_t VerbIndex = 0;
+        std::chrono::steady_clock::time_point Start;
+        StatsRecorder::Sample Sample;
+    };
+
+    std::atomic<bool> m_StatsEnabled = true;
+    StatsRecorder m_Stats;
+    PendingCommand m_PendingCommand;
+
+    struct TreeEntry
+    {
+        XboxPath RemotePath;
+        std::filesystem::path LocalPath;
+        File Attributes;
+    };
+
+    void ReceiveFile(const XboxPath &remotePath, const std::filesystem::path &localPath, TransferTracker &tracker);
+
+    // Receives remotePath and gives its content to write as it arrives, once open has been given
+    // its size. When open or write return false the rest of the content is still received, for
+    // the connection to stay usable, but dropped. Returns whether all of it was written.
+    bool ReceiveFileContent(const XboxPath &remotePath, const std::filesystem::path &localPath, TransferTracker &tracker, const std::function<bool(uint32_t)> &open, const std::function<bool(const char *, size_t)> &write);
+    void SendFile(const XboxPath &remotePath, const std::filesystem::path &localPath, TransferTracker &tracker);
+
+    // Sends size bytes to remotePath, read returns the next part of the content and its length.
+    // localPath is only used to identify the file in the result of the transfer. nextCommand is
+    // sent right after the content, before the response to this file, and the call sending its
+    // content then gets commandSent. Returns whether nextCommand was sent, it isn't once the
+    // transfer is cancelled.
+    bool SendFileContent(const XboxPath &remotePath, const std::filesystem::path &localPath, uint64_t size, TransferTracker &tracker, const std::function<size_t(const char *&)> &read, bool commandSent = false, const std::string &nextCommand = std::string());
+    void SendDirectory(const XboxPath &remotePath, const std::filesystem::path &localPath, TransferTracker &tracker);
+    void ListDirectoryTree(const XboxPath &remotePath, const std::filesystem::path &localPath, std::vector<TreeEntry> &entries);
+    void Reconnect();
+
+    // Sends each sendfile command right after the content of the previous file, so that the
+    // console acknowledging a file and accepting the next one takes a single round trip
+    void SendFiles(const std::vector<DeployEntry> &files, TransferTracker &tracker);
+
+    // Creates directoryPath and its missing parents, existing holds the directories known to exist
+    void CreateDirectories(const XboxPath &directoryPath, std::set<std::string> &existing);
+
+    // Sends the commands without waiting for each response, keeping at most s_MaxPipelinedCommands
+    // in flight, and calls receive with the index of each command when its response is next.
+    // When receive returns false no more commands are sent, the responses of the commands
+    // already sent are still given to receive.
+    void SendPipelined(const std::vector<std::string> &commands, const std::function<bool(size_t)> &receive);
+
+    // Receives the blocks of a getmemex response into buffer, adding the unreadable ranges,
+    // relative to buffer, to unreadable
+    void ReceiveMemoryBlocks(char *buffer, uint32_t length, std::vector<std::pair<uint32_t, uint32_t>> &unreadable);
 
     std::string Receive();
+    std::string ReceiveLine();
+    bool ReceiveBytes(char *buffer, size_t length);
+    int ReceiveSome(char *buffer, size_t length);
+    bool SendBytes(const char *buffer, size_t length);
     void SendCommand(const std::string &command);
 
+    void BeginCommand(const std::string &command);
+    void FinishCommand(bool success);
+
     uint32_t GetIntegerProperty(const std::string &line, const std::string &propertyName, bool hex = true);
     std::string GetStringProperty(const std::string &line, const std::string &propertyName);
 
     void ClearSocket();
+
+    void ApplyTimeout();
+    bool Connect(const sockaddr *address, int addressLength);
+
+    // Closes the socket without preventing commands from opening the connection again
+    void Disconnect();
+    bool IsConnectionAlive();
+    bool ReconnectWithBackoff();
+
+    // For commands that don't change the state of the console, sent again on a new connection
+    // when the connection is lost before their response is complete
+    std::string SendQuery(const std::string &command);
+
+    // Sends command, which boots the console, and waits for it to run expectedTitle, or any
+    // title once it went down when expectedTitle is empty
+    BootResult BootAndWait(const std::string &command, const XboxPath &expectedTitle, const BootOptions &options);
 };
 
 }
@@ -0,0 +1,296 @@
+#include "pch.h"
+#include "DebugLog.h"
+
+namespace XBDM
+{
+
+DebugLogRing::DebugLogRing(size_t capacity)
+{
+    size_t rounded = 1;
+    while (rounded < capacity)
+        rounded *= 2;
+
+    m_Slots = std::vector<Slot>(rounded);
+    m_Mask = rounded - 1;
+}
+
+void DebugLogRing::Write(std::chrono::system_clock::time_point time, uint32_t thread, const char *text, size_t length)
+{
+    uint64_t index = m_Written.load(std::memory_order_relaxed);
+    Slot &slot = m_Slots[index & m_Mask];
+    size_t storedLength = std::min(length, s_MaxLineSize);
+
+    // The content is stored with release so that a reader seeing any of the new content also
+    // sees the odd sequence number, and knows that the slot changed
+    slot.Sequence.store(2 * index + 1, std::memory_order_relaxed);
+    slot.Time.store(std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count(), std::memory_order_release);
+    slot.Thread.store(thread, std::memory_order_release);
+    slot.Length.store(static_cast<uint32_t>(storedLength), std::memory_order_release);
+    slot.Truncated.store(length > s_MaxLineSize, std::memory_order_release);
+
+    for (size_t offset = 0; offset < storedLength; offset += sizeof(uint64_t))
+    {
+        uint64_t word = 0;
+        memcpy(&word, text + offset, std::min(sizeof(word), storedLength - offset));
+        slot.Words[offset / sizeof(uint64_t)].store(word, std::memory_order_release);
+    }
+
+    slot.Sequence.store(2 * index + 2, std::memory_order_release);
+    m_Written.store(index + 1, std::memory_order_release);
+}
+
+size_t DebugLogRing::Read(DebugTail &tail, std::vector<DebugLine> &lines, size_t maxLines, const std::function<bool(const DebugLine &)> &filter) const
+{
+    uint64_t written = m_Written.load(std::memory_order_acquire);
+
+    // Lines older than the capacity are already overwritten
+    if (written - tail.Next > m_Slots.size() && written > m_Slots.size())
+    {
+        tail.Missed += written - m_Slots.size() - tail.Next;
+        tail.Next = written - m_Slots.size();
+    }
+
+    size_t read = 0;
+    std::array<uint64_t, s_WordCount> words;
+
+    for (; tail.Next < written && read < maxLines; tail.Next++)
+    {
+        const Slot &slot = m_Slots[tail.Next & m_Mask];
+        uint64_t sequence = slot.Sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * tail.Next + 2)
+        {
+            tail.Missed++;
+            continue;
+        }
+
+        DebugLine line;
+        line.Index = tail.Next;
+        line.Time = std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::microseconds(slot.Time.load(std::memory_order_acquire))));
+        line.Thread = slot.Thread.load(std::memory_order_acquire);
+        line.Truncated = slot.Truncated.load(std::memory_order_acquire);
+
+        // The length can be garbage if the slot is being overwritten, which is detected below
+        size_t length = std::min<size_t>(slot.Length.load(std::memory_order_acquire), s_MaxLineSize);
+        for (size_t i = 0; i < (length + sizeof(uint64_t) - 1) / sizeof(uint64_t); i++)
+            words[i] = slot.Words[i].load(std::memory_order_acquire);
+
+        if (slot.Sequence.load(std::memory_order_relaxed) != sequence)
+        {
+            tail.Missed++;
+            continue;
+        }
+
+        line.Text.assign(reinterpret_cast<const char *>(words.data()), length);
+
+        if (filter == nullptr || filter(line))
+        {
+            lines.push_back(std::move(line));
+            read++;
+        }
+    }
+
+    return read;
+}
+
+DebugOutputCapture::DebugOutputCapture(const Console &console, const DebugCaptureOptions &options)
+    : m_Options(options), m_Ring(options.Capacity), m_Listener(console)
+{
+    if (m_Options.ConsoleName.empty())
+        m_Options.ConsoleName = console.GetIpAddress();
+
+    m_Listener.Subscribe(NotificationType::DebugString, [this](const Notification &notification) { OnDebugString(notification); });
+}
+
+DebugOutputCapture::~DebugOutputCapture()
+{
+    try
+    {
+        Stop();
+    }
+    catch (const std::exception &)
+    {
+    }
+}
+
+void DebugOutputCapture::Start()
+{
+    // The file writer starts with the first line captured from now on
+    if (!m_Options.LogPath.empty())
+    {
+        m_File.open(m_Options.LogPath, std::ios::binary | std::ios::app);
+        if (m_File.fail())
+            throw std::runtime_error("Couldn't create " + m_Options.LogPath.string());
+
+        m_StopRequested = false;
+        m_FileError = nullptr;
+        m_FileFailed = false;
+        m_FileThread = std::thread(&DebugOutputCapture::WriteFiles, this, m_Ring.GetWrittenCount());
+    }
+
+    try
+    {
+        m_Listener.Start();
+    }
+    catch (...)
+    {
+        Stop();
+        throw;
+    }
+}
+
+void DebugOutputCapture::Stop()
+{
+    m_Listener.Stop();
+
+    if (m_FileThread.joinable())
+    {
+        m_StopRequested = true;
+        m_FileThread.join();
+        m_File.close();
+    }
+
+    if (m_FileError)
+    {
+        std::exception_ptr error = m_FileError;
+        m_FileError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+DebugCaptureStats DebugOutputCapture::GetStats() const
+{
+    DebugCaptureStats stats;
+    stats.Lines = m_Ring.GetWrittenCount();
+    stats.TruncatedLines = m_TruncatedLines.load();
+    stats.DroppedNotifications = m_Listener.GetDroppedCount();
+    stats.DroppedFileLines = m_DroppedFileLines.load();
+    stats.FileFailed = m_FileFailed.load();
+
+    return stats;
+}
+
+void DebugOutputCapture::OnDebugString(const Notification &notification)
+{
+    uint32_t thread = static_cast<uint32_t>(std::strtoul(notification.GetProperty("thread").c_str(), nullptr, 0));
+    std::string text = notification.GetProperty("string");
+
+    // A line can be split in several strings, only the last one has the lf (or cr) flag
+    std::string &partial = m_PartialLines[thread];
+    partial += text;
+    if (!notification.HasFlag("lf") && !notification.HasFlag("cr") && partial.size() <= DebugLogRing::s_MaxLineSize)
+        return;
+
+    while (!partial.empty() && (partial.back() == '\n' || partial.back() == '\r'))
+        partial.pop_back();
+
+    if (partial.size() > DebugLogRing::s_MaxLineSize)
+        m_TruncatedLines++;
+
+    m_Ring.Write(notification.Time, thread, partial.data(), partial.size());
+    m_PartialLines.erase(thread);
+}
+
+static std::string FormatTimestamp(std::chrono::system_clock::time_point time)
+{
+    time_t seconds = std::chrono::system_clock::to_time_t(time);
+    auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() % 1000;
+
+    tm utc = {};
+#ifdef _WIN32
+    gmtime_s(&utc, &seconds);
+#else
+    gmtime_r(&seconds, &utc);
+#endif
+
+    char buffer[64] = { 0 };
+    snprintf(buffer, sizeof(buffer), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday, utc.tm_hour, utc.tm_min, utc.tm_sec, static_cast<int>(milliseconds));
+
+    return buffer;
+}
+
+std::filesystem::path DebugOutputCapture::GetRotatedPath(size_t index) const
+{
+    const std::filesystem::path &path = m_Options.LogPath;
+
+    return path.parent_path() / (path.stem().string() + "." + std::to_string(index) + path.extension().string());
+}
+
+void DebugOutputCapture::WriteFiles(uint64_t firstLine)
+{
+    namespace fs = std::filesystem;
+
+    std::error_code error;
+    uint64_t fileSize = fs::is_regular_file(m_Options.LogPath, error) ? fs::file_size(m_Options.LogPath, error) : 0;
+
+    auto rotate = [&]() {
+        m_File.close();
+
+        if (m_Options.MaxFiles > 1)
+        {
+            fs::remove(GetRotatedPath(m_Options.MaxFiles - 1), error);
+            for (size_t i = m_Options.MaxFiles - 1; i > 1; i--)
+                fs::rename(GetRotatedPath(i - 1), GetRotatedPath(i), error);
+
+            fs::rename(m_Options.LogPath, GetRotatedPath(1), error);
+        }
+
+        m_File.open(m_Options.LogPath, std::ios::binary | std::ios::trunc);
+        if (m_File.fail())
+            throw std::runtime_error("Couldn't create " + m_Options.LogPath.string());
+
+        fileSize = 0;
+    };
+
+    // The file writer is a consumer of the ring like any other, lines it doesn't read in time
+    // are lost for the file but never slow the capture down
+    DebugTail tail;
+    tail.Next = firstLine;
+    std::vector<DebugLine> lines;
+    std::string text;
+
+    // A file that can't be written stops the writer, the error is rethrown by Stop
+    try
+    {
+        for (;;)
+        {
+            bool stopping = m_StopRequested.load();
+
+            lines.clear();
+            m_Ring.Read(tail, lines, 4096);
+            m_DroppedFileLines.store(tail.Missed);
+
+            for (const DebugLine &line : lines)
+            {
+                text = FormatTimestamp(line.Time) + " [" + m_Options.ConsoleName + "] " + line.Text + "\n";
+
+                if (fileSize > 0 && fileSize + text.size() > m_Options.MaxFileSize)
+                    rotate();
+
+                m_File.write(text.data(), static_cast<std::streamsize>(text.size()));
+                fileSize += text.size();
+            }
+
+            if (!lines.empty())
+            {
+                m_File.flush();
+                if (m_File.fail())
+                    throw std::runtime_error("Couldn't write " + m_Options.LogPath.string());
+
+                continue;
+            }
+
+            // Everything written before Stop was called is in the file
+            if (stopping)
+                break;
+
+            std::this_thread::sleep_for(s_FileFlushInterval);
+        }
+    }
+    catch (const std::exception &)
+    {
+        m_FileError = std::current_exception();
+        m_FileFailed = true;
+    }
+}
+
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "Notification.h"
+
+namespace XBDM
+{
+
+struct DebugLine
+{
+    // Position of the line in everything written to the log, starting at 0
+    uint64_t Index = 0;
+    std::chrono::system_clock::time_point Time;
+    uint32_t Thread = 0;
+
+    // Set when the line was longer than DebugLogRing::s_MaxLineSize and was cut
+    bool Truncated = false;
+    std::string Text;
+};
+
+// Position of a consumer in a DebugLogRing, each consumer has its own
+struct DebugTail
+{
+    // Index of the next line to read
+    uint64_t Next = 0;
+
+    // Lines overwritten by the writer before this consumer read them
+    uint64_t Missed = 0;
+};
+
+// Bounded log of lines with one writer and any number of readers. The writer never waits: when
+// the ring is full the oldest line is overwritten. Each slot is protected by a sequence number
+// (a seqlock), so readers detect lines that were overwritten while they were reading them
+// instead of locking the writer out.
+class DebugLogRing
+{
+public:
+    static constexpr size_t s_MaxLineSize = 504;
+
+    // The capacity is rounded up to a power of two
+    DebugLogRing(size_t capacity);
+
+    DebugLogRing(const DebugLogRing &) = delete;
+    DebugLogRing &operator=(const DebugLogRing &) = delete;
+
+    // Writer only
+    void Write(std::chrono::system_clock::time_point time, uint32_t thread, const char *text, size_t length);
+
+    // Reads the lines after tail, in order, for which filter returns true (all of them without a
+    // filter) until maxLines lines were read. Lines that were overwritten are skipped and counted
+    // in tail.Missed. Returns the number of lines read.
+    size_t Read(DebugTail &tail, std::vector<DebugLine> &lines, size_t maxLines = SIZE_MAX, const std::function<bool(const DebugLine &)> &filter = nullptr) const;
+
+    // Number of lines written since the ring was created
+    inline uint64_t GetWrittenCount() const { return m_Written.load(std::memory_order_acquire); }
+    inline size_t Capacity() const { return m_Slots.size(); }
+
+private:
+    static constexpr size_t s_WordCount = (s_MaxLineSize + 7) / 8;
+
+    // The content is stored in atomic words so that a reader copying a slot being overwritten
+    // only gets inconsistent bytes, which the sequence number makes it throw away
+    struct Slot
+    {
+        // 2 * index + 1 while line index is being written, 2 * index + 2 once it's written
+        std::atomic<uint64_t> Sequence = 0;
+        std::atomic<int64_t> Time = 0;
+        std::atomic<uint32_t> Thread = 0;
+        std::atomic<uint32_t> Length = 0;
+        std::atomic<bool> Truncated = false;
+        std::array<std::atomic<uint64_t>, s_WordCount> Words = {};
+    };
+
+    std::vector<Slot> m_Slots;
+    size_t m_Mask = 0;
+    std::atomic<uint64_t> m_Written = 0;
+};
+
+struct DebugCaptureOptions
+{
+    // Number of lines kept in memory for the consumers
+    size_t Capacity = 16 * 1024;
+
+    // Tag added to the lines written to the log files, the address of the console by default
+    std::string ConsoleName;
+
+    // Lines are also written to LogPath when it's not empty. When the file reaches MaxFileSize
+    // bytes it is renamed to <name>.1<extension>, the previous one to <name>.2<extension> and so
+    // on, keeping at most MaxFiles files.
+    std::filesystem::path LogPath;
+    uint64_t MaxFileSize = 16 * 1024 * 1024;
+    size_t MaxFiles = 4;
+};
+
+struct DebugCaptureStats
+{
+    uint64_t Lines = 0;
+    uint64_t TruncatedLines = 0;
+
+    // Notifications lost before reaching the ring because the capture didn't keep up
+    uint64_t DroppedNotifications = 0;
+
+    // Lines overwritten before the file writer wrote them
+    uint64_t DroppedFileLines = 0;
+
+    // Whether the log file couldn't be written, no more lines are written to it then and
+    // Stop throws the error
+    bool FileFailed = false;
+};
+
+// Captures the debug output of a console, the strings the title prints, from a notification
+// channel into a DebugLogRing. Consumers tail the ring at their own pace, and a background
+// writer can save the lines to rotating log files, without ever slowing the capture down.
+class DebugOutputCapture
+{
+public:
+    DebugOutputCapture(const Console &console, const DebugCaptureOptions &options = DebugCaptureOptions());
+    ~DebugOutputCapture();
+
+    // Throws std::runtime_error if the log file can't be created
+    void Start();
+
+    // Writes the lines captured until now to the log file before returning, throws the error
+    // that stopped the file writer if the log file couldn't be written
+    void Stop();
+
+    inline size_t Tail(DebugTail &tail, std::vector<DebugLine> &lines, size_t maxLines = SIZE_MAX, const std::function<bool(const DebugLine &)> &filter = nullptr) const
+    {
+        return m_Ring.Read(tail, lines, maxLines, filter);
+    }
+
+    DebugCaptureStats GetStats() const;
+
+private:
+    DebugCaptureOptions m_Options;
+    DebugLogRing m_Ring;
+    NotificationListener m_Listener;
+    std::atomic<uint64_t> m_TruncatedLines = 0;
+
+    // Debug strings without a line feed are continued by the next string of the same thread
+    std::unordered_map<uint32_t, std::string> m_PartialLines;
+
+    std::ofstream m_File;
+    std::thread m_FileThread;
+    std::atomic<bool> m_StopRequested = false;
+    std::atomic<uint64_t> m_DroppedFileLines = 0;
+    std::atomic<bool> m_FileFailed = false;
+    std::exception_ptr m_FileError;
+
+    static constexpr auto s_FileFlushInterval = std::chrono::milliseconds(20);
+
+    void OnDebugString(const Notification &notification);
+    void WriteFiles(uint64_t firstLine);
+    std::filesystem::path GetRotatedPath(size_t index) const;
+};
+
+}
@@ -48,4 +48,32 @@ struct File
     }
 };
 
+struct MemoryRange
+{
+    uint32_t Address = 0;
+    uint32_t Length = 0;
+
+    bool operator==(const MemoryRange &other) const { return Address == other.Address && Length == other.Length; }
+};
+
+// How a console connection found dead is opened again, waiting InitialDelay after the first
+// failed attempt and doubling the delay after each of the next ones, up to MaxDelay
+struct ReconnectPolicy
+{
+    // 0 disables reconnecting
+    uint32_t MaxAttempts = 3;
+    std::chrono::milliseconds InitialDelay = std::chrono::milliseconds(100);
+    std::chrono::milliseconds MaxDelay = std::chrono::milliseconds(2000);
+};
+
+struct MemoryRead
+{
+    uint32_t Address = 0;
+    uint32_t Length = 0;
+    void *Buffer = nullptr;
+
+    // Set by Console::ReadMemory, false when part of the range isn't readable
+    bool Succeeded = false;
+};
+
 }
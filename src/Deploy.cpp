@@ -0,0 +1,36 @@
+#include "pch.h"
+#include "Deploy.h"
+
+namespace XBDM
+{
+
+void DeployManifest::AddFile(const std::filesystem::path &localPath, const XboxPath &remotePath)
+{
+    m_Files.push_back({ localPath, remotePath });
+}
+
+void DeployManifest::AddDirectory(const std::filesystem::path &localPath, const XboxPath &remotePath)
+{
+    if (!std::filesystem::is_directory(localPath))
+        throw std::invalid_argument("Invalid local directory: " + localPath.string());
+
+    // Sorted so that the files are sent in the same order every time
+    std::vector<DeployEntry> entries;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(localPath))
+    {
+        if (!entry.is_regular_file())
+            continue;
+
+        XboxPath entryRemotePath = remotePath;
+        for (const auto &component : std::filesystem::relative(entry.path(), localPath))
+            entryRemotePath /= component.string();
+
+        entries.push_back({ entry.path(), entryRemotePath });
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const DeployEntry &left, const DeployEntry &right) { return left.RemotePath.String() < right.RemotePath.String(); });
+
+    m_Files.insert(m_Files.end(), entries.begin(), entries.end());
+}
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "XboxPath.h"
+#include "Transfer.h"
+#include "Boot.h"
+
+namespace XBDM
+{
+
+struct DeployEntry
+{
+    std::filesystem::path LocalPath;
+    XboxPath RemotePath;
+};
+
+// Local files to copy to the console and where they go
+class DeployManifest
+{
+public:
+    void AddFile(const std::filesystem::path &localPath, const XboxPath &remotePath);
+
+    // Every file under localPath, at the same relative path under remotePath
+    void AddDirectory(const std::filesystem::path &localPath, const XboxPath &remotePath);
+
+    inline const std::vector<DeployEntry> &GetFiles() const { return m_Files; }
+
+private:
+    std::vector<DeployEntry> m_Files;
+};
+
+struct DeployOptions
+{
+    // Progress, cancellation and checksums of the upload
+    TransferOptions Transfer;
+
+    BootOptions Boot;
+
+    // Sends every file, even the ones the console already has
+    bool Force = false;
+};
+
+struct DeployResult
+{
+    // Files sent, with their checksums
+    TransferResult Transfer;
+
+    // Files the console already had
+    std::vector<XboxPath> Skipped;
+
+    BootResult Boot;
+
+    // Listing the remote directories and creating the missing ones, sending the files and
+    // launching the title until it runs
+    std::chrono::microseconds CompareDuration = std::chrono::microseconds(0);
+    std::chrono::microseconds UploadDuration = std::chrono::microseconds(0);
+    std::chrono::microseconds LaunchDuration = std::chrono::microseconds(0);
+    std::chrono::microseconds TotalDuration = std::chrono::microseconds(0);
+};
+
+}
@@ -0,0 +1,300 @@
+#include "pch.h"
+#include "Discovery.h"
+
+#include "Definitions.h"
+
+#ifndef _WIN32
+    #include <arpa/inet.h>
+    #include <netinet/in.h>
+    #include <sys/socket.h>
+#endif
+
+namespace XBDM
+{
+
+// Name requests are a type byte followed by the length of the name and the name itself. Consoles
+// answer a request for their name, or a wildcard request, with a reply holding their name.
+static constexpr uint8_t s_NameRequest = 1;
+static constexpr uint8_t s_NameReply = 2;
+static constexpr uint8_t s_WildcardRequest = 3;
+static constexpr size_t s_MaxNameLength = 255;
+static constexpr int s_MinSubnetPrefix = 16;
+
+// Owns the UDP socket the requests are sent from and the replies received on
+class DiscoverySocket
+{
+public:
+    DiscoverySocket()
+    {
+#ifdef _WIN32
+        WSADATA wsaData;
+        if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+            throw std::runtime_error("Couldn't initialize the network");
+#endif
+
+        m_Socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (m_Socket == INVALID_SOCKET)
+        {
+            Close();
+            throw std::runtime_error("Couldn't create the discovery socket");
+        }
+
+        int yes = 1;
+        setsockopt(m_Socket, SOL_SOCKET, SO_BROADCAST, reinterpret_cast<const char *>(&yes), sizeof(yes));
+    }
+
+    ~DiscoverySocket()
+    {
+        Close();
+    }
+
+    DiscoverySocket(const DiscoverySocket &) = delete;
+    DiscoverySocket &operator=(const DiscoverySocket &) = delete;
+
+    inline SOCKET Get() const { return m_Socket; }
+
+private:
+    SOCKET m_Socket = INVALID_SOCKET;
+
+    void Close()
+    {
+        if (m_Socket != INVALID_SOCKET)
+        {
+#ifdef _WIN32
+            closesocket(m_Socket);
+#else
+            close(m_Socket);
+#endif
+            m_Socket = INVALID_SOCKET;
+        }
+
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+};
+
+static uint32_t ParseAddress(const std::string &address)
+{
+    in_addr parsed = {};
+    if (inet_pton(AF_INET, address.c_str(), &parsed) != 1)
+        throw std::invalid_argument("Invalid IPv4 address: " + address);
+
+    return ntohl(parsed.s_addr);
+}
+
+ConsoleDiscovery::ConsoleDiscovery(const DiscoveryOptions &options)
+    : m_Options(options)
+{
+    // Parsing the destinations now reports invalid options before anything is sent
+    GetDestinations();
+}
+
+std::vector<DiscoveredConsole> ConsoleDiscovery::Discover()
+{
+    std::vector<DiscoveredConsole> consoles;
+
+    std::string request = { static_cast<char>(s_WildcardRequest), 0 };
+    Request(request, [&](const DiscoveredConsole &console) {
+        // A console reached both by the broadcast and directly answers twice
+        if (std::find(consoles.begin(), consoles.end(), console) == consoles.end())
+            consoles.push_back(console);
+
+        return true;
+    });
+
+    std::sort(consoles.begin(), consoles.end(), [](const DiscoveredConsole &left, const DiscoveredConsole &right) {
+        return left.Name != right.Name ? left.Name < right.Name : left.IpAddress < right.IpAddress;
+    });
+
+    for (const DiscoveredConsole &console : consoles)
+        AddToCache(console);
+
+    return consoles;
+}
+
+std::string ConsoleDiscovery::Resolve(const std::string &name)
+{
+    if (name.empty() || name.size() > s_MaxNameLength)
+        throw std::invalid_argument("Console names are between 1 and " + std::to_string(s_MaxNameLength) + " characters long");
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        auto entry = m_Cache.find(name);
+        if (entry != m_Cache.end() && Clock::now() - entry->second.FoundAt < m_Options.CacheExpiry)
+            return entry->second.IpAddress;
+    }
+
+    std::string request = { static_cast<char>(s_NameRequest), static_cast<char>(name.size()) };
+    request += name;
+
+    std::string ipAddress;
+    Request(request, [&](const DiscoveredConsole &console) {
+        if (console.Name != name)
+            return true;
+
+        ipAddress = console.IpAddress;
+
+        return false;
+    });
+
+    if (ipAddress.empty())
+        throw std::runtime_error("No console named " + name + " answered");
+
+    AddToCache({ name, ipAddress });
+
+    return ipAddress;
+}
+
+std::vector<DiscoveredConsole> ConsoleDiscovery::GetCachedConsoles()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    std::vector<DiscoveredConsole> consoles;
+    Clock::time_point now = Clock::now();
+
+    for (const auto &[name, entry] : m_Cache)
+    {
+        if (now - entry.FoundAt < m_Options.CacheExpiry)
+            consoles.push_back({ name, entry.IpAddress });
+    }
+
+    std::sort(consoles.begin(), consoles.end(), [](const DiscoveredConsole &left, const DiscoveredConsole &right) { return left.Name < right.Name; });
+
+    return consoles;
+}
+
+void ConsoleDiscovery::ClearCache()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_Cache.clear();
+}
+
+void ConsoleDiscovery::Request(const std::string &request, const std::function<bool(const DiscoveredConsole &)> &found)
+{
+    DiscoverySocket discoverySocket;
+    SOCKET socket = discoverySocket.Get();
+
+    // Sending to an address that isn't reachable only fails for that address
+    size_t sent = 0;
+    for (uint32_t destination : GetDestinations())
+    {
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(destination);
+        address.sin_port = htons(m_Options.Port);
+
+        if (sendto(socket, request.data(), static_cast<int>(request.size()), 0, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != SOCKET_ERROR)
+            sent++;
+    }
+
+    if (sent == 0)
+        throw std::runtime_error("Couldn't send the discovery requests");
+
+    Clock::time_point deadline = Clock::now() + m_Options.Timeout;
+    std::array<char, 2 + s_MaxNameLength> buffer;
+
+    for (;;)
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - Clock::now());
+        if (remaining.count() <= 0)
+            return;
+
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(socket, &readSet);
+        timeval tv = { static_cast<long>(remaining.count() / 1000000), static_cast<long>(remaining.count() % 1000000) };
+
+        if (select(static_cast<int>(socket) + 1, &readSet, nullptr, nullptr, &tv) <= 0)
+            continue;
+
+        sockaddr_in sender = {};
+        socklen_t senderLength = sizeof(sender);
+        int received = recvfrom(socket, buffer.data(), static_cast<int>(buffer.size()), 0, reinterpret_cast<sockaddr *>(&sender), &senderLength);
+
+        // Anything that isn't a well formed reply is ignored
+        if (received < 2 || static_cast<uint8_t>(buffer[0]) != s_NameReply)
+            continue;
+
+        size_t nameLength = static_cast<uint8_t>(buffer[1]);
+        if (nameLength == 0 || static_cast<size_t>(received) < 2 + nameLength)
+            continue;
+
+        char ipAddress[INET_ADDRSTRLEN] = {};
+        inet_ntop(AF_INET, &sender.sin_addr, ipAddress, sizeof(ipAddress));
+
+        if (!found({ std::string(buffer.data() + 2, nameLength), ipAddress }))
+            return;
+    }
+}
+
+std::vector<uint32_t> ConsoleDiscovery::GetDestinations() const
+{
+    std::vector<uint32_t> destinations;
+
+    if (m_Options.Broadcast)
+        destinations.push_back(INADDR_BROADCAST);
+
+    for (const std::string &address : m_Options.Addresses)
+        destinations.push_back(ParseAddress(address));
+
+    if (!m_Options.Subnet.empty())
+    {
+        size_t slash = m_Options.Subnet.find('/');
+        if (slash == std::string::npos)
+            throw std::invalid_argument("Subnets are written as <address>/<prefix length>: " + m_Options.Subnet);
+
+        uint32_t network = ParseAddress(m_Options.Subnet.substr(0, slash));
+        int prefix = 0;
+
+        try
+        {
+            prefix = std::stoi(m_Options.Subnet.substr(slash + 1));
+        }
+        catch (const std::exception &)
+        {
+            throw std::invalid_argument("Invalid subnet prefix length: " + m_Options.Subnet);
+        }
+
+        if (prefix < s_MinSubnetPrefix || prefix > 32)
+            throw std::invalid_argument("Subnet prefix lengths are between " + std::to_string(s_MinSubnetPrefix) + " and 32");
+
+        uint32_t hostMask = prefix == 32 ? 0 : 0xffffffffu >> prefix;
+        uint32_t first = network & ~hostMask;
+        uint32_t last = first | hostMask;
+
+        // The network and broadcast addresses aren't hosts, except in the smallest subnets
+        if (prefix < 31)
+        {
+            first++;
+            last--;
+        }
+
+        for (uint32_t address = first; address <= last && address >= first; address++)
+            destinations.push_back(address);
+    }
+
+    if (destinations.empty())
+        throw std::invalid_argument("Discovery needs the broadcast, addresses or a subnet to send requests to");
+
+    return destinations;
+}
+
+void ConsoleDiscovery::AddToCache(const DiscoveredConsole &console)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_Cache[console.Name] = { console.IpAddress, Clock::now() };
+}
+
+std::vector<DiscoveredConsole> DiscoverConsoles(std::chrono::milliseconds timeout)
+{
+    DiscoveryOptions options;
+    options.Timeout = timeout;
+
+    return ConsoleDiscovery(options).Discover();
+}
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+namespace XBDM
+{
+
+struct DiscoveredConsole
+{
+    std::string Name;
+    std::string IpAddress;
+
+    inline bool operator==(const DiscoveredConsole &other) const { return Name == other.Name && IpAddress == other.IpAddress; }
+};
+
+struct DiscoveryOptions
+{
+    // How long replies are waited for, they are collected as they arrive from all the consoles
+    std::chrono::milliseconds Timeout = std::chrono::milliseconds(500);
+
+    // UDP port the consoles answer name requests on
+    uint16_t Port = 730;
+
+    // Sends the requests to the broadcast address, which only reaches the local network
+    bool Broadcast = true;
+
+    // Addresses the requests are also sent to directly, e.g. consoles on another subnet
+    std::vector<std::string> Addresses;
+
+    // Sends the requests to every address of a subnet, e.g. "192.168.1.0/24", for networks
+    // where broadcasts are filtered. Subnets are limited to /16.
+    std::string Subnet;
+
+    // How long Resolve trusts an address found before asking the network again
+    std::chrono::seconds CacheExpiry = std::chrono::seconds(60);
+};
+
+// Finds consoles with the name requests they answer on UDP, so that they can be reached without
+// knowing their address. The requests are all sent at once and the replies collected as they
+// arrive, so sweeping a whole subnet takes as long as waiting for the slowest console. Can be
+// used from several threads.
+class ConsoleDiscovery
+{
+public:
+    ConsoleDiscovery(const DiscoveryOptions &options = DiscoveryOptions());
+
+    // Every console answering within the timeout, sorted by name. Throws std::runtime_error
+    // if the requests can't be sent.
+    std::vector<DiscoveredConsole> Discover();
+
+    // Address of the console called name, from the consoles found less than CacheExpiry ago
+    // or by asking the network. Throws std::runtime_error if no console answered in time.
+    std::string Resolve(const std::string &name);
+
+    // Consoles found less than CacheExpiry ago, sorted by name
+    std::vector<DiscoveredConsole> GetCachedConsoles();
+
+    // Forgets the consoles found so far
+    void ClearCache();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct CacheEntry
+    {
+        std::string IpAddress;
+        Clock::time_point FoundAt;
+    };
+
+    DiscoveryOptions m_Options;
+    std::mutex m_Mutex;
+    std::unordered_map<std::string, CacheEntry> m_Cache;
+
+    // Sends request to all the destinations and gives every reply to found until it returns false
+    void Request(const std::string &request, const std::function<bool(const DiscoveredConsole &)> &found);
+    std::vector<uint32_t> GetDestinations() const;
+    void AddToCache(const DiscoveredConsole &console);
+};
+
+// Consoles answering a broadcast within timeout
+std::vector<DiscoveredConsole> DiscoverConsoles(std::chrono::milliseconds timeout = std::chrono::milliseconds(500));
+
+}
@@ -0,0 +1,295 @@
+#include "pch.h"
+#include "Dump.h"
+#include "Utils.h"
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+namespace XBDM
+{
+
+static constexpr char s_DumpMagic[8] = { 'X', 'B', 'D', 'M', 'D', 'U', 'M', 'P' };
+static constexpr uint32_t s_DumpVersion = 1;
+static constexpr size_t s_DumpHeaderSize = 40;
+static constexpr size_t s_RegionEntrySize = 8;
+static constexpr size_t s_PageEntrySize = 16;
+
+static void StoreLittleEndian(uint8_t *destination, uint64_t value, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        destination[i] = static_cast<uint8_t>(value >> (i * 8));
+}
+
+static uint64_t LoadLittleEndian(const uint8_t *source, size_t size)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; i++)
+        value |= static_cast<uint64_t>(source[i]) << (i * 8);
+
+    return value;
+}
+
+DumpWriter::DumpWriter(const std::filesystem::path &path, uint32_t pageSize)
+    : m_Path(path), m_PageSize(pageSize), m_DataEnd(pageSize)
+{
+    if (pageSize < s_DumpHeaderSize || (pageSize & (pageSize - 1)) != 0)
+        throw std::invalid_argument("The page size must be a power of two of at least " + std::to_string(s_DumpHeaderSize) + " bytes");
+
+    m_File.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_File.is_open())
+        throw std::runtime_error("Couldn't create dump: " + path.string());
+
+    // Left empty until Finish so that unfinished dumps can't be opened
+    std::vector<char> header(m_PageSize);
+    m_File.write(header.data(), header.size());
+}
+
+DumpWriter::~DumpWriter()
+{
+    // A dump destroyed without being finished, e.g. because its download failed, is incomplete
+    if (!m_Finished)
+    {
+        m_File.close();
+        std::error_code error;
+        std::filesystem::remove(m_Path, error);
+    }
+}
+
+void DumpWriter::AddRegion(uint32_t address, uint32_t length)
+{
+    m_Regions.push_back({ address, length });
+}
+
+void DumpWriter::WritePages(uint32_t address, const void *data, size_t length)
+{
+    if (m_Finished)
+        throw std::logic_error("The dump is already finished");
+
+    if (address % m_PageSize != 0 || length % m_PageSize != 0 || static_cast<uint64_t>(address) + length > static_cast<uint64_t>(UINT32_MAX) + 1)
+        throw std::invalid_argument("Only whole pages can be written to a dump");
+
+    m_File.write(static_cast<const char *>(data), static_cast<std::streamsize>(length));
+    if (!m_File)
+        throw std::runtime_error("Couldn't write to dump: " + m_Path.string());
+
+    for (size_t offset = 0; offset < length; offset += m_PageSize)
+        m_Pages.push_back({ static_cast<uint32_t>(address + offset), m_DataEnd + offset });
+
+    m_DataEnd += length;
+}
+
+void DumpWriter::Finish()
+{
+    if (m_Finished)
+        return;
+
+    std::sort(m_Pages.begin(), m_Pages.end(), [](const PageEntry &left, const PageEntry &right) {
+        return left.Address < right.Address;
+    });
+
+    auto duplicate = std::adjacent_find(m_Pages.begin(), m_Pages.end(), [](const PageEntry &left, const PageEntry &right) {
+        return left.Address == right.Address;
+    });
+    if (duplicate != m_Pages.end())
+        throw std::invalid_argument("Page " + Utils::ToHexAddress(duplicate->Address) + " was written twice to the dump");
+
+    std::vector<uint8_t> tables(m_Regions.size() * s_RegionEntrySize + m_Pages.size() * s_PageEntrySize);
+    uint8_t *entry = tables.data();
+    for (const MemoryRange &region : m_Regions)
+    {
+        StoreLittleEndian(entry, region.Address, 4);
+        StoreLittleEndian(entry + 4, region.Length, 4);
+        entry += s_RegionEntrySize;
+    }
+
+    for (const PageEntry &page : m_Pages)
+    {
+        StoreLittleEndian(entry, page.Address, 4);
+        StoreLittleEndian(entry + 4, 0, 4);
+        StoreLittleEndian(entry + 8, page.Offset, 8);
+        entry += s_PageEntrySize;
+    }
+
+    uint64_t regionTableOffset = m_DataEnd;
+    uint64_t pageTableOffset = regionTableOffset + m_Regions.size() * s_RegionEntrySize;
+
+    std::array<uint8_t, s_DumpHeaderSize> header = {};
+    memcpy(header.data(), s_DumpMagic, sizeof(s_DumpMagic));
+    StoreLittleEndian(header.data() + 8, s_DumpVersion, 4);
+    StoreLittleEndian(header.data() + 12, m_PageSize, 4);
+    StoreLittleEndian(header.data() + 16, m_Regions.size(), 4);
+    StoreLittleEndian(header.data() + 20, m_Pages.size(), 4);
+    StoreLittleEndian(header.data() + 24, regionTableOffset, 8);
+    StoreLittleEndian(header.data() + 32, pageTableOffset, 8);
+
+    m_File.write(reinterpret_cast<const char *>(tables.data()), static_cast<std::streamsize>(tables.size()));
+    m_File.seekp(0);
+    m_File.write(reinterpret_cast<const char *>(header.data()), static_cast<std::streamsize>(header.size()));
+    m_File.close();
+
+    if (!m_File)
+        throw std::runtime_error("Couldn't write to dump: " + m_Path.string());
+
+    m_Finished = true;
+}
+
+DumpReader::DumpReader(const std::filesystem::path &path)
+{
+    Map(path);
+
+    try
+    {
+        if (m_Size < s_DumpHeaderSize || memcmp(m_Data, s_DumpMagic, sizeof(s_DumpMagic)) != 0)
+            throw std::runtime_error("Not a dump or unfinished dump: " + path.string());
+
+        if (LoadLittleEndian(m_Data + 8, 4) != s_DumpVersion)
+            throw std::runtime_error("Unsupported dump version: " + path.string());
+
+        m_PageSize = static_cast<uint32_t>(LoadLittleEndian(m_Data + 12, 4));
+        uint64_t regionCount = LoadLittleEndian(m_Data + 16, 4);
+        m_PageCount = static_cast<uint32_t>(LoadLittleEndian(m_Data + 20, 4));
+        uint64_t regionTableOffset = LoadLittleEndian(m_Data + 24, 8);
+        uint64_t pageTableOffset = LoadLittleEndian(m_Data + 32, 8);
+
+        // The tables are checked to be in the file here, the pages when they are accessed
+        if (m_PageSize == 0 || (m_PageSize & (m_PageSize - 1)) != 0 || regionTableOffset > m_Size
+            || regionCount * s_RegionEntrySize > m_Size - regionTableOffset || pageTableOffset > m_Size
+            || static_cast<uint64_t>(m_PageCount) * s_PageEntrySize > m_Size - pageTableOffset)
+            throw std::runtime_error("Corrupted dump: " + path.string());
+
+        const uint8_t *regions = m_Data + regionTableOffset;
+        for (uint64_t i = 0; i < regionCount; i++)
+        {
+            const uint8_t *entry = regions + i * s_RegionEntrySize;
+            m_Regions.push_back({ static_cast<uint32_t>(LoadLittleEndian(entry, 4)), static_cast<uint32_t>(LoadLittleEndian(entry + 4, 4)) });
+        }
+
+        m_PageTable = m_Data + pageTableOffset;
+    }
+    catch (...)
+    {
+        Unmap();
+        throw;
+    }
+}
+
+DumpReader::~DumpReader()
+{
+    Unmap();
+}
+
+const uint8_t *DumpReader::GetPage(uint32_t address) const
+{
+    uint32_t pageAddress = address & ~(m_PageSize - 1);
+
+    // First entry whose address isn't below pageAddress
+    size_t low = 0;
+    size_t high = m_PageCount;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (LoadLittleEndian(m_PageTable + middle * s_PageEntrySize, 4) < pageAddress)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    if (low == m_PageCount)
+        return nullptr;
+
+    const uint8_t *entry = m_PageTable + low * s_PageEntrySize;
+    if (LoadLittleEndian(entry, 4) != pageAddress)
+        return nullptr;
+
+    uint64_t offset = LoadLittleEndian(entry + 8, 8);
+    if (offset > m_Size || m_Size - offset < m_PageSize)
+        throw std::runtime_error("Corrupted dump: page " + Utils::ToHexAddress(pageAddress) + " is past the end of the file");
+
+    return m_Data + offset;
+}
+
+void DumpReader::Read(uint32_t address, uint32_t length, void *buffer) const
+{
+    uint8_t *destination = static_cast<uint8_t *>(buffer);
+    uint64_t current = address;
+    uint64_t end = current + length;
+
+    while (current < end)
+    {
+        const uint8_t *page = GetPage(static_cast<uint32_t>(current));
+        if (page == nullptr)
+            throw std::invalid_argument("Memory at " + Utils::ToHexAddress(current) + " isn't in the dump");
+
+        uint64_t offset = current & (m_PageSize - 1);
+        uint64_t size = std::min<uint64_t>(m_PageSize - offset, end - current);
+        memcpy(destination, page + offset, static_cast<size_t>(size));
+
+        destination += size;
+        current += size;
+    }
+}
+
+void DumpReader::Map(const std::filesystem::path &path)
+{
+#ifdef _WIN32
+    m_File = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_File == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Couldn't open dump: " + path.string());
+
+    LARGE_INTEGER size = {};
+    GetFileSizeEx(m_File, &size);
+    m_Size = static_cast<uint64_t>(size.QuadPart);
+
+    m_Mapping = m_Size > 0 ? CreateFileMappingW(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    m_Data = m_Mapping != nullptr ? static_cast<const uint8_t *>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+    m_File = open(path.c_str(), O_RDONLY);
+    if (m_File == -1)
+        throw std::runtime_error("Couldn't open dump: " + path.string());
+
+    struct stat status = {};
+    fstat(m_File, &status);
+    m_Size = static_cast<uint64_t>(status.st_size);
+
+    void *data = m_Size > 0 ? mmap(nullptr, static_cast<size_t>(m_Size), PROT_READ, MAP_SHARED, m_File, 0) : MAP_FAILED;
+    m_Data = data != MAP_FAILED ? static_cast<const uint8_t *>(data) : nullptr;
+#endif
+
+    if (m_Data == nullptr)
+    {
+        Unmap();
+        throw std::runtime_error("Couldn't map dump: " + path.string());
+    }
+}
+
+void DumpReader::Unmap()
+{
+#ifdef _WIN32
+    if (m_Data != nullptr)
+        UnmapViewOfFile(m_Data);
+
+    if (m_Mapping != nullptr)
+        CloseHandle(m_Mapping);
+
+    if (m_File != INVALID_HANDLE_VALUE)
+        CloseHandle(m_File);
+
+    m_Mapping = nullptr;
+    m_File = INVALID_HANDLE_VALUE;
+#else
+    if (m_Data != nullptr)
+        munmap(const_cast<uint8_t *>(m_Data), static_cast<size_t>(m_Size));
+
+    if (m_File != -1)
+        close(m_File);
+
+    m_File = -1;
+#endif
+
+    m_Data = nullptr;
+}
+
+}
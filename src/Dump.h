@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Definitions.h"
+
+namespace XBDM
+{
+
+// Memory dumps only store the pages that could be read, in a file laid out to be mapped in
+// memory by the reader:
+// - a header of one page: magic "XBDMDUMP", version, page size, number of regions and pages
+//   and offsets of the region and page tables
+// - the content of the pages, each one at an offset multiple of the page size
+// - the region table, the ranges the dump was requested for, as { address, length }
+// - the page table, sorted by address, as { address, reserved, offset in the file }
+// All the integers are little-endian. The header is written last so a dump that wasn't
+// finished is rejected by the reader.
+class DumpWriter
+{
+public:
+    DumpWriter(const std::filesystem::path &path, uint32_t pageSize = 4096);
+    ~DumpWriter();
+
+    void AddRegion(uint32_t address, uint32_t length);
+
+    // Appends whole pages, address and length have to be multiples of the page size. Pages can
+    // be written in any order, e.g. as they are received.
+    void WritePages(uint32_t address, const void *data, size_t length);
+
+    // Writes the tables and the header, throws std::invalid_argument if a page was written twice.
+    // The file is removed if the writer is destroyed before the dump is finished.
+    void Finish();
+
+    inline uint32_t GetPageSize() const { return m_PageSize; }
+
+private:
+    struct PageEntry
+    {
+        uint32_t Address = 0;
+        uint64_t Offset = 0;
+    };
+
+    std::filesystem::path m_Path;
+    std::ofstream m_File;
+    uint32_t m_PageSize;
+    uint64_t m_DataEnd;
+    std::vector<MemoryRange> m_Regions;
+    std::vector<PageEntry> m_Pages;
+    bool m_Finished = false;
+};
+
+// Maps a dump in memory, pages are only loaded by the system when they are accessed so opening
+// a dump costs the same whatever its size
+class DumpReader
+{
+public:
+    DumpReader(const std::filesystem::path &path);
+    ~DumpReader();
+
+    DumpReader(const DumpReader &) = delete;
+    DumpReader &operator=(const DumpReader &) = delete;
+
+    inline uint32_t GetPageSize() const { return m_PageSize; }
+    inline uint32_t GetPageCount() const { return m_PageCount; }
+    inline const std::vector<MemoryRange> &GetRegions() const { return m_Regions; }
+
+    // Content of the page containing address, in the mapping of the file, or nullptr if the
+    // page isn't in the dump. Pages are found with a binary search in the page table.
+    const uint8_t *GetPage(uint32_t address) const;
+
+    // Copies memory from the dump, throws std::invalid_argument if part of it isn't in the dump
+    void Read(uint32_t address, uint32_t length, void *buffer) const;
+
+private:
+    const uint8_t *m_Data = nullptr;
+    uint64_t m_Size = 0;
+#ifdef _WIN32
+    HANDLE m_File = INVALID_HANDLE_VALUE;
+    HANDLE m_Mapping = nullptr;
+#else
+    int m_File = -1;
+#endif
+
+    uint32_t m_PageSize = 0;
+    uint32_t m_PageCount = 0;
+    const uint8_t *m_PageTable = nullptr;
+    std::vector<MemoryRange> m_Regions;
+
+    void Map(const std::filesystem::path &path);
+    void Unmap();
+};
+
+}
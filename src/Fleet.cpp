@@ -0,0 +1,354 @@
+#include "pch.h"
+#include "Fleet.h"
+
+namespace XBDM
+{
+
+// Chunks of the local files shared by the consoles they are sent to. Each console gets the chunks
+// in increasing order. A chunk is read from the disk by the first console asking for it and kept
+// until all the consoles got it, unless the memory budget is exceeded, in which case the chunks
+// the furthest behind are dropped first.
+class SharedChunks
+{
+public:
+    using Chunk = std::shared_ptr<const std::vector<char>>;
+
+    SharedChunks(size_t chunkSize, size_t memoryBudget, size_t consumers)
+        : m_ChunkSize(chunkSize), m_MemoryBudget(memoryBudget), m_NextChunks(consumers, 0)
+    {
+    }
+
+    Chunk Get(size_t consumer, const std::filesystem::path &localPath, uint64_t fileSize, size_t firstChunk, size_t chunkInFile)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+
+        size_t index = firstChunk + chunkInFile;
+
+        // The consoles asking for a chunk being read wait for it rather than reading it again
+        m_ChunkRead.wait(lock, [&]() { return m_Reading.count(index) == 0; });
+
+        auto it = m_Chunks.find(index);
+        if (it == m_Chunks.end())
+        {
+            // The disk is read without the lock so that the other consoles keep getting the chunks already read
+            m_Reading.insert(index);
+            lock.unlock();
+
+            Chunk data;
+            try
+            {
+                data = Read(localPath, fileSize, chunkInFile);
+            }
+            catch (const std::exception &)
+            {
+                lock.lock();
+                m_Reading.erase(index);
+                m_ChunkRead.notify_all();
+
+                throw;
+            }
+
+            lock.lock();
+            m_Reading.erase(index);
+            m_ChunkRead.notify_all();
+
+            m_BytesRead += data->size();
+            m_ResidentBytes += data->size();
+            it = m_Chunks.emplace(index, data).first;
+
+            while (m_ResidentBytes > m_MemoryBudget)
+            {
+                auto oldest = m_Chunks.begin()->first != index ? m_Chunks.begin() : std::next(m_Chunks.begin());
+                if (oldest == m_Chunks.end())
+                    break;
+
+                Drop(oldest);
+            }
+        }
+
+        Chunk chunk = it->second;
+        m_NextChunks[consumer] = index + 1;
+        DropConsumed();
+
+        return chunk;
+    }
+
+    // A consumer that stopped won't ask for the chunks it didn't get
+    void RemoveConsumer(size_t consumer)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        m_NextChunks[consumer] = SIZE_MAX;
+        DropConsumed();
+    }
+
+    uint64_t GetBytesRead()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        return m_BytesRead;
+    }
+
+private:
+    std::mutex m_Mutex;
+    std::condition_variable m_ChunkRead;
+    std::map<size_t, Chunk> m_Chunks;
+    std::set<size_t> m_Reading;
+    size_t m_ChunkSize;
+    size_t m_MemoryBudget;
+    size_t m_ResidentBytes = 0;
+    uint64_t m_BytesRead = 0;
+
+    // Index of the next chunk each consumer will ask for, SIZE_MAX once it stopped
+    std::vector<size_t> m_NextChunks;
+
+    Chunk Read(const std::filesystem::path &localPath, uint64_t fileSize, size_t chunkInFile)
+    {
+        uint64_t offset = static_cast<uint64_t>(chunkInFile) * m_ChunkSize;
+        size_t length = static_cast<size_t>(std::min<uint64_t>(m_ChunkSize, fileSize - offset));
+        auto data = std::make_shared<std::vector<char>>(length);
+
+        std::ifstream file(localPath, std::ifstream::binary);
+        file.seekg(static_cast<std::streamoff>(offset));
+        file.read(data->data(), static_cast<std::streamsize>(length));
+
+        if (file.fail())
+            throw std::runtime_error("The size of " + localPath.string() + " changed while sending it");
+
+        return data;
+    }
+
+    void Drop(std::map<size_t, Chunk>::iterator it)
+    {
+        m_ResidentBytes -= it->second->size();
+        m_Chunks.erase(it);
+    }
+
+    // The chunks before the one the furthest consumer behind will ask for are no longer needed
+    void DropConsumed()
+    {
+        size_t firstNeeded = *std::min_element(m_NextChunks.begin(), m_NextChunks.end());
+
+        while (!m_Chunks.empty() && m_Chunks.begin()->first < firstNeeded)
+            Drop(m_Chunks.begin());
+    }
+};
+
+ConsoleFleet::ConsoleFleet(const FleetOptions &options)
+    : m_Options(options)
+{
+    if (options.MaxParallelism == 0)
+        throw std::invalid_argument("At least one console has to be queried at a time");
+}
+
+size_t ConsoleFleet::Add(const std::string &ipAddress, uint16_t port)
+{
+    auto console = std::make_unique<Console>(ipAddress, port);
+    console->SetTimeout(m_Options.Timeout);
+    m_Consoles.push_back(std::move(console));
+
+    return m_Consoles.size() - 1;
+}
+
+std::vector<FleetResult<ConsoleStatus>> ConsoleFleet::GetStatus()
+{
+    return Run<ConsoleStatus>([](Console &console) {
+        ConsoleStatus status;
+        status.Name = console.GetName();
+        status.Type = console.GetType();
+        status.ActiveTitle = console.GetActiveTitle();
+        status.Drives = console.GetDrives();
+
+        return status;
+    });
+}
+
+FleetTransferResult ConsoleFleet::SendFile(const XboxPath &remotePath, const std::filesystem::path &localPath, const FleetTransferOptions &options)
+{
+    if (!std::filesystem::is_regular_file(localPath))
+        throw std::invalid_argument("Invalid local path: " + localPath.string());
+
+    TransferEntry entry;
+    entry.RemotePath = remotePath;
+    entry.LocalPath = localPath;
+    entry.Size = std::filesystem::file_size(localPath);
+
+    return Send({ entry }, options);
+}
+
+FleetTransferResult ConsoleFleet::SendDirectory(const XboxPath &remotePath, const std::filesystem::path &localPath, const FleetTransferOptions &options)
+{
+    if (!std::filesystem::is_directory(localPath))
+        throw std::invalid_argument("Invalid local path: " + localPath.string());
+
+    // The local tree is walked once for all the consoles so that they send the files in the
+    // same order and share their chunks
+    std::vector<TransferEntry> entries;
+    ListTransferEntries(remotePath, localPath, entries);
+
+    return Send(entries, options);
+}
+
+void ConsoleFleet::ListTransferEntries(const XboxPath &remotePath, const std::filesystem::path &localPath, std::vector<TransferEntry> &entries)
+{
+    TransferEntry directory;
+    directory.RemotePath = remotePath;
+    directory.LocalPath = localPath;
+    directory.IsDirectory = true;
+    entries.push_back(directory);
+
+    for (const auto &entry : std::filesystem::directory_iterator(localPath))
+    {
+        std::filesystem::path entryFileName = entry.path().filename();
+        XboxPath nextRemotePath = remotePath / entryFileName.string();
+
+        if (entry.is_directory())
+        {
+            ListTransferEntries(nextRemotePath, entry.path(), entries);
+            continue;
+        }
+
+        TransferEntry file;
+        file.RemotePath = nextRemotePath;
+        file.LocalPath = entry.path();
+        file.Size = entry.file_size();
+        entries.push_back(file);
+    }
+}
+
+FleetTransferResult ConsoleFleet::Send(const std::vector<TransferEntry> &entries, const FleetTransferOptions &options)
+{
+    if (options.ChunkSize == 0)
+        throw std::invalid_argument("The chunk size must be positive");
+
+    std::vector<TransferEntry> plannedEntries = entries;
+    uint64_t totalBytes = 0;
+    size_t chunkCount = 0;
+
+    for (TransferEntry &entry : plannedEntries)
+    {
+        entry.FirstChunk = chunkCount;
+        chunkCount += static_cast<size_t>((entry.Size + options.ChunkSize - 1) / options.ChunkSize);
+        totalBytes += entry.Size;
+    }
+
+    SharedChunks chunks(options.ChunkSize, options.MemoryBudget, m_Consoles.size());
+    FleetTransferResult result;
+    result.Consoles.resize(m_Consoles.size());
+
+    auto send = [&](size_t index, Console &console) {
+        TransferOptions transferOptions;
+        transferOptions.Cancellation = options.Cancellation;
+        transferOptions.Checksums = options.Checksums;
+
+        TransferTracker tracker(transferOptions);
+        tracker.SetTotalBytes(totalBytes);
+
+        for (const TransferEntry &entry : plannedEntries)
+        {
+            if (!entry.IsDirectory)
+            {
+                size_t chunkInFile = 0;
+                SharedChunks::Chunk chunk;
+
+                console.SendFileContent(entry.RemotePath, entry.LocalPath, entry.Size, tracker, [&](const char *&data) {
+                    chunk = chunks.Get(index, entry.LocalPath, entry.Size, entry.FirstChunk, chunkInFile++);
+                    data = chunk->data();
+
+                    return chunk->size();
+                });
+
+                continue;
+            }
+
+            // Same as Console::SendDirectory, the directory sent must not exist yet
+            if (&entry == &plannedEntries.front())
+            {
+                bool remotePathAlreadyExists = false;
+
+                try
+                {
+                    console.GetFileAttributes(entry.RemotePath);
+                    remotePathAlreadyExists = true;
+                }
+                catch (const std::exception &)
+                {
+                }
+
+                if (remotePathAlreadyExists)
+                    throw std::invalid_argument("A file or directory with the name \"" + entry.RemotePath + "\" already exists");
+            }
+
+            console.CreateDirectory(entry.RemotePath);
+        }
+
+        result.Consoles[index].Value = tracker.Finish();
+    };
+
+    std::vector<FleetOutcome> outcomes = ForEach(send, [&](size_t index) { chunks.RemoveConsumer(index); });
+
+    for (size_t i = 0; i < outcomes.size(); i++)
+        static_cast<FleetOutcome &>(result.Consoles[i]) = std::move(outcomes[i]);
+
+    result.BytesRead = chunks.GetBytesRead();
+
+    return result;
+}
+
+std::vector<FleetOutcome> ConsoleFleet::ForEach(const std::function<void(size_t, Console &)> &query, const std::function<void(size_t)> &done)
+{
+    std::vector<FleetOutcome> outcomes(m_Consoles.size());
+    std::atomic<size_t> next = 0;
+
+    // The consoles are taken in order by the workers so a slow console only holds up its worker
+    auto work = [&]() {
+        for (size_t index = next++; index < m_Consoles.size(); index = next++)
+        {
+            Console &console = *m_Consoles[index];
+            FleetOutcome &outcome = outcomes[index];
+            outcome.IpAddress = console.GetIpAddress();
+            outcome.Port = console.GetPort();
+
+            auto start = std::chrono::steady_clock::now();
+
+            try
+            {
+                if (!console.IsConnected() && !console.OpenConnection())
+                    throw std::runtime_error("Couldn't connect to " + console.GetIpAddress());
+
+                query(index, console);
+                outcome.Succeeded = true;
+            }
+            catch (const std::exception &exception)
+            {
+                outcome.Error = exception.what();
+
+                // The response of a command that timed out could still arrive and be taken for
+                // the response of the next one
+                console.CloseConnection();
+            }
+
+            outcome.Duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+            if (done)
+                done(index);
+        }
+    };
+
+    size_t workerCount = std::min(m_Options.MaxParallelism, m_Consoles.size());
+    std::vector<std::thread> workers;
+    workers.reserve(workerCount);
+
+    // The calling thread is one of the workers
+    for (size_t i = 1; i < workerCount; i++)
+        workers.emplace_back(work);
+
+    work();
+
+    for (std::thread &worker : workers)
+        worker.join();
+
+    return outcomes;
+}
+
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "Console.h"
+
+namespace XBDM
+{
+
+struct FleetOptions
+{
+    // Consoles queried at the same time, each one on its own thread
+    size_t MaxParallelism = 32;
+
+    // Given to Console::SetTimeout for each console, a console that doesn't respond in time
+    // fails without holding up the others for longer than that
+    std::chrono::milliseconds Timeout = std::chrono::milliseconds(2000);
+};
+
+// Outcome of a query on one console of a fleet
+struct FleetOutcome
+{
+    std::string IpAddress;
+    uint16_t Port = 0;
+    bool Succeeded = false;
+
+    // Message of the exception thrown by the query, or why the console couldn't be reached
+    std::string Error;
+    std::chrono::microseconds Duration = std::chrono::microseconds(0);
+};
+
+template<typename T>
+struct FleetResult : public FleetOutcome
+{
+    T Value = T();
+};
+
+struct FleetTransferOptions
+{
+    // The local files are read in chunks of ChunkSize bytes, each chunk being shared by all the
+    // consoles instead of read again for each of them
+    size_t ChunkSize = 1024 * 1024;
+
+    // Chunks are kept in memory until every console sent them, within MemoryBudget bytes. A
+    // console falling further behind than that reads its chunks from the disk again instead of
+    // holding the others up.
+    size_t MemoryBudget = 64 * 1024 * 1024;
+
+    CancellationToken Cancellation;
+    ChecksumType Checksums = ChecksumType::None;
+};
+
+struct FleetTransferResult
+{
+    // In the order the consoles were added
+    std::vector<FleetResult<TransferResult>> Consoles;
+
+    // Bytes read from the local files, only more than their size when some consoles fell behind
+    uint64_t BytesRead = 0;
+};
+
+struct ConsoleStatus
+{
+    std::string Name;
+    std::string Type;
+    XboxPath ActiveTitle;
+    std::vector<Drive> Drives;
+};
+
+// Many consoles queried concurrently from one process. Each console keeps its connection
+// between queries and the connections that failed are opened again by the next query.
+class ConsoleFleet
+{
+public:
+    ConsoleFleet(const FleetOptions &options = FleetOptions());
+
+    ConsoleFleet(const ConsoleFleet &) = delete;
+    ConsoleFleet &operator=(const ConsoleFleet &) = delete;
+
+    // Returns the index of the console in the results
+    size_t Add(const std::string &ipAddress, uint16_t port = 730);
+
+    inline size_t GetSize() const { return m_Consoles.size(); }
+
+    // Runs query on all the consoles, the results are in the order the consoles were added.
+    // query is called from several threads at once, never twice at once for the same console.
+    template<typename T>
+    std::vector<FleetResult<T>> Run(const std::function<T(Console &)> &query)
+    {
+        std::vector<FleetResult<T>> results(m_Consoles.size());
+        std::vector<FleetOutcome> outcomes = ForEach([&](size_t index, Console &console) { results[index].Value = query(console); });
+
+        for (size_t i = 0; i < results.size(); i++)
+            static_cast<FleetOutcome &>(results[i]) = std::move(outcomes[i]);
+
+        return results;
+    }
+
+    // Name, type, active title and drives of every console
+    std::vector<FleetResult<ConsoleStatus>> GetStatus();
+
+    // Send the same files to every console, reading each local file once. A console failing
+    // doesn't stop the transfer to the others.
+    FleetTransferResult SendFile(const XboxPath &remotePath, const std::filesystem::path &localPath, const FleetTransferOptions &options = FleetTransferOptions());
+    FleetTransferResult SendDirectory(const XboxPath &remotePath, const std::filesystem::path &localPath, const FleetTransferOptions &options = FleetTransferOptions());
+
+private:
+    FleetOptions m_Options;
+    std::vector<std::unique_ptr<Console>> m_Consoles;
+
+    struct TransferEntry
+    {
+        XboxPath RemotePath;
+        std::filesystem::path LocalPath;
+        bool IsDirectory = false;
+        uint64_t Size = 0;
+
+        // Index of the first chunk of the file among the chunks of all the files
+        size_t FirstChunk = 0;
+    };
+
+    // done is called once the query on a console is over, whether it succeeded or not
+    std::vector<FleetOutcome> ForEach(const std::function<void(size_t, Console &)> &query, const std::function<void(size_t)> &done = nullptr);
+
+    // The entries are sent in order, the directories being created before what they contain
+    FleetTransferResult Send(const std::vector<TransferEntry> &entries, const FleetTransferOptions &options);
+    void ListTransferEntries(const XboxPath &remotePath, const std::filesystem::path &localPath, std::vector<TransferEntry> &entries);
+};
+
+}
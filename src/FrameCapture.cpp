@@ -0,0 +1,303 @@
+#include "pch.h"
+#include "FrameCapture.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define XBDM_FRAME_CAPTURE_X86
+    #include <emmintrin.h>
+#endif
+
+namespace XBDM
+{
+
+static constexpr char s_FrameSequenceMagic[8] = { 'X', 'B', 'D', 'M', 'F', 'R', 'M', 'S' };
+static constexpr uint32_t s_FrameSequenceVersion = 1;
+static constexpr size_t s_FrameSequenceHeaderSize = 36;
+static constexpr size_t s_FrameHeaderSize = 12;
+static constexpr uint32_t s_BlockSize = 4096;
+
+static void StoreLittleEndian(uint8_t *destination, uint64_t value, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        destination[i] = static_cast<uint8_t>(value >> (i * 8));
+}
+
+static uint64_t LoadLittleEndian(const uint8_t *source, size_t size)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; i++)
+        value |= static_cast<uint64_t>(source[i]) << (i * 8);
+
+    return value;
+}
+
+bool AreBlocksEqual(const uint8_t *left, const uint8_t *right, size_t length)
+{
+    size_t offset = 0;
+
+#ifdef XBDM_FRAME_CAPTURE_X86
+    // Blocks that changed usually differ early, so the comparison stops at the first 64 bytes
+    // that aren't equal
+    for (; offset + 64 <= length; offset += 64)
+    {
+        __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(left + offset)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(right + offset)));
+        for (size_t i = 16; i < 64; i += 16)
+            equal = _mm_and_si128(equal, _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(left + offset + i)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(right + offset + i))));
+
+        if (_mm_movemask_epi8(equal) != 0xffff)
+            return false;
+    }
+#endif
+
+    return memcmp(left + offset, right + offset, length - offset) == 0;
+}
+
+FrameRecorder::FrameRecorder(const Console &console, const std::filesystem::path &path, const FrameCaptureOptions &options)
+    : m_Console(console.GetIpAddress(), console.GetPort()), m_Path(path), m_Options(options)
+{
+    m_Console.SetTimeout(console.GetTimeout());
+    m_Console.SetReconnectPolicy(console.GetReconnectPolicy());
+
+    if (options.MaxFrameRate < 0.0)
+        throw std::invalid_argument("The frame rate can't be negative");
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    try
+    {
+        Stop();
+    }
+    catch (const std::exception &)
+    {
+    }
+}
+
+void FrameRecorder::Start()
+{
+    if (IsRunning())
+        throw std::logic_error("The recorder is already running");
+
+    if (!m_Console.IsConnected() && !m_Console.OpenConnection())
+        throw std::runtime_error("Couldn't connect to " + m_Console.GetIpAddress());
+
+    m_File.open(m_Path, std::ios::binary | std::ios::trunc);
+    if (m_File.fail())
+        throw std::runtime_error("Couldn't create " + m_Path.string());
+
+    m_StopRequested = false;
+    m_Error = nullptr;
+    m_Frames = 0;
+    m_StoredBlocks = 0;
+    m_BytesWritten = 0;
+    m_Thread = std::thread(&FrameRecorder::Capture, this);
+}
+
+void FrameRecorder::Stop()
+{
+    if (!IsRunning())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_StopMutex);
+        m_StopRequested = true;
+    }
+
+    m_StopCondition.notify_all();
+    m_Thread.join();
+    m_File.close();
+
+    if (m_Error)
+    {
+        std::exception_ptr error = m_Error;
+        m_Error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+FrameCaptureStats FrameRecorder::GetStats() const
+{
+    FrameCaptureStats stats;
+    stats.Frames = m_Frames.load();
+    stats.StoredBlocks = m_StoredBlocks.load();
+    stats.BytesWritten = m_BytesWritten.load();
+
+    return stats;
+}
+
+void FrameRecorder::Capture()
+{
+    using Clock = std::chrono::steady_clock;
+
+    // The frame being captured is compared with the previous one, then they swap roles
+    std::vector<uint8_t> previous;
+    std::vector<uint8_t> current;
+    std::vector<uint32_t> blocks;
+    FramebufferInfo first;
+
+    Clock::duration period = Clock::duration::zero();
+    if (m_Options.MaxFrameRate > 0.0)
+        period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_Options.MaxFrameRate));
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start;
+
+    try
+    {
+        for (uint64_t frame = 0;; frame++)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_StopMutex);
+                if (m_StopCondition.wait_until(lock, deadline, [this]() { return m_StopRequested; }))
+                    return;
+            }
+
+            // Frames that can't be captured in time are captured as soon as possible instead,
+            // without trying to catch up
+            deadline = std::max(deadline + period, Clock::now());
+
+            Clock::time_point captureTime = Clock::now();
+            FramebufferInfo info = m_Console.CaptureFramebuffer(current);
+            auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(captureTime - start);
+
+            if (frame == 0)
+            {
+                first = info;
+
+                uint8_t header[s_FrameSequenceHeaderSize] = {};
+                memcpy(header, s_FrameSequenceMagic, sizeof(s_FrameSequenceMagic));
+                StoreLittleEndian(header + 8, s_FrameSequenceVersion, 4);
+                StoreLittleEndian(header + 12, info.Width, 4);
+                StoreLittleEndian(header + 16, info.Height, 4);
+                StoreLittleEndian(header + 20, info.Pitch, 4);
+                StoreLittleEndian(header + 24, info.Format, 4);
+                StoreLittleEndian(header + 28, info.Size, 4);
+                StoreLittleEndian(header + 32, s_BlockSize, 4);
+
+                m_File.write(reinterpret_cast<const char *>(header), sizeof(header));
+                m_BytesWritten += sizeof(header);
+            }
+            else if (info.Width != first.Width || info.Height != first.Height || info.Pitch != first.Pitch || info.Format != first.Format || info.Size != first.Size)
+            {
+                throw std::runtime_error("The framebuffer changed format during the capture");
+            }
+
+            bool keyframe = frame == 0 || (m_Options.KeyframeInterval != 0 && frame % m_Options.KeyframeInterval == 0);
+            uint32_t blockCount = (info.Size + s_BlockSize - 1) / s_BlockSize;
+
+            blocks.clear();
+            for (uint32_t i = 0; i < blockCount; i++)
+            {
+                size_t offset = static_cast<size_t>(i) * s_BlockSize;
+                size_t length = std::min<size_t>(s_BlockSize, info.Size - offset);
+
+                if (keyframe || !AreBlocksEqual(current.data() + offset, previous.data() + offset, length))
+                    blocks.push_back(i);
+            }
+
+            WriteFrame(timestamp, current, blocks);
+            std::swap(previous, current);
+            m_Frames++;
+        }
+    }
+    catch (const std::exception &)
+    {
+        m_Error = std::current_exception();
+    }
+}
+
+void FrameRecorder::WriteFrame(std::chrono::microseconds timestamp, const std::vector<uint8_t> &framebuffer, const std::vector<uint32_t> &blocks)
+{
+    uint8_t header[s_FrameHeaderSize] = {};
+    StoreLittleEndian(header, static_cast<uint64_t>(timestamp.count()), 8);
+    StoreLittleEndian(header + 8, blocks.size(), 4);
+    m_File.write(reinterpret_cast<const char *>(header), sizeof(header));
+
+    uint64_t written = sizeof(header);
+    for (uint32_t index : blocks)
+    {
+        size_t offset = static_cast<size_t>(index) * s_BlockSize;
+        size_t length = std::min<size_t>(s_BlockSize, framebuffer.size() - offset);
+
+        uint8_t blockIndex[4] = {};
+        StoreLittleEndian(blockIndex, index, sizeof(blockIndex));
+        m_File.write(reinterpret_cast<const char *>(blockIndex), sizeof(blockIndex));
+        m_File.write(reinterpret_cast<const char *>(framebuffer.data() + offset), static_cast<std::streamsize>(length));
+
+        written += sizeof(blockIndex) + length;
+    }
+
+    if (m_File.fail())
+        throw std::runtime_error("Couldn't write to " + m_Path.string());
+
+    m_StoredBlocks += blocks.size();
+    m_BytesWritten += written;
+}
+
+FrameSequenceReader::FrameSequenceReader(const std::filesystem::path &path)
+    : m_File(path, std::ios::binary)
+{
+    if (m_File.fail())
+        throw std::runtime_error("Couldn't open " + path.string());
+
+    uint8_t header[s_FrameSequenceHeaderSize] = {};
+    m_File.read(reinterpret_cast<char *>(header), sizeof(header));
+
+    if (m_File.gcount() != static_cast<std::streamsize>(sizeof(header)) || memcmp(header, s_FrameSequenceMagic, sizeof(s_FrameSequenceMagic)) != 0)
+        throw std::runtime_error(path.string() + " isn't a frame sequence file");
+
+    if (LoadLittleEndian(header + 8, 4) != s_FrameSequenceVersion)
+        throw std::runtime_error("Unsupported frame sequence version");
+
+    m_Info.Width = static_cast<uint32_t>(LoadLittleEndian(header + 12, 4));
+    m_Info.Height = static_cast<uint32_t>(LoadLittleEndian(header + 16, 4));
+    m_Info.Pitch = static_cast<uint32_t>(LoadLittleEndian(header + 20, 4));
+    m_Info.Format = static_cast<uint32_t>(LoadLittleEndian(header + 24, 4));
+    m_Info.Size = static_cast<uint32_t>(LoadLittleEndian(header + 28, 4));
+    m_BlockSize = static_cast<uint32_t>(LoadLittleEndian(header + 32, 4));
+
+    if (m_BlockSize == 0)
+        throw std::runtime_error("Invalid block size in " + path.string());
+
+    m_Framebuffer.resize(m_Info.Size);
+}
+
+bool FrameSequenceReader::ReadFrame(Image &image, std::chrono::microseconds &timestamp)
+{
+    uint8_t header[s_FrameHeaderSize] = {};
+    m_File.read(reinterpret_cast<char *>(header), sizeof(header));
+
+    // A recording stopped while a frame was written ends with part of it, which is ignored
+    if (m_File.gcount() != static_cast<std::streamsize>(sizeof(header)))
+        return false;
+
+    uint32_t blockCount = static_cast<uint32_t>(LoadLittleEndian(header + 8, 4));
+    uint32_t totalBlocks = (m_Info.Size + m_BlockSize - 1) / m_BlockSize;
+
+    for (uint32_t i = 0; i < blockCount; i++)
+    {
+        uint8_t blockIndex[4] = {};
+        m_File.read(reinterpret_cast<char *>(blockIndex), sizeof(blockIndex));
+
+        if (m_File.gcount() != sizeof(blockIndex))
+            return false;
+
+        uint32_t index = static_cast<uint32_t>(LoadLittleEndian(blockIndex, sizeof(blockIndex)));
+        if (index >= totalBlocks)
+            throw std::runtime_error("Invalid block index in frame sequence");
+
+        size_t offset = static_cast<size_t>(index) * m_BlockSize;
+        size_t length = std::min<size_t>(m_BlockSize, m_Info.Size - offset);
+
+        m_File.read(reinterpret_cast<char *>(m_Framebuffer.data() + offset), static_cast<std::streamsize>(length));
+        if (m_File.gcount() != static_cast<std::streamsize>(length))
+            return false;
+    }
+
+    timestamp = std::chrono::microseconds(LoadLittleEndian(header, 8));
+    m_StoredBlockCount = blockCount;
+    ConvertFramebuffer(m_Framebuffer.data(), m_Info, image);
+
+    return true;
+}
+
+}
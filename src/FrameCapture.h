@@ -0,0 +1,101 @@
+#pragma once
+
+#include "Console.h"
+
+namespace XBDM
+{
+
+// Frame sequence files store the raw framebuffers of a capture split in blocks of 4KB, which
+// are single tiles of 32x32 pixels in tiled framebuffers. The first frame stores all of its
+// blocks, the next ones only the blocks that changed since the previous frame.
+// - header: magic "XBDMFRMS", then version, width, height, pitch, format, framebuffer size and
+//   block size as 32-bit integers
+// - frames: timestamp in microseconds since the start of the capture (64-bit), number of blocks
+//   (32-bit), then the index (32-bit) and content of each block
+// All the integers are little-endian.
+struct FrameCaptureOptions
+{
+    // Frames are captured back to back when 0, otherwise at most MaxFrameRate per second
+    double MaxFrameRate = 0.0;
+
+    // All the blocks are stored every KeyframeInterval frames so that playback can start there,
+    // 0 only stores them in the first frame
+    uint32_t KeyframeInterval = 0;
+};
+
+struct FrameCaptureStats
+{
+    uint64_t Frames = 0;
+    uint64_t StoredBlocks = 0;
+    uint64_t BytesWritten = 0;
+};
+
+// Captures frames on its own thread and connection to the console, so that the console the
+// recorder is created from stays usable during the capture
+class FrameRecorder
+{
+public:
+    // The connection has the timeout and reconnection policy of console
+    FrameRecorder(const Console &console, const std::filesystem::path &path, const FrameCaptureOptions &options = FrameCaptureOptions());
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder &) = delete;
+    FrameRecorder &operator=(const FrameRecorder &) = delete;
+
+    // Throws std::runtime_error if the console can't be reached or the file can't be created
+    void Start();
+
+    // Rethrows the error that ended the capture early, if any
+    void Stop();
+
+    inline bool IsRunning() const { return m_Thread.joinable(); }
+
+    FrameCaptureStats GetStats() const;
+
+private:
+    Console m_Console;
+    std::filesystem::path m_Path;
+    FrameCaptureOptions m_Options;
+    std::ofstream m_File;
+
+    std::thread m_Thread;
+    std::mutex m_StopMutex;
+    std::condition_variable m_StopCondition;
+    bool m_StopRequested = false;
+    std::exception_ptr m_Error;
+
+    std::atomic<uint64_t> m_Frames = 0;
+    std::atomic<uint64_t> m_StoredBlocks = 0;
+    std::atomic<uint64_t> m_BytesWritten = 0;
+
+    void Capture();
+    void WriteFrame(std::chrono::microseconds timestamp, const std::vector<uint8_t> &framebuffer, const std::vector<uint32_t> &blocks);
+};
+
+// Plays a frame sequence file back one frame at a time
+class FrameSequenceReader
+{
+public:
+    // Throws std::runtime_error if path isn't a frame sequence file
+    FrameSequenceReader(const std::filesystem::path &path);
+
+    inline const FramebufferInfo &GetInfo() const { return m_Info; }
+
+    // Returns false at the end of the sequence
+    bool ReadFrame(Image &image, std::chrono::microseconds &timestamp);
+
+    // Number of blocks the last frame read stored
+    inline uint32_t GetStoredBlockCount() const { return m_StoredBlockCount; }
+
+private:
+    std::ifstream m_File;
+    FramebufferInfo m_Info;
+    uint32_t m_BlockSize = 0;
+    std::vector<uint8_t> m_Framebuffer;
+    uint32_t m_StoredBlockCount = 0;
+};
+
+// Whether the length bytes at left and right are the same, compared 16 bytes at a time
+bool AreBlocksEqual(const uint8_t *left, const uint8_t *right, size_t length);
+
+}
@@ -0,0 +1,245 @@
+#include "pch.h"
+#include "Image.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define XBDM_IMAGE_X86
+    #include <emmintrin.h>
+#endif
+
+namespace XBDM
+{
+
+uint32_t GetTiledOffset(uint32_t x, uint32_t y, uint32_t width)
+{
+    // Same as XGAddress2DTiledOffset from the XDK with 4 bytes per pixel
+    constexpr uint32_t logBpp = 2;
+    uint32_t alignedWidth = (width + 31) & ~31u;
+
+    uint32_t macro = ((x >> 5) + (y >> 5) * (alignedWidth >> 5)) << (logBpp + 7);
+    uint32_t micro = ((x & 7) + ((y & 6) << 2)) << logBpp;
+    uint32_t offset = macro + ((micro & ~15u) << 1) + (micro & 15) + ((y & 8) << (3 + logBpp)) + ((y & 1) << 4);
+
+    return (((offset & ~511u) << 3) + ((offset & 448) << 2) + (offset & 63) + ((y & 16) << 7) + (((((y & 8) >> 2) + (x >> 3)) & 3) << 6)) >> logBpp;
+}
+
+// Loaded as a little-endian integer, the bytes A R G B of a pixel are rotated by one byte to
+// become R G B A. The alpha of the framebuffer isn't meaningful so the pixels are made opaque.
+static inline uint32_t ConvertPixel(uint32_t argb)
+{
+    return ((argb >> 8) | (argb << 24)) | 0xff000000;
+}
+
+static void ConvertPixelsScalar(const uint8_t *source, uint8_t *destination, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t pixel = 0;
+        memcpy(&pixel, source + i * 4, sizeof(pixel));
+        pixel = ConvertPixel(pixel);
+        memcpy(destination + i * 4, &pixel, sizeof(pixel));
+    }
+}
+
+// Tiled framebuffers store the pixels of a row in runs of 4 so the conversion works on 16 bytes
+// at a time, which are a single SSE2 register
+static inline void ConvertFourPixels(const uint8_t *source, uint8_t *destination)
+{
+#ifdef XBDM_IMAGE_X86
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000));
+    __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source));
+    __m128i rotated = _mm_or_si128(_mm_or_si128(_mm_srli_epi32(pixels, 8), _mm_slli_epi32(pixels, 24)), alpha);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(destination), rotated);
+#else
+    ConvertPixelsScalar(source, destination, 4);
+#endif
+}
+
+void ConvertFramebuffer(const uint8_t *framebuffer, const FramebufferInfo &info, Image &image)
+{
+    // Only 8 bits per channel formats are supported, the framebuffer of all games
+    if ((info.Format & 0x3f) != 0x06)
+        throw std::runtime_error("Unsupported framebuffer format: " + std::to_string(info.Format));
+
+    uint64_t requiredSize = info.IsTiled() ? static_cast<uint64_t>((info.Width + 31) & ~31u) * ((info.Height + 31) & ~31u) * 4 : static_cast<uint64_t>(info.Pitch) * info.Height;
+    if (info.Size < requiredSize || (!info.IsTiled() && info.Pitch < info.Width * 4))
+        throw std::runtime_error("The framebuffer is too small for its dimensions");
+
+    image.Width = info.Width;
+    image.Height = info.Height;
+    image.Pixels.resize(static_cast<size_t>(info.Width) * info.Height * 4);
+
+    for (uint32_t y = 0; y < info.Height; y++)
+    {
+        uint8_t *row = image.Pixels.data() + static_cast<size_t>(y) * info.Width * 4;
+
+        if (!info.IsTiled())
+        {
+            const uint8_t *source = framebuffer + static_cast<size_t>(y) * info.Pitch;
+            uint32_t x = 0;
+            for (; x + 4 <= info.Width; x += 4)
+                ConvertFourPixels(source + x * 4, row + x * 4);
+
+            ConvertPixelsScalar(source + x * 4, row + x * 4, info.Width - x);
+            continue;
+        }
+
+        uint32_t x = 0;
+        for (; x + 4 <= info.Width; x += 4)
+            ConvertFourPixels(framebuffer + static_cast<size_t>(GetTiledOffset(x, y, info.Width)) * 4, row + x * 4);
+
+        for (; x < info.Width; x++)
+            ConvertPixelsScalar(framebuffer + static_cast<size_t>(GetTiledOffset(x, y, info.Width)) * 4, row + x * 4, 1);
+    }
+}
+
+void Image::Save(const std::filesystem::path &path) const
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (extension == ".png")
+        SavePng(path);
+    else if (extension == ".ppm")
+        SavePpm(path);
+    else
+        throw std::invalid_argument("Unsupported image format: " + extension);
+}
+
+// CRC-32 of zlib and PNG, which isn't the same polynomial as Crc32c
+static uint32_t UpdateCrc32(uint32_t crc, const uint8_t *data, size_t length)
+{
+    static const std::array<uint32_t, 256> table = []() {
+        std::array<uint32_t, 256> result = {};
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++)
+                value = (value & 1) != 0 ? 0xedb88320 ^ (value >> 1) : value >> 1;
+
+            result[i] = value;
+        }
+
+        return result;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+static void AppendBigEndian(std::vector<uint8_t> &buffer, uint32_t value)
+{
+    buffer.push_back(static_cast<uint8_t>(value >> 24));
+    buffer.push_back(static_cast<uint8_t>(value >> 16));
+    buffer.push_back(static_cast<uint8_t>(value >> 8));
+    buffer.push_back(static_cast<uint8_t>(value));
+}
+
+void Image::SavePng(const std::filesystem::path &path) const
+{
+    // The image data goes in a zlib stream of stored (uncompressed) deflate blocks: screenshots
+    // are saved as fast as possible and can be compressed later if needed
+    constexpr size_t maxBlockSize = 65535;
+    size_t rowSize = static_cast<size_t>(Width) * 4 + 1;
+    size_t rawSize = rowSize * Height;
+
+    std::vector<uint8_t> raw(rawSize);
+    for (uint32_t y = 0; y < Height; y++)
+    {
+        // Each row starts with its filter type, 0 for none
+        raw[y * rowSize] = 0;
+        memcpy(raw.data() + y * rowSize + 1, Pixels.data() + static_cast<size_t>(y) * Width * 4, rowSize - 1);
+    }
+
+    std::vector<uint8_t> idat = { 'I', 'D', 'A', 'T', 0x78, 0x01 };
+    idat.reserve(rawSize + rawSize / maxBlockSize * 5 + 16);
+
+    size_t offset = 0;
+    do
+    {
+        size_t blockSize = std::min(maxBlockSize, rawSize - offset);
+        bool last = offset + blockSize == rawSize;
+
+        idat.push_back(last ? 1 : 0);
+        idat.push_back(static_cast<uint8_t>(blockSize));
+        idat.push_back(static_cast<uint8_t>(blockSize >> 8));
+        idat.push_back(static_cast<uint8_t>(~blockSize));
+        idat.push_back(static_cast<uint8_t>(~blockSize >> 8));
+        idat.insert(idat.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+
+        offset += blockSize;
+    } while (offset < rawSize);
+
+    // Adler-32 of the uncompressed data, the sums are reduced every 5552 bytes, the most that
+    // can be added without overflowing 32 bits
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (size_t start = 0; start < rawSize; start += 5552)
+    {
+        size_t end = std::min(rawSize, start + 5552);
+        for (size_t i = start; i < end; i++)
+        {
+            a += raw[i];
+            b += a;
+        }
+
+        a %= 65521;
+        b %= 65521;
+    }
+
+    AppendBigEndian(idat, (b << 16) | a);
+
+    std::vector<uint8_t> ihdr = { 'I', 'H', 'D', 'R' };
+    AppendBigEndian(ihdr, Width);
+    AppendBigEndian(ihdr, Height);
+
+    // 8 bits per channel, RGBA, default compression and filtering, not interlaced
+    ihdr.insert(ihdr.end(), { 8, 6, 0, 0, 0 });
+
+    std::vector<uint8_t> iend = { 'I', 'E', 'N', 'D' };
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        throw std::runtime_error("Couldn't create image: " + path.string());
+
+    const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    file.write(reinterpret_cast<const char *>(signature), sizeof(signature));
+
+    // Chunks are their length, then their type and data, then the CRC of the type and data
+    for (const std::vector<uint8_t> *chunk : { &ihdr, &idat, &iend })
+    {
+        std::vector<uint8_t> length;
+        AppendBigEndian(length, static_cast<uint32_t>(chunk->size() - 4));
+        std::vector<uint8_t> crc;
+        AppendBigEndian(crc, UpdateCrc32(0, chunk->data(), chunk->size()));
+
+        file.write(reinterpret_cast<const char *>(length.data()), static_cast<std::streamsize>(length.size()));
+        file.write(reinterpret_cast<const char *>(chunk->data()), static_cast<std::streamsize>(chunk->size()));
+        file.write(reinterpret_cast<const char *>(crc.data()), static_cast<std::streamsize>(crc.size()));
+    }
+
+    if (!file)
+        throw std::runtime_error("Couldn't write image: " + path.string());
+}
+
+void Image::SavePpm(const std::filesystem::path &path) const
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        throw std::runtime_error("Couldn't create image: " + path.string());
+
+    file << "P6\n" << Width << " " << Height << "\n255\n";
+
+    std::vector<char> rgb(static_cast<size_t>(Width) * Height * 3);
+    for (size_t i = 0; i < static_cast<size_t>(Width) * Height; i++)
+        memcpy(rgb.data() + i * 3, Pixels.data() + i * 4, 3);
+
+    file.write(rgb.data(), static_cast<std::streamsize>(rgb.size()));
+
+    if (!file)
+        throw std::runtime_error("Couldn't write image: " + path.string());
+}
+
+}
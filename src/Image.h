@@ -0,0 +1,44 @@
+#pragma once
+
+namespace XBDM
+{
+
+// Framebuffer as described by the header of the screenshot response
+struct FramebufferInfo
+{
+    static constexpr uint32_t s_TiledFlag = 0x100;
+
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+
+    // Bytes between the starts of two rows, only used by linear framebuffers
+    uint32_t Pitch = 0;
+    uint32_t Format = 0;
+    uint32_t Size = 0;
+
+    inline bool IsTiled() const { return (Format & s_TiledFlag) != 0; }
+};
+
+struct Image
+{
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+
+    // RGBA with 8 bits per channel, rows are Width * 4 bytes long with no padding
+    std::vector<uint8_t> Pixels;
+
+    // Saves to PNG or PPM (binary, without alpha) depending on the extension of path
+    void Save(const std::filesystem::path &path) const;
+    void SavePng(const std::filesystem::path &path) const;
+    void SavePpm(const std::filesystem::path &path) const;
+};
+
+// Index of the pixel at x, y in a tiled framebuffer of width pixels. Framebuffers are tiled
+// in tiles of 32x32 pixels, themselves swizzled, with width and height aligned to 32.
+uint32_t GetTiledOffset(uint32_t x, uint32_t y, uint32_t width);
+
+// Converts a framebuffer of 32-bit big-endian ARGB pixels to an opaque RGBA image, untiling
+// it if needed. The Pixels of image are reused when they are big enough.
+void ConvertFramebuffer(const uint8_t *framebuffer, const FramebufferInfo &info, Image &image);
+
+}
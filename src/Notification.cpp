@@ -0,0 +1,313 @@
+#include "pch.h"
+#include "Notification.h"
+
+namespace XBDM
+{
+
+// Calls visit with the name and value of each argument, flags have an empty value and
+// visit returns false to stop
+static void VisitArguments(const std::string &arguments, const std::function<bool(const std::string &, const std::string &)> &visit)
+{
+    size_t position = 0;
+    while (position < arguments.size())
+    {
+        if (arguments[position] == ' ')
+        {
+            position++;
+            continue;
+        }
+
+        size_t keyEnd = arguments.find_first_of("= ", position);
+        std::string key = arguments.substr(position, keyEnd - position);
+
+        // Flags like "lf" don't have a value
+        if (keyEnd == std::string::npos || arguments[keyEnd] == ' ')
+        {
+            if (!visit(key, std::string()))
+                return;
+
+            position = keyEnd;
+            continue;
+        }
+
+        size_t valueStart = keyEnd + 1;
+        size_t valueEnd = std::string::npos;
+        std::string value;
+
+        if (key == "string")
+            value = arguments.substr(valueStart);
+        else if (valueStart < arguments.size() && arguments[valueStart] == '"')
+        {
+            valueEnd = arguments.find('"', valueStart + 1);
+            value = arguments.substr(valueStart + 1, valueEnd == std::string::npos ? std::string::npos : valueEnd - valueStart - 1);
+            valueEnd = valueEnd == std::string::npos ? valueEnd : valueEnd + 1;
+        }
+        else
+        {
+            valueEnd = arguments.find(' ', valueStart);
+            value = arguments.substr(valueStart, valueEnd == std::string::npos ? std::string::npos : valueEnd - valueStart);
+        }
+
+        if (!visit(key, value))
+            return;
+
+        position = valueEnd;
+    }
+}
+
+std::string Notification::GetProperty(const std::string &name) const
+{
+    std::string result;
+    VisitArguments(Arguments, [&](const std::string &key, const std::string &value) {
+        if (key != name || value.empty())
+            return true;
+
+        result = value;
+        return false;
+    });
+
+    return result;
+}
+
+bool Notification::HasFlag(const std::string &flag) const
+{
+    bool found = false;
+    VisitArguments(Arguments, [&](const std::string &key, const std::string &value) {
+        found = key == flag && value.empty();
+        return !found;
+    });
+
+    return found;
+}
+
+uint32_t Notification::GetIntegerProperty(const std::string &name) const
+{
+    std::string value = GetProperty(name);
+    if (value.empty())
+        throw std::runtime_error("Property '" + name + "' not found");
+
+    return static_cast<uint32_t>(std::stoul(value, nullptr, 0));
+}
+
+Notification Notification::Parse(const std::string &line)
+{
+    static const std::unordered_map<std::string, NotificationType> types = {
+        { "execution", NotificationType::ExecutionState },
+        { "modload", NotificationType::ModuleLoad },
+        { "modunload", NotificationType::ModuleUnload },
+        { "debugstr", NotificationType::DebugString },
+        { "exception", NotificationType::Exception },
+        { "break", NotificationType::Break },
+    };
+
+    Notification notification;
+    notification.Time = std::chrono::system_clock::now();
+
+    size_t space = line.find(' ');
+    notification.Name = line.substr(0, space);
+    notification.Arguments = space != std::string::npos ? line.substr(space + 1) : std::string();
+
+    auto type = types.find(notification.Name);
+    if (type != types.end())
+        notification.Type = type->second;
+
+    return notification;
+}
+
+NotificationListener::NotificationListener(const Console &console, size_t capacity)
+    : m_Console(console.GetIpAddress(), console.GetPort()), m_Queue(capacity)
+{
+    m_Console.SetTimeout(console.GetTimeout());
+    m_Console.SetReconnectPolicy(console.GetReconnectPolicy());
+}
+
+NotificationListener::~NotificationListener()
+{
+    Stop();
+}
+
+size_t NotificationListener::Subscribe(Callback callback)
+{
+    std::lock_guard<std::mutex> lock(m_SubscribersMutex);
+
+    m_Subscribers.push_back({ m_NextSubscriberId, true, NotificationType::Unknown, std::move(callback) });
+    m_SubscribersVersion++;
+
+    return m_NextSubscriberId++;
+}
+
+size_t NotificationListener::Subscribe(NotificationType type, Callback callback)
+{
+    std::lock_guard<std::mutex> lock(m_SubscribersMutex);
+
+    m_Subscribers.push_back({ m_NextSubscriberId, false, type, std::move(callback) });
+    m_SubscribersVersion++;
+
+    return m_NextSubscriberId++;
+}
+
+void NotificationListener::Unsubscribe(size_t id)
+{
+    std::lock_guard<std::mutex> lock(m_SubscribersMutex);
+
+    m_Subscribers.erase(std::remove_if(m_Subscribers.begin(), m_Subscribers.end(), [&](const Subscriber &subscriber) { return subscriber.Id == id; }), m_Subscribers.end());
+    m_SubscribersVersion++;
+}
+
+void NotificationListener::Start()
+{
+    if (IsRunning())
+        throw std::logic_error("The listener is already running");
+
+    if (!m_Console.OpenConnection())
+        throw std::runtime_error("Couldn't connect to " + m_Console.GetIpAddress());
+
+    m_Console.SendCommand("notify");
+    std::string response = m_Console.Receive();
+    if (response.compare(0, 3, "205") != 0)
+    {
+        m_Console.CloseConnection();
+        throw std::runtime_error("Couldn't open a notification channel: " + response);
+    }
+
+    m_StopRequested = false;
+    m_ReceiveFinished = false;
+    m_ReceiveThread = std::thread(&NotificationListener::Receive, this);
+    m_DispatchThread = std::thread(&NotificationListener::Dispatch, this);
+}
+
+void NotificationListener::Stop()
+{
+    if (!IsRunning())
+        return;
+
+    m_StopRequested = true;
+    m_ReceiveThread.join();
+    m_DispatchThread.join();
+    m_Console.CloseConnection();
+}
+
+void NotificationListener::Receive()
+{
+    // Notifications sent right after the channel was opened can already be in the receive buffer
+    std::string pending = std::move(m_Console.m_ReceiveBuffer);
+    m_Console.m_ReceiveBuffer.clear();
+
+    auto processLines = [&]() {
+        size_t lineEnd = 0;
+        while ((lineEnd = pending.find("\r\n")) != std::string::npos)
+        {
+            Push(Notification::Parse(pending.substr(0, lineEnd)));
+            pending.erase(0, lineEnd + 2);
+        }
+    };
+
+    processLines();
+
+    // The console only sends something when an event happens so the socket is waited on with
+    // a timeout, to notice stop requests
+    std::vector<char> buffer(s_ReceiveBufferSize);
+    bool connectionLost = false;
+    while (!m_StopRequested)
+    {
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(m_Console.m_Socket, &readSet);
+        timeval tv = { 0, s_StopCheckMilliseconds * 1000 };
+
+        int ready = select(static_cast<int>(m_Console.m_Socket) + 1, &readSet, nullptr, nullptr, &tv);
+        if (ready == 0)
+            continue;
+
+        int bytes = ready > 0 ? m_Console.ReceiveSome(buffer.data(), buffer.size()) : -1;
+        if (bytes <= 0)
+        {
+            connectionLost = true;
+            break;
+        }
+
+        pending.append(buffer.data(), static_cast<size_t>(bytes));
+        processLines();
+    }
+
+    if (connectionLost)
+    {
+        Notification notification;
+        notification.Type = NotificationType::ConnectionLost;
+        notification.Time = std::chrono::system_clock::now();
+        Push(std::move(notification));
+    }
+
+    m_ReceiveFinished = true;
+
+    {
+        std::lock_guard<std::mutex> lock(m_WakeUpMutex);
+    }
+    m_WakeUp.notify_one();
+}
+
+void NotificationListener::Push(Notification notification)
+{
+    if (!m_Queue.TryPush(std::move(notification)))
+    {
+        m_Dropped++;
+        return;
+    }
+
+    // Taking the mutex makes sure the dispatch thread is either waiting, and gets woken up, or
+    // hasn't checked the queue yet. The queue itself is never locked.
+    {
+        std::lock_guard<std::mutex> lock(m_WakeUpMutex);
+    }
+    m_WakeUp.notify_one();
+}
+
+void NotificationListener::Dispatch()
+{
+    Notification notification;
+
+    // The subscribers are called on a copy of the list so that they can subscribe and
+    // unsubscribe, the copy is only refreshed when the list changed
+    std::vector<Subscriber> subscribers;
+    uint64_t subscribersVersion = UINT64_MAX;
+
+    for (;;)
+    {
+        while (m_Queue.TryPop(notification))
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_SubscribersMutex);
+
+                if (subscribersVersion != m_SubscribersVersion)
+                {
+                    subscribers = m_Subscribers;
+                    subscribersVersion = m_SubscribersVersion;
+                }
+            }
+
+            for (const Subscriber &subscriber : subscribers)
+            {
+                if (!subscriber.AllTypes && subscriber.Type != notification.Type)
+                    continue;
+
+                // A subscriber throwing must not stop the dispatch thread, nor the other subscribers
+                try
+                {
+                    subscriber.Function(notification);
+                }
+                catch (...)
+                {
+                }
+            }
+        }
+
+        // Everything pushed before the reception finished was dispatched above
+        if (m_ReceiveFinished && m_Queue.Size() == 0)
+            return;
+
+        std::unique_lock<std::mutex> lock(m_WakeUpMutex);
+        m_WakeUp.wait(lock, [&]() { return m_Queue.Size() > 0 || m_ReceiveFinished; });
+    }
+}
+
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "Console.h"
+#include "RingBuffer.h"
+
+namespace XBDM
+{
+
+enum class NotificationType
+{
+    Unknown,
+
+    // "execution started", "execution stopped", "execution rebooting" or "execution pending"
+    ExecutionState,
+    ModuleLoad,
+    ModuleUnload,
+    DebugString,
+    Exception,
+    Break,
+
+    // Not sent by the console, given to the subscribers when the notification channel is closed
+    ConnectionLost,
+};
+
+// Event pushed by the console on a notification channel, e.g.
+// modload name="default.xex" base=0x82000000 size=0x00240000
+struct Notification
+{
+    NotificationType Type = NotificationType::Unknown;
+
+    // First word of the line, e.g. "modload"
+    std::string Name;
+
+    // Rest of the line
+    std::string Arguments;
+
+    std::chrono::system_clock::time_point Time;
+
+    // Value of a NAME=VALUE or NAME="VALUE" argument, empty if there is none. The string argument
+    // of debug strings goes to the end of the line and can contain anything.
+    std::string GetProperty(const std::string &name) const;
+
+    // Throws std::runtime_error if the argument doesn't exist
+    uint32_t GetIntegerProperty(const std::string &name) const;
+
+    // Whether an argument without value, like the "lf" of debug strings ending with a line feed, is there
+    bool HasFlag(const std::string &flag) const;
+
+    static Notification Parse(const std::string &line);
+};
+
+// Opens a notification channel to a console: a second connection on which the console sends
+// events instead of responses. Events are received and parsed on a background thread, queued in
+// a lock-free ring buffer and given to the subscribers on a dispatch thread, so that slow
+// subscribers don't hold up the reception.
+class NotificationListener
+{
+public:
+    using Callback = std::function<void(const Notification &)>;
+
+    // Connects to the same console as console when started, with its timeout and reconnection
+    // policy. console itself isn't used.
+    NotificationListener(const Console &console, size_t capacity = 1024);
+    ~NotificationListener();
+
+    NotificationListener(const NotificationListener &) = delete;
+    NotificationListener &operator=(const NotificationListener &) = delete;
+
+    // Subscribers are called on the dispatch thread, exceptions they throw are ignored. A
+    // subscriber can be called once more with a notification being dispatched when it is
+    // unsubscribed. Returns an id for Unsubscribe.
+    size_t Subscribe(Callback callback);
+    size_t Subscribe(NotificationType type, Callback callback);
+    void Unsubscribe(size_t id);
+
+    // Throws std::runtime_error if the console can't be reached or refuses the channel
+    void Start();
+    void Stop();
+
+    inline bool IsRunning() const { return m_ReceiveThread.joinable(); }
+
+    // Notifications lost because the subscribers didn't keep up and the queue was full
+    inline uint64_t GetDroppedCount() const { return m_Dropped.load(); }
+
+private:
+    struct Subscriber
+    {
+        size_t Id = 0;
+        bool AllTypes = true;
+        NotificationType Type = NotificationType::Unknown;
+        Callback Function;
+    };
+
+    Console m_Console;
+    RingBuffer<Notification> m_Queue;
+    std::atomic<uint64_t> m_Dropped = 0;
+
+    std::mutex m_SubscribersMutex;
+    std::vector<Subscriber> m_Subscribers;
+    size_t m_NextSubscriberId = 0;
+
+    // Incremented each time m_Subscribers changes
+    uint64_t m_SubscribersVersion = 0;
+
+    std::thread m_ReceiveThread;
+    std::thread m_DispatchThread;
+    std::atomic<bool> m_StopRequested = false;
+    std::atomic<bool> m_ReceiveFinished = false;
+
+    // Wakes the dispatch thread up when notifications are queued
+    std::mutex m_WakeUpMutex;
+    std::condition_variable m_WakeUp;
+
+    static constexpr int s_StopCheckMilliseconds = 50;
+    static constexpr size_t s_ReceiveBufferSize = 16 * 1024;
+
+    void Receive();
+    void Dispatch();
+    void Push(Notification notification);
+};
+
+}
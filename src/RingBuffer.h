@@ -0,0 +1,65 @@
+#pragma once
+
+namespace XBDM
+{
+
+// Lock-free ring buffer for exactly one producer thread and one consumer thread. Neither of
+// them ever waits for the other: TryPush fails when the buffer is full and TryPop when it's empty.
+template<typename T>
+class RingBuffer
+{
+public:
+    // The capacity is rounded up to a power of two
+    RingBuffer(size_t capacity)
+    {
+        size_t rounded = 1;
+        while (rounded < capacity)
+            rounded *= 2;
+
+        m_Items.resize(rounded);
+        m_Mask = rounded - 1;
+    }
+
+    RingBuffer(const RingBuffer &) = delete;
+    RingBuffer &operator=(const RingBuffer &) = delete;
+
+    // Producer only
+    bool TryPush(T item)
+    {
+        size_t tail = m_Tail.load(std::memory_order_relaxed);
+        if (tail - m_Head.load(std::memory_order_acquire) == m_Items.size())
+            return false;
+
+        m_Items[tail & m_Mask] = std::move(item);
+        m_Tail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Consumer only
+    bool TryPop(T &item)
+    {
+        size_t head = m_Head.load(std::memory_order_relaxed);
+        if (head == m_Tail.load(std::memory_order_acquire))
+            return false;
+
+        item = std::move(m_Items[head & m_Mask]);
+        m_Head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Only exact when called from one of the two threads while the other one is idle
+    inline size_t Size() const { return m_Tail.load(std::memory_order_acquire) - m_Head.load(std::memory_order_acquire); }
+    inline size_t Capacity() const { return m_Items.size(); }
+
+private:
+    std::vector<T> m_Items;
+    size_t m_Mask = 0;
+
+    // On separate cache lines so that the producer and the consumer don't invalidate each other's
+    alignas(64) std::atomic<size_t> m_Head = 0;
+    alignas(64) std::atomic<size_t> m_Tail = 0;
+};
+
+}
@@ -0,0 +1,262 @@
+#include "pch.h"
+#include "Scanner.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define XBDM_SCANNER_X86
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+    #include <immintrin.h>
+#endif
+
+namespace XBDM
+{
+
+Pattern::Pattern(std::vector<uint8_t> bytes, std::vector<uint8_t> mask)
+    : m_Bytes(std::move(bytes)), m_Mask(std::move(mask))
+{
+    auto isSolid = [](uint8_t mask) { return mask != 0; };
+
+    auto first = std::find_if(m_Mask.begin(), m_Mask.end(), isSolid);
+    if (first == m_Mask.end())
+        throw std::invalid_argument("A pattern needs at least one byte that isn't a wildcard");
+
+    m_FirstSolid = static_cast<size_t>(first - m_Mask.begin());
+    m_LastSolid = m_Mask.size() - 1 - static_cast<size_t>(std::find_if(m_Mask.rbegin(), m_Mask.rend(), isSolid) - m_Mask.rbegin());
+}
+
+Pattern Pattern::FromSignature(const std::string &signature)
+{
+    std::vector<uint8_t> bytes;
+    std::vector<uint8_t> mask;
+    std::istringstream stream(signature);
+    std::string token;
+
+    while (stream >> token)
+    {
+        if (token == "?" || token == "??")
+        {
+            bytes.push_back(0);
+            mask.push_back(0);
+            continue;
+        }
+
+        if (token.size() != 2 || !std::isxdigit(static_cast<unsigned char>(token[0])) || !std::isxdigit(static_cast<unsigned char>(token[1])))
+            throw std::invalid_argument("Invalid byte in signature: " + token);
+
+        bytes.push_back(static_cast<uint8_t>(std::stoul(token, nullptr, 16)));
+        mask.push_back(0xff);
+    }
+
+    return Pattern(std::move(bytes), std::move(mask));
+}
+
+Pattern Pattern::FromBytes(const void *data, size_t length)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+
+    return Pattern(std::vector<uint8_t>(bytes, bytes + length), std::vector<uint8_t>(length, 0xff));
+}
+
+Pattern Pattern::FromString(const std::string &string)
+{
+    return FromBytes(string.data(), string.size());
+}
+
+Pattern Pattern::FromInteger(uint64_t value, size_t size, bool bigEndian)
+{
+    if (size == 0 || size > sizeof(value))
+        throw std::invalid_argument("Integers are between 1 and 8 bytes long");
+
+    std::vector<uint8_t> bytes(size);
+    for (size_t i = 0; i < size; i++)
+        bytes[bigEndian ? size - 1 - i : i] = static_cast<uint8_t>(value >> (i * 8));
+
+    return Pattern(std::move(bytes), std::vector<uint8_t>(size, 0xff));
+}
+
+Pattern Pattern::FromFloat(float value, bool bigEndian)
+{
+    uint32_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+
+    return FromInteger(bits, sizeof(bits), bigEndian);
+}
+
+Pattern Pattern::FromDouble(double value, bool bigEndian)
+{
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+
+    return FromInteger(bits, sizeof(bits), bigEndian);
+}
+
+bool Pattern::MatchesAt(const uint8_t *data) const
+{
+    for (size_t i = m_FirstSolid; i <= m_LastSolid; i++)
+    {
+        if ((data[i] & m_Mask[i]) != m_Bytes[i])
+            return false;
+    }
+
+    return true;
+}
+
+// The kernels call candidate with every position, from start to positions excluded, where
+// data[position + firstOffset] is first and data[position + lastOffset] is last. They return
+// false when candidate asked to stop.
+using CandidateCallback = std::function<bool(size_t)>;
+
+struct CandidateSearch
+{
+    const uint8_t *Data = nullptr;
+    size_t Positions = 0;
+    size_t FirstOffset = 0;
+    uint8_t First = 0;
+    size_t LastOffset = 0;
+    uint8_t Last = 0;
+};
+
+static bool FindCandidatesScalar(const CandidateSearch &search, size_t start, const CandidateCallback &candidate)
+{
+    for (size_t position = start; position < search.Positions; position++)
+    {
+        if (search.Data[position + search.FirstOffset] == search.First && search.Data[position + search.LastOffset] == search.Last && !candidate(position))
+            return false;
+    }
+
+    return true;
+}
+
+#ifdef XBDM_SCANNER_X86
+
+static inline uint32_t CountTrailingZeros(uint32_t value)
+{
+    #ifdef _MSC_VER
+    unsigned long index = 0;
+    _BitScanForward(&index, value);
+
+    return static_cast<uint32_t>(index);
+    #else
+    return static_cast<uint32_t>(__builtin_ctz(value));
+    #endif
+}
+
+// Each bit of matches is a candidate position relative to base
+static inline bool ReportCandidates(uint32_t matches, size_t base, const CandidateCallback &candidate)
+{
+    while (matches != 0)
+    {
+        if (!candidate(base + CountTrailingZeros(matches)))
+            return false;
+
+        matches &= matches - 1;
+    }
+
+    return true;
+}
+
+static bool FindCandidatesSse2(const CandidateSearch &search, const CandidateCallback &candidate)
+{
+    const __m128i first = _mm_set1_epi8(static_cast<char>(search.First));
+    const __m128i last = _mm_set1_epi8(static_cast<char>(search.Last));
+    size_t position = 0;
+
+    for (; position + 16 <= search.Positions; position += 16)
+    {
+        __m128i firstBlock = _mm_loadu_si128(reinterpret_cast<const __m128i *>(search.Data + position + search.FirstOffset));
+        __m128i lastBlock = _mm_loadu_si128(reinterpret_cast<const __m128i *>(search.Data + position + search.LastOffset));
+        __m128i equal = _mm_and_si128(_mm_cmpeq_epi8(firstBlock, first), _mm_cmpeq_epi8(lastBlock, last));
+
+        if (!ReportCandidates(static_cast<uint32_t>(_mm_movemask_epi8(equal)), position, candidate))
+            return false;
+    }
+
+    return FindCandidatesScalar(search, position, candidate);
+}
+
+    #ifndef _MSC_VER
+__attribute__((target("avx2")))
+    #endif
+static bool FindCandidatesAvx2(const CandidateSearch &search, const CandidateCallback &candidate)
+{
+    const __m256i first = _mm256_set1_epi8(static_cast<char>(search.First));
+    const __m256i last = _mm256_set1_epi8(static_cast<char>(search.Last));
+    size_t position = 0;
+
+    for (; position + 32 <= search.Positions; position += 32)
+    {
+        __m256i firstBlock = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(search.Data + position + search.FirstOffset));
+        __m256i lastBlock = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(search.Data + position + search.LastOffset));
+        __m256i equal = _mm256_and_si256(_mm256_cmpeq_epi8(firstBlock, first), _mm256_cmpeq_epi8(lastBlock, last));
+
+        if (!ReportCandidates(static_cast<uint32_t>(_mm256_movemask_epi8(equal)), position, candidate))
+            return false;
+    }
+
+    return FindCandidatesScalar(search, position, candidate);
+}
+
+static bool IsAvx2Supported()
+{
+    static const bool supported = []() {
+    #ifdef _MSC_VER
+        int info[4] = { 0 };
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+
+        // The OS also has to save the AVX registers
+        __cpuid(info, 1);
+        bool osSavesAvx = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+
+        __cpuidex(info, 7, 0);
+
+        return osSavesAvx && (info[1] & (1 << 5)) != 0;
+    #else
+        return __builtin_cpu_supports("avx2") != 0;
+    #endif
+    }();
+
+    return supported;
+}
+
+#endif
+
+const char *Pattern::GetKernelName()
+{
+#ifdef XBDM_SCANNER_X86
+    return IsAvx2Supported() ? "avx2" : "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+void Pattern::Find(const uint8_t *data, size_t length, const std::function<bool(size_t)> &callback) const
+{
+    if (length < m_Bytes.size())
+        return;
+
+    CandidateSearch search;
+    search.Data = data;
+    search.Positions = length - m_Bytes.size() + 1;
+    search.FirstOffset = m_FirstSolid;
+    search.First = m_Bytes[m_FirstSolid];
+    search.LastOffset = m_LastSolid;
+    search.Last = m_Bytes[m_LastSolid];
+
+    auto candidate = [&](size_t position) {
+        return !MatchesAt(data + position) || callback(position);
+    };
+
+#ifdef XBDM_SCANNER_X86
+    if (IsAvx2Supported())
+        FindCandidatesAvx2(search, candidate);
+    else
+        FindCandidatesSse2(search, candidate);
+#else
+    FindCandidatesScalar(search, 0, candidate);
+#endif
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+namespace XBDM
+{
+
+// Sequence of bytes to search for, where some bytes can be wildcards matching any value
+class Pattern
+{
+public:
+    // Bytes in hexadecimal separated by spaces, with ? or ?? for wildcards, e.g. "7c 08 ?? a6 4b"
+    static Pattern FromSignature(const std::string &signature);
+
+    static Pattern FromBytes(const void *data, size_t length);
+    static Pattern FromString(const std::string &string);
+
+    // The console is big-endian so values are searched in big-endian order by default
+    static Pattern FromInteger(uint64_t value, size_t size, bool bigEndian = true);
+    static Pattern FromFloat(float value, bool bigEndian = true);
+    static Pattern FromDouble(double value, bool bigEndian = true);
+
+    inline size_t Size() const { return m_Bytes.size(); }
+
+    // Calls callback with the offset of each match in data, in increasing order, until it returns false
+    void Find(const uint8_t *data, size_t length, const std::function<bool(size_t)> &callback) const;
+
+    // Name of the kernel used by Find on this CPU: "avx2", "sse2" or "scalar"
+    static const char *GetKernelName();
+
+private:
+    // Wildcard bytes have a mask of 0 and a byte of 0
+    std::vector<uint8_t> m_Bytes;
+    std::vector<uint8_t> m_Mask;
+
+    // Candidates are found by comparing the first and last bytes that aren't wildcards, many
+    // positions at once, and then checked byte by byte
+    size_t m_FirstSolid = 0;
+    size_t m_LastSolid = 0;
+
+    Pattern(std::vector<uint8_t> bytes, std::vector<uint8_t> mask);
+
+    bool MatchesAt(const uint8_t *data) const;
+};
+
+struct ScanOptions
+{
+    // Only matches at addresses multiple of Alignment are reported, e.g. 4 for 32-bit values
+    uint32_t Alignment = 1;
+
+    // The scan stops after MaxResults matches, 0 means no limit
+    size_t MaxResults = 0;
+
+    // Memory is read in blocks of BlockSize bytes, the next blocks being received while the
+    // current one is scanned
+    uint32_t BlockSize = 1024 * 1024;
+};
+
+}
@@ -0,0 +1,174 @@
+#include "pch.h"
+#include "Snapshot.h"
+
+#include "Checksum.h"
+#include "Utils.h"
+
+namespace XBDM
+{
+
+SnapshotStore::SnapshotStore(uint32_t pageSize)
+    : m_PageSize(pageSize)
+{
+    if (pageSize == 0 || (pageSize & (pageSize - 1)) != 0)
+        throw std::invalid_argument("The page size must be a power of two");
+}
+
+size_t SnapshotStore::Take(Console &console, const std::vector<MemoryRange> &regions)
+{
+    // Regions are extended to whole pages and pages shared by several regions are only read once
+    std::set<uint32_t> addresses;
+    for (const MemoryRange &region : regions)
+    {
+        if (region.Length == 0)
+            continue;
+
+        uint64_t start = region.Address & ~static_cast<uint64_t>(m_PageSize - 1);
+        uint64_t end = static_cast<uint64_t>(region.Address) + region.Length;
+        for (uint64_t address = start; address < end; address += m_PageSize)
+            addresses.insert(static_cast<uint32_t>(address));
+    }
+
+    // One read per page so that each page knows whether it was readable, the reads of
+    // adjacent pages are merged by the console anyway
+    std::vector<uint8_t> content(addresses.size() * static_cast<size_t>(m_PageSize));
+    std::vector<MemoryRead> reads;
+    reads.reserve(addresses.size());
+    for (uint32_t address : addresses)
+    {
+        MemoryRead read;
+        read.Address = address;
+        read.Length = m_PageSize;
+        read.Buffer = content.data() + reads.size() * m_PageSize;
+        reads.push_back(read);
+    }
+
+    console.ReadMemory(reads);
+
+    const Snapshot *previous = m_Snapshots.empty() ? nullptr : &m_Snapshots.back();
+    auto previousEntry = previous != nullptr ? previous->begin() : Snapshot::const_iterator();
+    Snapshot snapshot;
+    snapshot.reserve(reads.size());
+
+    for (const MemoryRead &read : reads)
+    {
+        auto page = std::make_shared<Page>();
+        page->Readable = read.Succeeded;
+        if (page->Readable)
+        {
+            const uint8_t *data = static_cast<const uint8_t *>(read.Buffer);
+            page->Content.assign(data, data + m_PageSize);
+
+            XxHash64 hash;
+            hash.Update(data, m_PageSize);
+            page->Hash = hash.Finish();
+        }
+
+        // Both snapshots are sorted so the previous one is walked alongside
+        if (previous != nullptr)
+        {
+            while (previousEntry != previous->end() && previousEntry->Address < read.Address)
+                ++previousEntry;
+
+            if (previousEntry != previous->end() && previousEntry->Address == read.Address && IsSamePage(*previousEntry->Content, *page))
+            {
+                snapshot.push_back({ read.Address, previousEntry->Content });
+                continue;
+            }
+        }
+
+        m_StoredBytes += page->Content.size();
+        snapshot.push_back({ read.Address, std::move(page) });
+    }
+
+    m_Snapshots.push_back(std::move(snapshot));
+
+    return m_Snapshots.size() - 1;
+}
+
+std::vector<MemoryRange> SnapshotStore::Diff(size_t from, size_t to) const
+{
+    const Snapshot &left = GetSnapshot(from);
+    const Snapshot &right = GetSnapshot(to);
+    std::vector<MemoryRange> ranges;
+
+    auto addChangedPage = [&](uint32_t address) {
+        if (!ranges.empty() && static_cast<uint64_t>(ranges.back().Address) + ranges.back().Length == address)
+            ranges.back().Length += m_PageSize;
+        else
+            ranges.push_back({ address, m_PageSize });
+    };
+
+    auto leftEntry = left.begin();
+    auto rightEntry = right.begin();
+    while (leftEntry != left.end() || rightEntry != right.end())
+    {
+        if (rightEntry == right.end() || (leftEntry != left.end() && leftEntry->Address < rightEntry->Address))
+        {
+            addChangedPage(leftEntry->Address);
+            ++leftEntry;
+        }
+        else if (leftEntry == left.end() || rightEntry->Address < leftEntry->Address)
+        {
+            addChangedPage(rightEntry->Address);
+            ++rightEntry;
+        }
+        else
+        {
+            // Unchanged pages are usually shared, which saves comparing their content
+            if (leftEntry->Content != rightEntry->Content && !IsSamePage(*leftEntry->Content, *rightEntry->Content))
+                addChangedPage(leftEntry->Address);
+
+            ++leftEntry;
+            ++rightEntry;
+        }
+    }
+
+    return ranges;
+}
+
+void SnapshotStore::Read(size_t snapshot, uint32_t address, uint32_t length, void *buffer) const
+{
+    const Snapshot &pages = GetSnapshot(snapshot);
+    uint8_t *destination = static_cast<uint8_t *>(buffer);
+    uint64_t current = address;
+    uint64_t end = current + length;
+
+    while (current < end)
+    {
+        uint32_t pageAddress = static_cast<uint32_t>(current & ~static_cast<uint64_t>(m_PageSize - 1));
+        auto entry = std::lower_bound(pages.begin(), pages.end(), pageAddress, [](const PageEntry &entry, uint32_t address) {
+            return entry.Address < address;
+        });
+
+        if (entry == pages.end() || entry->Address != pageAddress)
+            throw std::invalid_argument("Memory at " + Utils::ToHexAddress(current) + " isn't part of the snapshot");
+
+        if (!entry->Content->Readable)
+            throw std::invalid_argument("Memory at " + Utils::ToHexAddress(current) + " wasn't readable when the snapshot was taken");
+
+        uint64_t offset = current - pageAddress;
+        uint64_t size = std::min<uint64_t>(m_PageSize - offset, end - current);
+        memcpy(destination, entry->Content->Content.data() + offset, static_cast<size_t>(size));
+
+        destination += size;
+        current += size;
+    }
+}
+
+const SnapshotStore::Snapshot &SnapshotStore::GetSnapshot(size_t index) const
+{
+    if (index >= m_Snapshots.size())
+        throw std::out_of_range("There is no snapshot " + std::to_string(index));
+
+    return m_Snapshots[index];
+}
+
+bool SnapshotStore::IsSamePage(const Page &left, const Page &right)
+{
+    // The hash rules out most differences, the content is still compared to not depend on
+    // the absence of collisions
+    return left.Readable == right.Readable && left.Hash == right.Hash && left.Content == right.Content;
+}
+
+}
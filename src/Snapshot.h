@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Console.h"
+
+namespace XBDM
+{
+
+// Keeps successive snapshots of memory regions of a console. Memory is split in pages which are
+// hashed when a snapshot is taken, a page that didn't change since the previous snapshot is
+// shared with it instead of being stored again, so that only the changed pages cost memory.
+class SnapshotStore
+{
+public:
+    SnapshotStore(uint32_t pageSize = 4096);
+
+    // Reads the regions, extended to whole pages, and returns the index of the new snapshot.
+    // Pages that aren't readable are part of the snapshot as unreadable pages.
+    size_t Take(Console &console, const std::vector<MemoryRange> &regions);
+
+    inline size_t GetSnapshotCount() const { return m_Snapshots.size(); }
+
+    // Ranges whose content differs between the two snapshots, made of whole pages. Pages
+    // only in one of the snapshots or only readable in one of them are different too.
+    std::vector<MemoryRange> Diff(size_t from, size_t to) const;
+
+    // Rebuilds memory as it was in a snapshot, throws std::invalid_argument if part of the
+    // range wasn't captured or wasn't readable
+    void Read(size_t snapshot, uint32_t address, uint32_t length, void *buffer) const;
+
+    // Memory taken by the content of the pages, each page being counted once
+    inline uint64_t GetStoredBytes() const { return m_StoredBytes; }
+
+    inline uint32_t GetPageSize() const { return m_PageSize; }
+
+private:
+    struct Page
+    {
+        uint64_t Hash = 0;
+        bool Readable = false;
+        std::vector<uint8_t> Content;
+    };
+
+    struct PageEntry
+    {
+        uint32_t Address = 0;
+        std::shared_ptr<const Page> Content;
+    };
+
+    // Sorted by address
+    using Snapshot = std::vector<PageEntry>;
+
+    uint32_t m_PageSize;
+    std::vector<Snapshot> m_Snapshots;
+    uint64_t m_StoredBytes = 0;
+
+    const Snapshot &GetSnapshot(size_t index) const;
+    static bool IsSamePage(const Page &left, const Page &right);
+};
+
+}
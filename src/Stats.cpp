@@ -0,0 +1,123 @@
+#include "pch.h"
+#include "Stats.h"
+
+namespace XBDM
+{
+
+std::chrono::nanoseconds CommandStats::MeanLatency() const
+{
+    if (Calls == 0)
+        return std::chrono::nanoseconds(0);
+
+    return TotalLatency / static_cast<int64_t>(Calls);
+}
+
+std::chrono::microseconds CommandStats::LatencyPercentile(double percentile) const
+{
+    uint64_t sampleCount = 0;
+    for (uint64_t count : LatencyHistogram)
+        sampleCount += count;
+
+    if (sampleCount == 0)
+        return std::chrono::microseconds(0);
+
+    // Rank of the sample at the given percentile, starting from 1
+    double clampedPercentile = std::clamp(percentile, 0.0, 100.0);
+    uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(clampedPercentile / 100.0 * static_cast<double>(sampleCount))), 1);
+
+    uint64_t seenSamples = 0;
+    for (size_t i = 0; i < LatencyHistogram.size(); i++)
+    {
+        seenSamples += LatencyHistogram[i];
+        if (seenSamples >= rank)
+            return std::chrono::microseconds(1ULL << (i + 1));
+    }
+
+    return std::chrono::microseconds(1ULL << LatencyHistogram.size());
+}
+
+size_t StatsRecorder::GetVerbIndex(const std::string &command)
+{
+    size_t verbLength = std::min(command.find(' '), command.size());
+
+    for (size_t i = 0; i < s_Verbs.size() - 1; i++)
+    {
+        if (command.compare(0, verbLength, s_Verbs[i]) == 0)
+            return i;
+    }
+
+    return s_Verbs.size() - 1;
+}
+
+void StatsRecorder::Record(size_t verbIndex, const Sample &sample)
+{
+    Counters &counters = m_Counters[verbIndex];
+
+    counters.Calls.fetch_add(1, std::memory_order_relaxed);
+    if (!sample.Success)
+        counters.Errors.fetch_add(1, std::memory_order_relaxed);
+
+    counters.BytesSent.fetch_add(sample.BytesSent, std::memory_order_relaxed);
+    counters.BytesReceived.fetch_add(sample.BytesReceived, std::memory_order_relaxed);
+    counters.TotalLatency.fetch_add(sample.Latency.count(), std::memory_order_relaxed);
+    counters.ReceiveTime.fetch_add(sample.ReceiveTime.count(), std::memory_order_relaxed);
+
+    // The bucket is the position of the highest bit set in the latency in microseconds
+    uint64_t microseconds = static_cast<uint64_t>(std::max<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(sample.Latency).count(), 0));
+    size_t bucket = 0;
+    while (microseconds > 1 && bucket < CommandStats::HistogramBucketCount - 1)
+    {
+        microseconds >>= 1;
+        bucket++;
+    }
+
+    counters.LatencyHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<CommandStats> StatsRecorder::GetSnapshot() const
+{
+    std::vector<CommandStats> snapshot;
+
+    for (size_t i = 0; i < s_Verbs.size(); i++)
+    {
+        const Counters &counters = m_Counters[i];
+
+        uint64_t calls = counters.Calls.load(std::memory_order_relaxed);
+        if (calls == 0)
+            continue;
+
+        CommandStats stats;
+        stats.Name = s_Verbs[i];
+        stats.Calls = calls;
+        stats.Errors = counters.Errors.load(std::memory_order_relaxed);
+        stats.BytesSent = counters.BytesSent.load(std::memory_order_relaxed);
+        stats.BytesReceived = counters.BytesReceived.load(std::memory_order_relaxed);
+        stats.TotalLatency = std::chrono::nanoseconds(counters.TotalLatency.load(std::memory_order_relaxed));
+        stats.ReceiveTime = std::chrono::nanoseconds(counters.ReceiveTime.load(std::memory_order_relaxed));
+
+        for (size_t j = 0; j < stats.LatencyHistogram.size(); j++)
+            stats.LatencyHistogram[j] = counters.LatencyHistogram[j].load(std::memory_order_relaxed);
+
+        snapshot.push_back(stats);
+    }
+
+    return snapshot;
+}
+
+void StatsRecorder::Reset()
+{
+    for (Counters &counters : m_Counters)
+    {
+        counters.Calls.store(0, std::memory_order_relaxed);
+        counters.Errors.store(0, std::memory_order_relaxed);
+        counters.BytesSent.store(0, std::memory_order_relaxed);
+        counters.BytesReceived.store(0, std::memory_order_relaxed);
+        counters.TotalLatency.store(0, std::memory_order_relaxed);
+        counters.ReceiveTime.store(0, std::memory_order_relaxed);
+
+        for (auto &count : counters.LatencyHistogram)
+            count.store(0, std::memory_order_relaxed);
+    }
+}
+
+}
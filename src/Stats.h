@@ -0,0 +1,95 @@
+#pragma once
+
+namespace XBDM
+{
+
+// Metrics of a single command verb (dirlist, getfile...), as returned by Console::GetStats
+struct CommandStats
+{
+    // Latencies are counted in buckets of powers of 2 microseconds, bucket i holding the
+    // latencies between 2^i (0 for the first bucket) and 2^(i + 1) microseconds
+    static const size_t HistogramBucketCount = 32;
+
+    std::string Name;
+    uint64_t Calls = 0;
+    uint64_t Errors = 0;
+    uint64_t BytesSent = 0;
+    uint64_t BytesReceived = 0;
+
+    // Time between sending the command and receiving the end of the response
+    std::chrono::nanoseconds TotalLatency = std::chrono::nanoseconds(0);
+
+    // Part of TotalLatency spent waiting in recv
+    std::chrono::nanoseconds ReceiveTime = std::chrono::nanoseconds(0);
+
+    std::array<uint64_t, HistogramBucketCount> LatencyHistogram = {};
+
+    std::chrono::nanoseconds MeanLatency() const;
+
+    // Upper bound of the bucket containing the given percentile (between 0 and 100)
+    std::chrono::microseconds LatencyPercentile(double percentile) const;
+};
+
+// Per-verb counters updated by the console after each command. Updates only use relaxed
+// atomic operations so reading a snapshot from another thread never blocks the console,
+// the counters of a snapshot might just not all be from the exact same instant.
+class StatsRecorder
+{
+public:
+    struct Sample
+    {
+        std::chrono::nanoseconds Latency = std::chrono::nanoseconds(0);
+        std::chrono::nanoseconds ReceiveTime = std::chrono::nanoseconds(0);
+        uint64_t BytesSent = 0;
+        uint64_t BytesReceived = 0;
+        bool Success = true;
+    };
+
+    // Returns the index to pass to Record for the verb the command starts with
+    static size_t GetVerbIndex(const std::string &command);
+
+    void Record(size_t verbIndex, const Sample &sample);
+
+    // Only contains the verbs that were called at least once
+    std::vector<CommandStats> GetSnapshot() const;
+
+    void Reset();
+
+private:
+    struct Counters
+    {
+        std::atomic<uint64_t> Calls = 0;
+        std::atomic<uint64_t> Errors = 0;
+        std::atomic<uint64_t> BytesSent = 0;
+        std::atomic<uint64_t> BytesReceived = 0;
+        std::atomic<int64_t> TotalLatency = 0;
+        std::atomic<int64_t> ReceiveTime = 0;
+        std::array<std::atomic<uint64_t>, CommandStats::HistogramBucketCount> LatencyHistogram = {};
+    };
+
+    // The verbs sent by Console, anything else is counted under "other"
+    static constexpr std::array<const char *, 18> s_Verbs = {
+        "dbgname",
+        "drivelist",
+        "drivefreespace",
+        "dirlist",
+        "getfileattributes",
+        "magicboot",
+        "xbeinfo",
+        "consoletype",
+        "setsystime",
+        "getfile",
+        "sendfile",
+        "delete",
+        "mkdir",
+        "rename",
+        "getmemex",
+        "setmem",
+        "screenshot",
+        "other",
+    };
+
+    std::array<Counters, s_Verbs.size()> m_Counters;
+};
+
+}
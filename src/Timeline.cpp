@@ -0,0 +1,151 @@
+#include "pch.h"
+#include "Timeline.h"
+
+namespace XBDM
+{
+
+Timeline::ScopedSpan::ScopedSpan(Timeline *timeline, uint32_t track, const char *name, const std::string &detail)
+    : m_Timeline(timeline), m_Track(track), m_Name(name)
+{
+    if (m_Timeline == nullptr)
+        return;
+
+    m_Detail = detail;
+    m_Start = Clock::now();
+}
+
+Timeline::ScopedSpan::~ScopedSpan()
+{
+    if (m_Timeline == nullptr)
+        return;
+
+    m_Timeline->AddSpan({ m_Name, "operation", m_Detail, m_Track, m_Start, Clock::now() });
+}
+
+Timeline::Timeline()
+    : m_Origin(Clock::now())
+{
+}
+
+uint32_t Timeline::AddTrack(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_Tracks.push_back(name);
+
+    // Track 0 is left unused because some viewers treat it as a special thread
+    return static_cast<uint32_t>(m_Tracks.size());
+}
+
+void Timeline::AddSpan(Span span)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_Spans.push_back(std::move(span));
+}
+
+std::vector<Timeline::Span> Timeline::GetSpans() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    return m_Spans;
+}
+
+void Timeline::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_Spans.clear();
+}
+
+static std::string EscapeJson(const std::string &string)
+{
+    std::ostringstream escaped;
+
+    for (char character : string)
+    {
+        switch (character)
+        {
+        case '"':
+            escaped << "\\\"";
+            break;
+        case '\\':
+            escaped << "\\\\";
+            break;
+        case '\n':
+            escaped << "\\n";
+            break;
+        case '\r':
+            escaped << "\\r";
+            break;
+        case '\t':
+            escaped << "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(character) < 0x20)
+                escaped << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(character) << std::dec;
+            else
+                escaped << character;
+        }
+    }
+
+    return escaped.str();
+}
+
+void Timeline::WriteChromeTrace(std::ostream &stream) const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    auto toMicroseconds = [](Clock::duration duration) {
+        return std::chrono::duration<double, std::micro>(duration).count();
+    };
+
+    // Formatted apart so that the state of the caller's stream (base, precision, locale...)
+    // neither affects the JSON nor gets changed
+    std::ostringstream json;
+    json.imbue(std::locale::classic());
+
+    json << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    // Metadata events naming the tracks
+    for (size_t i = 0; i < m_Tracks.size(); i++)
+    {
+        json << (i > 0 ? ",\n" : "\n");
+        json << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i + 1;
+        json << ",\"args\":{\"name\":\"" << EscapeJson(m_Tracks[i]) << "\"}}";
+    }
+
+    json << std::fixed << std::setprecision(3);
+
+    // Complete events, spans of the same track are nested by the viewers based on their times
+    for (size_t i = 0; i < m_Spans.size(); i++)
+    {
+        const Span &span = m_Spans[i];
+
+        json << (i > 0 || !m_Tracks.empty() ? ",\n" : "\n");
+        json << "{\"name\":\"" << EscapeJson(span.Name) << "\",\"cat\":\"" << EscapeJson(span.Category) << "\"";
+        json << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << span.Track;
+        json << ",\"ts\":" << toMicroseconds(span.Start - m_Origin) << ",\"dur\":" << toMicroseconds(span.End - span.Start);
+
+        if (!span.Detail.empty())
+            json << ",\"args\":{\"detail\":\"" << EscapeJson(span.Detail) << "\"}";
+
+        json << '}';
+    }
+
+    json << "\n]}\n";
+
+    std::string content = json.str();
+    stream.write(content.data(), static_cast<std::streamsize>(content.size()));
+}
+
+void Timeline::SaveChromeTrace(const std::filesystem::path &path) const
+{
+    std::ofstream file(path);
+    if (file.fail())
+        throw std::runtime_error("Couldn't create timeline file: " + path.string());
+
+    WriteChromeTrace(file);
+}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+namespace XBDM
+{
+
+// Collects spans of time from one or several consoles (see Console::SetTimeline) to show
+// them on a timeline, each console getting its own track. Spans can be added from several
+// threads at the same time.
+class Timeline
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Span
+    {
+        std::string Name;
+
+        // "operation" for the public methods of Console, "command" for the commands they send
+        // and "phase" for the parts of a command (send, wait and transfer)
+        std::string Category;
+
+        std::string Detail;
+        uint32_t Track = 0;
+        Clock::time_point Start;
+        Clock::time_point End;
+    };
+
+    // Adds a span from its construction to its destruction, does nothing without a timeline
+    class ScopedSpan
+    {
+    public:
+        ScopedSpan(Timeline *timeline, uint32_t track, const char *name, const std::string &detail = std::string());
+        ~ScopedSpan();
+
+        ScopedSpan(const ScopedSpan &) = delete;
+        ScopedSpan &operator=(const ScopedSpan &) = delete;
+
+    private:
+        Timeline *m_Timeline;
+        uint32_t m_Track;
+        const char *m_Name;
+        std::string m_Detail;
+        Clock::time_point m_Start;
+    };
+
+    Timeline();
+
+    // Returns the identifier of a new track shown under name
+    uint32_t AddTrack(const std::string &name);
+
+    void AddSpan(Span span);
+
+    std::vector<Span> GetSpans() const;
+
+    void Clear();
+
+    // Writes the spans in the trace event format of chrome://tracing and Perfetto
+    void WriteChromeTrace(std::ostream &stream) const;
+
+    // Throws if the file can't be created
+    void SaveChromeTrace(const std::filesystem::path &path) const;
+
+private:
+    mutable std::mutex m_Mutex;
+    Clock::time_point m_Origin;
+    std::vector<std::string> m_Tracks;
+    std::vector<Span> m_Spans;
+};
+
+}
@@ -0,0 +1,126 @@
+#include "pch.h"
+#include "Trace.h"
+
+namespace XBDM
+{
+
+static const char s_TraceMagic[] = "XBDMTRACE";
+static const uint8_t s_TraceVersion = 1;
+
+void TraceWriter::Open(const std::filesystem::path &path)
+{
+    Close();
+
+    m_File.open(path, std::ofstream::binary);
+    if (m_File.fail())
+        throw std::runtime_error("Couldn't create trace file: " + path.string());
+
+    m_File.write(s_TraceMagic, sizeof(s_TraceMagic) - 1);
+    m_File.put(static_cast<char>(s_TraceVersion));
+
+    m_Start = std::chrono::steady_clock::now();
+    m_LastTimestamp = std::chrono::microseconds(0);
+}
+
+void TraceWriter::Close()
+{
+    if (m_File.is_open())
+        m_File.close();
+}
+
+void TraceWriter::Write(TraceEvent::Type type, const char *data, size_t length)
+{
+    if (!m_File.is_open())
+        return;
+
+    auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_Start);
+
+    m_File.put(static_cast<char>(type));
+    WriteVarint(static_cast<uint64_t>((timestamp - m_LastTimestamp).count()));
+    WriteVarint(length);
+    m_File.write(data, static_cast<std::streamsize>(length));
+
+    m_LastTimestamp = timestamp;
+}
+
+void TraceWriter::WriteVarint(uint64_t value)
+{
+    // 7 bits per byte, the high bit is set on every byte but the last one
+    while (value >= 0x80)
+    {
+        m_File.put(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+
+    m_File.put(static_cast<char>(value));
+}
+
+static uint64_t ReadVarint(std::ifstream &file)
+{
+    uint64_t value = 0;
+
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        int byte = file.get();
+        if (byte == EOF)
+            throw std::runtime_error("Truncated trace");
+
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+
+    throw std::runtime_error("Invalid varint in trace");
+}
+
+std::vector<TraceEvent> ReadTrace(const std::filesystem::path &path)
+{
+    std::ifstream file(path, std::ifstream::binary);
+    if (file.fail())
+        throw std::runtime_error("Couldn't open trace file: " + path.string());
+
+    char magic[sizeof(s_TraceMagic) - 1] = { 0 };
+    file.read(magic, sizeof(magic));
+    if (file.gcount() != sizeof(magic) || memcmp(magic, s_TraceMagic, sizeof(magic)) != 0)
+        throw std::runtime_error("Not a trace file: " + path.string());
+
+    if (file.get() != s_TraceVersion)
+        throw std::runtime_error("Unsupported trace version: " + path.string());
+
+    // The lengths in the file are checked against its size before anything is allocated for them
+    std::streampos dataStart = file.tellg();
+    file.seekg(0, file.end);
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    file.seekg(dataStart);
+
+    std::vector<TraceEvent> events;
+    std::chrono::microseconds timestamp(0);
+
+    for (int type = file.get(); type != EOF; type = file.get())
+    {
+        if (type > static_cast<int>(TraceEvent::Type::Received))
+            throw std::runtime_error("Invalid event type in trace");
+
+        TraceEvent event;
+        event.EventType = static_cast<TraceEvent::Type>(type);
+
+        timestamp += std::chrono::microseconds(ReadVarint(file));
+        event.Timestamp = timestamp;
+
+        uint64_t length = ReadVarint(file);
+        if (length > fileSize - static_cast<uint64_t>(file.tellg()))
+            throw std::runtime_error("Truncated trace");
+
+        event.Data.resize(static_cast<size_t>(length));
+        file.read(event.Data.data(), static_cast<std::streamsize>(length));
+        if (static_cast<uint64_t>(file.gcount()) != length)
+            throw std::runtime_error("Truncated trace");
+
+        events.push_back(std::move(event));
+    }
+
+    return events;
+}
+
+}
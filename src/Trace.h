@@ -0,0 +1,50 @@
+#pragma once
+
+namespace XBDM
+{
+
+// What happened on the connection of a recorded session (see Console::StartRecording)
+struct TraceEvent
+{
+    enum class Type : uint8_t
+    {
+        // The connection was opened, everything until the next Connected event happened on it
+        Connected,
+        Sent,
+        Received,
+    };
+
+    Type EventType = Type::Connected;
+
+    // Time since the start of the recording
+    std::chrono::microseconds Timestamp = std::chrono::microseconds(0);
+
+    std::string Data;
+};
+
+// Writes traces in a compact binary format: a header made of the "XBDMTRACE" magic and a
+// version byte, then each event as its type byte, the time since the previous event and the
+// size of its data both as LEB128 varints, and its data.
+class TraceWriter
+{
+public:
+    // Throws if the file can't be created
+    void Open(const std::filesystem::path &path);
+    void Close();
+
+    inline bool IsOpen() const { return m_File.is_open(); }
+
+    void Write(TraceEvent::Type type, const char *data, size_t length);
+
+private:
+    std::ofstream m_File;
+    std::chrono::steady_clock::time_point m_Start;
+    std::chrono::microseconds m_LastTimestamp = std::chrono::microseconds(0);
+
+    void WriteVarint(uint64_t value);
+};
+
+// Throws if the file can't be read or is not a valid trace
+std::vector<TraceEvent> ReadTrace(const std::filesystem::path &path);
+
+}
@@ -0,0 +1,159 @@
+#include "pch.h"
+#include "Transfer.h"
+
+namespace XBDM
+{
+
+CancellationToken::CancellationToken()
+    : m_Cancelled(std::make_shared<std::atomic<bool>>(false))
+{
+}
+
+void CancellationToken::Cancel()
+{
+    m_Cancelled->store(true, std::memory_order_relaxed);
+}
+
+bool CancellationToken::IsCancelled() const
+{
+    return m_Cancelled->load(std::memory_order_relaxed);
+}
+
+TransferTracker::TransferTracker(const TransferOptions &options)
+    : m_Options(options), m_Start(Clock::now()), m_LastReport(m_Start)
+{
+}
+
+void TransferTracker::SetTotalBytes(uint64_t totalBytes)
+{
+    m_Progress.TotalBytes = totalBytes;
+    m_TotalKnown = true;
+}
+
+void TransferTracker::BeginFile(const std::string &remotePath, const std::filesystem::path &localPath)
+{
+    if (m_Options.ProgressCallback)
+        m_Progress.RemotePath = remotePath;
+
+    m_CurrentFile = FileDigest();
+    m_CurrentFile.RemotePath = remotePath;
+    m_CurrentFile.LocalPath = localPath;
+
+    m_Crc32c = Crc32c();
+    m_XxHash64 = XxHash64();
+    m_Sha256 = Sha256();
+}
+
+void TransferTracker::Add(const char *data, size_t length)
+{
+    m_Progress.BytesTransferred += length;
+    m_CurrentFile.Size += length;
+
+    if (HasChecksum(m_Options.Checksums, ChecksumType::Crc32c))
+        m_Crc32c.Update(data, length);
+
+    if (HasChecksum(m_Options.Checksums, ChecksumType::XxHash64))
+        m_XxHash64.Update(data, length);
+
+    if (HasChecksum(m_Options.Checksums, ChecksumType::Sha256))
+        m_Sha256.Update(data, length);
+
+    // Without a callback, counting the bytes is the only cost
+    if (!m_Options.ProgressCallback)
+        return;
+
+    Clock::time_point now = Clock::now();
+    if (now - m_LastReport >= m_Options.ProgressInterval)
+        Report(now);
+}
+
+void TransferTracker::EndFile()
+{
+    if (HasChecksum(m_Options.Checksums, ChecksumType::Crc32c))
+        m_CurrentFile.Crc32c = m_Crc32c.Finish();
+
+    if (HasChecksum(m_Options.Checksums, ChecksumType::XxHash64))
+        m_CurrentFile.XxHash64 = m_XxHash64.Finish();
+
+    if (HasChecksum(m_Options.Checksums, ChecksumType::Sha256))
+        m_CurrentFile.Sha256 = m_Sha256.Finish();
+
+    m_Result.Files.push_back(std::move(m_CurrentFile));
+}
+
+TransferResult TransferTracker::Finish()
+{
+    if (m_Options.ProgressCallback)
+        Report(Clock::now());
+
+    if (!m_Options.ManifestPath.empty())
+        WriteManifest();
+
+    m_Result.BytesTransferred = m_Progress.BytesTransferred;
+
+    return std::move(m_Result);
+}
+
+void TransferTracker::Report(Clock::time_point now)
+{
+    auto toSeconds = [](Clock::duration duration) {
+        return std::chrono::duration<double>(duration).count();
+    };
+
+    double secondsSinceLastReport = toSeconds(now - m_LastReport);
+    double secondsSinceStart = toSeconds(now - m_Start);
+
+    if (secondsSinceLastReport > 0.0)
+        m_Progress.InstantaneousBytesPerSecond = static_cast<double>(m_Progress.BytesTransferred - m_BytesAtLastReport) / secondsSinceLastReport;
+
+    if (secondsSinceStart > 0.0)
+        m_Progress.AverageBytesPerSecond = static_cast<double>(m_Progress.BytesTransferred) / secondsSinceStart;
+
+    m_Progress.Elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_Start);
+
+    // The estimation assumes the rest of the transfer goes at the average speed so far
+    uint64_t remainingBytes = m_Progress.TotalBytes > m_Progress.BytesTransferred ? m_Progress.TotalBytes - m_Progress.BytesTransferred : 0;
+    if (m_Progress.AverageBytesPerSecond > 0.0)
+        m_Progress.EstimatedTimeRemaining = std::chrono::milliseconds(static_cast<int64_t>(static_cast<double>(remainingBytes) / m_Progress.AverageBytesPerSecond * 1000.0));
+    else
+        m_Progress.EstimatedTimeRemaining = std::chrono::milliseconds(0);
+
+    m_LastReport = now;
+    m_BytesAtLastReport = m_Progress.BytesTransferred;
+
+    m_Options.ProgressCallback(m_Progress);
+}
+
+void TransferTracker::WriteManifest() const
+{
+    std::ofstream manifest(m_Options.ManifestPath);
+    if (manifest.fail())
+        throw std::runtime_error("Couldn't create manifest file: " + m_Options.ManifestPath.string());
+
+    manifest << std::hex << std::setfill('0');
+
+    // Same tags as the BSD style output of the usual tools (sha256sum --tag, xxhsum)
+    for (const FileDigest &file : m_Result.Files)
+    {
+        std::string path = file.LocalPath.generic_string();
+
+        if (HasChecksum(m_Options.Checksums, ChecksumType::Crc32c))
+            manifest << "CRC32C (" << path << ") = " << std::setw(8) << file.Crc32c << '\n';
+
+        if (HasChecksum(m_Options.Checksums, ChecksumType::XxHash64))
+            manifest << "XXH64 (" << path << ") = " << std::setw(16) << file.XxHash64 << '\n';
+
+        if (HasChecksum(m_Options.Checksums, ChecksumType::Sha256))
+        {
+            manifest << "SHA256 (" << path << ") = ";
+            for (uint8_t byte : file.Sha256)
+                manifest << std::setw(2) << static_cast<int>(byte);
+            manifest << '\n';
+        }
+    }
+
+    if (manifest.fail())
+        throw std::runtime_error("Couldn't write manifest file: " + m_Options.ManifestPath.string());
+}
+
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "Checksum.h"
+
+namespace XBDM
+{
+
+struct TransferProgress
+{
+    // File being transferred when the progress was reported
+    std::string RemotePath;
+
+    uint64_t BytesTransferred = 0;
+    uint64_t TotalBytes = 0;
+
+    // Throughput since the previous report and since the start of the transfer
+    double InstantaneousBytesPerSecond = 0.0;
+    double AverageBytesPerSecond = 0.0;
+
+    std::chrono::milliseconds Elapsed = std::chrono::milliseconds(0);
+    std::chrono::milliseconds EstimatedTimeRemaining = std::chrono::milliseconds(0);
+};
+
+// Copies share the same state so a copy can be given to a transfer and the original cancelled
+// from another thread
+class CancellationToken
+{
+public:
+    CancellationToken();
+
+    void Cancel();
+    bool IsCancelled() const;
+
+private:
+    std::shared_ptr<std::atomic<bool>> m_Cancelled;
+};
+
+// Checksums computed on the bytes of each file as they are transferred, can be combined with |
+enum class ChecksumType : uint32_t
+{
+    None = 0,
+    Crc32c = 1 << 0,
+    XxHash64 = 1 << 1,
+    Sha256 = 1 << 2,
+};
+
+inline ChecksumType operator|(ChecksumType left, ChecksumType right)
+{
+    return static_cast<ChecksumType>(static_cast<uint32_t>(left) | static_cast<uint32_t>(right));
+}
+
+inline bool HasChecksum(ChecksumType checksums, ChecksumType checksum)
+{
+    return (static_cast<uint32_t>(checksums) & static_cast<uint32_t>(checksum)) != 0;
+}
+
+struct TransferOptions
+{
+    // Called from the thread running the transfer, at most once per ProgressInterval and
+    // always once at the end
+    std::function<void(const TransferProgress &)> ProgressCallback;
+    std::chrono::milliseconds ProgressInterval = std::chrono::milliseconds(100);
+
+    CancellationToken Cancellation;
+
+    // Nothing is computed unless asked for, CRC32C is the cheapest as it's hardware accelerated
+    // on most CPUs
+    ChecksumType Checksums = ChecksumType::None;
+
+    // When set, the checksums of every file are written to this file once the transfer
+    // succeeds, one "<ALGORITHM> (<local path>) = <hex>" line per checksum
+    std::filesystem::path ManifestPath;
+};
+
+// Only the checksums requested in the options are set
+struct FileDigest
+{
+    std::string RemotePath;
+    std::filesystem::path LocalPath;
+    uint64_t Size = 0;
+
+    uint32_t Crc32c = 0;
+    uint64_t XxHash64 = 0;
+    std::array<uint8_t, 32> Sha256 = {};
+};
+
+struct TransferResult
+{
+    uint64_t BytesTransferred = 0;
+
+    // In the order the files were transferred
+    std::vector<FileDigest> Files;
+};
+
+// Thrown when a transfer is cancelled through its CancellationToken. The connection is still
+// usable afterwards and the partially transferred file has been removed.
+class OperationCancelled : public std::runtime_error
+{
+public:
+    OperationCancelled(const std::string &message)
+        : std::runtime_error(message) {}
+};
+
+// Keeps track of the bytes transferred by a file or directory transfer, reports them
+// through the progress callback of the options and checksums them file by file
+class TransferTracker
+{
+public:
+    TransferTracker(const TransferOptions &options);
+
+    // The total is unknown until it's set, single file transfers set it when they
+    // learn the size of the file
+    void SetTotalBytes(uint64_t totalBytes);
+    inline bool IsTotalKnown() const { return m_TotalKnown; }
+
+    // Every byte added between BeginFile and EndFile is part of the digest of that file,
+    // a file that is begun but never ended isn't part of the result
+    void BeginFile(const std::string &remotePath, const std::filesystem::path &localPath);
+    void Add(const char *data, size_t length);
+    void EndFile();
+
+    // Reports the final progress and writes the manifest
+    TransferResult Finish();
+
+    inline bool IsCancelled() const { return m_Options.Cancellation.IsCancelled(); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    const TransferOptions &m_Options;
+    TransferProgress m_Progress;
+    bool m_TotalKnown = false;
+    TransferResult m_Result;
+    FileDigest m_CurrentFile;
+    Crc32c m_Crc32c;
+    XxHash64 m_XxHash64;
+    Sha256 m_Sha256;
+    Clock::time_point m_Start;
+    Clock::time_point m_LastReport;
+    uint64_t m_BytesAtLastReport = 0;
+
+    void Report(Clock::time_point now);
+    void WriteManifest() const;
+};
+
+}
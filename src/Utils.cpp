@@ -6,6 +6,14 @@ namespace XBDM
 namespace Utils
 {
 
+std::string ToHexAddress(uint64_t address)
+{
+    std::stringstream stream;
+    stream << "0x" << std::hex << std::setw(8) << std::setfill('0') << address;
+
+    return stream.str();
+}
+
 bool String::EndsWith(const std::string &line, const std::string &ending)
 {
     if (ending.size() > line.size())
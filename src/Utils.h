@@ -5,6 +5,9 @@ namespace XBDM
 namespace Utils
 {
 
+// "0x" followed by at least 8 hexadecimal digits, the way memory addresses are reported
+std::string ToHexAddress(uint64_t address);
+
 namespace String
 {
 
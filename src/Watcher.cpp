@@ -0,0 +1,188 @@
+#include "pch.h"
+#include "Watcher.h"
+
+namespace XBDM
+{
+
+uint32_t WatchSample::GetUInt32(size_t offset) const
+{
+    if (offset + sizeof(uint32_t) > Size)
+        throw std::out_of_range("Reading past the end of the sample");
+
+    return (static_cast<uint32_t>(Data[offset]) << 24) | (static_cast<uint32_t>(Data[offset + 1]) << 16) | (static_cast<uint32_t>(Data[offset + 2]) << 8) | Data[offset + 3];
+}
+
+float WatchSample::GetFloat(size_t offset) const
+{
+    uint32_t bits = GetUInt32(offset);
+    float value = 0.0f;
+    memcpy(&value, &bits, sizeof(value));
+
+    return value;
+}
+
+MemoryWatcher::MemoryWatcher(const Console &console, size_t capacity)
+    : m_Console(console.GetIpAddress(), console.GetPort()), m_Samples(capacity)
+{
+    m_Console.SetTimeout(console.GetTimeout());
+    m_Console.SetReconnectPolicy(console.GetReconnectPolicy());
+}
+
+MemoryWatcher::~MemoryWatcher()
+{
+    Stop();
+}
+
+size_t MemoryWatcher::Watch(uint32_t address, uint32_t size)
+{
+    if (IsRunning())
+        throw std::logic_error("Watches can't be added while the watcher is running");
+
+    if (size == 0 || size > WatchSample::s_MaxSize)
+        throw std::invalid_argument("Watches are between 1 and " + std::to_string(WatchSample::s_MaxSize) + " bytes");
+
+    m_Watches.push_back({ address, size });
+
+    return m_Watches.size() - 1;
+}
+
+void MemoryWatcher::Start(std::chrono::microseconds period)
+{
+    if (IsRunning())
+        throw std::logic_error("The watcher is already running");
+
+    if (period.count() <= 0)
+        throw std::invalid_argument("The period must be positive");
+
+    if (!m_Console.IsConnected() && !m_Console.OpenConnection())
+        throw std::runtime_error("Couldn't connect to " + m_Console.GetIpAddress());
+
+    m_StopRequested = false;
+    m_Thread = std::thread(&MemoryWatcher::Sample, this, period);
+}
+
+void MemoryWatcher::Stop()
+{
+    if (!IsRunning())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_StopMutex);
+        m_StopRequested = true;
+    }
+
+    m_StopCondition.notify_all();
+    m_Thread.join();
+}
+
+WatchStats MemoryWatcher::GetStats() const
+{
+    WatchStats stats;
+    stats.Ticks = m_Ticks.load();
+    stats.FailedTicks = m_FailedTicks.load();
+    stats.MissedDeadlines = m_MissedDeadlines.load();
+    stats.DroppedSamples = m_DroppedSamples.load();
+    stats.MaxJitter = std::chrono::microseconds(m_MaxJitter.load());
+    stats.MaxReadTime = std::chrono::microseconds(m_MaxReadTime.load());
+
+    if (stats.Ticks > 0)
+    {
+        stats.MeanJitter = std::chrono::microseconds(m_TotalJitter.load() / stats.Ticks);
+        stats.MeanReadTime = std::chrono::microseconds(m_TotalReadTime.load() / stats.Ticks);
+    }
+
+    return stats;
+}
+
+void MemoryWatcher::Sample(std::chrono::microseconds period)
+{
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<std::array<uint8_t, WatchSample::s_MaxSize>> buffers(m_Watches.size());
+    std::vector<MemoryRead> reads(m_Watches.size());
+
+    auto elapsedMicroseconds = [](Clock::time_point from, Clock::time_point to) {
+        return static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(to - from).count()));
+    };
+
+    auto updateMax = [](std::atomic<uint64_t> &max, uint64_t value) {
+        if (value > max.load(std::memory_order_relaxed))
+            max.store(value, std::memory_order_relaxed);
+    };
+
+    Clock::time_point deadline = Clock::now();
+    uint64_t tick = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_StopMutex);
+            if (m_StopCondition.wait_until(lock, deadline, [this]() { return m_StopRequested; }))
+                return;
+        }
+
+        Clock::time_point start = Clock::now();
+        uint64_t jitter = elapsedMicroseconds(deadline, start);
+
+        for (size_t i = 0; i < reads.size(); i++)
+        {
+            reads[i].Address = m_Watches[i].Address;
+            reads[i].Length = m_Watches[i].Length;
+            reads[i].Buffer = buffers[i].data();
+            reads[i].Succeeded = false;
+        }
+
+        bool failed = false;
+        try
+        {
+            m_Console.ReadMemory(reads);
+        }
+        catch (const std::exception &)
+        {
+            failed = true;
+        }
+
+        Clock::time_point end = Clock::now();
+        uint64_t readTime = elapsedMicroseconds(start, end);
+
+        if (failed)
+            m_FailedTicks++;
+        else
+        {
+            for (size_t i = 0; i < reads.size(); i++)
+            {
+                const MemoryRead &read = reads[i];
+                WatchSample sample;
+                sample.Tick = tick;
+                sample.Time = start;
+                sample.WatchId = i;
+                sample.Address = read.Address;
+                sample.Size = read.Length;
+                sample.Readable = read.Succeeded;
+                memcpy(sample.Data.data(), read.Buffer, read.Length);
+
+                if (!m_Samples.TryPush(sample))
+                    m_DroppedSamples++;
+            }
+        }
+
+        m_TotalJitter += jitter;
+        updateMax(m_MaxJitter, jitter);
+        m_TotalReadTime += readTime;
+        updateMax(m_MaxReadTime, readTime);
+        m_Ticks++;
+        tick++;
+
+        // When the tick overran the period, the deadlines that already passed are skipped so that
+        // the sampler doesn't try to catch up with a burst of ticks
+        deadline += period;
+        if (deadline < end)
+        {
+            auto missed = (end - deadline) / period + 1;
+            m_MissedDeadlines += static_cast<uint64_t>(missed);
+            deadline += missed * period;
+        }
+    }
+}
+
+}
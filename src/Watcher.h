@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Console.h"
+#include "RingBuffer.h"
+
+namespace XBDM
+{
+
+struct WatchSample
+{
+    static constexpr size_t s_MaxSize = 64;
+
+    // Index of the tick the sample was taken at, all the watches are sampled at each tick
+    uint64_t Tick = 0;
+    std::chrono::steady_clock::time_point Time;
+    size_t WatchId = 0;
+    uint32_t Address = 0;
+    uint32_t Size = 0;
+    bool Readable = false;
+    std::array<uint8_t, s_MaxSize> Data = {};
+
+    // Values are big-endian on the console
+    uint32_t GetUInt32(size_t offset = 0) const;
+    float GetFloat(size_t offset = 0) const;
+};
+
+struct WatchStats
+{
+    uint64_t Ticks = 0;
+
+    // Ticks whose memory couldn't be read, e.g. because the connection was lost
+    uint64_t FailedTicks = 0;
+
+    // Ticks skipped because the previous one took longer than the period
+    uint64_t MissedDeadlines = 0;
+
+    // Samples lost because the consumer didn't keep up and the ring buffer was full
+    uint64_t DroppedSamples = 0;
+
+    // Delay between when a tick was scheduled and when it started
+    std::chrono::microseconds MeanJitter = std::chrono::microseconds(0);
+    std::chrono::microseconds MaxJitter = std::chrono::microseconds(0);
+
+    // Time to read the watched memory, about one round trip
+    std::chrono::microseconds MeanReadTime = std::chrono::microseconds(0);
+    std::chrono::microseconds MaxReadTime = std::chrono::microseconds(0);
+};
+
+// Samples a set of memory locations at a fixed rate on its own thread and connection to the
+// console. All the watches are read with a single batched ReadMemory per tick and the samples
+// are pushed to a ring buffer that the consumer drains with Poll, without ever blocking the sampler.
+class MemoryWatcher
+{
+public:
+    // Connects to the same console as console when started, with its timeout and reconnection
+    // policy. console itself isn't used.
+    MemoryWatcher(const Console &console, size_t capacity = 4096);
+    ~MemoryWatcher();
+
+    MemoryWatcher(const MemoryWatcher &) = delete;
+    MemoryWatcher &operator=(const MemoryWatcher &) = delete;
+
+    // Returns the id of the watch, which is in its samples. Watches are added before Start and
+    // are at most WatchSample::s_MaxSize bytes.
+    size_t Watch(uint32_t address, uint32_t size);
+
+    // Throws std::runtime_error if the console can't be reached
+    void Start(std::chrono::microseconds period);
+    void Stop();
+
+    inline bool IsRunning() const { return m_Thread.joinable(); }
+
+    // Consumer side, returns false when there is no sample to read. Must only be called from one thread.
+    inline bool Poll(WatchSample &sample) { return m_Samples.TryPop(sample); }
+
+    // Can be called from any thread
+    WatchStats GetStats() const;
+
+    // Stats of the commands sent by the sampler
+    inline std::vector<CommandStats> GetCommandStats() const { return m_Console.GetStats(); }
+
+private:
+    Console m_Console;
+    std::vector<MemoryRange> m_Watches;
+    RingBuffer<WatchSample> m_Samples;
+
+    std::thread m_Thread;
+    std::mutex m_StopMutex;
+    std::condition_variable m_StopCondition;
+    bool m_StopRequested = false;
+
+    // Only written by the sampler
+    std::atomic<uint64_t> m_Ticks = 0;
+    std::atomic<uint64_t> m_FailedTicks = 0;
+    std::atomic<uint64_t> m_MissedDeadlines = 0;
+    std::atomic<uint64_t> m_DroppedSamples = 0;
+    std::atomic<uint64_t> m_TotalJitter = 0;
+    std::atomic<uint64_t> m_MaxJitter = 0;
+    std::atomic<uint64_t> m_TotalReadTime = 0;
+    std::atomic<uint64_t> m_MaxReadTime = 0;
+
+    void Sample(std::chrono::microseconds period);
+};
+
+}
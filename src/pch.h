@@ -8,6 +8,7 @@
     #include <cstring>
     #include <netdb.h>
     #include <unistd.h>
+    #include <sys/select.h>
 #endif
 
 #include <string>
@@ -17,5 +18,17 @@
 #include <filesystem>
 #include <exception>
 #include <set>
+#include <map>
 #include <chrono>
 #include <thread>
+#include <algorithm>
+#include <atomic>
+#include <array>
+#include <cmath>
+#include <mutex>
+#include <memory>
+#include <iomanip>
+#include <functional>
+#include <future>
+#include <condition_variable>
+#include <unordered_map>
@@ -0,0 +1,119 @@
+#include "DiskStorage.h"
+
+#include <fstream>
+#include <algorithm>
+
+namespace fs = std::filesystem;
+
+class DiskFileWriter : public Storage::FileWriter
+{
+public:
+    DiskFileWriter(const fs::path &path)
+        : m_File(path, std::ofstream::binary) {}
+
+    bool IsOpen() const { return !m_File.fail(); }
+
+    bool Write(const char *buffer, size_t length) override
+    {
+        m_File.write(buffer, static_cast<std::streamsize>(length));
+
+        return !m_File.fail();
+    }
+
+private:
+    std::ofstream m_File;
+};
+
+bool DiskStorage::Exists(const std::string &path)
+{
+    return fs::exists(ToLocalPath(path));
+}
+
+bool DiskStorage::IsDirectory(const std::string &path)
+{
+    return fs::is_directory(ToLocalPath(path));
+}
+
+uint64_t DiskStorage::FileSize(const std::string &path)
+{
+    fs::path localPath = ToLocalPath(path);
+
+    return !fs::is_directory(localPath) ? fs::file_size(localPath) : 0;
+}
+
+bool DiskStorage::ListDirectory(const std::string &path, const std::function<void(const Entry &)> &callback)
+{
+    fs::path localPath = ToLocalPath(path);
+
+    if (!fs::is_directory(localPath))
+        return false;
+
+    for (const auto &directoryEntry : fs::directory_iterator(localPath))
+    {
+        Entry entry;
+        entry.Name = directoryEntry.path().filename().string();
+        entry.IsDirectory = directoryEntry.is_directory();
+        entry.Size = !entry.IsDirectory ? directoryEntry.file_size() : 0;
+
+        callback(entry);
+    }
+
+    return true;
+}
+
+size_t DiskStorage::Read(const std::string &path, uint64_t offset, char *buffer, size_t length)
+{
+    std::ifstream file(ToLocalPath(path), std::ifstream::binary);
+    if (file.fail())
+        return 0;
+
+    file.seekg(static_cast<std::streamoff>(offset));
+    file.read(buffer, static_cast<std::streamsize>(length));
+
+    return static_cast<size_t>(file.gcount());
+}
+
+std::unique_ptr<Storage::FileWriter> DiskStorage::CreateFile(const std::string &path)
+{
+    auto writer = std::make_unique<DiskFileWriter>(ToLocalPath(path));
+    if (!writer->IsOpen())
+        return nullptr;
+
+    return writer;
+}
+
+bool DiskStorage::CreateDirectory(const std::string &path)
+{
+    fs::path localPath = ToLocalPath(path);
+    fs::path parentPath = localPath.parent_path();
+
+    if (fs::exists(localPath) || !fs::is_directory(parentPath))
+        return false;
+
+    return fs::create_directory(localPath);
+}
+
+bool DiskStorage::Remove(const std::string &path)
+{
+    std::error_code error;
+
+    return fs::remove_all(ToLocalPath(path), error) > 0;
+}
+
+fs::path DiskStorage::ToLocalPath(const std::string &path)
+{
+    // The client will create paths using backslashes (\) because that's what the Xbox 360 uses.
+    // For the tests we need to forward slashes (/) on POSIX systems so we patch them here.
+#ifndef _WIN32
+    std::string localPath = path;
+    std::replace(localPath.begin(), localPath.end(), '\\', '/');
+
+    // fs::path considers paths with a trailing separator to be directories with an empty file name
+    while (localPath.size() > 1 && localPath.back() == '/')
+        localPath.pop_back();
+
+    return localPath;
+#else
+    return path;
+#endif
+}
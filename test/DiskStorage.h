@@ -0,0 +1,29 @@
+#pragma once
+
+#include <filesystem>
+
+#include "Storage.h"
+
+// Serves files from the local file system
+class DiskStorage : public Storage
+{
+public:
+    bool Exists(const std::string &path) override;
+
+    bool IsDirectory(const std::string &path) override;
+
+    uint64_t FileSize(const std::string &path) override;
+
+    bool ListDirectory(const std::string &path, const std::function<void(const Entry &)> &callback) override;
+
+    size_t Read(const std::string &path, uint64_t offset, char *buffer, size_t length) override;
+
+    std::unique_ptr<FileWriter> CreateFile(const std::string &path) override;
+
+    bool CreateDirectory(const std::string &path) override;
+
+    bool Remove(const std::string &path) override;
+
+private:
+    static std::filesystem::path ToLocalPath(const std::string &path);
+};
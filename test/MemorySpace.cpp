@@ -0,0 +1,169 @@
+#include "MemorySpace.h"
+
+#include <algorithm>
+#include <cstring>
+
+void MemorySpace::AddRegion(uint32_t base, uint32_t size, bool writable)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    uint64_t end = static_cast<uint64_t>(base) + size;
+
+    for (auto it = m_Regions.begin(); it != m_Regions.end();)
+    {
+        const Region &region = it->second;
+        uint64_t regionEnd = static_cast<uint64_t>(region.Base) + region.Size;
+
+        if (region.Base < end && base < regionEnd)
+        {
+            DiscardPages(region.Base, regionEnd);
+            it = m_Regions.erase(it);
+        }
+        else
+            it++;
+    }
+
+    // A new region starts with zeros, whatever was there before
+    DiscardPages(base, end);
+    m_Regions[base] = { base, size, writable };
+}
+
+void MemorySpace::RemoveRegion(uint32_t base)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    auto region = m_Regions.find(base);
+    if (region == m_Regions.end())
+        return;
+
+    DiscardPages(region->second.Base, static_cast<uint64_t>(region->second.Base) + region->second.Size);
+    m_Regions.erase(region);
+}
+
+std::vector<MemorySpace::Region> MemorySpace::GetRegions()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    std::vector<Region> regions;
+    for (const auto &[base, region] : m_Regions)
+        regions.push_back(region);
+
+    return regions;
+}
+
+uint32_t MemorySpace::GetRunLength(uint32_t address, uint32_t maxLength, bool &mapped)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    const Region *region = FindRegion(address);
+    mapped = region != nullptr;
+
+    uint64_t runEnd = 0;
+    if (mapped)
+        runEnd = static_cast<uint64_t>(region->Base) + region->Size;
+    else
+    {
+        // The run of unmapped bytes ends where the next region starts
+        auto next = m_Regions.upper_bound(address);
+        runEnd = next != m_Regions.end() ? next->first : static_cast<uint64_t>(UINT32_MAX) + 1;
+    }
+
+    return static_cast<uint32_t>(std::min<uint64_t>(maxLength, runEnd - address));
+}
+
+bool MemorySpace::Read(uint32_t address, char *buffer, size_t length)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    uint64_t end = static_cast<uint64_t>(address) + length;
+
+    // Check the whole range first so that nothing is read when it fails
+    for (uint64_t position = address; position < end;)
+    {
+        const Region *region = FindRegion(position);
+        if (region == nullptr)
+            return false;
+
+        position = static_cast<uint64_t>(region->Base) + region->Size;
+    }
+
+    for (uint64_t position = address; position < end;)
+    {
+        uint32_t pageIndex = static_cast<uint32_t>(position / s_PageSize);
+        size_t pageOffset = static_cast<size_t>(position % s_PageSize);
+        size_t toCopy = static_cast<size_t>(std::min<uint64_t>(s_PageSize - pageOffset, end - position));
+        char *destination = buffer + (position - address);
+
+        auto page = m_Pages.find(pageIndex);
+        if (page != m_Pages.end())
+            memcpy(destination, page->second->data() + pageOffset, toCopy);
+        else
+            memset(destination, 0, toCopy);
+
+        position += toCopy;
+    }
+
+    return true;
+}
+
+size_t MemorySpace::Write(uint32_t address, const char *data, size_t length)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    uint64_t end = static_cast<uint64_t>(address) + length;
+    uint64_t position = address;
+
+    while (position < end)
+    {
+        const Region *region = FindRegion(position);
+        if (region == nullptr || !region->Writable)
+            break;
+
+        uint32_t pageIndex = static_cast<uint32_t>(position / s_PageSize);
+        size_t pageOffset = static_cast<size_t>(position % s_PageSize);
+        uint64_t regionEnd = static_cast<uint64_t>(region->Base) + region->Size;
+        size_t toCopy = static_cast<size_t>(std::min<uint64_t>(s_PageSize - pageOffset, std::min(end, regionEnd) - position));
+
+        std::unique_ptr<Page> &page = m_Pages[pageIndex];
+        if (page == nullptr)
+            page = std::make_unique<Page>(Page {});
+
+        memcpy(page->data() + pageOffset, data + (position - address), toCopy);
+        position += toCopy;
+    }
+
+    return static_cast<size_t>(position - address);
+}
+
+const MemorySpace::Region *MemorySpace::FindRegion(uint64_t address) const
+{
+    // The region containing address is the last one starting at or before it
+    auto next = m_Regions.upper_bound(static_cast<uint32_t>(std::min<uint64_t>(address, UINT32_MAX)));
+    if (address > UINT32_MAX || next == m_Regions.begin())
+        return nullptr;
+
+    const Region &region = std::prev(next)->second;
+    if (address >= static_cast<uint64_t>(region.Base) + region.Size)
+        return nullptr;
+
+    return &region;
+}
+
+void MemorySpace::DiscardPages(uint64_t begin, uint64_t end)
+{
+    for (uint64_t position = begin; position < end;)
+    {
+        uint32_t pageIndex = static_cast<uint32_t>(position / s_PageSize);
+        size_t pageOffset = static_cast<size_t>(position % s_PageSize);
+        size_t length = static_cast<size_t>(std::min<uint64_t>(s_PageSize - pageOffset, end - position));
+
+        // Pages shared with a neighbouring region are only cleared
+        auto page = m_Pages.find(pageIndex);
+        if (page != m_Pages.end() && length == s_PageSize)
+            m_Pages.erase(page);
+        else if (page != m_Pages.end())
+            memset(page->second->data() + pageOffset, 0, length);
+
+        position += length;
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+// Emulates the address space of a console. Regions are mapped at fixed addresses and the pages
+// of their content are only allocated when written, so that regions of hundreds of megabytes
+// cost nothing until they are used. Memory that was never written reads as zeros.
+class MemorySpace
+{
+public:
+    struct Region
+    {
+        uint32_t Base = 0;
+        uint32_t Size = 0;
+        bool Writable = true;
+    };
+
+    // Regions can't overlap, adding one overlapping an existing region replaces it
+    void AddRegion(uint32_t base, uint32_t size, bool writable = true);
+    void RemoveRegion(uint32_t base);
+
+    std::vector<Region> GetRegions();
+
+    // Gives the number of bytes, at most maxLength, starting at address that are either all mapped
+    // or all unmapped, and which one it is
+    uint32_t GetRunLength(uint32_t address, uint32_t maxLength, bool &mapped);
+
+    // Returns false, without reading anything, if part of the range isn't mapped
+    bool Read(uint32_t address, char *buffer, size_t length);
+
+    // Returns the number of bytes written, writing stops at the first byte that isn't writable
+    size_t Write(uint32_t address, const char *data, size_t length);
+
+private:
+    static constexpr uint32_t s_PageSize = 4096;
+
+    using Page = std::array<char, s_PageSize>;
+
+    // Regions are indexed by base address
+    std::map<uint32_t, Region> m_Regions;
+    std::unordered_map<uint32_t, std::unique_ptr<Page>> m_Pages;
+    std::mutex m_Mutex;
+
+    const Region *FindRegion(uint64_t address) const;
+    void DiscardPages(uint64_t begin, uint64_t end);
+};
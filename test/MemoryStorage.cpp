@@ -0,0 +1,407 @@
+#include "MemoryStorage.h"
+
+#include <algorithm>
+#include <cstring>
+
+class MemoryStorage::MemoryFileWriter : public Storage::FileWriter
+{
+public:
+    MemoryFileWriter(std::shared_ptr<std::vector<char>> content)
+        : m_Content(content) {}
+
+    bool Write(const char *buffer, size_t length) override
+    {
+        m_Content->insert(m_Content->end(), buffer, buffer + length);
+
+        return true;
+    }
+
+private:
+    std::shared_ptr<std::vector<char>> m_Content;
+};
+
+MemoryStorage::MemoryStorage()
+{
+    // The root always exists
+    m_Nodes[""].IsDirectory = true;
+}
+
+void MemoryStorage::AddGeneratedTree(const std::string &root, size_t width, size_t depth, uint64_t fileSize)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    std::string normalizedRoot = Normalize(root);
+
+    AddParentDirectories(normalizedRoot);
+    m_Nodes[normalizedRoot].IsDirectory = true;
+    m_GeneratedTrees[normalizedRoot] = { width, depth, fileSize };
+}
+
+void MemoryStorage::AddGeneratedFile(const std::string &path, uint64_t size)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    std::string normalizedPath = Normalize(path);
+
+    AddParentDirectories(normalizedPath);
+
+    Node &node = m_Nodes[normalizedPath];
+    node.IsGenerated = true;
+    node.GeneratedSize = size;
+}
+
+static uint64_t SplitMix64(uint64_t value)
+{
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+
+    return value ^ (value >> 31);
+}
+
+void MemoryStorage::GenerateContent(const std::string &path, uint64_t offset, char *buffer, size_t length)
+{
+    // Each file gets its own sequence of pseudo-random 8-byte words, seeded with the FNV-1a hash
+    // of its normalized path, so any part of it can be generated independently of the rest
+    uint64_t seed = 0xcbf29ce484222325ULL;
+    for (char character : Normalize(path))
+        seed = (seed ^ static_cast<unsigned char>(character)) * 0x100000001b3ULL;
+
+    size_t written = 0;
+    while (written < length)
+    {
+        uint64_t position = offset + written;
+        uint64_t word = SplitMix64(seed ^ (position / sizeof(uint64_t)));
+        size_t offsetInWord = static_cast<size_t>(position % sizeof(uint64_t));
+        size_t toCopy = std::min<size_t>(sizeof(uint64_t) - offsetInWord, length - written);
+
+        memcpy(buffer + written, reinterpret_cast<const char *>(&word) + offsetInWord, toCopy);
+        written += toCopy;
+    }
+}
+
+bool MemoryStorage::Exists(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    Node node;
+
+    return Find(Normalize(path), node);
+}
+
+bool MemoryStorage::IsDirectory(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    Node node;
+
+    return Find(Normalize(path), node) && node.IsDirectory;
+}
+
+uint64_t MemoryStorage::FileSize(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    Node node;
+    if (!Find(Normalize(path), node) || node.IsDirectory)
+        return 0;
+
+    return node.IsGenerated ? node.GeneratedSize : node.Content->size();
+}
+
+bool MemoryStorage::ListDirectory(const std::string &path, const std::function<void(const Entry &)> &callback)
+{
+    std::vector<Entry> entries;
+    std::string normalizedPath = Normalize(path);
+    bool isGenerated = false;
+    GeneratedTree generatedTree;
+    size_t level = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        Node node;
+        const GeneratedTree *tree = nullptr;
+
+        if (FindInGeneratedTree(normalizedPath, node, level, tree))
+        {
+            if (!node.IsDirectory)
+                return false;
+
+            isGenerated = true;
+            generatedTree = *tree;
+        }
+        else
+        {
+            if (!Find(normalizedPath, node) || !node.IsDirectory)
+                return false;
+
+            // Children are stored right after their parent because the map is sorted,
+            // only direct children are listed
+            std::string prefix = normalizedPath.empty() ? "" : normalizedPath + '/';
+            for (auto it = m_Nodes.upper_bound(prefix); it != m_Nodes.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+            {
+                std::string name = it->first.substr(prefix.size());
+                if (name.empty() || name.find('/') != std::string::npos)
+                    continue;
+
+                Entry entry;
+                entry.Name = name;
+                entry.IsDirectory = it->second.IsDirectory;
+                if (!entry.IsDirectory)
+                    entry.Size = it->second.IsGenerated ? it->second.GeneratedSize : it->second.Content->size();
+                entry.ModificationDate = it->second.ModificationDate;
+
+                entries.push_back(entry);
+            }
+        }
+    }
+
+    // Generated entries are created on the fly and never stored, no matter how many there are
+    if (isGenerated)
+    {
+        for (size_t i = 0; i < generatedTree.Width; i++)
+        {
+            if (level < generatedTree.Depth)
+                callback({ "directory" + std::to_string(i), 0, true });
+
+            callback({ "file" + std::to_string(i) + ".bin", generatedTree.FileSize, false });
+        }
+
+        return true;
+    }
+
+    for (auto &entry : entries)
+        callback(entry);
+
+    return true;
+}
+
+size_t MemoryStorage::Read(const std::string &path, uint64_t offset, char *buffer, size_t length)
+{
+    std::string normalizedPath = Normalize(path);
+    Node node;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        if (!Find(normalizedPath, node) || node.IsDirectory)
+            return 0;
+    }
+
+    uint64_t size = node.IsGenerated ? node.GeneratedSize : node.Content->size();
+    if (offset >= size)
+        return 0;
+
+    size_t toRead = static_cast<size_t>(std::min<uint64_t>(length, size - offset));
+
+    if (node.IsGenerated)
+        GenerateContent(normalizedPath, offset, buffer, toRead);
+    else
+        memcpy(buffer, node.Content->data() + offset, toRead);
+
+    return toRead;
+}
+
+std::unique_ptr<Storage::FileWriter> MemoryStorage::CreateFile(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    std::string normalizedPath = Normalize(path);
+
+    Node parent;
+    if (!Find(ParentPath(normalizedPath), parent) || !parent.IsDirectory)
+        return nullptr;
+
+    // Generated trees are read-only
+    Node existingNode;
+    size_t level = 0;
+    const GeneratedTree *tree = nullptr;
+    if (FindInGeneratedTree(normalizedPath, existingNode, level, tree) || tree != nullptr)
+        return nullptr;
+
+    Node &node = m_Nodes[normalizedPath];
+    if (node.IsDirectory)
+        return nullptr;
+
+    node.IsGenerated = false;
+    node.Content = std::make_shared<std::vector<char>>();
+    node.ModificationDate = std::time(nullptr);
+
+    return std::make_unique<MemoryFileWriter>(node.Content);
+}
+
+bool MemoryStorage::CreateDirectory(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    std::string normalizedPath = Normalize(path);
+
+    Node node;
+    if (Find(normalizedPath, node))
+        return false;
+
+    size_t level = 0;
+    const GeneratedTree *tree = nullptr;
+    if (FindInGeneratedTree(normalizedPath, node, level, tree) || tree != nullptr)
+        return false;
+
+    Node parent;
+    if (!Find(ParentPath(normalizedPath), parent) || !parent.IsDirectory)
+        return false;
+
+    m_Nodes[normalizedPath].IsDirectory = true;
+
+    return true;
+}
+
+bool MemoryStorage::Remove(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    std::string normalizedPath = Normalize(path);
+
+    // The root can't be removed
+    if (normalizedPath.empty() || m_Nodes.find(normalizedPath) == m_Nodes.end())
+        return false;
+
+    std::string prefix = normalizedPath + '/';
+    auto first = m_Nodes.find(normalizedPath);
+    auto last = std::next(first);
+    while (last != m_Nodes.end() && last->first.compare(0, prefix.size(), prefix) == 0)
+        ++last;
+
+    m_Nodes.erase(first, last);
+
+    for (auto it = m_GeneratedTrees.begin(); it != m_GeneratedTrees.end();)
+    {
+        if (it->first == normalizedPath || it->first.compare(0, prefix.size(), prefix) == 0)
+            it = m_GeneratedTrees.erase(it);
+        else
+            ++it;
+    }
+
+    return true;
+}
+
+bool MemoryStorage::Find(const std::string &normalizedPath, Node &node)
+{
+    auto it = m_Nodes.find(normalizedPath);
+    if (it != m_Nodes.end())
+    {
+        node = it->second;
+        return true;
+    }
+
+    size_t level = 0;
+    const GeneratedTree *tree = nullptr;
+
+    return FindInGeneratedTree(normalizedPath, node, level, tree);
+}
+
+static bool ParseIndex(const std::string &component, const std::string &prefix, const std::string &suffix, size_t &index)
+{
+    if (component.size() <= prefix.size() + suffix.size())
+        return false;
+
+    if (component.compare(0, prefix.size(), prefix) != 0 || component.compare(component.size() - suffix.size(), suffix.size(), suffix) != 0)
+        return false;
+
+    std::string digits = component.substr(prefix.size(), component.size() - prefix.size() - suffix.size());
+    if (!std::all_of(digits.begin(), digits.end(), [](char character) { return character >= '0' && character <= '9'; }))
+        return false;
+
+    // Reject leading zeros so that each entry has a single name
+    if (digits.size() > 1 && digits[0] == '0')
+        return false;
+
+    index = std::stoull(digits);
+
+    return true;
+}
+
+bool MemoryStorage::FindInGeneratedTree(const std::string &normalizedPath, Node &node, size_t &level, const GeneratedTree *&tree)
+{
+    tree = nullptr;
+
+    // Find the generated tree whose root is the longest prefix of the path
+    std::string root;
+    for (auto &[treeRoot, generatedTree] : m_GeneratedTrees)
+    {
+        bool isInTree = normalizedPath == treeRoot || normalizedPath.compare(0, treeRoot.size() + 1, treeRoot + '/') == 0;
+        if (isInTree && (tree == nullptr || treeRoot.size() > root.size()))
+        {
+            root = treeRoot;
+            tree = &generatedTree;
+        }
+    }
+
+    if (tree == nullptr)
+        return false;
+
+    node = Node();
+    node.IsDirectory = true;
+    level = 0;
+
+    if (normalizedPath == root)
+        return true;
+
+    std::string relativePath = normalizedPath.substr(root.size() + 1);
+    size_t start = 0;
+
+    for (;;)
+    {
+        size_t end = relativePath.find('/', start);
+        std::string component = relativePath.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        bool isLast = end == std::string::npos;
+        size_t index = 0;
+
+        if (level < tree->Depth && ParseIndex(component, "directory", "", index) && index < tree->Width)
+        {
+            level++;
+
+            if (isLast)
+                return true;
+
+            start = end + 1;
+            continue;
+        }
+
+        if (isLast && ParseIndex(component, "file", ".bin", index) && index < tree->Width)
+        {
+            node.IsDirectory = false;
+            node.IsGenerated = true;
+            node.GeneratedSize = tree->FileSize;
+            return true;
+        }
+
+        return false;
+    }
+}
+
+void MemoryStorage::AddParentDirectories(const std::string &normalizedPath)
+{
+    for (std::string parent = ParentPath(normalizedPath); !parent.empty(); parent = ParentPath(parent))
+        m_Nodes[parent].IsDirectory = true;
+}
+
+std::string MemoryStorage::Normalize(const std::string &path)
+{
+    // Accept both separators and ignore the trailing ones so that "a\b\" and "a/b" are the same path
+    std::string normalizedPath = path;
+    std::replace(normalizedPath.begin(), normalizedPath.end(), '\\', '/');
+
+    while (!normalizedPath.empty() && normalizedPath.back() == '/')
+        normalizedPath.pop_back();
+
+    return normalizedPath;
+}
+
+std::string MemoryStorage::ParentPath(const std::string &normalizedPath)
+{
+    size_t lastSeparatorPos = normalizedPath.find_last_of('/');
+    if (lastSeparatorPos == std::string::npos)
+        return "";
+
+    return normalizedPath.substr(0, lastSeparatorPos);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "Storage.h"
+
+// Keeps the files in memory. On top of regular files and directories, it can serve generated
+// trees and files whose content is computed on the fly, which makes it possible to emulate
+// millions of entries or multi-gigabyte files without storing them anywhere.
+class MemoryStorage : public Storage
+{
+public:
+    MemoryStorage();
+
+    // Generates a read-only tree at root where each directory contains width files named fileN.bin
+    // and, until depth levels have been generated, width subdirectories named directoryN
+    void AddGeneratedTree(const std::string &root, size_t width, size_t depth, uint64_t fileSize);
+
+    // Generates a read-only file of size bytes, its content is given by GenerateContent
+    void AddGeneratedFile(const std::string &path, uint64_t size);
+
+    // Fills buffer with the content of a generated file, starting at offset
+    static void GenerateContent(const std::string &path, uint64_t offset, char *buffer, size_t length);
+
+    bool Exists(const std::string &path) override;
+
+    bool IsDirectory(const std::string &path) override;
+
+    uint64_t FileSize(const std::string &path) override;
+
+    bool ListDirectory(const std::string &path, const std::function<void(const Entry &)> &callback) override;
+
+    size_t Read(const std::string &path, uint64_t offset, char *buffer, size_t length) override;
+
+    std::unique_ptr<FileWriter> CreateFile(const std::string &path) override;
+
+    bool CreateDirectory(const std::string &path) override;
+
+    bool Remove(const std::string &path) override;
+
+private:
+    struct Node
+    {
+        bool IsDirectory = false;
+        bool IsGenerated = false;
+        uint64_t GeneratedSize = 0;
+        std::shared_ptr<std::vector<char>> Content;
+        time_t ModificationDate = 0;
+    };
+
+    struct GeneratedTree
+    {
+        size_t Width = 0;
+        size_t Depth = 0;
+        uint64_t FileSize = 0;
+    };
+
+    class MemoryFileWriter;
+
+    // Nodes are indexed by normalized path (see Normalize) so that the children of a directory
+    // are next to each other
+    std::map<std::string, Node> m_Nodes;
+    std::map<std::string, GeneratedTree> m_GeneratedTrees;
+    std::mutex m_Mutex;
+
+    bool Find(const std::string &normalizedPath, Node &node);
+    bool FindInGeneratedTree(const std::string &normalizedPath, Node &node, size_t &level, const GeneratedTree *&tree);
+    void AddParentDirectories(const std::string &normalizedPath);
+
+    static std::string Normalize(const std::string &path);
+    static std::string ParentPath(const std::string &normalizedPath);
+};
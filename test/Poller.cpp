@@ -0,0 +1,165 @@
+#include "Poller.h"
+
+#ifndef _WIN32
+    #include <unistd.h>
+#endif
+
+#include <algorithm>
+
+#if defined(__linux__)
+
+static uint32_t ToEpollEvents(int interest)
+{
+    uint32_t events = 0;
+
+    if (interest & Poller::Readable)
+        events |= EPOLLIN;
+
+    if (interest & Poller::Writable)
+        events |= EPOLLOUT;
+
+    return events;
+}
+
+Poller::Poller()
+    : m_EpollFd(epoll_create1(EPOLL_CLOEXEC)), m_SocketCount(0)
+{
+}
+
+Poller::~Poller()
+{
+    if (m_EpollFd != -1)
+        close(m_EpollFd);
+}
+
+bool Poller::Add(SOCKET socket, int interest)
+{
+    epoll_event event = {};
+    event.events = ToEpollEvents(interest);
+    event.data.fd = socket;
+
+    if (epoll_ctl(m_EpollFd, EPOLL_CTL_ADD, socket, &event) != 0)
+        return false;
+
+    m_SocketCount++;
+
+    return true;
+}
+
+bool Poller::Modify(SOCKET socket, int interest)
+{
+    epoll_event event = {};
+    event.events = ToEpollEvents(interest);
+    event.data.fd = socket;
+
+    return epoll_ctl(m_EpollFd, EPOLL_CTL_MOD, socket, &event) == 0;
+}
+
+void Poller::Remove(SOCKET socket)
+{
+    if (epoll_ctl(m_EpollFd, EPOLL_CTL_DEL, socket, nullptr) == 0)
+        m_SocketCount--;
+}
+
+std::vector<Poller::Event> Poller::Wait(std::chrono::milliseconds timeout)
+{
+    std::vector<epoll_event> epollEvents(std::max<size_t>(m_SocketCount, 1));
+    std::vector<Event> events;
+
+    int count = epoll_wait(m_EpollFd, epollEvents.data(), static_cast<int>(epollEvents.size()), static_cast<int>(timeout.count()));
+
+    for (int i = 0; i < count; i++)
+    {
+        Event event;
+        event.Socket = epollEvents[i].data.fd;
+        event.Readable = (epollEvents[i].events & EPOLLIN) != 0;
+        event.Writable = (epollEvents[i].events & EPOLLOUT) != 0;
+        event.Error = (epollEvents[i].events & (EPOLLERR | EPOLLHUP)) != 0;
+
+        events.push_back(event);
+    }
+
+    return events;
+}
+
+#else
+
+static short ToPollEvents(int interest)
+{
+    short events = 0;
+
+    if (interest & Poller::Readable)
+        events |= POLLIN;
+
+    if (interest & Poller::Writable)
+        events |= POLLOUT;
+
+    return events;
+}
+
+Poller::Poller()
+{
+}
+
+Poller::~Poller()
+{
+}
+
+bool Poller::Add(SOCKET socket, int interest)
+{
+    auto &pollFd = m_PollFds.emplace_back();
+    pollFd.fd = socket;
+    pollFd.events = ToPollEvents(interest);
+    pollFd.revents = 0;
+
+    return true;
+}
+
+bool Poller::Modify(SOCKET socket, int interest)
+{
+    auto pollFd = std::find_if(m_PollFds.begin(), m_PollFds.end(), [&](const auto &pollFd) { return pollFd.fd == socket; });
+    if (pollFd == m_PollFds.end())
+        return false;
+
+    pollFd->events = ToPollEvents(interest);
+
+    return true;
+}
+
+void Poller::Remove(SOCKET socket)
+{
+    m_PollFds.erase(
+        std::remove_if(m_PollFds.begin(), m_PollFds.end(), [&](const auto &pollFd) { return pollFd.fd == socket; }),
+        m_PollFds.end()
+    );
+}
+
+std::vector<Poller::Event> Poller::Wait(std::chrono::milliseconds timeout)
+{
+    std::vector<Event> events;
+
+    #ifdef _WIN32
+    int count = WSAPoll(m_PollFds.data(), static_cast<ULONG>(m_PollFds.size()), static_cast<INT>(timeout.count()));
+    #else
+    int count = poll(m_PollFds.data(), static_cast<nfds_t>(m_PollFds.size()), static_cast<int>(timeout.count()));
+    #endif
+
+    for (size_t i = 0; i < m_PollFds.size() && count > 0; i++)
+    {
+        if (m_PollFds[i].revents == 0)
+            continue;
+
+        Event event;
+        event.Socket = m_PollFds[i].fd;
+        event.Readable = (m_PollFds[i].revents & POLLIN) != 0;
+        event.Writable = (m_PollFds[i].revents & POLLOUT) != 0;
+        event.Error = (m_PollFds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) != 0;
+
+        events.push_back(event);
+        count--;
+    }
+
+    return events;
+}
+
+#endif
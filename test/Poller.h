@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#ifdef _WIN32
+    #include <WinSock2.h>
+#elif defined(__linux__)
+    #include <sys/epoll.h>
+#else
+    #include <poll.h>
+#endif
+
+#ifndef _WIN32
+// clang-format off
+    typedef int SOCKET;
+// clang-format on
+#endif
+
+// Waits for events on many sockets at once, with epoll on Linux and poll (WSAPoll on Windows)
+// everywhere else
+class Poller
+{
+public:
+    enum Interest
+    {
+        None = 0,
+        Readable = 1 << 0,
+        Writable = 1 << 1,
+    };
+
+    struct Event
+    {
+        SOCKET Socket;
+        bool Readable = false;
+        bool Writable = false;
+
+        // Set when the connection was closed or reset, in which case the socket should be closed
+        bool Error = false;
+    };
+
+    Poller();
+    ~Poller();
+
+    Poller(const Poller &) = delete;
+    Poller &operator=(const Poller &) = delete;
+
+    bool Add(SOCKET socket, int interest);
+    bool Modify(SOCKET socket, int interest);
+    void Remove(SOCKET socket);
+
+    // Waits until at least one socket has an event or until timeout is reached
+    std::vector<Event> Wait(std::chrono::milliseconds timeout);
+
+private:
+#if defined(__linux__)
+    int m_EpollFd;
+    size_t m_SocketCount;
+#else
+    #ifdef _WIN32
+    std::vector<WSAPOLLFD> m_PollFds;
+    #else
+    std::vector<pollfd> m_PollFds;
+    #endif
+#endif
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <ctime>
+
+// Where the test server stores the files it serves. Paths are the ones sent by the client
+// so they can use either backslashes or forward slashes as separators.
+class Storage
+{
+public:
+    struct Entry
+    {
+        std::string Name;
+        uint64_t Size = 0;
+        bool IsDirectory = false;
+
+        // 0 when the storage doesn't know it
+        time_t ModificationDate = 0;
+    };
+
+    class FileWriter
+    {
+    public:
+        virtual ~FileWriter() = default;
+
+        virtual bool Write(const char *buffer, size_t length) = 0;
+    };
+
+    virtual ~Storage() = default;
+
+    virtual bool Exists(const std::string &path) = 0;
+
+    virtual bool IsDirectory(const std::string &path) = 0;
+
+    // Returns 0 for directories
+    virtual uint64_t FileSize(const std::string &path) = 0;
+
+    // Calls callback for each entry of the directory without building the whole list first so that
+    // huge directories can be listed. Returns false if path is not a directory.
+    virtual bool ListDirectory(const std::string &path, const std::function<void(const Entry &)> &callback) = 0;
+
+    // Reads at most length bytes starting at offset and returns the number of bytes read
+    virtual size_t Read(const std::string &path, uint64_t offset, char *buffer, size_t length) = 0;
+
+    // Creates or truncates a file, returns nullptr if it can't be created
+    virtual std::unique_ptr<FileWriter> CreateFile(const std::string &path) = 0;
+
+    // Returns false if the parent directory doesn't exist or if something already exists at path
+    virtual bool CreateDirectory(const std::string &path) = 0;
+
+    // Removes a file or a directory and everything it contains
+    virtual bool Remove(const std::string &path) = 0;
+};
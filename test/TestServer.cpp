@@ -5,17 +5,35 @@
 #include <fstream>
 #include <thread>
 #include <algorithm>
+#include <cerrno>
 
 #include "Utils.h"
+#include "DiskStorage.h"
 
 using namespace std::chrono_literals;
 namespace fs = std::filesystem;
 
-#define BIND_FN(fn) std::bind(&TestServer::fn, this, std::placeholders::_1)
+#define BIND_FN(fn) std::bind(&TestServer::fn, this, std::placeholders::_1, std::placeholders::_2)
+
+#ifdef _WIN32
+    #define CloseSocket(socket) closesocket(socket)
+    #define IsWouldBlockError() (WSAGetLastError() == WSAEWOULDBLOCK)
+#else
+    #define CloseSocket(socket) close(socket)
+    #define IsWouldBlockError() (errno == EAGAIN || errno == EWOULDBLOCK)
+#endif
+
+#ifdef MSG_NOSIGNAL
+    #define SEND_FLAGS MSG_NOSIGNAL
+#else
+    #define SEND_FLAGS 0
+#endif
 
 TestServer::TestServer()
-    : m_ServerSocket(INVALID_SOCKET), m_ClientSocket(INVALID_SOCKET), m_Listening(false)
+    : m_Listening(false), m_Storage(std::make_shared<DiskStorage>())
 {
+    m_Listeners.push_back({ INVALID_SOCKET, 730, "TestXDK", nullptr, std::make_shared<MemorySpace>() });
+
     m_CommandMap["dbgname"] = BIND_FN(ConsoleName);
     m_CommandMap["drivelist"] = BIND_FN(DriveList);
     m_CommandMap["drivefreespace"] = BIND_FN(DriveFreeSpace);
@@ -30,33 +48,38 @@ TestServer::TestServer()
     m_CommandMap["delete"] = BIND_FN(DeleteFile);
     m_CommandMap["mkdir"] = BIND_FN(CreateDirectory);
     m_CommandMap["rename"] = BIND_FN(RenameFile);
+    m_CommandMap["getmemex"] = BIND_FN(ReadMemory);
+    m_CommandMap["setmem"] = BIND_FN(WriteMemory);
+    m_CommandMap["notify"] = BIND_FN(Notify);
+    m_CommandMap["screenshot"] = BIND_FN(Screenshot);
 }
 
-void TestServer::Start()
+TestServer::~TestServer()
 {
-    if (!InitServerSocket())
-    {
-        Shutdown();
-        return;
-    }
+    Shutdown();
+}
 
-    if (!InitClientSocket())
-    {
-        Shutdown();
-        return;
-    }
+void TestServer::AddConsole(uint16_t port, const std::string &name, std::shared_ptr<Storage> storage)
+{
+    m_Listeners.push_back({ INVALID_SOCKET, port, name, std::move(storage), std::make_shared<MemorySpace>() });
+}
 
-    if (!Send("201- connected\r\n"))
-    {
-        Shutdown();
-        return;
-    }
+void TestServer::EnableDiscovery(uint16_t port)
+{
+    m_DiscoveryPort = port;
+}
 
-    if (!Run())
+void TestServer::Start()
+{
+    if (!InitServerSockets())
     {
         Shutdown();
         return;
     }
+
+    Run();
+
+    Shutdown();
 }
 
 void TestServer::WaitForServerToListen()
@@ -73,22 +96,80 @@ void TestServer::RequestShutdown()
     SignalListening(false);
 }
 
-void TestServer::ConsoleName(const std::vector<Arg> &args)
+void TestServer::SetNetworkConditions(const NetworkConditions &conditions)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_NetworkConditions = conditions;
+
+    // Reseed the generator so that the same conditions always produce the same delays
+    m_RandomGenerator.seed(conditions.Seed);
+}
+
+void TestServer::SetReplay(uint16_t port, const std::vector<XBDM::TraceEvent> &trace, double timeScale)
+{
+    auto replay = std::make_shared<Replay>();
+    replay->TimeScale = std::max(timeScale, 0.0);
+
+    for (const auto &event : trace)
+    {
+        if (event.EventType == XBDM::TraceEvent::Type::Connected || replay->Sessions.empty())
+        {
+            ReplaySession session;
+            session.StartTimestamp = event.Timestamp;
+            replay->Sessions.push_back(session);
+        }
+
+        if (event.EventType != XBDM::TraceEvent::Type::Connected)
+            replay->Sessions.back().Events.push_back(event);
+    }
+
+    for (auto &session : replay->Sessions)
+        session.SendBanner = session.Events.empty() || session.Events[0].EventType != XBDM::TraceEvent::Type::Received || session.Events[0].Data.compare(0, 4, "201-") != 0;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (replay->Sessions.empty())
+        m_Replays.erase(port);
+    else
+        m_Replays[port] = replay;
+}
+
+std::shared_ptr<MemorySpace> TestServer::GetMemory(uint16_t port)
+{
+    auto listener = std::find_if(m_Listeners.begin(), m_Listeners.end(), [&](const Listener &listener) { return listener.Port == port; });
+
+    return listener != m_Listeners.end() ? listener->Memory : nullptr;
+}
+
+void TestServer::SendNotification(uint16_t port, const std::string &line)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_PendingNotifications.emplace_back(port, line);
+}
+
+void TestServer::SetStorage(std::shared_ptr<Storage> storage)
+{
+    m_Storage = std::move(storage);
+}
+
+void TestServer::ConsoleName(Connection &connection, const std::vector<Arg> &args)
 {
     if (!args.empty())
     {
-        Send("400- no argument expected\r\n");
+        Send(connection, "400- no argument expected\r\n");
         return;
     }
 
-    Send("200- TestXDK\r\n");
+    Send(connection, "200- " + connection.ConsoleName + "\r\n");
 }
 
-void TestServer::DriveList(const std::vector<Arg> &args)
+void TestServer::DriveList(Connection &connection, const std::vector<Arg> &args)
 {
     if (!args.empty())
     {
-        Send("400- no argument expected\r\n");
+        Send(connection, "400- no argument expected\r\n");
         return;
     }
 
@@ -102,20 +183,20 @@ void TestServer::DriveList(const std::vector<Arg> &args)
 
     response << ".\r\n";
 
-    Send(response.str());
+    Send(connection, response.str());
 }
 
-void TestServer::DriveFreeSpace(const std::vector<Arg> &args)
+void TestServer::DriveFreeSpace(Connection &connection, const std::vector<Arg> &args)
 {
     if (args.size() != 1)
     {
-        Send("400- wrong number of arguments provided, one expected\r\n");
+        Send(connection, "400- wrong number of arguments provided, one expected\r\n");
         return;
     }
 
     if (args[0].Name != "name")
     {
-        Send("400- argument 'name' not found\r\n");
+        Send(connection, "400- argument 'name' not found\r\n");
         return;
     }
 
@@ -125,117 +206,112 @@ void TestServer::DriveFreeSpace(const std::vector<Arg> &args)
         "totalbyteshi=0x0 totalbyteslo=0xb "
         "totalfreebyteshi=0x0 totalfreebyteslo=0xc\r\n";
 
-    Send(response);
+    Send(connection, response);
 }
 
-void TestServer::DirectoryContents(const std::vector<Arg> &args)
+void TestServer::DirectoryContents(Connection &connection, const std::vector<Arg> &args)
 {
     if (args.size() != 1)
     {
-        Send("400- wrong number of arguments provided, one expected\r\n");
+        Send(connection, "400- wrong number of arguments provided, one expected\r\n");
         return;
     }
 
     if (args[0].Name != "name")
     {
-        Send("400- argument 'name' not found\r\n");
+        Send(connection, "400- argument 'name' not found\r\n");
         return;
     }
 
-    // The client will create paths using backslashes (\) because that's what the Xbox 360 uses.
-    // For the tests we need to forward slashes (/) on POSIX systems so we patch them here.
-#ifndef _WIN32
-    std::string directoryPath = args[0].Value;
-    std::replace(directoryPath.begin(), directoryPath.end(), '\\', '/');
-#else
     const std::string &directoryPath = args[0].Value;
-#endif
-
-    if (!fs::exists(directoryPath))
-    {
-        Send("404- " + directoryPath + " not found\r\n");
-        return;
-    }
 
     std::stringstream response;
     response << "202- multiline response follows\r\n";
 
-    for (const auto &entry : fs::directory_iterator(directoryPath))
-    {
-        std::stringstream line;
-        line << "name=\"" << entry.path().filename().string() << "\"";
-
-        // Some random but valid creation and modification dates
-        line << " createhi=0x01d11fb5 createlo=0x59683c00";
-        line << " changehi=0x01d11fb5 changelo=0x59683c00";
+    bool isDirectory = connection.FileSystem->ListDirectory(directoryPath, [&](const Storage::Entry &entry) {
+        response << "name=\"" << entry.Name << "\"";
 
-        if (!entry.is_directory())
+        // Some random but valid creation and modification dates, unless the storage knows when the file was written
+        response << " createhi=0x01d11fb5 createlo=0x59683c00";
+        if (entry.ModificationDate != 0)
         {
-            line << " sizehi=0x" << std::hex << (entry.file_size() & 0xffff0000);
-            line << " sizelo=0x" << std::hex << (entry.file_size() & 0x0000ffff);
-            line << "\r\n";
+            uint64_t changeDate = (static_cast<uint64_t>(entry.ModificationDate) + 11644473600ULL) * 10000000ULL;
+            response << " changehi=0x" << std::hex << (changeDate >> 32) << " changelo=0x" << (changeDate & 0xffffffff);
         }
         else
-            line << " sizehi=0x0 sizelo=0x0 directory\r\n";
+            response << " changehi=0x01d11fb5 changelo=0x59683c00";
 
-        line << ".\r\n";
+        if (!entry.IsDirectory)
+        {
+            response << " sizehi=0x" << std::hex << (entry.Size >> 32);
+            response << " sizelo=0x" << std::hex << (entry.Size & 0xffffffff);
+            response << "\r\n";
+        }
+        else
+            response << " sizehi=0x0 sizelo=0x0 directory\r\n";
+    });
 
-        response << line.str();
+    if (!isDirectory)
+    {
+        Send(connection, "404- " + directoryPath + " not found\r\n");
+        return;
     }
 
-    Send(response.str());
+    response << ".\r\n";
+
+    Send(connection, response.str());
 }
 
-void TestServer::FileAttributes(const std::vector<Arg> &args)
+void TestServer::FileAttributes(Connection &connection, const std::vector<Arg> &args)
 {
     if (args.size() != 1)
     {
-        Send("400- wrong number of arguments provided, one expected\r\n");
+        Send(connection, "400- wrong number of arguments provided, one expected\r\n");
         return;
     }
 
     if (args[0].Name != "name")
     {
-        Send("400- argument 'name' not found\r\n");
+        Send(connection, "400- argument 'name' not found\r\n");
         return;
     }
 
-    std::string path = args[0].Value;
+    const std::string &path = args[0].Value;
 
-    if (!fs::exists(path))
+    if (!connection.FileSystem->Exists(path))
     {
-        Send("404- " + path + " not found\r\n");
+        Send(connection, "404- " + path + " not found\r\n");
         return;
     }
 
-    size_t fileSize = !fs::is_directory(path) ? fs::file_size(path) : 0;
+    uint64_t fileSize = connection.FileSystem->FileSize(path);
 
     std::stringstream response;
     response << "202- multiline response follows\r\n";
 
-    response << "sizehi=0x" << std::hex << (fileSize & 0xffff0000);
-    response << " sizelo=0x" << std::hex << (fileSize & 0x0000ffff);
+    response << "sizehi=0x" << std::hex << (fileSize >> 32);
+    response << " sizelo=0x" << std::hex << (fileSize & 0xffffffff);
     response << " createhi=0x01d11fb5 createlo=0x59683c00";
     response << " changehi=0x01d11fb5 changelo=0x59683c00";
     response << "\r\n.\r\n";
 
-    Send(response.str());
+    Send(connection, response.str());
 }
 
-void TestServer::MagicBoot(const std::vector<Arg> &args)
+void TestServer::MagicBoot(Connection &connection, const std::vector<Arg> &args)
 {
     // Case of launching a specific XEX
     if (args.size() == 2)
     {
         if (args[0].Name != "title")
         {
-            Send("400- argument 'title' not found\r\n");
+            Send(connection, "400- argument 'title' not found\r\n");
             return;
         }
 
         if (args[1].Name != "directory")
         {
-            Send("400- argument 'directory' not found\r\n");
+            Send(connection, "400- argument 'directory' not found\r\n");
             return;
         }
 
@@ -245,444 +321,1113 @@ void TestServer::MagicBoot(const std::vector<Arg> &args)
 
         if (providedDirectory != directoryFromTitle)
         {
-            Send("400- the value of 'directory' does not match with the title path\r\n");
+            Send(connection, "400- the value of 'directory' does not match with the title path\r\n");
             return;
         }
     }
 
-    Send("200- OK");
+    Send(connection, "200- OK\r\n");
+
+    std::chrono::milliseconds bootDuration(0);
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        auto duration = m_BootDurations.find(connection.Port);
+        if (duration != m_BootDurations.end())
+            bootDuration = duration->second;
+    }
+
+    if (bootDuration.count() == 0)
+        return;
+
+    Boot &boot = m_Boots[connection.Port];
+    boot.Title = args.size() == 2 ? args[0].Value : s_DashboardPath;
+    boot.Cold = args.size() == 1 && args[0].Name == "COLD";
+    boot.EndTime = Clock::now() + bootDuration;
+
+    // The notification goes out before the connections are closed, both at the next iteration of the server loop
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_PendingNotifications.emplace_back(connection.Port, "execution rebooting");
+    if (boot.Cold)
+        m_PendingDrops.push_back(connection.Port);
 }
 
-void TestServer::ActiveTitle(const std::vector<Arg> &args)
+void TestServer::ActiveTitle(Connection &connection, const std::vector<Arg> &args)
 {
     if (args.size() != 1)
     {
-        Send("400- wrong number of arguments provided, one expected\r\n");
+        Send(connection, "400- wrong number of arguments provided, one expected\r\n");
         return;
     }
 
     if (args[0].Name != "running")
     {
-        Send("400- argument 'running' not found\r\n");
+        Send(connection, "400- argument 'running' not found\r\n");
         return;
     }
 
+    auto activeTitle = m_ActiveTitles.find(connection.Port);
+
     std::string response =
         "202- multiline response follows\r\n"
         "timestamp=0x00000000 checksum=0x00000000\r\n"
-        "name=\"\\Device\\Harddisk0\\SystemExtPartition\\20449700\\dash.xex\"\r\n"
+        "name=\"" + (activeTitle != m_ActiveTitles.end() ? activeTitle->second : std::string(s_DashboardPath)) + "\"\r\n"
         ".\r\n";
 
-    Send(response);
+    Send(connection, response);
 }
 
-void TestServer::ConsoleType(const std::vector<Arg> &args)
+void TestServer::ConsoleType(Connection &connection, const std::vector<Arg> &args)
 {
     if (!args.empty())
     {
-        Send("400- no argument expected\r\n");
+        Send(connection, "400- no argument expected\r\n");
         return;
     }
 
-    Send("200- reviewerkit\r\n");
+    Send(connection, "200- reviewerkit\r\n");
 }
 
-void TestServer::SetSystemTime(const std::vector<Arg> &args)
+void TestServer::SetSystemTime(Connection &connection, const std::vector<Arg> &args)
 {
     if (args.size() != 2)
     {
-        Send("400- wrong number of arguments provided, 2 expected\r\n");
+        Send(connection, "400- wrong number of arguments provided, 2 expected\r\n");
         return;
     }
 
     if (args[0].Name != "clockhi")
     {
-        Send("400- argument 'clockhi' not found\r\n");
+        Send(connection, "400- argument 'clockhi' not found\r\n");
         return;
     }
 
     if (args[1].Name != "clocklo")
     {
-        Send("400- argument 'clocklo' not found\r\n");
+        Send(connection, "400- argument 'clocklo' not found\r\n");
         return;
     }
 
-    Send("200- OK\r\n");
+    Send(connection, "200- OK\r\n");
 }
 
-void TestServer::ReceiveFile(const std::vector<Arg> &args)
+void TestServer::ReceiveFile(Connection &connection, const std::vector<Arg> &args)
 {
     if (args.size() != 1)
     {
-        Send("400- wrong number of arguments provided, one expected\r\n");
+        Send(connection, "400- wrong number of arguments provided, one expected\r\n");
         return;
     }
 
     if (args[0].Name != "name")
     {
-        Send("400- argument 'name' not found\r\n");
+        Send(connection, "400- argument 'name' not found\r\n");
         return;
     }
 
-    // The client will create paths using backslashes (\) because that's what the Xbox 360 uses.
-    // For the tests we need to forward slashes (/) on POSIX systems so we patch them here.
-#ifndef _WIN32
-    std::string filePath = args[0].Value;
-    std::replace(filePath.begin(), filePath.end(), '\\', '/');
-#else
     const std::string &filePath = args[0].Value;
-#endif
 
-    // Open the requested file
-    std::ifstream inFile;
-    inFile.open(filePath, std::ifstream::binary);
-
-    if (inFile.fail())
+    if (!connection.FileSystem->Exists(filePath) || connection.FileSystem->IsDirectory(filePath))
     {
-        Send("404- Couldn't open file: " + filePath + "\r\n");
+        Send(connection, "404- Couldn't open file: " + filePath + "\r\n");
         return;
     }
 
-    // Get the file size
-    inFile.seekg(0, inFile.end);
-    int fileSize = static_cast<int>(inFile.tellg());
-    inFile.seekg(0, inFile.beg);
-
-    // Start building the response
-    std::vector<char> response;
-    std::string header = "203- binary response follows\r\n";
-
-    // The final response will contain the header, a 32-bit integer for the file size and the file content
-    // so we preallocate enough memory for that
-    response.reserve(header.size() + sizeof(fileSize) + fileSize);
-
-    // Append the header and the file size to the response
-    response.insert(response.end(), header.begin(), header.end());
-    response.insert(response.end(), reinterpret_cast<const char *>(&fileSize), reinterpret_cast<const char *>(&fileSize) + sizeof(fileSize));
-
-    // Buffer to hold file chunks while reading it
-    char buffer[s_PacketSize] = { 0 };
-
-    while (!inFile.eof())
+    // The file size is sent as a 32-bit integer so bigger files can't be sent
+    uint64_t fileSize = connection.FileSystem->FileSize(filePath);
+    if (fileSize > UINT32_MAX)
     {
-        inFile.read(buffer, sizeof(buffer));
-
-        // Append the current chunk to the response
-        response.insert(response.end(), buffer, buffer + inFile.gcount());
-
-        // Reset the buffer
-        memset(buffer, 0, sizeof(buffer));
+        Send(connection, "400- file too large: " + filePath + "\r\n");
+        return;
     }
 
-    inFile.close();
+    // The response starts with the header and a 32-bit integer for the file size
+    std::string header = "203- binary response follows\r\n";
+    uint32_t fileSize32 = static_cast<uint32_t>(fileSize);
+    header.append(reinterpret_cast<const char *>(&fileSize32), sizeof(fileSize32));
 
-    Send(response.data(), response.size());
+    Send(connection, header);
+
+    // The file content is then read as the client receives it (see TestServer::FillOutput)
+    // so that files of any size can be sent without loading them in memory
+    connection.DownloadPath = filePath;
+    connection.DownloadOffset = 0;
+    connection.DownloadRemaining = fileSize;
+    FillOutput(connection);
 }
 
-void TestServer::SendFile(const std::vector<Arg> &args)
+void TestServer::SendFile(Connection &connection, const std::vector<Arg> &args)
 {
     if (args.size() != 2)
     {
-        Send("400- wrong number of arguments provided, two expected\r\n");
+        Send(connection, "400- wrong number of arguments provided, two expected\r\n");
         return;
     }
 
     if (args[0].Name != "name")
     {
-        Send("400- argument 'name' not found\r\n");
+        Send(connection, "400- argument 'name' not found\r\n");
         return;
     }
 
     if (args[1].Name != "length")
     {
-        Send("400- argument 'length' not found\r\n");
+        Send(connection, "400- argument 'length' not found\r\n");
         return;
     }
 
-    // The client will create paths using backslashes (\) because that's what the Xbox 360 uses.
-    // For the tests we need to forward slashes (/) on POSIX systems so we patch them here.
-#ifndef _WIN32
-    std::string pathOnServer = args[0].Value;
-    std::replace(pathOnServer.begin(), pathOnServer.end(), '\\', '/');
-#else
     const std::string &pathOnServer = args[0].Value;
-#endif
 
-    // Convert the file size that came in as a hex string to a size_t
-    size_t fileSize;
+    // Convert the file size that came in as a hex string to a uint64_t
+    uint64_t fileSize;
     std::stringstream fileSizeStream;
     fileSizeStream << std::hex << args[1].Value;
     fileSizeStream >> fileSize;
 
-    // Tell the client to start sending the file content
-    Send("204- send binary data\r\n");
+    // Create the file on the server before accepting any data so that the client doesn't send
+    // the file content if we can't store it
+    connection.Upload = connection.FileSystem->CreateFile(pathOnServer);
 
-    // Create the file on the server
-    std::ofstream outFile;
-    outFile.open(pathOnServer, std::ofstream::binary);
-
-    if (outFile.fail())
+    if (connection.Upload == nullptr)
     {
-        Send("400- Couldn't create file: " + pathOnServer + "\r\n");
+        Send(connection, "400- Couldn't create file: " + pathOnServer + "\r\n");
         return;
     }
 
-    int bytes = 0;
-    size_t totalBytes = 0;
-    char contentBuffer[s_PacketSize] = { 0 };
-
-    // Receive the content of the file from the client and write it to the file on the server
-    while (totalBytes < fileSize)
-    {
-        // Wait for a little to line up with how long the client waits between each packet
-        std::this_thread::sleep_for(20ms);
-
-        if ((bytes = recv(m_ClientSocket, contentBuffer, sizeof(contentBuffer), 0)) == SOCKET_ERROR)
-        {
-            outFile.close();
-            Send("400- Couldn't receive bytes\r\n");
-            return;
-        }
-
-        totalBytes += static_cast<size_t>(bytes);
-
-        outFile.write(contentBuffer, bytes);
-
-        // Reset contentBuffer
-        memset(contentBuffer, 0, sizeof(contentBuffer));
-    }
-
-    outFile.close();
+    // From now on, the bytes received on this connection are the file content until the whole
+    // file is received (see TestServer::ProcessInput)
+    connection.UploadRemaining = fileSize;
 
-    Send("200- OK\r\n");
+    // Tell the client to start sending the file content
+    Send(connection, "204- send binary data\r\n");
 }
 
-void TestServer::DeleteFile(const std::vector<Arg> &args)
+void TestServer::DeleteFile(Connection &connection, const std::vector<Arg> &args)
 {
     if (args.size() < 1 || args.size() > 2)
     {
-        Send("400- wrong number of arguments provided, one or two expected\r\n");
+        Send(connection, "400- wrong number of arguments provided, one or two expected\r\n");
         return;
     }
 
     if (args[0].Name != "name")
     {
-        Send("400- argument 'name' not found\r\n");
+        Send(connection, "400- argument 'name' not found\r\n");
         return;
     }
 
-    // The client will create paths using backslashes (\) because that's what the Xbox 360 uses.
-    // For the tests we need to forward slashes (/) on POSIX systems so we patch them here.
-#ifndef _WIN32
-    std::string filePath = args[0].Value;
-    std::replace(filePath.begin(), filePath.end(), '\\', '/');
-#else
     const std::string &filePath = args[0].Value;
-#endif
 
-    if (!fs::exists(filePath))
+    if (!connection.FileSystem->Exists(filePath))
     {
-        Send("404- " + filePath + " not found\r\n");
+        Send(connection, "404- " + filePath + " not found\r\n");
         return;
     }
 
-    Send("200- OK\r\n");
+    Send(connection, "200- OK\r\n");
 }
 
-void TestServer::CreateDirectory(const std::vector<Arg> &args)
+void TestServer::CreateDirectory(Connection &connection, const std::vector<Arg> &args)
 {
     if (args.size() != 1)
     {
-        Send("400- wrong number of arguments provided, one expected\r\n");
+        Send(connection, "400- wrong number of arguments provided, one expected\r\n");
         return;
     }
 
     if (args[0].Name != "name")
     {
-        Send("400- argument 'name' not found\r\n");
+        Send(connection, "400- argument 'name' not found\r\n");
         return;
     }
 
-    // The client will create paths using backslashes (\) because that's what the Xbox 360 uses.
-    // For the tests we need to forward slashes (/) on POSIX systems so we patch them here.
-#ifndef _WIN32
-    std::string directoryPath = args[0].Value;
-    std::replace(directoryPath.begin(), directoryPath.end(), '\\', '/');
-#else
     const std::string &directoryPath = args[0].Value;
-#endif
-
-    fs::path parentPath = fs::path(directoryPath).parent_path();
 
-    if (fs::exists(directoryPath))
+    if (connection.FileSystem->Exists(directoryPath))
     {
-        Send("400- " + directoryPath + " already exists\r\n");
+        Send(connection, "400- " + directoryPath + " already exists\r\n");
         return;
     }
 
-    if (!fs::exists(parentPath) || !fs::is_directory(parentPath))
-    {
-        Send("400- Invalid path: " + directoryPath + "\r\n");
-        return;
-    }
-
-    bool directoryCreated = fs::create_directory(directoryPath);
+    bool directoryCreated = connection.FileSystem->CreateDirectory(directoryPath);
     if (!directoryCreated)
     {
-        Send("500- Could not create directory at location: " + directoryPath + "\r\n");
+        Send(connection, "400- Invalid path: " + directoryPath + "\r\n");
         return;
     }
 
-    Send("200- OK\r\n");
+    Send(connection, "200- OK\r\n");
 }
 
-void TestServer::RenameFile(const std::vector<Arg> &args)
+void TestServer::RenameFile(Connection &connection, const std::vector<Arg> &args)
 {
     if (args.size() != 2)
     {
-        Send("400- wrong number of arguments provided, two expected\r\n");
+        Send(connection, "400- wrong number of arguments provided, two expected\r\n");
         return;
     }
 
     if (args[0].Name != "name")
     {
-        Send("400- argument 'name' not found\r\n");
+        Send(connection, "400- argument 'name' not found\r\n");
         return;
     }
 
     if (args[1].Name != "newname")
     {
-        Send("400- argument 'newname' not found\r\n");
+        Send(connection, "400- argument 'newname' not found\r\n");
         return;
     }
 
     const std::string &oldFilePath = args[0].Value;
     const std::string &newFilePath = args[1].Value;
 
-    if (!fs::exists(oldFilePath))
+    if (!connection.FileSystem->Exists(oldFilePath))
     {
-        Send("404- " + oldFilePath + " not found\r\n");
+        Send(connection, "404- " + oldFilePath + " not found\r\n");
         return;
     }
 
-    if (fs::exists(newFilePath))
+    if (connection.FileSystem->Exists(newFilePath))
     {
-        Send("400- " + newFilePath + " already exists\r\n");
+        Send(connection, "400- " + newFilePath + " already exists\r\n");
         return;
     }
 
-    Send("200- OK\r\n");
+    Send(connection, "200- OK\r\n");
 }
 
-bool TestServer::InitServerSocket()
+// Integers are sent in hexadecimal with a 0x prefix but decimal values are accepted too
+static bool ParseInteger(const std::string &value, uint64_t &result)
 {
-    sockaddr_in address;
-    memset(&address, 0, sizeof(sockaddr_in));
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
-    address.sin_port = htons(730);
+    try
+    {
+        size_t parsedLength = 0;
+        result = std::stoull(value, &parsedLength, 0);
 
-#ifdef _WIN32
-    WSADATA wsaData;
-    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+        return parsedLength == value.size();
+    }
+    catch (const std::exception &)
+    {
         return false;
-#endif
+    }
+}
 
-    m_ServerSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (m_ServerSocket == INVALID_SOCKET)
-        return false;
+void TestServer::ReadMemory(Connection &connection, const std::vector<Arg> &args)
+{
+    if (args.size() != 2)
+    {
+        Send(connection, "400- wrong number of arguments provided, two expected\r\n");
+        return;
+    }
 
-    int yes = 1;
-    if (setsockopt(m_ServerSocket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&yes), sizeof(int)) == SOCKET_ERROR)
-        return false;
+    uint64_t address = 0;
+    if (args[0].Name != "addr" || !ParseInteger(args[0].Value, address) || address > UINT32_MAX)
+    {
+        Send(connection, "400- argument 'addr' not found\r\n");
+        return;
+    }
 
-    if (bind(m_ServerSocket, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == SOCKET_ERROR)
-        return false;
+    uint64_t length = 0;
+    if (args[1].Name != "length" || !ParseInteger(args[1].Value, length) || address + length > static_cast<uint64_t>(UINT32_MAX) + 1)
+    {
+        Send(connection, "400- argument 'length' not found\r\n");
+        return;
+    }
 
-    if (listen(m_ServerSocket, 1) == SOCKET_ERROR)
-        return false;
+    // The memory is sent in blocks starting with a 16-bit size, the high bit of the size is set
+    // when the memory of the block isn't readable and then no content follows
+    // Nothing is reserved from length, which comes from the client and can be up to 4 GB
+    std::string response = "203- binary response follows\r\n";
 
-    SignalListening(true);
+    for (uint64_t offset = 0; offset < length;)
+    {
+        uint32_t blockAddress = static_cast<uint32_t>(address + offset);
+        uint32_t maxBlockSize = static_cast<uint32_t>(std::min<uint64_t>(s_MemoryBlockSize, length - offset));
+        bool mapped = false;
+        uint32_t blockSize = connection.Memory->GetRunLength(blockAddress, maxBlockSize, mapped);
 
-    return true;
+        uint16_t blockHeader = static_cast<uint16_t>(blockSize | (mapped ? 0 : 0x8000));
+        response.append(reinterpret_cast<const char *>(&blockHeader), sizeof(blockHeader));
+
+        if (mapped)
+        {
+            size_t contentOffset = response.size();
+            response.resize(contentOffset + blockSize);
+
+            // The region can be removed in the meantime, it then reads as zeros
+            if (!connection.Memory->Read(blockAddress, &response[contentOffset], blockSize))
+                memset(&response[contentOffset], 0, blockSize);
+        }
+
+        offset += blockSize;
+    }
+
+    Send(connection, response);
 }
 
-bool TestServer::InitClientSocket()
+void TestServer::WriteMemory(Connection &connection, const std::vector<Arg> &args)
 {
-    m_ClientSocket = accept(m_ServerSocket, static_cast<sockaddr *>(nullptr), static_cast<socklen_t *>(nullptr));
-    if (m_ClientSocket == INVALID_SOCKET)
-        return false;
+    if (args.size() != 2)
+    {
+        Send(connection, "400- wrong number of arguments provided, two expected\r\n");
+        return;
+    }
+
+    uint64_t address = 0;
+    if (args[0].Name != "addr" || !ParseInteger(args[0].Value, address) || address > UINT32_MAX)
+    {
+        Send(connection, "400- argument 'addr' not found\r\n");
+        return;
+    }
+
+    const std::string &hexData = args[1].Value;
+    if (args[1].Name != "data" || hexData.size() % 2 != 0)
+    {
+        Send(connection, "400- argument 'data' not found\r\n");
+        return;
+    }
 
+    std::vector<char> data(hexData.size() / 2);
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        uint64_t byte = 0;
+        if (!ParseInteger("0x" + hexData.substr(i * 2, 2), byte))
+        {
+            Send(connection, "400- argument 'data' not found\r\n");
+            return;
+        }
+
+        data[i] = static_cast<char>(byte);
+    }
+
+    // Like on a real console, the bytes before the first one that can't be written are still set
+    size_t written = connection.Memory->Write(static_cast<uint32_t>(address), data.data(), data.size());
+
+    std::stringstream response;
+    response << "200- set 0x" << std::hex << written << " bytes\r\n";
+    Send(connection, response.str());
+}
+
+void TestServer::Notify(Connection &connection, const std::vector<Arg> &args)
+{
+    if (!args.empty())
+    {
+        Send(connection, "400- unexpected arguments\r\n");
+        return;
+    }
+
+    connection.NotificationChannel = true;
+    Send(connection, "205- now a notification channel\r\n");
+}
+
+uint32_t TestServer::GetScreenPixel(uint32_t x, uint32_t y, uint32_t frame)
+{
+    // A 64x64 white square moving 32 pixels to the right at each frame
+    uint32_t squareX = (frame * 32) % (s_ScreenWidth - 64);
+    if (x >= squareX && x < squareX + 64 && y >= 100 && y < 164)
+        return 0x00ffffff;
+
+    // The alpha is left to 0 like on the console
+    return ((x & 0xff) << 16) | ((y & 0xff) << 8) | ((x + y) & 0xff);
+}
+
+void TestServer::Screenshot(Connection &connection, const std::vector<Arg> &args)
+{
+    if (!args.empty())
+    {
+        Send(connection, "400- unexpected arguments\r\n");
+        return;
+    }
+
+    uint32_t frame = m_ScreenFrames[connection.Port]++;
+
+    // The framebuffer is tiled, with its dimensions aligned to 32 pixels, and its pixels are big-endian
+    uint32_t alignedHeight = (s_ScreenHeight + 31) & ~31u;
+    std::vector<char> framebuffer(static_cast<size_t>(s_ScreenWidth) * alignedHeight * 4);
+    for (uint32_t y = 0; y < s_ScreenHeight; y++)
+    {
+        for (uint32_t x = 0; x < s_ScreenWidth; x++)
+        {
+            uint32_t pixel = GetScreenPixel(x, y, frame);
+            char *destination = framebuffer.data() + static_cast<size_t>(XBDM::GetTiledOffset(x, y, s_ScreenWidth)) * 4;
+            destination[0] = static_cast<char>(pixel >> 24);
+            destination[1] = static_cast<char>(pixel >> 16);
+            destination[2] = static_cast<char>(pixel >> 8);
+            destination[3] = static_cast<char>(pixel);
+        }
+    }
+
+    char description[256] = { 0 };
+    snprintf(description, sizeof(description),
+        "pitch=0x%08x width=0x%08x height=0x%08x format=0x18280186 offsetx=0x00000000 offsety=0x00000000, framebuffersize=0x%08x sw=0x%08x sh=0x%08x colorspace=0x00000000\r\n",
+        s_ScreenWidth * 4, s_ScreenWidth, s_ScreenHeight, static_cast<uint32_t>(framebuffer.size()), s_ScreenWidth, s_ScreenHeight);
+
+    Send(connection, std::string("203- binary response follows\r\n") + description);
+    Send(connection, framebuffer.data(), framebuffer.size());
+}
+
+static bool SetNonBlocking(SOCKET socket)
+{
     // clang-format off
 
-    // Mark the client socket as nonblocking
     int setToNonBlockingResult = 0;
 #ifdef _WIN32
     unsigned long nonBlocking = 1;
-    setToNonBlockingResult = ioctlsocket(m_ClientSocket, FIONBIO, &nonBlocking);
+    setToNonBlockingResult = ioctlsocket(socket, FIONBIO, &nonBlocking);
 #else
-    int flags = fcntl(m_ClientSocket, F_GETFL, 0);
+    int flags = fcntl(socket, F_GETFL, 0);
     if (flags == SOCKET_ERROR)
         return false;
 
     flags |= O_NONBLOCK;
-    setToNonBlockingResult = fcntl(m_ClientSocket, F_SETFL, flags);
+    setToNonBlockingResult = fcntl(socket, F_SETFL, flags);
 #endif
 
-    if (setToNonBlockingResult != 0)
+    // clang-format on
+
+    return setToNonBlockingResult == 0;
+}
+
+bool TestServer::InitServerSockets()
+{
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
         return false;
+#endif
 
-    // clang-format on
+    for (auto &listener : m_Listeners)
+    {
+        sockaddr_in address;
+        memset(&address, 0, sizeof(sockaddr_in));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(listener.Port);
+
+        listener.Socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (listener.Socket == INVALID_SOCKET)
+            return false;
+
+        int yes = 1;
+        if (setsockopt(listener.Socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&yes), sizeof(int)) == SOCKET_ERROR)
+            return false;
+
+        if (bind(listener.Socket, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == SOCKET_ERROR)
+            return false;
+
+        if (listen(listener.Socket, SOMAXCONN) == SOCKET_ERROR)
+            return false;
+
+        // Accepting is driven by the poller so it must never block
+        if (!SetNonBlocking(listener.Socket))
+            return false;
+
+        if (!m_Poller.Add(listener.Socket, Poller::Readable))
+            return false;
+    }
+
+    if (m_DiscoveryPort != 0)
+    {
+        sockaddr_in address;
+        memset(&address, 0, sizeof(sockaddr_in));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(m_DiscoveryPort);
+
+        m_DiscoverySocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (m_DiscoverySocket == INVALID_SOCKET)
+            return false;
+
+        if (bind(m_DiscoverySocket, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == SOCKET_ERROR)
+            return false;
+
+        if (!SetNonBlocking(m_DiscoverySocket) || !m_Poller.Add(m_DiscoverySocket, Poller::Readable))
+            return false;
+    }
+
+    SignalListening(true);
 
     return true;
 }
 
 bool TestServer::Run()
 {
-    char buffer[s_PacketSize + 1] = { 0 };
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (!m_Listening)
+                break;
+        }
+
+        // Wake up regularly even if nothing happens to notice shutdown requests
+        Clock::time_point now = Clock::now();
+        Clock::time_point nextWakeUp = now + 50ms;
+
+        FinishBoots(now, nextWakeUp);
+
+        for (auto &[socket, connection] : m_Connections)
+            UpdateInterest(*connection, now, nextWakeUp);
 
-    while (m_Listening)
+        auto timeout = std::chrono::ceil<std::chrono::milliseconds>(nextWakeUp - now);
+        std::vector<Poller::Event> events = m_Poller.Wait(std::max(timeout, 0ms));
+
+        SendPendingNotifications();
+        DropPendingConnections();
+
+        for (auto &event : events)
+        {
+            if (event.Socket == m_DiscoverySocket)
+            {
+                AnswerNameRequests();
+                continue;
+            }
+
+            auto listener = std::find_if(m_Listeners.begin(), m_Listeners.end(), [&](const Listener &listener) { return listener.Socket == event.Socket; });
+            if (listener != m_Listeners.end())
+            {
+                AcceptConnections(*listener);
+                continue;
+            }
+
+            auto connection = m_Connections.find(event.Socket);
+            if (connection == m_Connections.end())
+                continue;
+
+            // Errors are detected by recv so both cases are handled the same way
+            bool open = true;
+            if (event.Readable || event.Error)
+                open = ReadFromConnection(*connection->second);
+
+            // Reading might have generated replies that can be sent right away
+            if (open)
+                open = WriteToConnection(*connection->second);
+
+            if (!open)
+                CloseConnection(event.Socket);
+        }
+    }
+
+    return true;
+}
+
+void TestServer::AnswerNameRequests()
+{
+    for (;;)
     {
-        if (recv(m_ClientSocket, buffer, s_PacketSize, 0) <= 0)
+        std::array<char, 512> request;
+        sockaddr_in sender;
+        socklen_t senderLength = sizeof(sender);
+
+        int received = recvfrom(m_DiscoverySocket, request.data(), static_cast<int>(request.size()), 0, reinterpret_cast<sockaddr *>(&sender), &senderLength);
+        if (received < 2)
+            return;
+
+        // A request is a type byte, 1 for a name and 3 for any console, followed by the length of
+        // the name and the name. Every console matching replies with 2 followed by its name.
+        uint8_t type = static_cast<uint8_t>(request[0]);
+        size_t nameLength = static_cast<uint8_t>(request[1]);
+        if ((type != 1 && type != 3) || static_cast<size_t>(received) < 2 + nameLength)
             continue;
 
-        Command command = Parse(buffer);
+        std::string name(request.data() + 2, nameLength);
 
-        memset(buffer, 0, sizeof(buffer));
+        for (const Listener &listener : m_Listeners)
+        {
+            if (type == 1 && listener.ConsoleName != name)
+                continue;
 
-        if (m_CommandMap.find(command.Name) != m_CommandMap.end())
-            m_CommandMap.at(command.Name)(command.Args);
+            std::string reply = { 2, static_cast<char>(listener.ConsoleName.size()) };
+            reply += listener.ConsoleName;
+            sendto(m_DiscoverySocket, reply.data(), static_cast<int>(reply.size()), 0, reinterpret_cast<const sockaddr *>(&sender), senderLength);
+        }
     }
+}
 
-    return true;
+void TestServer::AcceptConnections(const Listener &listener)
+{
+    for (;;)
+    {
+        SOCKET clientSocket = accept(listener.Socket, static_cast<sockaddr *>(nullptr), static_cast<socklen_t *>(nullptr));
+        if (clientSocket == INVALID_SOCKET)
+            return;
+
+        // A console booting after a cold reboot isn't listening yet
+        auto boot = m_Boots.find(listener.Port);
+        if (boot != m_Boots.end() && boot->second.Cold)
+        {
+            CloseSocket(clientSocket);
+            continue;
+        }
+
+        // Disable Nagle's algorithm so that the only delays are the ones from the simulated network conditions
+        int yes = 1;
+        if (!SetNonBlocking(clientSocket) ||
+            setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&yes), sizeof(int)) == SOCKET_ERROR ||
+            !m_Poller.Add(clientSocket, Poller::Readable))
+        {
+            CloseSocket(clientSocket);
+            continue;
+        }
+
+        auto connection = std::make_unique<Connection>();
+        connection->Socket = clientSocket;
+        connection->Port = listener.Port;
+        connection->ConsoleName = listener.ConsoleName;
+        connection->FileSystem = listener.FileSystem != nullptr ? listener.FileSystem : m_Storage;
+        connection->Memory = listener.Memory;
+        connection->Interest = Poller::Readable;
+
+        std::shared_ptr<Replay> replay;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            auto replayIt = m_Replays.find(listener.Port);
+            if (replayIt != m_Replays.end())
+                replay = replayIt->second;
+        }
+
+        bool open = true;
+        if (replay != nullptr)
+        {
+            connection->Replay = std::make_unique<ReplayState>();
+            connection->Replay->Source = replay;
+            connection->Replay->Session = &replay->Sessions[replay->NextSession];
+            connection->Replay->AnchorTime = Clock::now();
+            connection->Replay->AnchorTimestamp = connection->Replay->Session->StartTimestamp;
+            replay->NextSession = (replay->NextSession + 1) % replay->Sessions.size();
+
+            if (connection->Replay->Session->SendBanner)
+                Send(*connection, "201- connected\r\n");
+
+            open = AdvanceReplay(*connection);
+        }
+        else
+            Send(*connection, "201- connected\r\n");
+
+        open = open && WriteToConnection(*connection);
+
+        m_Connections[clientSocket] = std::move(connection);
+
+        if (!open)
+            CloseConnection(clientSocket);
+    }
 }
 
-bool TestServer::Send(const std::string &response)
+bool TestServer::ReadFromConnection(Connection &connection)
 {
-    return Send(response.c_str(), response.size());
+    char buffer[s_ReceiveBufferSize];
+
+    int bytes = recv(connection.Socket, buffer, sizeof(buffer), 0);
+
+    // The client closed the connection
+    if (bytes == 0)
+        return false;
+
+    if (bytes == SOCKET_ERROR)
+        return IsWouldBlockError();
+
+    connection.Input.append(buffer, static_cast<size_t>(bytes));
+
+    // Simulate the bandwidth of the client to server direction by not reading anything else
+    // until the bytes just received would have been transferred
+    NetworkConditions conditions = GetNetworkConditions();
+    if (conditions.Bandwidth > 0)
+        connection.ReadResumeTime = Clock::now() + std::chrono::microseconds(static_cast<uint64_t>(bytes) * 1000000 / conditions.Bandwidth);
+
+    if (connection.Replay != nullptr)
+        return AdvanceReplay(connection);
+
+    ProcessInput(connection);
+
+    return !connection.Dropped;
 }
 
-bool TestServer::Send(const char *buffer, size_t length)
+bool TestServer::AdvanceReplay(Connection &connection)
 {
-    int sent = 0;
-    size_t totalSent = 0;
+    ReplayState &replay = *connection.Replay;
+    const std::vector<XBDM::TraceEvent> &events = replay.Session->Events;
+    Clock::time_point now = Clock::now();
 
-    // Send data in chunks of s_PacketSize bytes at most to simulate packets
-    for (size_t i = 0; i < length; i += s_PacketSize)
+    for (; replay.NextEvent < events.size(); replay.NextEvent++)
     {
-        size_t toSend = std::min<size_t>(s_PacketSize, length - totalSent);
-        if ((sent = send(m_ClientSocket, buffer + i, static_cast<int>(toSend), 0)) == SOCKET_ERROR)
+        const XBDM::TraceEvent &event = events[replay.NextEvent];
+
+        // Replies are sent after the same delay as in the trace, counted from the previous event
+        if (event.EventType == XBDM::TraceEvent::Type::Received)
         {
-            Shutdown();
-            return false;
+            auto recordedDelay = std::chrono::duration_cast<std::chrono::microseconds>((event.Timestamp - replay.AnchorTimestamp) * replay.Source->TimeScale);
+            Clock::time_point releaseTime = replay.AnchorTime + recordedDelay;
+
+            Enqueue(connection, event.Data.data(), event.Data.size(), std::max(std::chrono::duration_cast<std::chrono::microseconds>(releaseTime - now), 0us));
+
+            replay.AnchorTime = std::max(releaseTime, now);
+            replay.AnchorTimestamp = event.Timestamp;
+            continue;
         }
 
-        totalSent += static_cast<size_t>(sent);
+        if (event.EventType != XBDM::TraceEvent::Type::Sent)
+            continue;
+
+        // The client has to send what was sent during the recording before the session can go on
+        size_t toMatch = std::min(event.Data.size() - replay.MatchedBytes, connection.Input.size());
+        if (connection.Input.compare(0, toMatch, event.Data, replay.MatchedBytes, toMatch) != 0)
+            return false;
+
+        connection.Input.erase(0, toMatch);
+        replay.MatchedBytes += toMatch;
+
+        if (replay.MatchedBytes < event.Data.size())
+            return true;
+
+        replay.MatchedBytes = 0;
+        replay.AnchorTime = now;
+        replay.AnchorTimestamp = event.Timestamp;
     }
 
+    // The session is over, whatever the client sends now is ignored
+    connection.Input.clear();
+
     return true;
 }
 
+bool TestServer::WriteToConnection(Connection &connection)
+{
+    Clock::time_point now = Clock::now();
+    bool wasDownloading = connection.DownloadRemaining > 0;
+
+    while (!connection.Output.empty() && connection.Output.front().ReleaseTime <= now)
+    {
+        const Segment &segment = connection.Output.front();
+        size_t toSend = segment.Data.size() - connection.OutputOffset;
+
+        int sent = send(connection.Socket, segment.Data.data() + connection.OutputOffset, static_cast<int>(toSend), SEND_FLAGS);
+        if (sent == SOCKET_ERROR)
+            return IsWouldBlockError();
+
+        connection.OutputOffset += static_cast<size_t>(sent);
+
+        // The send buffer is full, the rest will be sent when the socket becomes writable again
+        if (connection.OutputOffset < segment.Data.size())
+            return true;
+
+        connection.Output.pop_front();
+        connection.OutputOffset = 0;
+
+        // Keep the output queue filled while a file is being sent
+        if (connection.Output.empty() && connection.DownloadRemaining > 0 && !FillOutput(connection))
+            return false;
+    }
+
+    if (connection.DownloadRemaining > 0 && !FillOutput(connection))
+        return false;
+
+    // Commands received during the download were put on hold to keep the replies in order
+    if (wasDownloading && connection.DownloadRemaining == 0)
+        ProcessInput(connection);
+
+    return true;
+}
+
+bool TestServer::FillOutput(Connection &connection)
+{
+    size_t queuedBytes = 0;
+    for (const Segment &segment : connection.Output)
+        queuedBytes += segment.Data.size();
+
+    std::vector<char> buffer;
+    while (connection.DownloadRemaining > 0 && queuedBytes < s_OutputHighWatermark)
+    {
+        size_t toRead = static_cast<size_t>(std::min<uint64_t>(s_DownloadChunkSize, connection.DownloadRemaining));
+        buffer.resize(toRead);
+
+        // The size was already sent so the connection can't be used anymore if the file
+        // became shorter in the meantime
+        size_t bytesRead = connection.FileSystem->Read(connection.DownloadPath, connection.DownloadOffset, buffer.data(), toRead);
+        if (bytesRead != toRead)
+            return false;
+
+        // The chunks are part of the reply that started with the header so they are
+        // not delayed again by the latency
+        Enqueue(connection, buffer.data(), bytesRead, std::chrono::microseconds(0));
+
+        connection.DownloadOffset += bytesRead;
+        connection.DownloadRemaining -= bytesRead;
+        queuedBytes += bytesRead;
+    }
+
+    return true;
+}
+
+void TestServer::ProcessInput(Connection &connection)
+{
+    // Nothing sent on a notification channel is interpreted
+    if (connection.NotificationChannel)
+    {
+        connection.Input.clear();
+        return;
+    }
+
+    for (;;)
+    {
+        // While a file is being uploaded, everything received is the file content
+        if (connection.Upload != nullptr)
+        {
+            size_t toWrite = static_cast<size_t>(std::min<uint64_t>(connection.UploadRemaining, connection.Input.size()));
+            // If writing failed, the rest of the file is still received but discarded
+            // so that it doesn't get interpreted as commands
+            if (!connection.UploadFailed && !connection.Upload->Write(connection.Input.data(), toWrite))
+                connection.UploadFailed = true;
+
+            connection.Input.erase(0, toWrite);
+            connection.UploadRemaining -= toWrite;
+
+            if (connection.UploadRemaining > 0)
+                return;
+
+            connection.Upload.reset();
+            Send(connection, connection.UploadFailed ? "400- Couldn't write file\r\n" : "200- OK\r\n");
+            continue;
+        }
+
+        // The reply to the next command can't be queued before the end of the file being sent
+        if (connection.DownloadRemaining > 0)
+            return;
+
+        // Clients can send several commands without waiting for the responses
+        // so each complete line is processed as a separate command
+        size_t endPos = connection.Input.find("\r\n");
+        if (endPos == std::string::npos)
+            return;
+
+        Command command = Parse(connection.Input.substr(0, endPos + 2));
+        connection.Input.erase(0, endPos + 2);
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_CommandCounts[{ connection.Port, command.Name }]++;
+
+            if (m_DropOnNextCommand.erase(connection.Port) > 0)
+            {
+                connection.Dropped = true;
+                return;
+            }
+        }
+
+        auto handler = m_CommandMap.find(command.Name);
+        if (handler != m_CommandMap.end())
+            handler->second(connection, command.Args);
+        else
+            Send(connection, "407- unknown command\r\n");
+    }
+}
+
+void TestServer::UpdateInterest(Connection &connection, Clock::time_point now, Clock::time_point &nextWakeUp)
+{
+    int interest = Poller::None;
+
+    if (now >= connection.ReadResumeTime)
+        interest |= Poller::Readable;
+    else
+        nextWakeUp = std::min(nextWakeUp, connection.ReadResumeTime);
+
+    if (!connection.Output.empty())
+    {
+        if (connection.Output.front().ReleaseTime <= now)
+            interest |= Poller::Writable;
+        else
+            nextWakeUp = std::min(nextWakeUp, connection.Output.front().ReleaseTime);
+    }
+    else if (connection.DownloadRemaining > 0)
+        interest |= Poller::Writable;
+
+    if (interest != connection.Interest && m_Poller.Modify(connection.Socket, interest))
+        connection.Interest = interest;
+}
+
+void TestServer::CloseConnection(SOCKET socket)
+{
+    m_Poller.Remove(socket);
+    CloseSocket(socket);
+    m_Connections.erase(socket);
+}
+
+void TestServer::DropConnections(uint16_t port)
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    m_PendingDrops.push_back(port);
+    m_Cond.wait(lock, [&]() { return m_PendingDrops.empty() || !m_Listening; });
+}
+
+void TestServer::DropConnectionOnNextCommand(uint16_t port)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_DropOnNextCommand.insert(port);
+}
+
+void TestServer::DropPendingConnections()
+{
+    std::vector<uint16_t> ports;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        ports.swap(m_PendingDrops);
+    }
+
+    if (ports.empty())
+        return;
+
+    std::vector<SOCKET> dropped;
+    for (auto &[socket, connection] : m_Connections)
+    {
+        if (std::find(ports.begin(), ports.end(), connection->Port) != ports.end())
+            dropped.push_back(socket);
+    }
+
+    for (SOCKET socket : dropped)
+        CloseConnection(socket);
+
+    m_Cond.notify_all();
+}
+
+uint64_t TestServer::GetCommandCount(uint16_t port, const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    auto count = m_CommandCounts.find({ port, name });
+
+    return count != m_CommandCounts.end() ? count->second : 0;
+}
+
+void TestServer::SetBootDuration(uint16_t port, std::chrono::milliseconds duration)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_BootDurations[port] = duration;
+}
+
+void TestServer::FinishBoots(Clock::time_point now, Clock::time_point &nextWakeUp)
+{
+    bool finished = false;
+    for (auto boot = m_Boots.begin(); boot != m_Boots.end();)
+    {
+        if (boot->second.EndTime > now)
+        {
+            nextWakeUp = std::min(nextWakeUp, boot->second.EndTime);
+            ++boot;
+            continue;
+        }
+
+        m_ActiveTitles[boot->first] = boot->second.Title;
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_PendingNotifications.emplace_back(boot->first, "execution started");
+        }
+
+        boot = m_Boots.erase(boot);
+        finished = true;
+    }
+
+    // Without waiting for the next iteration of the server loop
+    if (finished)
+        SendPendingNotifications();
+}
+
+void TestServer::SendPendingNotifications()
+{
+    std::vector<std::pair<uint16_t, std::string>> notifications;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        notifications.swap(m_PendingNotifications);
+    }
+
+    if (notifications.empty())
+        return;
+
+    std::vector<SOCKET> closed;
+    for (auto &[socket, connection] : m_Connections)
+    {
+        if (!connection->NotificationChannel)
+            continue;
+
+        for (const auto &[port, line] : notifications)
+        {
+            if (port == connection->Port)
+                Send(*connection, line + "\r\n");
+        }
+
+        if (!WriteToConnection(*connection))
+            closed.push_back(socket);
+    }
+
+    for (SOCKET socket : closed)
+        CloseConnection(socket);
+}
+
+void TestServer::Send(Connection &connection, const std::string &response)
+{
+    Send(connection, response.c_str(), response.size());
+}
+
+void TestServer::Send(Connection &connection, const char *buffer, size_t length)
+{
+    NetworkConditions conditions = GetNetworkConditions();
+    std::chrono::microseconds delay = conditions.Latency;
+
+    if (conditions.Jitter.count() > 0)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        std::uniform_int_distribution<int64_t> distribution(0, conditions.Jitter.count());
+        delay += std::chrono::microseconds(distribution(m_RandomGenerator));
+    }
+
+    Enqueue(connection, buffer, length, delay);
+}
+
+void TestServer::Enqueue(Connection &connection, const char *buffer, size_t length, std::chrono::microseconds delay)
+{
+    NetworkConditions conditions = GetNetworkConditions();
+
+    auto transmissionTime = [&](size_t bytes) {
+        if (conditions.Bandwidth == 0)
+            return std::chrono::microseconds(0);
+
+        return std::chrono::microseconds(bytes * 1000000 / conditions.Bandwidth);
+    };
+
+    // Replies are sent in order so a reply can't start before the previous one is fully sent
+    Clock::time_point releaseTime = Clock::now() + delay;
+    if (!connection.Output.empty())
+    {
+        const Segment &lastSegment = connection.Output.back();
+        releaseTime = std::max(releaseTime, lastSegment.ReleaseTime + transmissionTime(lastSegment.Data.size()));
+    }
+
+    size_t segmentSize = std::max<size_t>(conditions.SegmentSize, 1);
+
+    // Split the data in segments of segmentSize bytes at most to simulate packets
+    for (size_t offset = 0; offset < length; offset += segmentSize)
+    {
+        size_t size = std::min<size_t>(segmentSize, length - offset);
+
+        // A small segment at the end of a reply is held back until the previous segments are acknowledged
+        if (offset > 0 && size < segmentSize)
+            releaseTime += conditions.DelayedAck;
+
+        connection.Output.push_back({ std::string(buffer + offset, size), releaseTime });
+
+        releaseTime += transmissionTime(size);
+    }
+}
+
+TestServer::NetworkConditions TestServer::GetNetworkConditions()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    return m_NetworkConditions;
+}
+
 void TestServer::SignalListening(bool isListening)
 {
     // Wait to get ownership of the mutex
@@ -693,28 +1438,35 @@ void TestServer::SignalListening(bool isListening)
     m_Cond.notify_all();
 }
 
-#ifdef _WIN32
-    #define CloseSocket(socket) closesocket(socket)
-#else
-    #define CloseSocket(socket) close(socket)
-#endif
-
 void TestServer::Shutdown()
 {
     if (m_Listening)
         SignalListening(false);
 
-    if (m_ServerSocket != INVALID_SOCKET)
+    for (auto &listener : m_Listeners)
     {
-        CloseSocket(m_ServerSocket);
-        m_ServerSocket = INVALID_SOCKET;
+        if (listener.Socket != INVALID_SOCKET)
+        {
+            m_Poller.Remove(listener.Socket);
+            CloseSocket(listener.Socket);
+            listener.Socket = INVALID_SOCKET;
+        }
     }
 
-    if (m_ClientSocket != INVALID_SOCKET)
+    if (m_DiscoverySocket != INVALID_SOCKET)
     {
-        CloseSocket(m_ClientSocket);
-        m_ClientSocket = INVALID_SOCKET;
+        m_Poller.Remove(m_DiscoverySocket);
+        CloseSocket(m_DiscoverySocket);
+        m_DiscoverySocket = INVALID_SOCKET;
     }
+
+    for (auto &[socket, connection] : m_Connections)
+    {
+        m_Poller.Remove(socket);
+        CloseSocket(socket);
+    }
+
+    m_Connections.clear();
 }
 
 TestServer::Command TestServer::Parse(const std::string &commandString)
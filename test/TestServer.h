@@ -4,8 +4,14 @@
 #include <condition_variable>
 #include <string>
 #include <vector>
+#include <set>
+#include <map>
+#include <deque>
+#include <memory>
 #include <unordered_map>
 #include <functional>
+#include <chrono>
+#include <random>
 
 #ifdef _WIN32
     #include <WinSock2.h>
@@ -15,8 +21,14 @@
     #include <netdb.h>
     #include <unistd.h>
     #include <fcntl.h>
+    #include <netinet/tcp.h>
 #endif
 
+#include "XBDM.h"
+#include "Poller.h"
+#include "Storage.h"
+#include "MemorySpace.h"
+
 #ifdef _WIN32
 // clang-format off
     typedef int socklen_t;
@@ -31,43 +43,258 @@
 class TestServer
 {
 public:
+    // Conditions of the simulated link between the server and the client. The default
+    // values reply instantly, in packets of s_PacketSize bytes.
+    struct NetworkConditions
+    {
+        // Delay before each reply starts being sent
+        std::chrono::microseconds Latency = std::chrono::microseconds(0);
+
+        // Upper bound of a random delay added to Latency, drawn from a generator seeded
+        // with Seed so that runs are reproducible
+        std::chrono::microseconds Jitter = std::chrono::microseconds(0);
+        uint32_t Seed = 0;
+
+        // Bytes per second in each direction, 0 means unlimited
+        uint64_t Bandwidth = 0;
+
+        // Replies are split into segments of at most SegmentSize bytes, each sent separately
+        size_t SegmentSize = s_PacketSize;
+
+        // Delay before sending the last segment of a reply when it is smaller than SegmentSize,
+        // like a sender running Nagle's algorithm waiting for the receiver's delayed ACK
+        std::chrono::microseconds DelayedAck = std::chrono::microseconds(0);
+    };
+
     TestServer();
+    ~TestServer();
+
+    // Emulates an additional console listening on port, must be called before Start.
+    // The default console, named TestXDK, always listens on port 730. Consoles added without
+    // their own storage share the one given to SetStorage.
+    void AddConsole(uint16_t port, const std::string &name, std::shared_ptr<Storage> storage = nullptr);
+
+    // Answers the name requests sent over UDP on port, as each console would on the network,
+    // must be called before Start
+    void EnableDiscovery(uint16_t port);
 
     void Start();
 
     void WaitForServerToListen();
     void RequestShutdown();
 
+    void SetNetworkConditions(const NetworkConditions &conditions);
+
+    // Replaces where the served files are stored, must be called before Start.
+    // The default storage is the local disk.
+    void SetStorage(std::shared_ptr<Storage> storage);
+
+    // Makes the connections accepted from now on on port replay a trace recorded with
+    // Console::StartRecording instead of running commands. The trace is split in sessions at
+    // its Connected events and each connection replays the next session, starting over after
+    // the last one. The recorded replies are sent once the client sent the same bytes as in the
+    // trace, with the recorded delays multiplied by timeScale (0 replies as fast as possible).
+    // A connection sending something else is closed. An empty trace stops replaying.
+    void SetReplay(uint16_t port, const std::vector<XBDM::TraceEvent> &trace, double timeScale = 1.0);
+
+    // Address space read and written by the memory commands of the console listening on port,
+    // each console has its own and it starts empty. nullptr if no console listens on port.
+    std::shared_ptr<MemorySpace> GetMemory(uint16_t port);
+
+    // Sends line, without its line ending, on the notification channels opened with the notify
+    // command to the console listening on port. Can be called from any thread, the line is sent
+    // at the next iteration of the server loop.
+    void SendNotification(uint16_t port, const std::string &line);
+
+    // Closes the connections to the console listening on port, like when it reboots. Can be
+    // called from any thread, returns once they are closed.
+    void DropConnections(uint16_t port);
+
+    // The next command received by the console listening on port closes its connection instead
+    // of running, like a console rebooting before responding
+    void DropConnectionOnNextCommand(uint16_t port);
+
+    // Number of commands named name the console listening on port received, whether they
+    // succeeded or not. Can be called from any thread.
+    uint64_t GetCommandCount(uint16_t port, const std::string &name);
+
+    // Makes magicboot take duration to boot the console listening on port, 0 (the default) keeping
+    // it on its dashboard whatever magicboot asks. Booting sends "execution rebooting" on the
+    // notification channels, a cold reboot also closes the connections and refuses new ones until
+    // booted. Once booted, the title launched (the dashboard after a reboot) is the active title and
+    // "execution started" is sent. Can be called from any thread.
+    void SetBootDuration(uint16_t port, std::chrono::milliseconds duration);
+
+    // Pixel, as a 32-bit ARGB value, of the synthetic framebuffer served by the screenshot command.
+    // Each screenshot of a console is the next frame, where a square moved over the gradient.
+    static uint32_t GetScreenPixel(uint32_t x, uint32_t y, uint32_t frame);
+
+    static constexpr uint32_t s_ScreenWidth = 1280;
+    static constexpr uint32_t s_ScreenHeight = 720;
+
 private:
-    SOCKET m_ServerSocket;
-    SOCKET m_ClientSocket;
+    using Clock = std::chrono::steady_clock;
+
+    struct Listener
+    {
+        SOCKET Socket = INVALID_SOCKET;
+        uint16_t Port = 0;
+        std::string ConsoleName;
+        std::shared_ptr<Storage> FileSystem;
+        std::shared_ptr<MemorySpace> Memory;
+    };
+
+    // Boot started by magicboot on a console with a boot duration
+    struct Boot
+    {
+        std::string Title;
+        bool Cold = false;
+        Clock::time_point EndTime;
+    };
+
+    struct ReplaySession
+    {
+        std::vector<XBDM::TraceEvent> Events;
+        std::chrono::microseconds StartTimestamp = std::chrono::microseconds(0);
+
+        // Recordings started after the connection was opened don't contain the connection banner
+        bool SendBanner = false;
+    };
+
+    struct Replay
+    {
+        std::vector<ReplaySession> Sessions;
+        double TimeScale = 1.0;
+        size_t NextSession = 0;
+    };
+
+    // Progress of a connection through the session it replays. The anchor is the last event
+    // that happened, the next reply is sent relative to when it happened.
+    struct ReplayState
+    {
+        std::shared_ptr<Replay> Source;
+        const ReplaySession *Session = nullptr;
+        size_t NextEvent = 0;
+        size_t MatchedBytes = 0;
+        Clock::time_point AnchorTime;
+        std::chrono::microseconds AnchorTimestamp = std::chrono::microseconds(0);
+    };
+
+    struct Segment
+    {
+        std::string Data;
+        Clock::time_point ReleaseTime;
+    };
+
+    // Everything the server knows about a client, each connection being independent
+    // from the others
+    struct Connection
+    {
+        SOCKET Socket = INVALID_SOCKET;
+        uint16_t Port = 0;
+        std::string ConsoleName;
+        std::shared_ptr<Storage> FileSystem;
+        std::shared_ptr<MemorySpace> Memory;
+
+        // Set once the client sent notify, the console then only sends notifications
+        bool NotificationChannel = false;
+
+        // Set when the connection is to be closed by the server
+        bool Dropped = false;
+
+        // Bytes received but not processed yet
+        std::string Input;
+
+        // Replies waiting to be sent, each segment can't be sent before its release time
+        std::deque<Segment> Output;
+        size_t OutputOffset = 0;
+
+        // Set while receiving the content of a file sent with sendfile
+        std::unique_ptr<Storage::FileWriter> Upload;
+        uint64_t UploadRemaining = 0;
+        bool UploadFailed = false;
+
+        // Set while sending the content of a file requested with getfile, the file
+        // is read in chunks as the output queue empties
+        std::string DownloadPath;
+        uint64_t DownloadOffset = 0;
+        uint64_t DownloadRemaining = 0;
+
+        // Set when the connection replays a trace instead of running commands
+        std::unique_ptr<ReplayState> Replay;
+
+        // Used to simulate the bandwidth of the client to server direction
+        Clock::time_point ReadResumeTime;
+
+        int Interest = Poller::None;
+    };
+
+    std::vector<Listener> m_Listeners;
+    uint16_t m_DiscoveryPort = 0;
+    SOCKET m_DiscoverySocket = INVALID_SOCKET;
+    std::unordered_map<SOCKET, std::unique_ptr<Connection>> m_Connections;
+    Poller m_Poller;
     bool m_Listening;
     static const int s_PacketSize = 1024;
+    static const int s_ReceiveBufferSize = 64 * 1024;
+    static constexpr size_t s_DownloadChunkSize = 64 * 1024;
+    static constexpr size_t s_OutputHighWatermark = 256 * 1024;
+    static constexpr uint32_t s_MemoryBlockSize = 1024;
     std::mutex m_Mutex;
     std::condition_variable m_Cond;
+    NetworkConditions m_NetworkConditions;
+    std::mt19937 m_RandomGenerator;
+    std::shared_ptr<Storage> m_Storage;
+    std::unordered_map<uint16_t, std::shared_ptr<Replay>> m_Replays;
+    std::vector<std::pair<uint16_t, std::string>> m_PendingNotifications;
+    std::vector<uint16_t> m_PendingDrops;
+    std::set<uint16_t> m_DropOnNextCommand;
+    std::map<std::pair<uint16_t, std::string>, uint64_t> m_CommandCounts;
+    std::unordered_map<uint16_t, uint32_t> m_ScreenFrames;
+    std::unordered_map<uint16_t, std::chrono::milliseconds> m_BootDurations;
+    std::unordered_map<uint16_t, Boot> m_Boots;
+    std::unordered_map<uint16_t, std::string> m_ActiveTitles;
+    static constexpr const char *s_DashboardPath = "\\Device\\Harddisk0\\SystemExtPartition\\20449700\\dash.xex";
 
     struct Arg;
 
-    void ConsoleName(const std::vector<Arg> &args);
-    void DriveList(const std::vector<Arg> &args);
-    void DriveFreeSpace(const std::vector<Arg> &args);
-    void DirectoryContents(const std::vector<Arg> &args);
-    void FileAttributes(const std::vector<Arg> &args);
-    void MagicBoot(const std::vector<Arg> &args);
-    void ActiveTitle(const std::vector<Arg> &args);
-    void ConsoleType(const std::vector<Arg> &args);
-    void SetSystemTime(const std::vector<Arg> &args);
-    void ReceiveFile(const std::vector<Arg> &args);
-    void SendFile(const std::vector<Arg> &args);
-    void DeleteFile(const std::vector<Arg> &args);
-    void CreateDirectory(const std::vector<Arg> &args);
-    void RenameFile(const std::vector<Arg> &args);
-
-    bool InitServerSocket();
-    bool InitClientSocket();
+    void ConsoleName(Connection &connection, const std::vector<Arg> &args);
+    void DriveList(Connection &connection, const std::vector<Arg> &args);
+    void DriveFreeSpace(Connection &connection, const std::vector<Arg> &args);
+    void DirectoryContents(Connection &connection, const std::vector<Arg> &args);
+    void FileAttributes(Connection &connection, const std::vector<Arg> &args);
+    void MagicBoot(Connection &connection, const std::vector<Arg> &args);
+    void ActiveTitle(Connection &connection, const std::vector<Arg> &args);
+    void ConsoleType(Connection &connection, const std::vector<Arg> &args);
+    void SetSystemTime(Connection &connection, const std::vector<Arg> &args);
+    void ReceiveFile(Connection &connection, const std::vector<Arg> &args);
+    void SendFile(Connection &connection, const std::vector<Arg> &args);
+    void DeleteFile(Connection &connection, const std::vector<Arg> &args);
+    void CreateDirectory(Connection &connection, const std::vector<Arg> &args);
+    void RenameFile(Connection &connection, const std::vector<Arg> &args);
+    void ReadMemory(Connection &connection, const std::vector<Arg> &args);
+    void WriteMemory(Connection &connection, const std::vector<Arg> &args);
+    void Notify(Connection &connection, const std::vector<Arg> &args);
+    void Screenshot(Connection &connection, const std::vector<Arg> &args);
+
+    bool InitServerSockets();
     bool Run();
-    bool Send(const std::string &response);
-    bool Send(const char *buffer, size_t length);
+    void AcceptConnections(const Listener &listener);
+    void AnswerNameRequests();
+    bool ReadFromConnection(Connection &connection);
+    bool WriteToConnection(Connection &connection);
+    bool FillOutput(Connection &connection);
+    void ProcessInput(Connection &connection);
+    bool AdvanceReplay(Connection &connection);
+    void UpdateInterest(Connection &connection, Clock::time_point now, Clock::time_point &nextWakeUp);
+    void CloseConnection(SOCKET socket);
+    void SendPendingNotifications();
+    void DropPendingConnections();
+    void FinishBoots(Clock::time_point now, Clock::time_point &nextWakeUp);
+    void Send(Connection &connection, const std::string &response);
+    void Send(Connection &connection, const char *buffer, size_t length);
+    void Enqueue(Connection &connection, const char *buffer, size_t length, std::chrono::microseconds delay);
+    NetworkConditions GetNetworkConditions();
     void SignalListening(bool isListening);
     void Shutdown();
 
@@ -94,7 +321,7 @@ private:
         std::vector<Arg> Args;
     };
 
-    std::unordered_map<std::string, std::function<void(const std::vector<Arg> &)>> m_CommandMap;
+    std::unordered_map<std::string, std::function<void(Connection &, const std::vector<Arg> &)>> m_CommandMap;
 
     Command Parse(const std::string &commandString);
 };
@@ -1,11 +1,14 @@
 #include "TestRunner.h"
 #include "XBDM.h"
 #include "TestServer.h"
+#include "MemoryStorage.h"
 #include "Utils.h"
 
 #include <thread>
+#include <algorithm>
 
 namespace fs = std::filesystem;
+using namespace std::chrono_literals;
 
 int main()
 {
@@ -13,6 +16,25 @@ int main()
     TestServer server;
     TestRunner runner;
 
+    // A second console to make sure consoles listening on different ports are independent
+    server.AddConsole(7301, "SecondTestXDK");
+
+    // A console whose files only exist in memory, to test with content that would be too big for the fixtures
+    auto memoryStorage = std::make_shared<MemoryStorage>();
+    server.AddConsole(7302, "MemoryTestXDK", memoryStorage);
+
+    // A console to replay traces on
+    server.AddConsole(7303, "ReplayTestXDK");
+
+    // Consoles with their own files in memory, to send the same files to several consoles
+    auto firstFleetStorage = std::make_shared<MemoryStorage>();
+    auto secondFleetStorage = std::make_shared<MemoryStorage>();
+    server.AddConsole(7304, "FirstFleetTestXDK", firstFleetStorage);
+    server.AddConsole(7305, "SecondFleetTestXDK", secondFleetStorage);
+
+    // The consoles answer name requests on UDP like on a real network
+    server.EnableDiscovery(7310);
+
     std::thread thread(std::bind(&TestServer::Start, &server));
     server.WaitForServerToListen();
 
@@ -394,6 +416,1844 @@ int main()
         TEST_EQ(throws, true);
     });
 
+    runner.AddTest("Connect to several consoles", [&]() {
+        XBDM::Console secondConsole("127.0.0.1", 7301);
+
+        TEST_EQ(secondConsole.OpenConnection(), true);
+        TEST_EQ(secondConsole.GetName(), "SecondTestXDK");
+        TEST_EQ(console.GetName(), "TestXDK");
+    });
+
+    runner.AddTest("Serve several clients concurrently", [&]() {
+        const size_t clientCount = 16;
+        fs::path pathOnServer = Utils::GetFixtureDir() / "server" / "file.txt";
+        std::vector<std::thread> threads;
+        std::vector<int> results(clientCount, 0);
+
+        for (size_t i = 0; i < clientCount; i++)
+        {
+            threads.emplace_back([&, i]() {
+                fs::path pathOnClient = Utils::GetFixtureDir() / "client" / ("result" + std::to_string(i) + ".txt");
+                XBDM::Console client("127.0.0.1");
+
+                try
+                {
+                    if (!client.OpenConnection())
+                        return;
+
+                    for (size_t j = 0; j < 10; j++)
+                        client.GetType();
+
+                    client.ReceiveFile(pathOnServer.string(), pathOnClient);
+                    results[i] = Utils::CompareFiles(pathOnServer, pathOnClient);
+                }
+                catch (const std::exception &)
+                {
+                }
+
+                fs::remove(pathOnClient);
+            });
+        }
+
+        for (auto &thread : threads)
+            thread.join();
+
+        TEST_EQ(static_cast<size_t>(std::count(results.begin(), results.end(), 1)), clientCount);
+    });
+
+    runner.AddTest("Receive file to a full disk", [&]() {
+        // Writing to /dev/full always fails with ENOSPC, other systems don't have an equivalent
+        if (!fs::exists("/dev/full"))
+            return;
+
+        memoryStorage->AddGeneratedFile("hdd:\\full.bin", 1024 * 1024);
+        XBDM::Console memoryConsole("127.0.0.1", 7302);
+        memoryConsole.OpenConnection();
+
+        std::string error;
+        try
+        {
+            memoryConsole.ReceiveFile("hdd:\\full.bin", "/dev/full");
+        }
+        catch (const std::exception &exception)
+        {
+            error = exception.what();
+        }
+
+        // The whole content was still received so the connection can be used
+        std::string name = memoryConsole.GetName();
+        memoryStorage->Remove("hdd:\\full.bin");
+
+        TEST_EQ(error, "Couldn't write /dev/full");
+        TEST_EQ(fs::exists("/dev/full"), true);
+        TEST_EQ(name, "MemoryTestXDK");
+    });
+
+    runner.AddTest("Receive generated file from in-memory storage", [&]() {
+        const uint64_t fileSize = 5 * 1024 * 1024 + 123;
+        fs::path pathOnClient = Utils::GetFixtureDir() / "client" / "generated.bin";
+        memoryStorage->AddGeneratedFile("hdd:\\generated.bin", fileSize);
+        XBDM::Console memoryConsole("127.0.0.1", 7302);
+
+        TEST_EQ(memoryConsole.OpenConnection(), true);
+        memoryConsole.ReceiveFile("hdd:\\generated.bin", pathOnClient);
+
+        // Compare with what the storage generates instead of keeping a copy of the file
+        std::vector<char> expected(static_cast<size_t>(fileSize));
+        MemoryStorage::GenerateContent("hdd:\\generated.bin", 0, expected.data(), expected.size());
+        std::ifstream file(pathOnClient, std::ifstream::binary);
+        std::vector<char> received((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        file.close();
+
+        TEST_EQ(received == expected, true);
+        TEST_EQ(memoryConsole.GetName(), "MemoryTestXDK");
+
+        fs::remove(pathOnClient);
+        memoryStorage->Remove("hdd:\\generated.bin");
+    });
+
+    runner.AddTest("Get directory contents of a generated tree", [&]() {
+        memoryStorage->AddGeneratedTree("hdd:\\tree", 1000, 1, 4096);
+        XBDM::Console memoryConsole("127.0.0.1", 7302);
+
+        TEST_EQ(memoryConsole.OpenConnection(), true);
+        std::set<XBDM::File> files = memoryConsole.GetDirectoryContents("hdd:\\tree");
+        std::set<XBDM::File> subFiles = memoryConsole.GetDirectoryContents("hdd:\\tree\\directory999");
+        XBDM::File attributes = memoryConsole.GetFileAttributes("hdd:\\tree\\directory999\\file0.bin");
+
+        TEST_EQ(files.size(), 2000);
+        TEST_EQ(subFiles.size(), 1000);
+        TEST_EQ(attributes.Size, 4096);
+        TEST_EQ(attributes.IsDirectory, false);
+
+        memoryStorage->Remove("hdd:\\tree");
+        TEST_EQ(memoryStorage->Exists("hdd:\\tree"), false);
+    });
+
+#ifndef XBDM_DISABLE_STATS
+    runner.AddTest("Collect per-command stats", [&]() {
+        XBDM::Console statsConsole("127.0.0.1", 7301);
+        TEST_EQ(statsConsole.OpenConnection(), true);
+
+        for (size_t i = 0; i < 3; i++)
+            statsConsole.GetType();
+
+        fs::path inexistantPathOnServer = Utils::GetFixtureDir() / "server" / "inexistant";
+        try
+        {
+            statsConsole.GetDirectoryContents(inexistantPathOnServer.string());
+        }
+        catch (const std::exception &)
+        {
+        }
+
+        fs::path pathOnServer = Utils::GetFixtureDir() / "server" / "file.txt";
+        fs::path pathOnClient = Utils::GetFixtureDir() / "client" / "result.txt";
+        statsConsole.ReceiveFile(pathOnServer.string(), pathOnClient);
+        fs::remove(pathOnClient);
+
+        std::vector<XBDM::CommandStats> stats = statsConsole.GetStats();
+        auto findStats = [&](const std::string &name) {
+            return *std::find_if(stats.begin(), stats.end(), [&](const XBDM::CommandStats &commandStats) { return commandStats.Name == name; });
+        };
+
+        TEST_EQ(stats.size(), 3);
+
+        XBDM::CommandStats consoleTypeStats = findStats("consoletype");
+        TEST_EQ(consoleTypeStats.Calls, 3);
+        TEST_EQ(consoleTypeStats.Errors, 0);
+        TEST_EQ(consoleTypeStats.BytesSent, 3 * std::string("consoletype\r\n").size());
+        TEST_EQ(consoleTypeStats.BytesReceived, 3 * std::string("200- reviewerkit\r\n").size());
+        TEST_EQ(consoleTypeStats.LatencyPercentile(100) > 0us, true);
+
+        XBDM::CommandStats dirlistStats = findStats("dirlist");
+        TEST_EQ(dirlistStats.Calls, 1);
+        TEST_EQ(dirlistStats.Errors, 1);
+
+        // The status line, the 4-byte size and the content of the file
+        XBDM::CommandStats getfileStats = findStats("getfile");
+        TEST_EQ(getfileStats.Errors, 0);
+        TEST_EQ(getfileStats.BytesReceived, std::string("203- binary response follows\r\n").size() + 4 + fs::file_size(pathOnServer));
+        TEST_EQ(getfileStats.ReceiveTime <= getfileStats.TotalLatency, true);
+    });
+
+    runner.AddTest("Disable per-command stats", [&]() {
+        XBDM::Console statsConsole("127.0.0.1", 7301);
+        TEST_EQ(statsConsole.OpenConnection(), true);
+
+        statsConsole.GetType();
+        statsConsole.SetStatsEnabled(false);
+        statsConsole.GetType();
+
+        TEST_EQ(statsConsole.GetStats().size(), 1);
+        TEST_EQ(statsConsole.GetStats()[0].Calls, 1);
+
+        statsConsole.ResetStats();
+        TEST_EQ(statsConsole.GetStats().empty(), true);
+    });
+#else
+    runner.AddTest("Compile out per-command stats", [&]() {
+        XBDM::Console statsConsole("127.0.0.1", 7301);
+        TEST_EQ(statsConsole.OpenConnection(), true);
+
+        statsConsole.GetType();
+
+        TEST_EQ(statsConsole.GetStats().empty(), true);
+    });
+#endif
+
+    runner.AddTest("Record a session and replay it", [&]() {
+        fs::path tracePath = Utils::GetFixtureDir() / "client" / "session.trace";
+        fs::path pathOnServer = Utils::GetFixtureDir() / "server" / "file.txt";
+        fs::path recordedPathOnClient = Utils::GetFixtureDir() / "client" / "recorded.txt";
+        fs::path replayedPathOnClient = Utils::GetFixtureDir() / "client" / "replayed.txt";
+
+        XBDM::Console recordedConsole("127.0.0.1", 7301);
+        recordedConsole.StartRecording(tracePath);
+        TEST_EQ(recordedConsole.OpenConnection(), true);
+        std::string recordedType = recordedConsole.GetType();
+        std::set<XBDM::File> recordedFiles = recordedConsole.GetDirectoryContents(Utils::GetFixtureDir().string());
+        recordedConsole.ReceiveFile(pathOnServer.string(), recordedPathOnClient);
+        recordedConsole.StopRecording();
+
+        std::vector<XBDM::TraceEvent> trace = XBDM::ReadTrace(tracePath);
+        TEST_EQ(trace[0].EventType == XBDM::TraceEvent::Type::Connected, true);
+        TEST_EQ(trace[1].Data, "201- connected\r\n");
+        TEST_EQ(trace[2].Data, "consoletype\r\n");
+
+        // The replay server never looks at the files, the replies come from the trace
+        server.SetReplay(7303, trace, 0.0);
+        XBDM::Console replayedConsole("127.0.0.1", 7303);
+        TEST_EQ(replayedConsole.OpenConnection(), true);
+        TEST_EQ(replayedConsole.GetType(), recordedType);
+        TEST_EQ(replayedConsole.GetDirectoryContents(Utils::GetFixtureDir().string()).size(), recordedFiles.size());
+        replayedConsole.ReceiveFile(pathOnServer.string(), replayedPathOnClient);
+        TEST_EQ(Utils::CompareFiles(recordedPathOnClient, replayedPathOnClient), true);
+
+        // Anything that diverges from the trace closes the connection
+        XBDM::Console divergingConsole("127.0.0.1", 7303);
+        TEST_EQ(divergingConsole.OpenConnection(), true);
+        bool diverged = false;
+        try
+        {
+            divergingConsole.GetActiveTitle();
+        }
+        catch (const std::exception &)
+        {
+            diverged = true;
+        }
+        TEST_EQ(diverged, true);
+
+        server.SetReplay(7303, {});
+        fs::remove(tracePath);
+        fs::remove(recordedPathOnClient);
+        fs::remove(replayedPathOnClient);
+    });
+
+    runner.AddTest("Reject a trace with an invalid length", [&]() {
+        fs::path tracePath = Utils::GetFixtureDir() / "client" / "invalid.trace";
+
+        // A Sent event announcing 2^64 - 1 bytes of data, with only a few bytes after it
+        std::string content = "XBDMTRACE\x01";
+        content += '\x01';
+        content += '\x00';
+        content += std::string(9, '\xff') + '\x01';
+        content += "sent";
+        std::ofstream(tracePath, std::ofstream::binary) << content;
+
+        std::string error;
+        try
+        {
+            XBDM::ReadTrace(tracePath);
+        }
+        catch (const std::runtime_error &exception)
+        {
+            error = exception.what();
+        }
+
+        fs::remove(tracePath);
+
+        TEST_EQ(error, "Truncated trace");
+    });
+
+    runner.AddTest("Replay a session with scaled timing", [&]() {
+        fs::path tracePath = Utils::GetFixtureDir() / "client" / "session.trace";
+
+        TestServer::NetworkConditions conditions;
+        conditions.Latency = 40ms;
+        server.SetNetworkConditions(conditions);
+
+        XBDM::Console recordedConsole("127.0.0.1", 7301);
+        recordedConsole.StartRecording(tracePath);
+        TEST_EQ(recordedConsole.OpenConnection(), true);
+        recordedConsole.GetType();
+        recordedConsole.StopRecording();
+
+        server.SetNetworkConditions(TestServer::NetworkConditions());
+
+        auto timeReplay = [&](double timeScale) {
+            server.SetReplay(7303, XBDM::ReadTrace(tracePath), timeScale);
+            XBDM::Console replayedConsole("127.0.0.1", 7303);
+            auto start = std::chrono::steady_clock::now();
+            replayedConsole.OpenConnection();
+            replayedConsole.GetType();
+
+            return std::chrono::steady_clock::now() - start;
+        };
+
+        // The banner and the reply were both delayed by the latency during the recording
+        auto originalTiming = timeReplay(1.0);
+        auto halvedTiming = timeReplay(0.5);
+        auto fastestTiming = timeReplay(0.0);
+
+        server.SetReplay(7303, {});
+        fs::remove(tracePath);
+
+        TEST_EQ(originalTiming >= 2 * conditions.Latency, true);
+        TEST_EQ(halvedTiming >= conditions.Latency && halvedTiming < originalTiming, true);
+        TEST_EQ(fastestTiming < conditions.Latency, true);
+    });
+
+    runner.AddTest("Export operations and commands to a timeline", [&]() {
+        fs::path pathOnServer = Utils::GetFixtureDir() / "server";
+        fs::path pathOnClient = Utils::GetFixtureDir() / "client" / "receivedFolder";
+        auto timeline = std::make_shared<XBDM::Timeline>();
+
+        XBDM::Console timelineConsole("127.0.0.1", 7301);
+        timelineConsole.SetTimeline(timeline);
+        TEST_EQ(timelineConsole.OpenConnection(), true);
+        timelineConsole.ReceiveDirectory(pathOnServer.string(), pathOnClient);
+        fs::remove_all(pathOnClient);
+
+        std::vector<XBDM::Timeline::Span> spans = timeline->GetSpans();
+        auto findSpan = [&](const std::string &name) {
+            return *std::find_if(spans.begin(), spans.end(), [&](const XBDM::Timeline::Span &span) { return span.Name == name; });
+        };
+
+        // The operation contains its commands, which contain their phases
+        XBDM::Timeline::Span receiveDirectory = findSpan("ReceiveDirectory");
+        XBDM::Timeline::Span receiveFile = findSpan("ReceiveFile");
+        XBDM::Timeline::Span getfile = findSpan("getfile");
+        XBDM::Timeline::Span wait = *std::find_if(spans.begin(), spans.end(), [&](const XBDM::Timeline::Span &span) { return span.Name == "wait" && span.Start >= getfile.Start; });
+        TEST_EQ(receiveDirectory.Category, "operation");
+        TEST_EQ(getfile.Category, "command");
+        TEST_EQ(wait.Category, "phase");
+        TEST_EQ(receiveDirectory.Start <= receiveFile.Start && receiveFile.End <= receiveDirectory.End, true);
+        TEST_EQ(receiveFile.Start <= getfile.Start && getfile.End <= receiveFile.End, true);
+        TEST_EQ(getfile.Start <= wait.Start && wait.End <= getfile.End, true);
+        TEST_EQ(std::count_if(spans.begin(), spans.end(), [](const XBDM::Timeline::Span &span) { return span.Category == "command"; }), 2);
+
+        // The formatting of the caller's stream is left as it was
+        std::stringstream chromeTrace;
+        chromeTrace << std::hex;
+        timeline->WriteChromeTrace(chromeTrace);
+        TEST_EQ(chromeTrace.str().find("\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"127.0.0.1:7301\"}") != std::string::npos, true);
+        TEST_EQ(chromeTrace.str().find("\"name\":\"ReceiveDirectory\",\"cat\":\"operation\",\"ph\":\"X\"") != std::string::npos, true);
+        TEST_EQ(chromeTrace.flags() & std::ios::basefield, std::ios::hex);
+        TEST_EQ(chromeTrace.flags() & std::ios::floatfield, 0);
+        TEST_EQ(chromeTrace.precision(), 6);
+    });
+
+    runner.AddTest("Report the progress of a directory transfer", [&]() {
+        fs::path pathOnClient = Utils::GetFixtureDir() / "client" / "receivedTree";
+        memoryStorage->AddGeneratedTree("hdd:\\progressTree", 3, 1, 256 * 1024);
+        XBDM::Console memoryConsole("127.0.0.1", 7302);
+        TEST_EQ(memoryConsole.OpenConnection(), true);
+
+        std::vector<XBDM::TransferProgress> reports;
+        XBDM::TransferOptions options;
+        options.ProgressInterval = 0ms;
+        options.ProgressCallback = [&](const XBDM::TransferProgress &progress) { reports.push_back(progress); };
+        memoryConsole.ReceiveDirectory("hdd:\\progressTree", pathOnClient, options);
+
+        // 3 files at the root and 3 in each of the 3 subdirectories
+        const uint64_t totalBytes = 12 * 256 * 1024;
+        bool increasing = std::is_sorted(reports.begin(), reports.end(), [](const XBDM::TransferProgress &left, const XBDM::TransferProgress &right) { return left.BytesTransferred < right.BytesTransferred; });
+
+        TEST_EQ(reports.size() > 12, true);
+        TEST_EQ(increasing, true);
+        TEST_EQ(reports.front().TotalBytes, totalBytes);
+        TEST_EQ(reports.back().BytesTransferred, totalBytes);
+        TEST_EQ(reports.back().EstimatedTimeRemaining.count(), 0);
+        TEST_EQ(reports.back().AverageBytesPerSecond > 0.0, true);
+        TEST_EQ(reports.back().RemotePath, "hdd:\\progressTree\\file2.bin");
+
+        fs::remove_all(pathOnClient);
+        memoryStorage->Remove("hdd:\\progressTree");
+    });
+
+    runner.AddTest("Cancel a file being received", [&]() {
+        fs::path pathOnClient = Utils::GetFixtureDir() / "client" / "cancelled.bin";
+        memoryStorage->AddGeneratedFile("hdd:\\cancelled.bin", 16 * 1024 * 1024);
+        XBDM::Console memoryConsole("127.0.0.1", 7302);
+        TEST_EQ(memoryConsole.OpenConnection(), true);
+
+        XBDM::TransferOptions options;
+        options.ProgressInterval = 0ms;
+        options.ProgressCallback = [&](const XBDM::TransferProgress &progress) {
+            if (progress.BytesTransferred >= 1024 * 1024)
+                options.Cancellation.Cancel();
+        };
+
+        bool cancelled = false;
+        try
+        {
+            memoryConsole.ReceiveFile("hdd:\\cancelled.bin", pathOnClient, options);
+        }
+        catch (const XBDM::OperationCancelled &)
+        {
+            cancelled = true;
+        }
+
+        TEST_EQ(cancelled, true);
+        TEST_EQ(fs::exists(pathOnClient), false);
+        TEST_EQ(memoryConsole.IsConnected(), true);
+        TEST_EQ(memoryConsole.GetType(), "reviewerkit");
+
+        memoryStorage->Remove("hdd:\\cancelled.bin");
+    });
+
+    runner.AddTest("Cancel a file being sent", [&]() {
+        fs::path pathOnClient = Utils::GetFixtureDir() / "client" / "cancelled.bin";
+        std::ofstream(pathOnClient, std::ofstream::binary) << std::string(16 * 1024 * 1024, 'x');
+        if (!memoryStorage->Exists("hdd:"))
+            memoryStorage->CreateDirectory("hdd:");
+
+        XBDM::Console memoryConsole("127.0.0.1", 7302);
+        TEST_EQ(memoryConsole.OpenConnection(), true);
+        uint64_t deleteCallsBefore = server.GetCommandCount(7302, "delete");
+
+        XBDM::TransferOptions options;
+        options.ProgressInterval = 0ms;
+        options.ProgressCallback = [&](const XBDM::TransferProgress &progress) {
+            if (progress.BytesTransferred >= 1024 * 1024)
+                options.Cancellation.Cancel();
+        };
+
+        bool cancelled = false;
+        try
+        {
+            memoryConsole.SendFile("hdd:\\cancelled.bin", pathOnClient, options);
+        }
+        catch (const XBDM::OperationCancelled &)
+        {
+            cancelled = true;
+        }
+
+        TEST_EQ(cancelled, true);
+        TEST_EQ(memoryConsole.IsConnected(), true);
+        TEST_EQ(memoryConsole.GetType(), "reviewerkit");
+
+        // The test server doesn't actually delete files, so check that the client asked it to
+        TEST_EQ(server.GetCommandCount(7302, "delete") - deleteCallsBefore, 1);
+
+        fs::remove(pathOnClient);
+        memoryStorage->Remove("hdd:\\cancelled.bin");
+    });
+
+    runner.AddTest("Compute checksums of known vectors", [&]() {
+        std::string check = "123456789";
+        std::string abc = "abc";
+
+        XBDM::Crc32c crc;
+        crc.Update(check.data(), check.size());
+        XBDM::XxHash64 emptyXxHash;
+        XBDM::XxHash64 xxHash;
+        xxHash.Update(abc.data(), abc.size());
+        XBDM::Sha256 sha;
+        sha.Update(abc.data(), abc.size());
+        XBDM::Sha256::Digest expectedSha = { 0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+                                             0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad };
+
+        TEST_EQ(crc.Finish(), 0xe3069283);
+        TEST_EQ(emptyXxHash.Finish(), 0xef46db3751d8e999);
+        TEST_EQ(xxHash.Finish(), 0x44bc2cf5ad770999);
+        TEST_EQ(sha.Finish() == expectedSha, true);
+
+        // Feeding the data in uneven pieces must give the same checksums as feeding it at once
+        std::vector<char> data(100000);
+        MemoryStorage::GenerateContent("hdd:\\checksum.bin", 0, data.data(), data.size());
+        XBDM::Crc32c wholeCrc, splitCrc;
+        XBDM::XxHash64 wholeXxHash, splitXxHash;
+        XBDM::Sha256 wholeSha, splitSha;
+        wholeCrc.Update(data.data(), data.size());
+        wholeXxHash.Update(data.data(), data.size());
+        wholeSha.Update(data.data(), data.size());
+        for (size_t offset = 0, length = 1; offset < data.size(); offset += length, length = length * 3 + 1)
+        {
+            length = std::min(length, data.size() - offset);
+            splitCrc.Update(data.data() + offset, length);
+            splitXxHash.Update(data.data() + offset, length);
+            splitSha.Update(data.data() + offset, length);
+        }
+
+        TEST_EQ(splitCrc.Finish(), wholeCrc.Finish());
+        TEST_EQ(splitXxHash.Finish(), wholeXxHash.Finish());
+        TEST_EQ(splitSha.Finish() == wholeSha.Finish(), true);
+    });
+
+    runner.AddTest("Checksum transferred files and write a manifest", [&]() {
+        const uint64_t fileSize = 3 * 1024 * 1024 + 77;
+        fs::path pathOnClient = Utils::GetFixtureDir() / "client" / "checksummed.bin";
+        fs::path manifestPath = Utils::GetFixtureDir() / "client" / "checksummed.txt";
+        memoryStorage->AddGeneratedFile("hdd:\\checksummed.bin", fileSize);
+        XBDM::Console memoryConsole("127.0.0.1", 7302);
+        TEST_EQ(memoryConsole.OpenConnection(), true);
+
+        XBDM::TransferOptions options;
+        options.Checksums = XBDM::ChecksumType::Crc32c | XBDM::ChecksumType::XxHash64 | XBDM::ChecksumType::Sha256;
+        options.ManifestPath = manifestPath;
+        XBDM::TransferResult received = memoryConsole.ReceiveFile("hdd:\\checksummed.bin", pathOnClient, options);
+
+        std::vector<char> expected(static_cast<size_t>(fileSize));
+        MemoryStorage::GenerateContent("hdd:\\checksummed.bin", 0, expected.data(), expected.size());
+        XBDM::Crc32c crc;
+        crc.Update(expected.data(), expected.size());
+        XBDM::XxHash64 xxHash;
+        xxHash.Update(expected.data(), expected.size());
+        XBDM::Sha256 sha;
+        sha.Update(expected.data(), expected.size());
+
+        TEST_EQ(received.BytesTransferred, fileSize);
+        TEST_EQ(received.Files.size(), 1);
+        TEST_EQ(received.Files[0].Size, fileSize);
+        TEST_EQ(received.Files[0].Crc32c, crc.Finish());
+        TEST_EQ(received.Files[0].XxHash64, xxHash.Finish());
+        TEST_EQ(received.Files[0].Sha256 == sha.Finish(), true);
+
+        std::ifstream manifest(manifestPath);
+        std::vector<std::string> lines;
+        for (std::string line; std::getline(manifest, line);)
+            lines.push_back(line);
+        manifest.close();
+
+        std::ostringstream expectedCrcLine;
+        expectedCrcLine << "CRC32C (" << pathOnClient.generic_string() << ") = " << std::hex << std::setw(8) << std::setfill('0') << crc.Finish();
+        TEST_EQ(lines.size(), 3);
+        TEST_EQ(lines[0], expectedCrcLine.str());
+        TEST_EQ(lines[2].rfind("SHA256 (", 0), 0);
+        TEST_EQ(lines[2].size(), std::string("SHA256 (" + pathOnClient.generic_string() + ") = ").size() + 64);
+
+        // Sending the file back goes through the other half of the transfer path
+        options.ManifestPath.clear();
+        XBDM::TransferResult sent = memoryConsole.SendFile("hdd:\\checksummed-copy.bin", pathOnClient, options);
+
+        TEST_EQ(sent.Files.size(), 1);
+        TEST_EQ(sent.Files[0].Crc32c, received.Files[0].Crc32c);
+        TEST_EQ(sent.Files[0].XxHash64, received.Files[0].XxHash64);
+        TEST_EQ(sent.Files[0].Sha256 == received.Files[0].Sha256, true);
+
+        fs::remove(pathOnClient);
+        fs::remove(manifestPath);
+        memoryStorage->Remove("hdd:\\checksummed.bin");
+        memoryStorage->Remove("hdd:\\checksummed-copy.bin");
+    });
+
+    runner.AddTest("Receive a directory into a tar archive", [&]() {
+        memoryStorage->AddGeneratedTree("hdd:\\archiveTree", 2, 1, 3000);
+        XBDM::Console memoryConsole("127.0.0.1", 7302);
+        TEST_EQ(memoryConsole.OpenConnection(), true);
+        time_t modificationDate = memoryConsole.GetFileAttributes("hdd:\\archiveTree\\file0.bin").ModificationDate;
+
+        std::string archive;
+        XBDM::CallbackArchiveSink sink([&](const char *data, size_t length) { archive.append(data, length); });
+        XBDM::TransferResult result = memoryConsole.ReceiveDirectoryToArchive("hdd:\\archiveTree", sink);
+
+        // Read the archive back, checking the checksum of each header and the content of each file
+        auto readOctal = [&](size_t offset, size_t length) { return std::stoull(archive.substr(offset, length), nullptr, 8); };
+        std::vector<std::string> directories;
+        std::vector<std::string> files;
+        bool valid = archive.size() % 512 == 0;
+        size_t offset = 0;
+        while (valid && offset + 512 <= archive.size() && archive[offset] != '\0')
+        {
+            uint64_t checksum = 0;
+            for (size_t i = 0; i < 512; i++)
+                checksum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(archive[offset + i]);
+
+            std::string name = archive.substr(offset, 100).c_str();
+            uint64_t size = readOctal(offset + 124, 12);
+            valid = valid && checksum == readOctal(offset + 148, 7) && archive.compare(offset + 257, 6, std::string("ustar\0", 6)) == 0;
+            valid = valid && readOctal(offset + 136, 12) == static_cast<uint64_t>(modificationDate);
+
+            if (archive[offset + 156] == '5')
+                directories.push_back(name);
+            else
+            {
+                std::vector<char> expected(static_cast<size_t>(size));
+                MemoryStorage::GenerateContent("hdd:/" + name, 0, expected.data(), expected.size());
+                valid = valid && archive.compare(offset + 512, expected.size(), std::string(expected.begin(), expected.end())) == 0;
+                files.push_back(name);
+            }
+
+            offset += 512 + (size + 511) / 512 * 512;
+        }
+
+        TEST_EQ(valid, true);
+        TEST_EQ(archive.size(), offset + 1024);
+        TEST_EQ(directories.size(), 3);
+        TEST_EQ(directories[0], "archiveTree/");
+        TEST_EQ(files.size(), 6);
+        TEST_EQ(std::count(files.begin(), files.end(), "archiveTree/directory1/file0.bin"), 1);
+        TEST_EQ(result.Files.size(), 6);
+        TEST_EQ(result.BytesTransferred, 6 * 3000);
+
+        memoryStorage->Remove("hdd:\\archiveTree");
+    });
+
+    runner.AddTest("Write long paths to a tar archive", [&]() {
+        std::ostringstream stream;
+        XBDM::StreamArchiveSink sink(stream);
+        XBDM::TarWriter writer(sink);
+
+        // Fits the ustar header once split between the prefix and the name
+        std::string splitPath = std::string(120, 'a') + '/' + std::string(60, 'b');
+        // Doesn't fit, needs a pax extended header
+        std::string longPath = std::string(200, 'c');
+
+        writer.BeginFile(splitPath, 3, 0);
+        writer.WriteFileContent("abc", 3);
+        writer.EndFile();
+        writer.BeginFile(longPath, 0, 0);
+        writer.EndFile();
+        writer.Finish();
+
+        std::string archive = stream.str();
+        std::string paxRecord = "210 path=" + longPath + "\n";
+
+        TEST_EQ(archive.size(), 512 * 2 + 512 * 2 + 512 + 1024);
+        TEST_EQ(archive.substr(0, 60), std::string(60, 'b'));
+        TEST_EQ(archive.substr(345, 120), std::string(120, 'a'));
+        TEST_EQ(archive.substr(512, 3), "abc");
+        TEST_EQ(archive[1024 + 156], 'x');
+        TEST_EQ(archive.substr(1536, paxRecord.size()), paxRecord);
+        TEST_EQ(archive[2048 + 156], '0');
+    });
+
+    runner.AddTest("Read and write memory", [&]() {
+        std::shared_ptr<MemorySpace> memory = server.GetMemory(7302);
+        memory->AddRegion(0x82000000, 4 * 1024 * 1024);
+        memory->AddRegion(0x90000000, 64 * 1024, false);
+        XBDM::Console memoryConsole("127.0.0.1", 7302);
+        TEST_EQ(memoryConsole.OpenConnection(), true);
+
+        std::vector<uint8_t> written(3000);
+        for (size_t i = 0; i < written.size(); i++)
+            written[i] = static_cast<uint8_t>(i * 7 + 3);
+
+        memoryConsole.WriteMemory(0x82000100, written);
+        std::vector<uint8_t> read(written.size());
+        memoryConsole.ReadMemory(0x82000100, static_cast<uint32_t>(read.size()), read.data());
+
+        TEST_EQ(read == written, true);
+
+        // Big enough to be split in several pipelined chunks
+        std::vector<char> expected(3 * 1024 * 1024 + 5);
+        MemoryStorage::GenerateContent("memory", 0, expected.data(), expected.size());
+        memory->Write(0x82010000, expected.data(), expected.size());
+        std::vector<char> large(expected.size());
+        memoryConsole.ReadMemory(0x82010000, static_cast<uint32_t>(large.size()), large.data());
+
+        TEST_EQ(large == expected, true);
+
+        bool unmappedReadThrew = false;
+        try
+        {
+            std::vector<char> crossingEnd(0x2000);
+            memoryConsole.ReadMemory(0x823ff000, static_cast<uint32_t>(crossingEnd.size()), crossingEnd.data());
+        }
+        catch (const std::invalid_argument &)
+        {
+            unmappedReadThrew = true;
+        }
+
+        bool readOnlyWriteThrew = false;
+        try
+        {
+            memoryConsole.WriteMemory(0x90000000, written);
+        }
+        catch (const std::invalid_argument &)
+        {
+            readOnlyWriteThrew = true;
+        }
+
+        TEST_EQ(unmappedReadThrew, true);
+        TEST_EQ(readOnlyWriteThrew, true);
+        TEST_EQ(memoryConsole.GetType(), "reviewerkit");
+
+        memory->RemoveRegion(0x82000000);
+        memory->RemoveRegion(0x90000000);
+    });
+
+    runner.AddTest("Batch scattered memory reads", [&]() {
+        std::shared_ptr<MemorySpace> memory = server.GetMemory(7302);
+        memory->AddRegion(0x40000000, 16 * 1024 * 1024);
+        std::vector<char> content(16 * 1024 * 1024);
+        MemoryStorage::GenerateContent("batch", 0, content.data(), content.size());
+        memory->Write(0x40000000, content.data(), content.size());
+
+        XBDM::Console memoryConsole("127.0.0.1", 7302);
+        TEST_EQ(memoryConsole.OpenConnection(), true);
+        uint64_t getMemoryCallsBefore = server.GetCommandCount(7302, "getmemex");
+
+        // Groups of reads close to each other, spread over the region, and one read outside of it
+        std::vector<uint32_t> offsets;
+        for (uint32_t group = 0; group < 100; group++)
+        {
+            for (uint32_t i = 0; i < 4; i++)
+                offsets.push_back(group * 160 * 1024 + i * 100);
+        }
+
+        std::vector<std::array<char, 16>> buffers(offsets.size() + 1);
+        std::vector<XBDM::MemoryRead> reads(buffers.size());
+        for (size_t i = 0; i < offsets.size(); i++)
+        {
+            reads[i].Address = 0x40000000 + offsets[i];
+            reads[i].Length = 16;
+            reads[i].Buffer = buffers[i].data();
+        }
+
+        reads.back().Address = 0x50000000;
+        reads.back().Length = 16;
+        reads.back().Buffer = buffers.back().data();
+
+        memoryConsole.ReadMemory(reads);
+
+        bool allRead = true;
+        for (size_t i = 0; i < offsets.size(); i++)
+            allRead = allRead && reads[i].Succeeded && memcmp(buffers[i].data(), content.data() + offsets[i], 16) == 0;
+
+        uint64_t getMemoryCalls = server.GetCommandCount(7302, "getmemex") - getMemoryCallsBefore;
+
+        TEST_EQ(allRead, true);
+        TEST_EQ(reads.back().Succeeded, false);
+        TEST_EQ(getMemoryCalls, 101);
+        TEST_EQ(memoryConsole.GetType(), "reviewerkit");
+
+        memory->RemoveRegion(0x40000000);
+    });
+
+    runner.AddTest("Find patterns in a buffer", [&]() {
+        std::vector<char> content(5000);
+        MemoryStorage::GenerateContent("patterns", 0, content.data(), content.size());
+        const uint8_t *data = reinterpret_cast<const uint8_t *>(content.data());
+
+        auto findAll = [&](const XBDM::Pattern &pattern, size_t length) {
+            std::vector<size_t> offsets;
+            pattern.Find(data, length, [&](size_t offset) {
+                offsets.push_back(offset);
+                return true;
+            });
+
+            return offsets;
+        };
+
+        auto toHex = [](char byte) {
+            std::ostringstream stream;
+            stream << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(static_cast<uint8_t>(byte));
+
+            return stream.str();
+        };
+
+        // Compare with a naive search for every length so that all the tails of the vectorised kernel are covered
+        XBDM::Pattern signature = XBDM::Pattern::FromSignature("?? " + toHex(content[101]) + " ? " + toHex(content[103]));
+        bool sameAsNaive = true;
+        for (size_t length = 0; length < 300; length++)
+        {
+            std::vector<size_t> expected;
+            for (size_t offset = 0; offset + 4 <= length; offset++)
+            {
+                if (content[offset + 1] == content[101] && content[offset + 3] == content[103])
+                    expected.push_back(offset);
+            }
+
+            sameAsNaive = sameAsNaive && findAll(signature, length) == expected;
+        }
+
+        memcpy(content.data() + 4000, "needle", 6);
+        const uint8_t bigEndianInteger[] = { 0x12, 0x34, 0x56, 0x78 };
+        memcpy(content.data() + 4100, bigEndianInteger, sizeof(bigEndianInteger));
+        const uint8_t bigEndianFloat[] = { 0x3f, 0xc0, 0x00, 0x00 };
+        memcpy(content.data() + 4200, bigEndianFloat, sizeof(bigEndianFloat));
+
+        TEST_EQ(sameAsNaive, true);
+        TEST_EQ(findAll(XBDM::Pattern::FromString("needle"), content.size()) == std::vector<size_t>({ 4000 }), true);
+        TEST_EQ(findAll(XBDM::Pattern::FromInteger(0x12345678, 4), content.size()) == std::vector<size_t>({ 4100 }), true);
+        TEST_EQ(findAll(XBDM::Pattern::FromFloat(1.5f), content.size()) == std::vector<size_t>({ 4200 }), true);
+    });
+
+    runner.AddTest("Scan remote memory", [&]() {
+        std::shared_ptr<MemorySpace> memory = server.GetMemory(7302);
+        memory->AddRegion(0x82000000, 8 * 1024 * 1024);
+        memory->AddRegion(0x82900000, 1024 * 1024);
+        std::vector<char> content(8 * 1024 * 1024);
+        MemoryStorage::GenerateContent("scan", 0, content.data(), content.size());
+        memory->Write(0x82000000, content.data(), content.size());
+
+        // One match at the start, one across the boundary of the first two blocks, one after unmapped memory
+        const std::string signature = "XBDM-SIG";
+        std::vector<uint32_t> planted = { 0x82000000, 0x820ffffd, 0x82345678, 0x82900010 };
+        for (uint32_t address : planted)
+            memory->Write(address, signature.data(), signature.size());
+
+        XBDM::Console memoryConsole("127.0.0.1", 7302);
+        TEST_EQ(memoryConsole.OpenConnection(), true);
+
+        XBDM::Pattern pattern = XBDM::Pattern::FromSignature("58 42 44 4d ?? 53 49 47");
+        std::vector<uint32_t> matches = memoryConsole.ScanMemory(0x82000000, 0x1000000, pattern);
+
+        XBDM::ScanOptions aligned;
+        aligned.Alignment = 8;
+        std::vector<uint32_t> alignedMatches = memoryConsole.ScanMemory(0x82000000, 0x1000000, pattern, aligned);
+
+        XBDM::ScanOptions limited;
+        limited.MaxResults = 2;
+        limited.BlockSize = 64 * 1024;
+        std::vector<uint32_t> limitedMatches = memoryConsole.ScanMemory(0x82000000, 0x1000000, pattern, limited);
+
+        TEST_EQ(matches == planted, true);
+        TEST_EQ(alignedMatches == std::vector<uint32_t>({ 0x82000000, 0x82345678, 0x82900010 }), true);
+        TEST_EQ(limitedMatches == std::vector<uint32_t>({ 0x82000000, 0x820ffffd }), true);
+        TEST_EQ(memoryConsole.GetType(), "reviewerkit");
+
+        memory->RemoveRegion(0x82000000);
+        memory->RemoveRegion(0x82900000);
+    });
+
+    runner.AddTest("Diff memory snapshots", [&]() {
+        std::shared_ptr<MemorySpace> memory = server.GetMemory(7302);
+        memory->AddRegion(0x82000000, 0x10000);
+        memory->AddRegion(0x83000000, 0x1000);
+        std::vector<char> content(0x10000);
+        MemoryStorage::GenerateContent("snapshot", 0, content.data(), content.size());
+        memory->Write(0x82000000, content.data(), content.size());
+
+        XBDM::Console memoryConsole("127.0.0.1", 7302);
+        TEST_EQ(memoryConsole.OpenConnection(), true);
+
+        // The second region ends in the middle of an unmapped page
+        std::vector<XBDM::MemoryRange> regions = { { 0x82000000, 0x10000 }, { 0x83000000, 0x1800 } };
+        XBDM::SnapshotStore store;
+        size_t before = store.Take(memoryConsole, regions);
+        uint64_t storedBefore = store.GetStoredBytes();
+
+        // Two adjacent pages and one on its own
+        const std::string changed = "changed across pages";
+        memory->Write(0x82002ff8, changed.data(), changed.size());
+        memory->Write(0x8200a123, changed.data(), changed.size());
+
+        size_t after = store.Take(memoryConsole, regions);
+        size_t unchanged = store.Take(memoryConsole, regions);
+
+        std::vector<char> original(content.size());
+        store.Read(before, 0x82000000, static_cast<uint32_t>(original.size()), original.data());
+        std::vector<char> modified(content.size());
+        store.Read(after, 0x82000000, static_cast<uint32_t>(modified.size()), modified.data());
+        std::vector<char> expected(content.size());
+        memory->Read(0x82000000, expected.data(), expected.size());
+
+        bool unreadableReadThrew = false;
+        try
+        {
+            std::vector<char> crossingEnd(0x20);
+            store.Read(before, 0x83000ff0, static_cast<uint32_t>(crossingEnd.size()), crossingEnd.data());
+        }
+        catch (const std::invalid_argument &)
+        {
+            unreadableReadThrew = true;
+        }
+
+        std::vector<XBDM::MemoryRange> expectedDiff = { { 0x82002000, 0x2000 }, { 0x8200a000, 0x1000 } };
+        TEST_EQ(store.GetSnapshotCount(), 3);
+        TEST_EQ(storedBefore, 17 * 0x1000);
+        TEST_EQ(store.GetStoredBytes(), 20 * 0x1000);
+        TEST_EQ(store.Diff(before, after) == expectedDiff, true);
+        TEST_EQ(store.Diff(after, unchanged).empty(), true);
+        TEST_EQ(original == content, true);
+        TEST_EQ(modified == expected, true);
+        TEST_EQ(unreadableReadThrew, true);
+
+        memory->RemoveRegion(0x82000000);
+        memory->RemoveRegion(0x83000000);
+    });
+
+    runner.AddTest("Dump memory to a sparse file", [&]() {
+        fs::path dumpPath = Utils::GetFixtureDir() / "client" / "memory.dump";
+
+        // A page in the middle of the first chunk isn't mapped
+        std::shared_ptr<MemorySpace> memory = server.GetMemory(7302);
+        memory->AddRegion(0x82000000, 0x10000);
+        memory->AddRegion(0x82011000, 0x16f000);
+        std::vector<char> content(0x180000);
+        MemoryStorage::GenerateContent("dump", 0, content.data(), content.size());
+        memory->Write(0x82000000, content.data(), 0x10000);
+        memory->Write(0x82011000, content.data() + 0x11000, 0x16f000);
+
+        XBDM::Console memoryConsole("127.0.0.1", 7302);
+        TEST_EQ(memoryConsole.OpenConnection(), true);
+
+        // The second region overlaps the first one and the last one isn't mapped at all
+        std::vector<XBDM::MemoryRange> regions = { { 0x82000000, 0x180000 }, { 0x82008800, 0x100 }, { 0x90000000, 0x10 } };
+        memoryConsole.DumpMemory(regions, dumpPath);
+
+        XBDM::DumpReader reader(dumpPath);
+        std::vector<char> beforeHole(0x10000);
+        reader.Read(0x82000000, static_cast<uint32_t>(beforeHole.size()), beforeHole.data());
+        std::vector<char> afterHole(0x16f000);
+        reader.Read(0x82011000, static_cast<uint32_t>(afterHole.size()), afterHole.data());
+        const uint8_t *page = reader.GetPage(0x82123456);
+
+        bool holeReadThrew = false;
+        try
+        {
+            std::vector<char> crossingHole(0x20);
+            reader.Read(0x8200fff0, static_cast<uint32_t>(crossingHole.size()), crossingHole.data());
+        }
+        catch (const std::invalid_argument &)
+        {
+            holeReadThrew = true;
+        }
+
+        // The header is only written when the dump is finished
+        fs::path unfinishedPath = Utils::GetFixtureDir() / "client" / "unfinished.dump";
+        bool unfinishedOpenThrew = false;
+        {
+            XBDM::DumpWriter writer(unfinishedPath);
+            writer.WritePages(0x82000000, content.data(), 0x1000);
+            try
+            {
+                XBDM::DumpReader unfinished(unfinishedPath);
+            }
+            catch (const std::runtime_error &)
+            {
+                unfinishedOpenThrew = true;
+            }
+        }
+
+        TEST_EQ(reader.GetPageCount(), 0x17f);
+        TEST_EQ(reader.GetRegions() == regions, true);
+        TEST_EQ(std::equal(beforeHole.begin(), beforeHole.end(), content.begin()), true);
+        TEST_EQ(std::equal(afterHole.begin(), afterHole.end(), content.begin() + 0x11000), true);
+        TEST_EQ(page != nullptr && memcmp(page, content.data() + 0x123000, 0x1000) == 0, true);
+        TEST_EQ(reader.GetPage(0x82010000) == nullptr, true);
+        TEST_EQ(reader.GetPage(0x90000000) == nullptr, true);
+        TEST_EQ(holeReadThrew, true);
+        TEST_EQ(unfinishedOpenThrew, true);
+        TEST_EQ(fs::exists(unfinishedPath), false);
+        TEST_EQ(memoryConsole.GetType(), "reviewerkit");
+
+        memory->RemoveRegion(0x82000000);
+        memory->RemoveRegion(0x82011000);
+        fs::remove(dumpPath);
+    });
+
+    runner.AddTest("Watch memory at a fixed rate", [&]() {
+        std::shared_ptr<MemorySpace> memory = server.GetMemory(7302);
+        memory->AddRegion(0x82000000, 0x1000);
+
+        // A frame counter and a position next to it, both big-endian like on the console
+        auto writeFrame = [&](uint32_t frame) {
+            const char bytes[4] = { static_cast<char>(frame >> 24), static_cast<char>(frame >> 16), static_cast<char>(frame >> 8), static_cast<char>(frame) };
+            memory->Write(0x82000000, bytes, sizeof(bytes));
+        };
+        const char position[12] = { 0x3f, static_cast<char>(0xc0), 0, 0, 0x40, 0x20, 0, 0, static_cast<char>(0xc1), 0x20, 0, 0 };
+        memory->Write(0x82000010, position, sizeof(position));
+        writeFrame(0);
+
+        uint64_t getMemoryCallsBefore = server.GetCommandCount(7302, "getmemex");
+
+        XBDM::Console memoryConsole("127.0.0.1", 7302);
+        XBDM::MemoryWatcher watcher(memoryConsole);
+        size_t frameWatch = watcher.Watch(0x82000000, 4);
+        size_t positionWatch = watcher.Watch(0x82000010, 12);
+        size_t unmappedWatch = watcher.Watch(0x90000000, 4);
+        watcher.Start(2ms);
+
+        // The samples are consumed while the sampler is running
+        std::vector<XBDM::WatchSample> samples;
+        for (uint32_t frame = 1; frame <= 100; frame++)
+        {
+            writeFrame(frame);
+            std::this_thread::sleep_for(1ms);
+
+            XBDM::WatchSample sample;
+            while (watcher.Poll(sample))
+                samples.push_back(sample);
+        }
+
+        watcher.Stop();
+        XBDM::WatchSample sample;
+        while (watcher.Poll(sample))
+            samples.push_back(sample);
+
+        XBDM::WatchStats stats = watcher.GetStats();
+        uint64_t getMemoryCalls = server.GetCommandCount(7302, "getmemex") - getMemoryCallsBefore;
+
+        bool framesIncrease = true;
+        bool positionsMatch = true;
+        bool unmappedUnreadable = true;
+        uint32_t lastFrame = 0;
+        for (const XBDM::WatchSample &watchSample : samples)
+        {
+            if (watchSample.WatchId == frameWatch)
+            {
+                framesIncrease = framesIncrease && watchSample.Readable && watchSample.GetUInt32() >= lastFrame;
+                lastFrame = watchSample.GetUInt32();
+            }
+            else if (watchSample.WatchId == positionWatch)
+                positionsMatch = positionsMatch && watchSample.GetFloat(0) == 1.5f && watchSample.GetFloat(4) == 2.5f && watchSample.GetFloat(8) == -10.0f;
+            else if (watchSample.WatchId == unmappedWatch)
+                unmappedUnreadable = unmappedUnreadable && !watchSample.Readable;
+        }
+
+        TEST_EQ(stats.Ticks > 10, true);
+        TEST_EQ(stats.FailedTicks, 0);
+        TEST_EQ(stats.DroppedSamples, 0);
+        TEST_EQ(samples.size(), stats.Ticks * 3);
+        TEST_EQ(framesIncrease, true);
+        TEST_EQ(lastFrame > 0, true);
+        TEST_EQ(positionsMatch, true);
+        TEST_EQ(unmappedUnreadable, true);
+
+        // The two watches next to each other are merged, the unmapped one is pipelined with them
+        TEST_EQ(getMemoryCalls, stats.Ticks * 2);
+
+        memory->RemoveRegion(0x82000000);
+    });
+
+    runner.AddTest("Receive notifications", [&]() {
+        std::mutex mutex;
+        std::condition_variable received;
+        std::vector<XBDM::Notification> notifications;
+        size_t moduleLoads = 0;
+
+        XBDM::NotificationListener listener(console);
+
+        // Unsubscribes itself and throws, which must not keep the next subscribers from being called
+        size_t failingCalls = 0;
+        size_t failingId = 0;
+        failingId = listener.Subscribe([&](const XBDM::Notification &) {
+            failingCalls++;
+            listener.Unsubscribe(failingId);
+            throw std::runtime_error("Subscriber failed");
+        });
+        listener.Subscribe([&](const XBDM::Notification &notification) {
+            std::lock_guard<std::mutex> lock(mutex);
+            notifications.push_back(notification);
+            received.notify_all();
+        });
+        listener.Subscribe(XBDM::NotificationType::ModuleLoad, [&](const XBDM::Notification &) {
+            std::lock_guard<std::mutex> lock(mutex);
+            moduleLoads++;
+        });
+        listener.Start();
+
+        server.SendNotification(730, "modload name=\"default.xex\" base=0x82000000 size=0x00240000");
+        server.SendNotification(730, "debugstr thread=0xf9000010 lf string=Hello world, x=\"1\"");
+        server.SendNotification(730, "execution started");
+        server.SendNotification(730, "custom");
+
+        // The console can still be used while notifications are received on the other connection
+        std::string consoleType = console.GetType();
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            received.wait_for(lock, 2s, [&]() { return notifications.size() >= 4; });
+        }
+
+        listener.Stop();
+
+        TEST_EQ(notifications.size(), 4);
+        TEST_EQ(moduleLoads, 1);
+        TEST_EQ(failingCalls, 1);
+        TEST_EQ(notifications[0].Type == XBDM::NotificationType::ModuleLoad, true);
+        TEST_EQ(notifications[0].GetProperty("name"), "default.xex");
+        TEST_EQ(notifications[0].GetIntegerProperty("base"), 0x82000000);
+        TEST_EQ(notifications[0].GetIntegerProperty("size"), 0x240000);
+        TEST_EQ(notifications[1].Type == XBDM::NotificationType::DebugString, true);
+        TEST_EQ(notifications[1].GetIntegerProperty("thread"), 0xf9000010);
+        TEST_EQ(notifications[1].GetProperty("string"), "Hello world, x=\"1\"");
+        TEST_EQ(notifications[2].Type == XBDM::NotificationType::ExecutionState, true);
+        TEST_EQ(notifications[2].Arguments, "started");
+        TEST_EQ(notifications[3].Type == XBDM::NotificationType::Unknown, true);
+        TEST_EQ(notifications[3].Name, "custom");
+        TEST_EQ(listener.GetDroppedCount(), 0);
+        TEST_EQ(consoleType, "reviewerkit");
+    });
+
+    runner.AddTest("Tail a debug log ring while it is written", [&]() {
+        XBDM::DebugLogRing ring(4);
+        auto now = std::chrono::system_clock::now();
+        for (int i = 0; i < 6; i++)
+        {
+            std::string text = "line " + std::to_string(i);
+            ring.Write(now, 1, text.data(), text.size());
+        }
+
+        // The ring only keeps the last 4 lines
+        XBDM::DebugTail tail;
+        std::vector<XBDM::DebugLine> lines;
+        size_t read = ring.Read(tail, lines);
+
+        XBDM::DebugTail filteredTail;
+        std::vector<XBDM::DebugLine> filteredLines;
+        ring.Read(filteredTail, filteredLines, SIZE_MAX, [](const XBDM::DebugLine &line) { return line.Text == "line 4"; });
+
+        std::string longText(XBDM::DebugLogRing::s_MaxLineSize + 10, 'x');
+        ring.Write(now, 1, longText.data(), longText.size());
+        std::vector<XBDM::DebugLine> longLines;
+        ring.Read(tail, longLines);
+
+        TEST_EQ(read, 4);
+        TEST_EQ(tail.Missed, 2);
+        TEST_EQ(lines.front().Index, 2);
+        TEST_EQ(lines.front().Text, "line 2");
+        TEST_EQ(lines.back().Text, "line 5");
+        TEST_EQ(filteredLines.size(), 1);
+        TEST_EQ(filteredLines[0].Index, 4);
+        TEST_EQ(longLines.size(), 1);
+        TEST_EQ(longLines[0].Truncated, true);
+        TEST_EQ(longLines[0].Text.size(), XBDM::DebugLogRing::s_MaxLineSize);
+
+        // A reader much slower than the writer misses lines but never reads a line being overwritten
+        XBDM::DebugLogRing smallRing(64);
+        const uint64_t lineCount = 200000;
+        std::thread writer([&]() {
+            for (uint64_t i = 0; i < lineCount; i++)
+            {
+                std::string text = "line " + std::to_string(i) + std::string(i % 100, '.');
+                smallRing.Write(now, static_cast<uint32_t>(i), text.data(), text.size());
+            }
+        });
+
+        XBDM::DebugTail concurrentTail;
+        uint64_t concurrentRead = 0;
+        bool consistent = true;
+        while (concurrentTail.Next < lineCount)
+        {
+            std::vector<XBDM::DebugLine> batch;
+            smallRing.Read(concurrentTail, batch, 16);
+            for (const XBDM::DebugLine &line : batch)
+                consistent = consistent && line.Thread == line.Index && line.Text == "line " + std::to_string(line.Index) + std::string(line.Index % 100, '.');
+
+            concurrentRead += batch.size();
+        }
+
+        writer.join();
+
+        TEST_EQ(consistent, true);
+        TEST_EQ(concurrentRead + concurrentTail.Missed, lineCount);
+    });
+
+    runner.AddTest("Capture debug output to rotating log files", [&]() {
+        fs::path logDirectory = Utils::GetFixtureDir() / "client" / "logs";
+        fs::create_directories(logDirectory);
+
+        XBDM::DebugCaptureOptions options;
+        options.ConsoleName = "TestXDK";
+        options.LogPath = logDirectory / "debug.log";
+        options.MaxFileSize = 200;
+        options.MaxFiles = 3;
+        XBDM::DebugOutputCapture capture(console, options);
+        capture.Start();
+
+        // The first line is split in two strings, only the last one ends with a line feed
+        server.SendNotification(730, "debugstr thread=0xf9000010 string=Hello ");
+        server.SendNotification(730, "execution started");
+        server.SendNotification(730, "debugstr thread=0xf9000010 lf string=world");
+        for (int i = 0; i < 20; i++)
+            server.SendNotification(730, "debugstr thread=0xf9000014 lf string=line " + std::to_string(i));
+
+        XBDM::DebugTail tail;
+        std::vector<XBDM::DebugLine> lines;
+        auto deadline = std::chrono::steady_clock::now() + 2s;
+        while (lines.size() < 21 && std::chrono::steady_clock::now() < deadline)
+        {
+            capture.Tail(tail, lines);
+            std::this_thread::sleep_for(5ms);
+        }
+
+        capture.Stop();
+        XBDM::DebugCaptureStats stats = capture.GetStats();
+
+        std::ifstream lastFile(options.LogPath);
+        std::string lastFileContent((std::istreambuf_iterator<char>(lastFile)), std::istreambuf_iterator<char>());
+        lastFile.close();
+
+        TEST_EQ(lines.size(), 21);
+        TEST_EQ(lines[0].Text, "Hello world");
+        TEST_EQ(lines[0].Thread, 0xf9000010);
+        TEST_EQ(lines[20].Text, "line 19");
+        TEST_EQ(stats.Lines, 21);
+        TEST_EQ(stats.DroppedNotifications, 0);
+        TEST_EQ(stats.DroppedFileLines, 0);
+        TEST_EQ(stats.FileFailed, false);
+        TEST_EQ(fs::exists(logDirectory / "debug.1.log"), true);
+        TEST_EQ(fs::exists(logDirectory / "debug.2.log"), true);
+        TEST_EQ(fs::exists(logDirectory / "debug.3.log"), false);
+        TEST_EQ(fs::file_size(options.LogPath) <= options.MaxFileSize, true);
+        TEST_EQ(lastFileContent.find(" [TestXDK] line 19\n") != std::string::npos, true);
+
+        fs::remove_all(logDirectory);
+    });
+
+    runner.AddTest("Report debug log files that can't be written", [&]() {
+        XBDM::DebugCaptureOptions options;
+        options.LogPath = Utils::GetFixtureDir() / "client" / "missing" / "debug.log";
+        XBDM::DebugOutputCapture missingDirectoryCapture(console, options);
+
+        std::string createError;
+        try
+        {
+            missingDirectoryCapture.Start();
+        }
+        catch (const std::runtime_error &exception)
+        {
+            createError = exception.what();
+        }
+
+        TEST_EQ(createError, "Couldn't create " + options.LogPath.string());
+
+        // Writing to /dev/full always fails with ENOSPC, other systems don't have an equivalent
+        if (!fs::exists("/dev/full"))
+            return;
+
+        options.LogPath = "/dev/full";
+        XBDM::DebugOutputCapture fullDiskCapture(console, options);
+        fullDiskCapture.Start();
+
+        server.SendNotification(730, "debugstr thread=0xf9000010 lf string=Hello");
+
+        auto deadline = std::chrono::steady_clock::now() + 2s;
+        while (!fullDiskCapture.GetStats().FileFailed && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(5ms);
+
+        std::string writeError;
+        try
+        {
+            fullDiskCapture.Stop();
+        }
+        catch (const std::runtime_error &exception)
+        {
+            writeError = exception.what();
+        }
+
+        TEST_EQ(fullDiskCapture.GetStats().FileFailed, true);
+        TEST_EQ(writeError, "Couldn't write /dev/full");
+        TEST_EQ(fs::exists("/dev/full"), true);
+    });
+
+    runner.AddTest("Compute tiled framebuffer offsets", [&]() {
+        // Reference values of XGAddress2DTiledOffset for 4-byte pixels: pixels are grouped in
+        // 32x32 tiles of 4 KB stored row of tiles after row of tiles, the width being aligned
+        // to 32, and shuffled inside each tile
+        std::vector<std::array<uint32_t, 4>> vectors = {
+            { 0, 0, 1280, 0 },
+            { 1, 0, 1280, 1 },
+            { 7, 0, 1280, 11 },
+            { 8, 0, 1280, 16 },
+            { 0, 1, 1280, 4 },
+            { 0, 2, 1280, 64 },
+            { 0, 8, 1280, 288 },
+            { 0, 16, 1280, 512 },
+            { 31, 31, 1280, 991 },
+            { 32, 0, 1280, 1024 },
+            { 0, 32, 1280, 40960 },
+            { 1279, 719, 1280, 941535 },
+            { 5, 3, 100, 77 },
+            { 0, 32, 100, 4096 },
+        };
+
+        size_t mismatches = 0;
+        for (const auto &[x, y, width, offset] : vectors)
+        {
+            if (XBDM::GetTiledOffset(x, y, width) != offset)
+                mismatches++;
+        }
+
+        // Each tile covers its own 4 KB, every pixel of it exactly once
+        std::vector<bool> covered(1024, false);
+        bool tileCoveredOnce = true;
+        for (uint32_t y = 32; y < 64; y++)
+        {
+            for (uint32_t x = 64; x < 96; x++)
+            {
+                uint32_t offset = XBDM::GetTiledOffset(x, y, 1280);
+                uint32_t tileStart = (1 * 40 + 2) * 1024;
+
+                if (offset < tileStart || offset >= tileStart + 1024 || covered[offset - tileStart])
+                    tileCoveredOnce = false;
+                else
+                    covered[offset - tileStart] = true;
+            }
+        }
+
+        TEST_EQ(mismatches, 0);
+        TEST_EQ(tileCoveredOnce, true);
+    });
+
+    runner.AddTest("Take a screenshot", [&]() {
+        fs::path pngPath = Utils::GetFixtureDir() / "client" / "screenshot.png";
+        fs::path ppmPath = Utils::GetFixtureDir() / "client" / "screenshot.ppm";
+
+        XBDM::Console screenshotConsole("127.0.0.1", 7301);
+        TEST_EQ(screenshotConsole.OpenConnection(), true);
+
+        XBDM::Image image = screenshotConsole.Screenshot();
+
+        bool pixelsMatch = true;
+        for (uint32_t y = 0; y < image.Height && pixelsMatch; y++)
+        {
+            for (uint32_t x = 0; x < image.Width && pixelsMatch; x++)
+            {
+                uint32_t expected = TestServer::GetScreenPixel(x, y, 0);
+                const uint8_t *pixel = image.Pixels.data() + (static_cast<size_t>(y) * image.Width + x) * 4;
+                pixelsMatch = pixel[0] == ((expected >> 16) & 0xff) && pixel[1] == ((expected >> 8) & 0xff) && pixel[2] == (expected & 0xff) && pixel[3] == 0xff;
+            }
+        }
+
+        screenshotConsole.Screenshot(pngPath);
+        screenshotConsole.Screenshot(ppmPath);
+
+        std::ifstream pngFile(pngPath, std::ios::binary);
+        std::string pngSignature(8, '\0');
+        pngFile.read(pngSignature.data(), pngSignature.size());
+        pngFile.close();
+
+        std::ifstream ppmFile(ppmPath, std::ios::binary);
+        std::string ppmMagic;
+        uint32_t ppmWidth = 0;
+        uint32_t ppmHeight = 0;
+        ppmFile >> ppmMagic >> ppmWidth >> ppmHeight;
+        ppmFile.close();
+
+        TEST_EQ(image.Width, TestServer::s_ScreenWidth);
+        TEST_EQ(image.Height, TestServer::s_ScreenHeight);
+        TEST_EQ(pixelsMatch, true);
+        TEST_EQ(pngSignature, std::string("\x89PNG\r\n\x1a\n"));
+        TEST_EQ(ppmMagic, "P6");
+        TEST_EQ(ppmWidth, TestServer::s_ScreenWidth);
+        TEST_EQ(ppmHeight, TestServer::s_ScreenHeight);
+        TEST_EQ(fs::file_size(ppmPath), 16 + static_cast<uintmax_t>(TestServer::s_ScreenWidth) * TestServer::s_ScreenHeight * 3);
+        TEST_EQ(screenshotConsole.GetType(), "reviewerkit");
+
+        fs::remove(pngPath);
+        fs::remove(ppmPath);
+    });
+
+    runner.AddTest("Record the screen as a delta-encoded frame sequence", [&]() {
+        fs::path sequencePath = Utils::GetFixtureDir() / "client" / "capture.xfs";
+
+        XBDM::Console recordedConsole("127.0.0.1", 7301);
+        TEST_EQ(recordedConsole.OpenConnection(), true);
+
+        XBDM::FrameRecorder recorder(recordedConsole, sequencePath);
+        recorder.Start();
+
+        // The console stays usable while the recorder captures frames on its own connection
+        bool consoleUsable = recordedConsole.GetType() == "reviewerkit";
+
+        auto timeout = std::chrono::steady_clock::now() + 20s;
+        while (recorder.GetStats().Frames < 5 && std::chrono::steady_clock::now() < timeout)
+            std::this_thread::sleep_for(10ms);
+
+        recorder.Stop();
+        XBDM::FrameCaptureStats stats = recorder.GetStats();
+
+        XBDM::FrameSequenceReader reader(sequencePath);
+        XBDM::Image image;
+        std::chrono::microseconds timestamp(0);
+        std::chrono::microseconds previousTimestamp(-1);
+        std::vector<uint32_t> storedBlocks;
+        uint32_t firstFrame = 0;
+        bool pixelsMatch = true;
+        bool timestampsIncrease = true;
+
+        while (reader.ReadFrame(image, timestamp))
+        {
+            // The server counts the frames of each port, the first recorded one is found from
+            // the position of the square
+            if (storedBlocks.empty())
+            {
+                for (uint32_t x = 0; x < image.Width; x++)
+                {
+                    if (memcmp(image.Pixels.data() + (100 * static_cast<size_t>(image.Width) + x) * 4, "\xff\xff\xff\xff", 4) == 0)
+                    {
+                        firstFrame = x / 32;
+                        break;
+                    }
+                }
+            }
+
+            uint32_t frame = firstFrame + static_cast<uint32_t>(storedBlocks.size());
+            for (uint32_t y = 0; y < image.Height && pixelsMatch; y++)
+            {
+                for (uint32_t x = 0; x < image.Width && pixelsMatch; x++)
+                {
+                    uint32_t expected = TestServer::GetScreenPixel(x, y, frame);
+                    const uint8_t *pixel = image.Pixels.data() + (static_cast<size_t>(y) * image.Width + x) * 4;
+                    pixelsMatch = pixel[0] == ((expected >> 16) & 0xff) && pixel[1] == ((expected >> 8) & 0xff) && pixel[2] == (expected & 0xff);
+                }
+            }
+
+            timestampsIncrease = timestampsIncrease && timestamp > previousTimestamp;
+            previousTimestamp = timestamp;
+            storedBlocks.push_back(reader.GetStoredBlockCount());
+        }
+
+        // The square covers 3 rows of tiles and moves by one column of tiles at each frame,
+        // so one column of tiles is uncovered and another one covered
+        bool onlyChangesStored = storedBlocks.size() > 1 && std::all_of(storedBlocks.begin() + 1, storedBlocks.end(), [](uint32_t count) { return count == 6; });
+
+        TEST_EQ(consoleUsable, true);
+        TEST_EQ(stats.Frames >= 5, true);
+        TEST_EQ(storedBlocks.size(), stats.Frames);
+        TEST_EQ(reader.GetInfo().Width, TestServer::s_ScreenWidth);
+        TEST_EQ(storedBlocks.front(), 920);
+        TEST_EQ(onlyChangesStored, true);
+        TEST_EQ(stats.StoredBlocks, 920 + (stats.Frames - 1) * 6);
+        TEST_EQ(stats.BytesWritten, fs::file_size(sequencePath));
+        TEST_EQ(pixelsMatch, true);
+        TEST_EQ(timestampsIncrease, true);
+
+        fs::remove(sequencePath);
+    });
+
+    runner.AddTest("Query a fleet of consoles concurrently", [&]() {
+        XBDM::FleetOptions options;
+        options.Timeout = 300ms;
+        XBDM::ConsoleFleet fleet(options);
+
+        for (size_t i = 0; i < 8; i++)
+            fleet.Add("127.0.0.1", 730);
+
+        // Nothing listens on this port
+        size_t unreachable = fleet.Add("127.0.0.1", 7399);
+
+        // A status takes 7 round trips, the consoles are queried at the same time so the sweep
+        // takes about as long as querying one console
+        TestServer::NetworkConditions conditions;
+        conditions.Latency = 100ms;
+        server.SetNetworkConditions(conditions);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<XBDM::FleetResult<XBDM::ConsoleStatus>> statuses = fleet.GetStatus();
+        auto statusElapsed = std::chrono::steady_clock::now() - start;
+
+        // The consoles not responding in time fail without waiting for each other
+        conditions.Latency = 500ms;
+        server.SetNetworkConditions(conditions);
+
+        start = std::chrono::steady_clock::now();
+        std::vector<XBDM::FleetResult<std::string>> timedOut = fleet.Run<std::string>([](XBDM::Console &fleetConsole) { return fleetConsole.GetType(); });
+        auto timedOutElapsed = std::chrono::steady_clock::now() - start;
+
+        server.SetNetworkConditions(TestServer::NetworkConditions());
+
+        // The connections that timed out are opened again
+        std::vector<XBDM::FleetResult<std::string>> types = fleet.Run<std::string>([](XBDM::Console &fleetConsole) { return fleetConsole.GetType(); });
+
+        auto succeeded = [](const XBDM::FleetOutcome &outcome) { return outcome.Succeeded; };
+
+        TEST_EQ(statuses.size(), 9);
+        TEST_EQ(std::count_if(statuses.begin(), statuses.end(), succeeded), 8);
+        TEST_EQ(statuses[unreachable].Succeeded, false);
+        TEST_EQ(statuses[unreachable].Port, 7399);
+        TEST_EQ(statuses[unreachable].Error.empty(), false);
+        TEST_EQ(statuses[0].Value.Name, "TestXDK");
+        TEST_EQ(statuses[0].Value.Type, "reviewerkit");
+        TEST_EQ(statuses[7].Value.ActiveTitle.String(), "\\Device\\Harddisk0\\SystemExtPartition\\20449700\\dash.xex");
+        TEST_EQ(statuses[7].Value.Drives.size(), 2);
+        TEST_EQ(statuses[3].Duration >= 7 * 100ms, true);
+        TEST_EQ(statusElapsed < 14 * 100ms, true);
+        TEST_EQ(std::count_if(timedOut.begin(), timedOut.end(), succeeded), 0);
+        TEST_EQ(timedOutElapsed < 2 * options.Timeout, true);
+        TEST_EQ(std::count_if(types.begin(), types.end(), succeeded), 8);
+        TEST_EQ(types[5].Value, "reviewerkit");
+    });
+
+    runner.AddTest("Send a directory to a fleet of consoles", [&]() {
+        fs::path localDirectory = Utils::GetFixtureDir() / "client" / "fleet";
+        fs::create_directories(localDirectory / "data");
+
+        std::vector<std::pair<std::string, size_t>> localFiles = { { "default.xex", 3 * 1024 * 1024 + 1234 }, { "data/level.bin", 700000 }, { "data/empty.bin", 0 } };
+        uint64_t totalSize = 0;
+        for (const auto &[name, size] : localFiles)
+        {
+            std::string content(size, '\0');
+            MemoryStorage::GenerateContent(name, 0, content.data(), content.size());
+            std::ofstream(localDirectory / name, std::ofstream::binary) << content;
+            totalSize += size;
+        }
+
+        std::vector<std::shared_ptr<MemoryStorage>> storages = { memoryStorage, firstFleetStorage, secondFleetStorage };
+        for (auto &storage : storages)
+            storage->CreateDirectory("hdd:");
+
+        // The second fleet console already has the directory so only the transfer to it fails
+        secondFleetStorage->CreateDirectory("hdd:\\fleet");
+
+        XBDM::ConsoleFleet fleet;
+        fleet.Add("127.0.0.1", 7302);
+        fleet.Add("127.0.0.1", 7304);
+        fleet.Add("127.0.0.1", 7305);
+        fleet.Add("127.0.0.1", 7399);
+
+        XBDM::FleetTransferOptions options;
+        options.Checksums = XBDM::ChecksumType::Crc32c;
+        XBDM::FleetTransferResult sent = fleet.SendDirectory("hdd:\\fleet", localDirectory, options);
+
+        // Chunks dropped to stay within the memory budget are read again by the consoles behind
+        XBDM::FleetTransferOptions smallBudget;
+        smallBudget.ChunkSize = 256 * 1024;
+        smallBudget.MemoryBudget = 512 * 1024;
+        XBDM::FleetTransferResult sentWithSmallBudget = fleet.SendDirectory("hdd:\\fleetSmallBudget", localDirectory, smallBudget);
+
+        auto remoteContentMatches = [&](MemoryStorage &storage, const std::string &remoteDirectory) {
+            for (const auto &[name, size] : localFiles)
+            {
+                std::string remotePath = remoteDirectory + "\\" + name;
+                std::string expected(size, '\0');
+                std::string content(size, '\0');
+                MemoryStorage::GenerateContent(name, 0, expected.data(), expected.size());
+
+                if (!storage.Exists(remotePath) || storage.FileSize(remotePath) != size || storage.Read(remotePath, 0, content.data(), content.size()) != size || content != expected)
+                    return false;
+            }
+
+            return true;
+        };
+
+        TEST_EQ(sent.Consoles.size(), 4);
+        TEST_EQ(sent.Consoles[0].Succeeded, true);
+        TEST_EQ(sent.Consoles[1].Succeeded, true);
+        TEST_EQ(sent.Consoles[2].Succeeded, false);
+        TEST_EQ(sent.Consoles[2].Error.find("already exists") != std::string::npos, true);
+        TEST_EQ(sent.Consoles[3].Succeeded, false);
+        TEST_EQ(sent.Consoles[3].Port, 7399);
+        TEST_EQ(sent.BytesRead, totalSize);
+        TEST_EQ(sent.Consoles[0].Value.BytesTransferred, totalSize);
+        TEST_EQ(sent.Consoles[1].Value.Files.size(), 3);
+        TEST_EQ(sent.Consoles[0].Value.Files[0].Crc32c, sent.Consoles[1].Value.Files[0].Crc32c);
+        TEST_EQ(remoteContentMatches(*memoryStorage, "hdd:\\fleet"), true);
+        TEST_EQ(remoteContentMatches(*firstFleetStorage, "hdd:\\fleet"), true);
+        TEST_EQ(sentWithSmallBudget.Consoles[0].Succeeded && sentWithSmallBudget.Consoles[1].Succeeded && sentWithSmallBudget.Consoles[2].Succeeded, true);
+        TEST_EQ(sentWithSmallBudget.BytesRead >= totalSize, true);
+        TEST_EQ(remoteContentMatches(*memoryStorage, "hdd:\\fleetSmallBudget"), true);
+        TEST_EQ(remoteContentMatches(*firstFleetStorage, "hdd:\\fleetSmallBudget"), true);
+        TEST_EQ(remoteContentMatches(*secondFleetStorage, "hdd:\\fleetSmallBudget"), true);
+
+        for (auto &storage : storages)
+        {
+            storage->Remove("hdd:\\fleet");
+            storage->Remove("hdd:\\fleetSmallBudget");
+        }
+
+        fs::remove_all(localDirectory);
+    });
+
+    runner.AddTest("Deploy the changed files and launch the title", [&]() {
+        fs::path localDirectory = Utils::GetFixtureDir() / "client" / "deploy";
+        fs::create_directories(localDirectory / "media");
+
+        std::vector<std::pair<std::string, size_t>> localFiles = { { "default.xex", 200000 }, { "media/music.bin", 300000 }, { "media/sounds.bin", 5000 }, { "readme.txt", 0 } };
+        for (const auto &[name, size] : localFiles)
+        {
+            std::string content(size, '\0');
+            MemoryStorage::GenerateContent(name, 0, content.data(), content.size());
+            std::ofstream(localDirectory / name, std::ofstream::binary) << content;
+
+            // Built a while before being deployed
+            fs::last_write_time(localDirectory / name, fs::file_time_type::clock::now() - 1h);
+        }
+
+        if (!firstFleetStorage->Exists("hdd:"))
+            firstFleetStorage->CreateDirectory("hdd:");
+
+        server.SetBootDuration(7304, 50ms);
+
+        XBDM::Console deployConsole("127.0.0.1", 7304);
+        deployConsole.OpenConnection();
+        uint64_t sendFileCallsBefore = server.GetCommandCount(7304, "sendfile");
+
+        XBDM::DeployManifest manifest;
+        manifest.AddDirectory(localDirectory, "hdd:\\Deploy\\Game");
+        XBDM::XboxPath xexPath = "hdd:\\Deploy\\Game\\default.xex";
+
+        XBDM::DeployResult first = deployConsole.DeployAndLaunch(manifest, xexPath);
+
+        // Rebuilt with the same size, only its date changed
+        std::ofstream(localDirectory / "media" / "sounds.bin", std::ofstream::binary) << std::string(5000, 'x');
+        XBDM::DeployResult second = deployConsole.DeployAndLaunch(manifest, xexPath);
+
+        std::string remoteXex(200000, '\0');
+        std::string expectedXex(200000, '\0');
+        std::string remoteSounds(5000, '\0');
+        firstFleetStorage->Read("hdd:\\Deploy\\Game\\default.xex", 0, remoteXex.data(), remoteXex.size());
+        MemoryStorage::GenerateContent("default.xex", 0, expectedXex.data(), expectedXex.size());
+        firstFleetStorage->Read("hdd:\\Deploy\\Game\\media\\sounds.bin", 0, remoteSounds.data(), remoteSounds.size());
+
+        uint64_t sendFileCalls = server.GetCommandCount(7304, "sendfile") - sendFileCallsBefore;
+
+        // Leaves the console on its dashboard for the next tests
+        deployConsole.RebootAndWait();
+        server.SetBootDuration(7304, 0ms);
+        firstFleetStorage->Remove("hdd:\\Deploy");
+        fs::remove_all(localDirectory);
+
+        TEST_EQ(first.Transfer.Files.size(), 4);
+        TEST_EQ(first.Transfer.BytesTransferred, 505000);
+        TEST_EQ(first.Skipped.size(), 0);
+        TEST_EQ(first.Boot.ActiveTitle, xexPath);
+        TEST_EQ(first.TotalDuration >= first.CompareDuration + first.UploadDuration + first.LaunchDuration, true);
+        TEST_EQ(first.LaunchDuration >= 50ms, true);
+        TEST_EQ(second.Transfer.Files.size(), 1);
+        TEST_EQ(second.Transfer.Files[0].RemotePath, "hdd:\\Deploy\\Game\\media\\sounds.bin");
+        TEST_EQ(second.Skipped.size(), 3);
+        TEST_EQ(second.Boot.ActiveTitle, xexPath);
+        TEST_EQ(remoteXex == expectedXex, true);
+        TEST_EQ(remoteSounds, std::string(5000, 'x'));
+        TEST_EQ(sendFileCalls, 5);
+    });
+
+    runner.AddTest("Discover consoles on the network", [&]() {
+        // Broadcasts aren't delivered on the loopback interface so the subnet is swept instead
+        XBDM::DiscoveryOptions options;
+        options.Port = 7310;
+        options.Broadcast = false;
+        options.Subnet = "127.0.0.0/24";
+        options.Timeout = 300ms;
+        XBDM::ConsoleDiscovery discovery(options);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<XBDM::DiscoveredConsole> consoles = discovery.Discover();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        size_t cachedAfterDiscovery = discovery.GetCachedConsoles().size();
+        discovery.ClearCache();
+        size_t cachedAfterClear = discovery.GetCachedConsoles().size();
+
+        std::string secondAddress = discovery.Resolve("SecondTestXDK");
+        std::vector<XBDM::DiscoveredConsole> cachedAfterResolve = discovery.GetCachedConsoles();
+
+        bool missingThrew = false;
+        try
+        {
+            discovery.Resolve("MissingXDK");
+        }
+        catch (const std::runtime_error &)
+        {
+            missingThrew = true;
+        }
+
+        // Addresses found are forgotten once they expire
+        options.CacheExpiry = 0s;
+        XBDM::ConsoleDiscovery expiringDiscovery(options);
+        std::string expiringAddress = expiringDiscovery.Resolve("TestXDK");
+
+        bool invalidSubnetThrew = false;
+        try
+        {
+            options.Subnet = "127.0.0.0/8";
+            XBDM::ConsoleDiscovery invalidDiscovery(options);
+        }
+        catch (const std::invalid_argument &)
+        {
+            invalidSubnetThrew = true;
+        }
+
+        TEST_EQ(consoles.size(), 6);
+        TEST_EQ(consoles[0].Name, "FirstFleetTestXDK");
+        TEST_EQ(consoles[0].IpAddress, "127.0.0.1");
+        TEST_EQ(consoles[5].Name, "TestXDK");
+        TEST_EQ(elapsed < 2 * options.Timeout, true);
+        TEST_EQ(cachedAfterDiscovery, 6);
+        TEST_EQ(cachedAfterClear, 0);
+        TEST_EQ(secondAddress, "127.0.0.1");
+        TEST_EQ(cachedAfterResolve.size(), 1);
+        TEST_EQ(cachedAfterResolve[0].Name, "SecondTestXDK");
+        TEST_EQ(missingThrew, true);
+        TEST_EQ(expiringAddress, "127.0.0.1");
+        TEST_EQ(expiringDiscovery.GetCachedConsoles().size(), 0);
+        TEST_EQ(invalidSubnetThrew, true);
+    });
+
+    runner.AddTest("Reconnect when the console closes the connection", [&]() {
+        fs::path directoryPath = Utils::GetFixtureDir() / "client" / "reconnect";
+
+        XBDM::Console reconnectingConsole("127.0.0.1", 7301);
+        TEST_EQ(reconnectingConsole.OpenConnection(), true);
+
+        // The closed connection is noticed before sending the next command
+        server.DropConnections(7301);
+        std::string typeAfterDrop = reconnectingConsole.GetType();
+
+        // The connection is lost after sending the command, commands only reading from the
+        // console are sent again
+        server.DropConnectionOnNextCommand(7301);
+        std::string typeAfterLostResponse = reconnectingConsole.GetType();
+
+        // Commands changing the console aren't, they could have run before the connection was lost
+        server.DropConnectionOnNextCommand(7301);
+        bool createFailed = false;
+        try
+        {
+            reconnectingConsole.CreateDirectory(directoryPath.string());
+        }
+        catch (const std::exception &)
+        {
+            createFailed = true;
+        }
+
+        std::string nameAfterFailedCreate = reconnectingConsole.GetName();
+        uint64_t reconnections = reconnectingConsole.GetReconnectionCount();
+
+        // A connection closed on purpose stays closed
+        reconnectingConsole.CloseConnection();
+        bool closedFailed = false;
+        try
+        {
+            reconnectingConsole.GetType();
+        }
+        catch (const std::exception &)
+        {
+            closedFailed = true;
+        }
+
+        TEST_EQ(typeAfterDrop, "reviewerkit");
+        TEST_EQ(typeAfterLostResponse, "reviewerkit");
+        TEST_EQ(createFailed, true);
+        TEST_EQ(fs::exists(directoryPath), false);
+        TEST_EQ(nameAfterFailedCreate, "SecondTestXDK");
+        TEST_EQ(reconnections, 3);
+        TEST_EQ(closedFailed, true);
+        TEST_EQ(reconnectingConsole.GetReconnectionCount(), 3);
+    });
+
+    runner.AddTest("Wait for the console to boot", [&]() {
+        server.SetBootDuration(7301, 250ms);
+
+        XBDM::Console bootingConsole("127.0.0.1", 7301);
+        bootingConsole.OpenConnection();
+
+        XBDM::XboxPath gamePath = "hdd:\\Games\\Game\\default.xex";
+        XBDM::XboxPath dashboardPath = "\\Device\\Harddisk0\\SystemExtPartition\\20449700\\dash.xex";
+
+        // Ended by the "execution started" notification
+        XBDM::BootResult launch = bootingConsole.LaunchXexAndWait(gamePath);
+        XBDM::XboxPath titleAfterLaunch = bootingConsole.GetActiveTitle();
+
+        // Noticed by polling, connecting again once the console is back
+        XBDM::BootOptions pollingOptions;
+        pollingOptions.UseNotifications = false;
+        XBDM::BootResult reboot = bootingConsole.RebootAndWait(pollingOptions);
+
+        XBDM::BootOptions impatientOptions;
+        impatientOptions.Timeout = 100ms;
+        bool timedOut = false;
+        try
+        {
+            bootingConsole.LaunchXexAndWait(gamePath, impatientOptions);
+        }
+        catch (const std::exception &)
+        {
+            timedOut = true;
+        }
+
+        // Leaves the console on its dashboard for the next tests
+        XBDM::BootResult secondReboot = bootingConsole.RebootAndWait();
+        server.SetBootDuration(7301, 0ms);
+
+        // The command can't be sent so there is nothing to wait for
+        XBDM::Console unreachableConsole("127.0.0.1", 7399);
+        auto unreachableStart = std::chrono::steady_clock::now();
+        std::string unreachableError;
+        try
+        {
+            unreachableConsole.RebootAndWait();
+        }
+        catch (const std::exception &exception)
+        {
+            unreachableError = exception.what();
+        }
+        auto unreachableDuration = std::chrono::steady_clock::now() - unreachableStart;
+
+        TEST_EQ(launch.ActiveTitle, gamePath);
+        TEST_EQ(titleAfterLaunch, gamePath);
+        TEST_EQ(launch.Notified, true);
+        TEST_EQ(launch.ShutdownDuration.count() > 0, true);
+        TEST_EQ(launch.ReadyDuration >= 250ms, true);
+        TEST_EQ(launch.ReadyDuration < 2s, true);
+        TEST_EQ(reboot.ActiveTitle, dashboardPath);
+        TEST_EQ(reboot.Notified, false);
+        TEST_EQ(reboot.ShutdownDuration.count() > 0, true);
+        TEST_EQ(reboot.ShutdownDuration < reboot.ReadyDuration, true);
+        TEST_EQ(reboot.ReadyDuration >= 250ms, true);
+        TEST_EQ(reboot.Polls > 1, true);
+        TEST_EQ(timedOut, true);
+        TEST_EQ(secondReboot.ActiveTitle, dashboardPath);
+        TEST_EQ(unreachableError, "Lost the connection to 127.0.0.1");
+        TEST_EQ(unreachableDuration < 2s, true);
+    });
+
+    runner.AddTest("Get console type over a link with latency and jitter", [&]() {
+        TestServer::NetworkConditions conditions;
+        conditions.Latency = 50ms;
+        conditions.Jitter = 20ms;
+        conditions.Seed = 42;
+        server.SetNetworkConditions(conditions);
+
+        auto start = std::chrono::steady_clock::now();
+        std::string consoleType = console.GetType();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        server.SetNetworkConditions(TestServer::NetworkConditions());
+
+        TEST_EQ(consoleType, "reviewerkit");
+        TEST_EQ(elapsed >= conditions.Latency, true);
+    });
+
+    runner.AddTest("Receive file split in small segments with delayed ACKs", [&]() {
+        fs::path pathOnServer = Utils::GetFixtureDir() / "server" / "file.txt";
+        fs::path pathOnClient = Utils::GetFixtureDir() / "client" / "result.txt";
+
+        TestServer::NetworkConditions conditions;
+        conditions.SegmentSize = 8;
+        conditions.DelayedAck = 40ms;
+        server.SetNetworkConditions(conditions);
+
+        console.ReceiveFile(pathOnServer.string(), pathOnClient);
+        std::set<XBDM::File> files = console.GetDirectoryContents(Utils::GetFixtureDir().string());
+
+        server.SetNetworkConditions(TestServer::NetworkConditions());
+
+        TEST_EQ(Utils::CompareFiles(pathOnServer, pathOnClient), true);
+        TEST_EQ(files.size(), 3);
+
+        fs::remove(pathOnClient);
+    });
+
+    runner.AddTest("Send file over a link with limited bandwidth", [&]() {
+        fs::path pathOnServer = Utils::GetFixtureDir() / "server" / "result.txt";
+        fs::path pathOnClient = Utils::GetFixtureDir() / "client" / "file.txt";
+
+        TestServer::NetworkConditions conditions;
+        conditions.Bandwidth = 1024;
+        server.SetNetworkConditions(conditions);
+
+        auto start = std::chrono::steady_clock::now();
+        console.SendFile(pathOnServer.string(), pathOnClient);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        server.SetNetworkConditions(TestServer::NetworkConditions());
+
+        // Receiving the file at 1 KB/s should take at least as many milliseconds as the file has bytes
+        TEST_EQ(Utils::CompareFiles(pathOnServer, pathOnClient), true);
+        TEST_EQ(elapsed >= std::chrono::milliseconds(fs::file_size(pathOnClient)), true);
+
+        fs::remove(pathOnServer);
+    });
+
     runner.AddTest("Create an XboxPath", []() {
         XBDM::XboxPath completePath("hdd:\\Games\\MyGame\\default.xex");
         TEST_EQ(completePath.Drive(), "hdd:");